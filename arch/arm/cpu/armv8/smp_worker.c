@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Secondary CPUs running jobs for smp_worker_run(), started with PSCI
+ *
+ * Each CPU listed in the devicetree with the 'psci' enable-method is turned
+ * on with CPU_ON, runs its jobs with the MMU setup of the boot CPU and then
+ * turns itself off again with CPU_OFF. It is then in the same state as
+ * before, ready for the OS to start it.
+ */
+
+#define LOG_CATEGORY	LOGC_BOOT
+
+#include <cpu_func.h>
+#include <cyclic.h>
+#include <log.h>
+#include <malloc.h>
+#include <smp_worker.h>
+#include <time.h>
+#include <asm/armv8/smp_worker.h>
+#include <asm/global_data.h>
+#include <asm/psci.h>
+#include <asm/ptrace.h>
+#include <asm/system.h>
+#include <dm/ofnode.h>
+#include <linux/compiler.h>
+#include <linux/errno.h>
+#include <linux/sizes.h>
+#include <linux/string.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define SMP_WORKER_STACK_SIZE	SZ_16K
+#define SMP_WORKER_OFF_TIMEOUT_MS	100
+
+/* Affinity fields of MPIDR_EL1, as used in the 'reg' property */
+#define MPIDR_HWID_MASK		0xff00ffffffUL
+
+static struct arm_smp_cpu cpus[CONFIG_SMP_WORKERS_MAX + 1];
+static int num_workers = -1;
+
+static ulong psci_call(ulong fn, ulong arg0, ulong arg1, ulong arg2)
+{
+	struct pt_regs regs = {};
+
+	regs.regs[0] = fn;
+	regs.regs[1] = arg0;
+	regs.regs[2] = arg1;
+	regs.regs[3] = arg2;
+	smc_call(&regs);
+
+	return regs.regs[0];
+}
+
+/* Find the secondary CPUs which PSCI can start */
+static int smp_worker_scan(void)
+{
+	ulong boot = read_mpidr() & MPIDR_HWID_MASK;
+	const char *type, *method;
+	ofnode node;
+	int count = 0;
+	u64 mpidr;
+	u32 reg;
+
+	/* Without firmware at EL3 there is no one to answer CPU_ON */
+	if (current_el() == 3)
+		return 0;
+
+	ofnode_for_each_subnode(node, ofnode_path("/cpus")) {
+		if (count == CONFIG_SMP_WORKERS_MAX)
+			break;
+		type = ofnode_read_string(node, "device_type");
+		method = ofnode_read_string(node, "enable-method");
+		if (!ofnode_is_enabled(node) || !type || strcmp("cpu", type) ||
+		    !method || strcmp("psci", method))
+			continue;
+
+		/* 'reg' has one cell or two, depending on #address-cells */
+		if (ofnode_read_u64(node, "reg", &mpidr)) {
+			if (ofnode_read_u32(node, "reg", &reg))
+				continue;
+			mpidr = reg;
+		}
+		if (mpidr != boot)
+			cpus[++count].mpidr = mpidr;
+	}
+	log_debug("%d secondary CPUs for jobs\n", count);
+
+	return count;
+}
+
+int arch_smp_worker_count(void)
+{
+	if (num_workers < 0)
+		num_workers = smp_worker_scan();
+
+	return num_workers;
+}
+
+int arch_smp_worker_start(int cpu, void (*entry)(int cpu))
+{
+	struct arm_smp_cpu *priv = &cpus[cpu];
+	long ret;
+
+	if (cpu < 1 || cpu > arch_smp_worker_count())
+		return -EINVAL;
+	if (priv->stack)
+		return -EBUSY;
+	priv->stack = memalign(16, SMP_WORKER_STACK_SIZE);
+	if (!priv->stack)
+		return -ENOMEM;
+	priv->sp = (ulong)priv->stack + SMP_WORKER_STACK_SIZE;
+	priv->gd = (ulong)gd;
+	priv->entry = entry;
+	priv->cpu = cpu;
+	priv->done = false;
+	smp_worker_save_mmu(priv);
+
+	/* The CPU reads this before turning on its MMU and caches */
+	flush_dcache_range((ulong)priv, (ulong)priv + sizeof(*priv));
+
+	ret = psci_call(ARM_PSCI_0_2_FN64_CPU_ON, priv->mpidr,
+			(ulong)smp_worker_secondary_entry, (ulong)priv);
+	if (ret != ARM_PSCI_RET_SUCCESS) {
+		log_debug("CPU_ON %llx failed (err=%ld)\n", priv->mpidr, ret);
+		free(priv->stack);
+		priv->stack = NULL;
+		return -EIO;
+	}
+
+	return 0;
+}
+
+void __noreturn smp_worker_secondary(struct arm_smp_cpu *priv)
+{
+	priv->entry(priv->cpu);
+
+	/* Make sure the results are seen before the flag */
+	dsb();
+	WRITE_ONCE(priv->done, true);
+	psci_call(ARM_PSCI_0_2_FN_CPU_OFF, 0, 0, 0);
+
+	/* CPU_OFF only returns if it fails */
+	while (1)
+		wfi();
+}
+
+int arch_smp_worker_park(int cpu)
+{
+	struct arm_smp_cpu *priv = &cpus[cpu];
+	ulong start;
+
+	if (cpu < 1 || cpu > arch_smp_worker_count() || !priv->stack)
+		return -EINVAL;
+
+	/* Keep cyclic functions, e.g. the watchdog, going meanwhile */
+	while (!READ_ONCE(priv->done))
+		schedule();
+	dmb();
+
+	/* Wait until the CPU is off and no longer using its stack */
+	start = get_timer(0);
+	while (psci_call(ARM_PSCI_0_2_FN64_AFFINITY_INFO, priv->mpidr, 0, 0) !=
+	       PSCI_AFFINITY_LEVEL_OFF) {
+		if (get_timer(start) > SMP_WORKER_OFF_TIMEOUT_MS)
+			return -ETIMEDOUT;
+	}
+	free(priv->stack);
+	priv->stack = NULL;
+
+	return 0;
+}
+
+int arch_smp_worker_cpu(void)
+{
+	ulong mpidr;
+	int cpu;
+
+	for (cpu = 1; cpu <= num_workers; cpu++) {
+		if (!cpus[cpu].stack)
+			continue;
+		mpidr = read_mpidr() & MPIDR_HWID_MASK;
+		if (cpus[cpu].mpidr == mpidr)
+			return cpu;
+	}
+
+	return 0;
+}
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Secondary CPUs running jobs for smp_worker_run(), started with PSCI
+ */
+
+#ifndef __ASM_ARMV8_SMP_WORKER_H
+#define __ASM_ARMV8_SMP_WORKER_H
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+
+/**
+ * struct arm_smp_cpu - a secondary CPU which can run jobs
+ *
+ * The first part is read by smp_worker_secondary_entry() before it turns on
+ * the MMU, so the boot CPU cleans it to memory before starting the CPU.
+ *
+ * @sp: Initial stack pointer
+ * @gd: Global data pointer, shared with the boot CPU
+ * @mair: Memory attributes, as used by the boot CPU
+ * @tcr: Translation control, as used by the boot CPU
+ * @ttbr0: Page tables, as used by the boot CPU
+ * @sctlr: System control, with the MMU and caches on
+ * @vbar: Exception vectors
+ * @mpidr: Affinity of the CPU, from the 'reg' property of its node
+ * @entry: Function to run, passed @cpu
+ * @cpu: CPU number used by smp_worker_run()
+ * @stack: Stack allocated for the CPU, or NULL if it is not started
+ * @done: Set by the CPU when @entry has returned
+ */
+struct arm_smp_cpu {
+	u64 sp;
+	u64 gd;
+	u64 mair;
+	u64 tcr;
+	u64 ttbr0;
+	u64 sctlr;
+	u64 vbar;
+	u64 mpidr;
+	void (*entry)(int cpu);
+	int cpu;
+	void *stack;
+	bool done;
+};
+
+/**
+ * smp_worker_save_mmu() - save the MMU setup of the boot CPU
+ *
+ * This fills in @mair to @vbar from the registers for the current exception
+ * level.
+ *
+ * @priv: CPU to update
+ */
+void smp_worker_save_mmu(struct arm_smp_cpu *priv);
+
+/**
+ * smp_worker_secondary_entry() - entry point of a secondary CPU
+ *
+ * This is passed to PSCI CPU_ON with @priv as the context ID. It sets up
+ * the MMU, stack and global data as on the boot CPU, then calls
+ * smp_worker_secondary().
+ *
+ * @priv: CPU being started
+ */
+void smp_worker_secondary_entry(struct arm_smp_cpu *priv);
+
+/**
+ * smp_worker_secondary() - run the jobs on a secondary CPU
+ *
+ * This calls the entry function, then turns the CPU off again.
+ *
+ * @priv: CPU being started
+ */
+void __noreturn smp_worker_secondary(struct arm_smp_cpu *priv);
+
+#endif /* __ASM_ARMV8_SMP_WORKER_H */
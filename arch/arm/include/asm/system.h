@@ -87,6 +87,7 @@
 #define HCR_EL2_AMO_EL2		(1 <<  5) /* Route SErrors to EL2             */
 
 #define ID_AA64ISAR0_EL1_RNDR	(0xFUL << 60) /* RNDR random registers */
+#define ID_AA64ISAR0_EL1_CRC32	(0xFUL << 16) /* CRC32 instructions */
 /*
  * ID_AA64ISAR1_EL1 bits definitions
  */
@@ -171,6 +172,15 @@ static inline unsigned int current_el(void)
 	return 3 & (el >> 2);
 }
 
+/* The CRC32 instructions are mandatory from ARMv8.1 but optional before */
+static inline bool cpu_has_crc32(void)
+{
+	unsigned long reg;
+
+	asm volatile("mrs %0, ID_AA64ISAR0_EL1" : "=r" (reg));
+	return reg & ID_AA64ISAR0_EL1_CRC32;
+}
+
 static inline unsigned int get_sctlr(void)
 {
 	unsigned int el;
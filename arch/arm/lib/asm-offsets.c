@@ -19,6 +19,10 @@
 #include <linux/kbuild.h>
 #include <linux/arm-smccc.h>
 
+#if defined(CONFIG_ARM64) && defined(CONFIG_SMP_WORKERS)
+#include <asm/armv8/smp_worker.h>
+#endif
+
 #if defined(CONFIG_MX51) || defined(CONFIG_MX53)
 #include <asm/arch/imx-regs.h>
 #endif
@@ -107,5 +111,12 @@ int main(void)
 #endif
 #endif
 
+#if defined(CONFIG_ARM64) && defined(CONFIG_SMP_WORKERS)
+	DEFINE(SMP_CPU_SP,	offsetof(struct arm_smp_cpu, sp));
+	DEFINE(SMP_CPU_MAIR,	offsetof(struct arm_smp_cpu, mair));
+	DEFINE(SMP_CPU_TTBR0,	offsetof(struct arm_smp_cpu, ttbr0));
+	DEFINE(SMP_CPU_VBAR,	offsetof(struct arm_smp_cpu, vbar));
+#endif
+
 	return 0;
 }
@@ -42,6 +42,12 @@ void __noreturn sandbox_exit(void)
 	os_exit(0);
 }
 
+int initjmp(jmp_buf jmp, void __noreturn (*func)(void), void *stack_base,
+	    size_t stack_sz)
+{
+	return os_initjmp(jmp->data, func, stack_base, stack_sz);
+}
+
 /* delay x useconds */
 void __udelay(unsigned long usec)
 {
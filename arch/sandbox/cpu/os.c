@@ -1032,6 +1032,62 @@ void os_set_time_offset(long offset)
 		       ENV_TIME_OFFSET);
 }
 
+int os_thread_create(void *(*func)(void *arg), void *arg, void **threadp)
+{
+	pthread_t thread;
+	int ret;
+
+	ret = pthread_create(&thread, NULL, func, arg);
+	if (ret)
+		return -ret;
+	*threadp = (void *)thread;
+
+	return 0;
+}
+
+int os_thread_join(void *thread)
+{
+	return -pthread_join((pthread_t)thread, NULL);
+}
+
+/* State passed to os_initjmp_entry() while it sets up its jmp_buf */
+static ucontext_t initjmp_caller;
+static jmp_buf *initjmp_jmp;
+static void (*initjmp_func)(void);
+
+static void os_initjmp_entry(void)
+{
+	void (*func)(void) = initjmp_func;
+
+	/*
+	 * Record this point on the new stack and go straight back to
+	 * os_initjmp(). A later longjmp() returns here and calls the function.
+	 */
+	if (!setjmp(*initjmp_jmp))
+		setcontext(&initjmp_caller);
+	func();
+	os_abort();
+}
+
+int os_initjmp(ulong *jmp, void (*func)(void), void *stack, size_t size)
+{
+	ucontext_t uc;
+
+	if (getcontext(&uc))
+		return -errno;
+	uc.uc_stack.ss_sp = stack;
+	uc.uc_stack.ss_size = size;
+	uc.uc_link = NULL;
+	makecontext(&uc, os_initjmp_entry, 0);
+
+	initjmp_jmp = (jmp_buf *)jmp;
+	initjmp_func = func;
+	if (swapcontext(&initjmp_caller, &uc))
+		return -errno;
+
+	return 0;
+}
+
 void os_localtime(struct rtc_time *rt)
 {
 	time_t t = time(NULL);
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Secondary CPUs for sandbox, emulated with host threads
+ */
+
+#include <dm.h>
+#include <errno.h>
+#include <os.h>
+#include <smp_worker.h>
+#include <asm/test.h>
+
+/**
+ * struct sandbox_smp_cpu - an emulated secondary CPU
+ *
+ * @thread: Host thread running the CPU, or NULL if it is parked
+ * @entry: Function to run
+ * @cpu: CPU number
+ */
+struct sandbox_smp_cpu {
+	void *thread;
+	void (*entry)(int cpu);
+	int cpu;
+};
+
+static struct sandbox_smp_cpu cpus[CONFIG_SMP_WORKERS_MAX + 1];
+static int num_workers = CONFIG_SMP_WORKERS_MAX;
+
+/* CPU running the current host thread; 0 for the main thread */
+static __thread int this_cpu;
+
+void sandbox_smp_set_workers(int count)
+{
+	num_workers = count;
+}
+
+static void *sandbox_smp_thread(void *arg)
+{
+	struct sandbox_smp_cpu *priv = arg;
+
+	this_cpu = priv->cpu;
+	priv->entry(priv->cpu);
+
+	return NULL;
+}
+
+int arch_smp_worker_count(void)
+{
+	return num_workers;
+}
+
+int arch_smp_worker_start(int cpu, void (*entry)(int cpu))
+{
+	struct sandbox_smp_cpu *priv = &cpus[cpu];
+
+	if (priv->thread)
+		return -EBUSY;
+	priv->entry = entry;
+	priv->cpu = cpu;
+
+	return os_thread_create(sandbox_smp_thread, priv, &priv->thread);
+}
+
+int arch_smp_worker_park(int cpu)
+{
+	struct sandbox_smp_cpu *priv = &cpus[cpu];
+	int ret;
+
+	if (!priv->thread)
+		return -EINVAL;
+	ret = os_thread_join(priv->thread);
+	priv->thread = NULL;
+
+	return ret;
+}
+
+int arch_smp_worker_cpu(void)
+{
+	return this_cpu;
+}
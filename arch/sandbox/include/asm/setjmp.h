@@ -32,4 +32,19 @@ typedef struct jmp_buf_data jmp_buf[1];
 int setjmp(jmp_buf jmp);
 __noreturn void longjmp(jmp_buf jmp, int ret);
 
+/**
+ * initjmp() - set up a jmp_buf to start a function on a new stack
+ *
+ * A later longjmp() to @jmp calls @func with the stack pointer at the top of
+ * the stack.
+ *
+ * @jmp: Buffer to set up
+ * @func: Function to call, which must not return
+ * @stack_base: Lowest address of the stack
+ * @stack_sz: Size of the stack in bytes
+ * Return: 0 if OK, -ve on error
+ */
+int initjmp(jmp_buf jmp, void __noreturn (*func)(void), void *stack_base,
+	    size_t stack_sz);
+
 #endif /* _SETJMP_H_ */
@@ -361,4 +361,72 @@ bool sandbox_sf_bootdev_enabled(void);
  */
 void sandbox_sf_set_enable_bootdevs(bool enable);
 
+/**
+ * sandbox_hash_set_rate() - Set the emulated throughput of a hash device
+ *
+ * @dev: Sandbox hash device
+ * @rate: Throughput in MB/s, or 0 to hash submitted data straight away
+ */
+void sandbox_hash_set_rate(struct udevice *dev, uint rate);
+
+/**
+ * sandbox_hash_get_bytes() - Get the number of bytes hashed by a device
+ *
+ * @dev: Sandbox hash device
+ * Returns: number of bytes hashed since the device was probed
+ */
+ulong sandbox_hash_get_bytes(struct udevice *dev);
+
+/**
+ * sandbox_virtio_blk_setup() - Set up the disk of an emulated virtio-blk device
+ *
+ * The virtio-blk device must be removed and probed again to see the change.
+ *
+ * @dev: Sandbox virtio transport device emulating a block device
+ * @blocks: Size of the disk in 512-byte blocks, or 0 for no disk
+ * @seg_max: Maximum number of data segments in a request
+ * @size_max: Maximum size of a data segment in bytes
+ * @indirect: true to offer indirect descriptors
+ * Returns: 0 if OK, -ENOMEM if there is no memory for the disk
+ */
+int sandbox_virtio_blk_setup(struct udevice *dev, ulong blocks, uint seg_max,
+			     uint size_max, bool indirect);
+
+/**
+ * sandbox_virtio_blk_get_counts() - Get activity counts for a virtio-blk device
+ *
+ * @dev: Sandbox virtio transport device emulating a block device
+ * @notifiesp: Returns the number of times the device was notified
+ * @chainsp: Returns the number of descriptor chains processed
+ * @indirectp: Returns the number of those chains which were indirect
+ */
+void sandbox_virtio_blk_get_counts(struct udevice *dev, ulong *notifiesp,
+				   ulong *chainsp, ulong *indirectp);
+
+/**
+ * sandbox_smp_set_workers() - Set the number of emulated secondary CPUs
+ *
+ * @count: Number of secondary CPUs offered to smp_worker_run(), 0 for none
+ */
+void sandbox_smp_set_workers(int count);
+
+/**
+ * sandbox_mmc_get_queue_stats() - Get command-queue activity for an eMMC
+ *
+ * @dev: Sandbox MMC device emulating an eMMC ("sandbox,emmc")
+ * @tasksp: Returns the number of command-queue tasks carried out
+ * @max_tasksp: Returns the most tasks which were queued at once
+ * @packedp: Returns the number of packed reads carried out
+ */
+void sandbox_mmc_get_queue_stats(struct udevice *dev, int *tasksp,
+				 int *max_tasksp, int *packedp);
+
+/**
+ * sandbox_mmc_get_cmd_count() - Get the number of commands sent to an MMC
+ *
+ * @dev: Sandbox MMC device
+ * Return: number of commands received since the device was probed
+ */
+int sandbox_mmc_get_cmd_count(struct udevice *dev);
+
 #endif
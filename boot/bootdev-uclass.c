@@ -11,6 +11,7 @@
 #include <bootflow.h>
 #include <bootmeth.h>
 #include <bootstd.h>
+#include <cyclic.h>
 #include <fs.h>
 #include <log.h>
 #include <malloc.h>
@@ -814,7 +815,17 @@ static int bootdev_hunt_drv(struct bootdev_hunter *info, uint seq, bool show)
 			printf("Hunting with: %s\n",
 			       uclass_get_name(info->uclass));
 		log_debug("Hunting with: %s\n", name);
-		if (info->hunt) {
+
+		/*
+		 * A background job may already be setting up this uclass. If
+		 * it succeeded there is nothing left to hunt; otherwise, or if
+		 * the job is no longer current because the uclass's devices
+		 * were removed (e.g. 'usb stop'), hunt as usual
+		 */
+		ret = cyclic_job_wait_uclass(info->uclass);
+		if (ret != -ESRCH)
+			log_debug("  - job result %d\n", ret);
+		if (ret && info->hunt) {
 			ret = info->hunt(info, show);
 			log_debug("  - hunt result %d\n", ret);
 			if (ret && ret != -ENOENT)
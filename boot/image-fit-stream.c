@@ -0,0 +1,417 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Streaming load of FIT images with external data
+ *
+ * The external data of an image is read in chunks. Each chunk is hashed and
+ * then decompressed (or copied) to the load address before the next one is
+ * read, so that the data only passes through memory once instead of being
+ * read, hashed and decompressed in three separate passes.
+ */
+
+#define LOG_CATEGORY LOGC_BOOT
+
+#include <gzip.h>
+#include <hash.h>
+#include <image.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <watchdog.h>
+#include <linux/libfdt.h>
+#include <linux/zstd.h>
+#include <u-boot/crc.h>
+#include <u-boot/zlib.h>
+
+/* Maximum number of hash nodes in an image which can be streamed */
+#define FIT_STREAM_MAX_HASHES	4
+
+/**
+ * struct fit_stream_hash - a hash being calculated over the image data
+ *
+ * @algo: Hash algorithm
+ * @ctx: Context for progressive hashing
+ * @noffset: Offset of the hash node
+ */
+struct fit_stream_hash {
+	struct hash_algo *algo;
+	void *ctx;
+	int noffset;
+};
+
+/**
+ * struct fit_stream - state of a streaming load
+ *
+ * @comp: Compression type (IH_COMP_...)
+ * @dst: Destination buffer
+ * @dst_size: Size of destination buffer
+ * @out_len: Number of bytes written to @dst so far
+ * @started: true once the first chunk has been processed
+ * @done: true once the end of the compressed stream has been seen
+ * @hash: Hashes being calculated
+ * @hash_count: Number of entries in @hash
+ * @zs: zlib state, for IH_COMP_GZIP
+ * @zds: zstd state, for IH_COMP_ZSTD
+ * @zstd_ws: Workspace for @zds
+ */
+struct fit_stream {
+	int comp;
+	void *dst;
+	ulong dst_size;
+	ulong out_len;
+	bool started;
+	bool done;
+	struct fit_stream_hash hash[FIT_STREAM_MAX_HASHES];
+	int hash_count;
+#if CONFIG_IS_ENABLED(GZIP)
+	z_stream zs;
+#endif
+#if CONFIG_IS_ENABLED(ZSTD)
+	zstd_dstream *zds;
+	void *zstd_ws;
+#endif
+};
+
+/**
+ * struct fit_stream_source - where to read the external data of a FIT
+ *
+ * @fit: FIT structure in memory, or NULL if none
+ * @crc: CRC32 of the FIT structure, to spot it being overwritten
+ * @read: Function to read the FIT
+ * @priv: Private data for @read
+ */
+struct fit_stream_source {
+	const void *fit;
+	u32 crc;
+	fit_stream_read_t read;
+	void *priv;
+};
+
+static struct fit_stream_source fit_source;
+
+static int fit_stream_init_hashes(struct fit_stream *st, const void *fit,
+				  int image_noffset)
+{
+	struct fit_stream_hash *hash;
+	const char *name, *algo;
+	int noffset, ignore, ret;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		name = fit_get_name(fit, noffset, NULL);
+
+		/* Signatures over the image data need the whole image */
+		if (FIT_IMAGE_ENABLE_VERIFY &&
+		    !strncmp(name, FIT_SIG_NODENAME, strlen(FIT_SIG_NODENAME)))
+			return -EPROTONOSUPPORT;
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+
+		if (!fit_image_hash_get_ignore(fit, noffset, &ignore) &&
+		    ignore)
+			continue;
+		if (st->hash_count == FIT_STREAM_MAX_HASHES)
+			return -EPROTONOSUPPORT;
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			return -EINVAL;
+
+		hash = &st->hash[st->hash_count];
+		if (hash_progressive_lookup_algo(algo, &hash->algo))
+			return -EPROTONOSUPPORT;
+		ret = hash->algo->hash_init(hash->algo, &hash->ctx);
+		if (ret)
+			return -ENOMEM;
+		hash->noffset = noffset;
+		st->hash_count++;
+	}
+
+	return 0;
+}
+
+/*
+ * Finish all hashes, freeing their contexts, and check them against the
+ * values in the FIT if @check is true
+ */
+static int fit_stream_finish_hashes(struct fit_stream *st, const void *fit,
+				    int image_noffset, bool check)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, value, FIT_MAX_HASH_LEN);
+	struct fit_stream_hash *hash;
+	int fit_value_len;
+	u8 *fit_value;
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < st->hash_count; i++) {
+		hash = &st->hash[i];
+		hash->algo->hash_finish(hash->algo, hash->ctx, value,
+					FIT_MAX_HASH_LEN);
+		if (!check || ret)
+			continue;
+
+		if (fit_image_hash_get_value(fit, hash->noffset, &fit_value,
+					     &fit_value_len) ||
+		    fit_value_len != hash->algo->digest_size ||
+		    memcmp(value, fit_value, fit_value_len)) {
+			log_err("Bad hash value for '%s' hash node in '%s' image node\n",
+				fit_get_name(fit, hash->noffset, NULL),
+				fit_get_name(fit, image_noffset, NULL));
+			ret = -EPERM;
+		}
+	}
+
+	return ret;
+}
+
+static int fit_stream_init_decomp(struct fit_stream *st)
+{
+	switch (st->comp) {
+	case IH_COMP_NONE:
+		return 0;
+#if CONFIG_IS_ENABLED(GZIP)
+	case IH_COMP_GZIP:
+		st->zs.zalloc = gzalloc;
+		st->zs.zfree = gzfree;
+		if (inflateInit2(&st->zs, -MAX_WBITS) != Z_OK)
+			return -ENOMEM;
+		return 0;
+#endif
+#if CONFIG_IS_ENABLED(ZSTD)
+	case IH_COMP_ZSTD:
+		/* Set up when the frame header is seen */
+		return 0;
+#endif
+	default:
+		/* The decompressor does not support streaming */
+		return -EPROTONOSUPPORT;
+	}
+}
+
+static void fit_stream_end_decomp(struct fit_stream *st)
+{
+#if CONFIG_IS_ENABLED(GZIP)
+	if (st->comp == IH_COMP_GZIP)
+		inflateEnd(&st->zs);
+#endif
+#if CONFIG_IS_ENABLED(ZSTD)
+	free(st->zstd_ws);
+#endif
+}
+
+#if CONFIG_IS_ENABLED(GZIP)
+static int fit_stream_gunzip(struct fit_stream *st, const u8 *data, ulong len)
+{
+	int offset, ret;
+
+	if (!st->started) {
+		/* The gzip header must be within the first chunk */
+		offset = gzip_parse_header(data, len);
+		if (offset < 0)
+			return -EINVAL;
+		data += offset;
+		len -= offset;
+	}
+
+	st->zs.next_in = (u8 *)data;
+	st->zs.avail_in = len;
+	while (st->zs.avail_in && !st->done) {
+		st->zs.next_out = st->dst + st->out_len;
+		st->zs.avail_out = st->dst_size - st->out_len;
+		if (!st->zs.avail_out)
+			return -ENOSPC;
+		ret = inflate(&st->zs, Z_NO_FLUSH);
+		st->out_len = (void *)st->zs.next_out - st->dst;
+		if (ret == Z_STREAM_END)
+			st->done = true;
+		else if (ret != Z_OK)
+			return -EIO;
+	}
+
+	return 0;
+}
+#endif
+
+#if CONFIG_IS_ENABLED(ZSTD)
+static int fit_stream_unzstd(struct fit_stream *st, const u8 *data, ulong len)
+{
+	zstd_in_buffer in = { .src = data, .size = len };
+	zstd_out_buffer out;
+	size_t ret;
+
+	if (!st->started) {
+		zstd_frame_header hdr;
+		size_t wsize;
+
+		/* The frame header must be within the first chunk */
+		ret = zstd_get_frame_header(&hdr, data, len);
+		if (ret)
+			return -EINVAL;
+		wsize = zstd_dstream_workspace_bound(hdr.windowSize);
+		st->zstd_ws = malloc(wsize);
+		if (!st->zstd_ws)
+			return -ENOMEM;
+		st->zds = zstd_init_dstream(hdr.windowSize, st->zstd_ws, wsize);
+		if (!st->zds)
+			return -EINVAL;
+	}
+
+	out.dst = st->dst;
+	out.size = st->dst_size;
+	out.pos = st->out_len;
+	while (in.pos < in.size && !st->done) {
+		if (out.pos == out.size)
+			return -ENOSPC;
+		ret = zstd_decompress_stream(st->zds, &out, &in);
+		if (zstd_is_error(ret)) {
+			log_debug("zstd error %d\n", zstd_get_error_code(ret));
+			return -EIO;
+		}
+		if (!ret)
+			st->done = true;
+	}
+	st->out_len = out.pos;
+
+	return 0;
+}
+#endif
+
+/* Hash a chunk of image data and write it to the destination */
+static int fit_stream_process(struct fit_stream *st, const u8 *data,
+			      ulong len)
+{
+	struct fit_stream_hash *hash;
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < st->hash_count; i++) {
+		hash = &st->hash[i];
+		ret = hash->algo->hash_update(hash->algo, hash->ctx, data, len,
+					      false);
+		if (ret)
+			return -EIO;
+	}
+
+	switch (st->comp) {
+	case IH_COMP_NONE:
+		if (len > st->dst_size - st->out_len)
+			return -ENOSPC;
+		memcpy(st->dst + st->out_len, data, len);
+		st->out_len += len;
+		break;
+#if CONFIG_IS_ENABLED(GZIP)
+	case IH_COMP_GZIP:
+		ret = fit_stream_gunzip(st, data, len);
+		break;
+#endif
+#if CONFIG_IS_ENABLED(ZSTD)
+	case IH_COMP_ZSTD:
+		ret = fit_stream_unzstd(st, data, len);
+		break;
+#endif
+	}
+	st->started = true;
+
+	return ret;
+}
+
+int fit_image_load_stream(const void *fit, int noffset, ulong ext_offset,
+			  ulong align, bool decomp, fit_stream_read_t read,
+			  void *priv, void *dst, ulong dst_size, ulong *lenp)
+{
+	struct fit_stream st = {
+		.dst = dst,
+		.dst_size = dst_size,
+	};
+	ulong start, end, pos, size, chunk, skip;
+	int offset, len, ret;
+	u8 *buf = NULL;
+	u8 comp;
+	long got;
+
+	if (!fit_image_get_data_position(fit, noffset, &offset))
+		start = offset;
+	else if (!fit_image_get_data_offset(fit, noffset, &offset))
+		start = ext_offset + offset;
+	else
+		return -EPROTONOSUPPORT;	/* embedded data */
+
+	if (fit_image_get_data_size(fit, noffset, &len))
+		return -ENOENT;
+	if (!decomp || fit_image_get_comp(fit, noffset, &comp))
+		comp = IH_COMP_NONE;
+	st.comp = comp;
+
+	ret = fit_stream_init_decomp(&st);
+	if (ret)
+		return ret;
+	ret = fit_stream_init_hashes(&st, fit, noffset);
+	if (ret)
+		goto err;
+
+	align = max(align, 1UL);
+	chunk = ALIGN(CONFIG_FIT_STREAM_CHUNK_SIZE, align);
+	buf = malloc_cache_aligned(chunk);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	/* Reads must be aligned, so the first may start before the data */
+	end = start + len;
+	for (pos = ALIGN_DOWN(start, align); pos < end; pos += size) {
+		size = min(chunk, ALIGN(end, align) - pos);
+		got = read(priv, pos, size, buf);
+		if (got < 0 || (ulong)got < min(size, end - pos)) {
+			ret = -EIO;
+			goto err;
+		}
+
+		skip = pos < start ? start - pos : 0;
+		ret = fit_stream_process(&st, buf + skip,
+					 min(size, end - pos) - skip);
+		if (ret)
+			goto err;
+		schedule();
+	}
+
+	if (st.comp != IH_COMP_NONE && !st.done) {
+		log_err("Compressed data for '%s' is truncated\n",
+			fit_get_name(fit, noffset, NULL));
+		ret = -EIO;
+		goto err;
+	}
+
+	free(buf);
+	fit_stream_end_decomp(&st);
+	ret = fit_stream_finish_hashes(&st, fit, noffset, true);
+	if (ret)
+		return ret;
+	*lenp = st.out_len;
+
+	return 0;
+
+err:
+	free(buf);
+	fit_stream_end_decomp(&st);
+	fit_stream_finish_hashes(&st, fit, noffset, false);
+
+	return ret;
+}
+
+void fit_stream_set_source(const void *fit, fit_stream_read_t read,
+			   void *priv)
+{
+	fit_source.fit = read ? fit : NULL;
+	fit_source.read = read;
+	fit_source.priv = priv;
+	if (fit_source.fit)
+		fit_source.crc = crc32(0, fit, fdt_totalsize(fit));
+}
+
+fit_stream_read_t fit_stream_get_source(const void *fit, void **privp)
+{
+	if (!fit_source.fit || fit != fit_source.fit ||
+	    crc32(0, fit, fdt_totalsize(fit)) != fit_source.crc)
+		return NULL;
+	*privp = fit_source.priv;
+
+	return fit_source.read;
+}
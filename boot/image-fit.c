@@ -1151,7 +1151,7 @@ int fit_image_hash_get_value(const void *fit, int noffset, uint8_t **value,
  *     0, on ignore not found
  *     value, on ignore found
  */
-static int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore)
+int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore)
 {
 	int len;
 	int *value;
@@ -1249,7 +1249,8 @@ int fit_set_timestamp(void *fit, int noffset, time_t timestamp)
 int calculate_hash(const void *data, int data_len, const char *name,
 			uint8_t *value, int *value_len)
 {
-#if !defined(USE_HOSTCC) && defined(CONFIG_DM_HASH)
+#if !defined(USE_HOSTCC) && defined(CONFIG_DM_HASH) && \
+	!CONFIG_IS_ENABLED(HASH_OFFLOAD)
 	int rc;
 	enum HASH_ALGO hash_algo;
 	struct udevice *dev;
@@ -1968,21 +1969,159 @@ int fit_get_data_conf_prop(const void *fit, const char *prop_name,
 	return fit_get_data_tail(fit, noffset, data, size);
 }
 
+static int fit_image_check_hashes(const void *fit, int noffset)
+{
+	puts("   Verifying Hash Integrity ... ");
+	if (!fit_image_verify(fit, noffset)) {
+		puts("Bad Data Hash\n");
+		return -EACCES;
+	}
+	puts("OK\n");
+
+	return 0;
+}
+
 static int fit_image_select(const void *fit, int rd_noffset, int verify)
 {
 	fit_image_print(fit, rd_noffset, "   ");
 
-	if (verify) {
-		puts("   Verifying Hash Integrity ... ");
-		if (!fit_image_verify(fit, rd_noffset)) {
-			puts("Bad Data Hash\n");
-			return -EACCES;
-		}
+	if (verify)
+		return fit_image_check_hashes(fit, rd_noffset);
+
+	return 0;
+}
+
+#if CONFIG_IS_ENABLED(FIT_STREAM) && !defined(USE_HOSTCC)
+/* Read from a FIT held in memory, for fit_image_load_stream() */
+static long fit_mem_read(void *priv, ulong offset, ulong size, void *buf)
+{
+	memcpy(buf, priv + offset, size);
+
+	return size;
+}
+
+/* Check whether the control FDT has keys which every image must be signed by */
+static bool fit_image_keys_required(void)
+{
+	const void *blob = gd_fdt_blob();
+	const char *required;
+	int sig_node, noffset;
+
+	if (!FIT_IMAGE_ENABLE_VERIFY || !blob)
+		return false;
+	sig_node = fdt_subnode_offset(blob, 0, FIT_SIG_NODENAME);
+	fdt_for_each_subnode(noffset, blob, sig_node) {
+		required = fdt_getprop(blob, noffset, FIT_KEY_REQUIRED, NULL);
+		if (required && !strcmp(required, "image"))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Check whether an image may be loaded with fit_image_load_stream(), so that
+ * its hashes are checked while it is copied or decompressed rather than in a
+ * separate pass first
+ */
+static bool fit_image_can_stream(const void *fit, int noffset, int verify)
+{
+	int offset;
+
+	if (!verify || IS_ENABLED(CONFIG_FIT_IMAGE_POST_PROCESS) ||
+	    fit_image_keys_required())
+		return false;
+	if (IS_ENABLED(CONFIG_FIT_CIPHER) &&
+	    fdt_subnode_offset(fit, noffset, FIT_CIPHER_NODENAME) >= 0)
+		return false;
+
+	return !fit_image_get_data_position(fit, noffset, &offset) ||
+	       !fit_image_get_data_offset(fit, noffset, &offset);
+}
+
+/*
+ * Load an image's external data to @load, checking its hashes on the way.
+ * Return: 0 if OK, -EPROTONOSUPPORT or -ENOMEM if the image must be loaded
+ * the usual way, -EACCES if a hash is wrong, other -ve on other error
+ */
+static int fit_image_load_streamed(const void *fit, int noffset, bool decomp,
+				   ulong load, ulong max_len, ulong *lenp)
+{
+	fit_stream_read_t read;
+	void *priv;
+	int ret;
+
+	read = fit_stream_get_source(fit, &priv);
+	if (!read) {
+		read = fit_mem_read;
+		priv = (void *)fit;
+	}
+	ret = fit_image_load_stream(fit, noffset, ALIGN(fdt_totalsize(fit), 4),
+				    1, decomp, read, priv,
+				    map_sysmem(load, max_len), max_len, lenp);
+	if (ret == -EPROTONOSUPPORT || ret == -ENOMEM)
+		return ret;
+
+	puts("   Verifying Hash Integrity ... ");
+	switch (ret) {
+	case 0:
 		puts("OK\n");
+		break;
+	case -EPERM:
+		puts("Bad Data Hash\n");
+		return -EACCES;
+	default:
+		printf("Error %d\n", ret);
+		break;
 	}
 
+	return ret;
+}
+
+/*
+ * If only the structure of the FIT is in memory, read an image's external
+ * data to just after it, where it would be if the whole FIT were loaded
+ */
+static int fit_image_fetch_data(const void *fit, int noffset)
+{
+	fit_stream_read_t read;
+	int offset, len;
+	ulong start;
+	void *priv;
+
+	read = fit_stream_get_source(fit, &priv);
+	if (!read)
+		return 0;
+	if (!fit_image_get_data_position(fit, noffset, &offset))
+		start = offset;
+	else if (!fit_image_get_data_offset(fit, noffset, &offset))
+		start = ALIGN(fdt_totalsize(fit), 4) + offset;
+	else
+		return 0;	/* embedded data */
+	if (fit_image_get_data_size(fit, noffset, &len))
+		return -ENOENT;
+	if (read(priv, start, len, (void *)fit + start) != len)
+		return -EIO;
+
 	return 0;
 }
+#else
+static bool fit_image_can_stream(const void *fit, int noffset, int verify)
+{
+	return false;
+}
+
+static int fit_image_fetch_data(const void *fit, int noffset)
+{
+	return 0;
+}
+
+static int fit_image_load_streamed(const void *fit, int noffset, bool decomp,
+				   ulong load, ulong max_len, ulong *lenp)
+{
+	return -EPROTONOSUPPORT;
+}
+#endif
 
 int fit_get_node_from_config(struct bootm_headers *images,
 			     const char *prop_name, ulong addr)
@@ -2065,6 +2204,7 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 	ulong load, load_end, data, len;
 	uint8_t os, comp;
 	const char *prop_name;
+	bool stream, decomp;
 	int ret;
 
 	fit = map_sysmem(addr, 0);
@@ -2138,7 +2278,14 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+	/* If the image can be streamed, its hashes are checked as it loads */
+	stream = fit_image_can_stream(fit, noffset, images->verify);
+	if (!stream && fit_image_fetch_data(fit, noffset)) {
+		printf("Could not read %s subimage data!\n", prop_name);
+		bootstage_error(bootstage_id + BOOTSTAGE_SUB_GET_DATA);
+		return -EIO;
+	}
+	ret = fit_image_select(fit, noffset, images->verify && !stream);
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
@@ -2259,11 +2406,31 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 	comp = IH_COMP_NONE;
 	loadbuf = buf;
 	/* Kernel images get decompressed later in bootm_load_os(). */
-	if (!fit_image_get_comp(fit, noffset, &comp) &&
-	    comp != IH_COMP_NONE &&
-	    !(image_type == IH_TYPE_KERNEL ||
-	      image_type == IH_TYPE_KERNEL_NOLOAD ||
-	      image_type == IH_TYPE_RAMDISK)) {
+	decomp = !fit_image_get_comp(fit, noffset, &comp) &&
+		 comp != IH_COMP_NONE &&
+		 !(image_type == IH_TYPE_KERNEL ||
+		   image_type == IH_TYPE_KERNEL_NOLOAD ||
+		   image_type == IH_TYPE_RAMDISK);
+
+	/* Streaming needs somewhere to load the image other than the FIT */
+	ret = -EPROTONOSUPPORT;
+	if (stream && load != data)
+		ret = fit_image_load_streamed(fit, noffset, decomp, load,
+					      decomp ? len * 20 : len, &len);
+	if (ret != -EPROTONOSUPPORT && ret != -ENOMEM) {
+		if (ret) {
+			bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
+			return ret;
+		}
+		loadbuf = map_sysmem(load, len);
+	} else if (stream && fit_image_fetch_data(fit, noffset)) {
+		printf("Could not read %s subimage data!\n", prop_name);
+		bootstage_error(bootstage_id + BOOTSTAGE_SUB_GET_DATA);
+		return -EIO;
+	} else if (stream && fit_image_check_hashes(fit, noffset)) {
+		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
+		return -EACCES;
+	} else if (decomp) {
 		ulong max_decomp_len = len * 20;
 		if (load == data) {
 			loadbuf = malloc(max_decomp_len);
@@ -471,7 +471,11 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 			ret = -ENOSPC;
 		break;
 	case IH_COMP_GZIP:
-		if (!tools_build() && CONFIG_IS_ENABLED(GZIP))
+		if (!tools_build() && CONFIG_IS_ENABLED(GZIP) &&
+		    CONFIG_IS_ENABLED(DECOMP_PARALLEL))
+			ret = gunzip_parallel(load_buf, unc_len, image_buf,
+					      &image_len);
+		else if (!tools_build() && CONFIG_IS_ENABLED(GZIP))
 			ret = gunzip(load_buf, unc_len, image_buf, &image_len);
 		break;
 	case IH_COMP_BZIP2:
@@ -519,7 +523,10 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 
 			abuf_init_set(&in, image_buf, image_len);
 			abuf_init_set(&out, load_buf, unc_len);
-			ret = zstd_decompress(&in, &out);
+			if (CONFIG_IS_ENABLED(DECOMP_PARALLEL))
+				ret = zstd_decompress_parallel(&in, &out);
+			else
+				ret = zstd_decompress(&in, &out);
 			if (ret >= 0) {
 				image_len = ret;
 				ret = 0;
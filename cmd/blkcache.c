@@ -4,25 +4,67 @@
  * Author: Eric Nelson<eric@nelint.com>
  *
  */
+#include <blk.h>
+#include <bouncebuf.h>
 #include <command.h>
 #include <config.h>
 #include <malloc.h>
 #include <part.h>
 #include <vsprintf.h>
 
+static void blkc_show_dev(struct block_cache_dev_stats *dstats)
+{
+	unsigned lookups = dstats->hits + dstats->misses;
+
+	printf("%-8s %3d %8u %8u %4u%% %9u %4u%% %10llu\n",
+	       blk_get_uclass_name(dstats->iftype), dstats->devnum,
+	       dstats->hits, dstats->misses,
+	       lookups ? dstats->hits * 100 / lookups : 0,
+	       dstats->ra_blocks,
+	       dstats->ra_blocks ?
+			(unsigned)((u64)dstats->ra_used * 100 /
+				   dstats->ra_blocks) : 0,
+	       (unsigned long long)dstats->bytes_saved);
+}
+
 static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 		     int argc, char *const argv[])
 {
+	struct block_cache_dev_stats dstats;
 	struct block_cache_stats stats;
+	int i;
+
+	if (!blkcache_dev_stats(0, &dstats)) {
+		printf("device   num     hits   misses  hit  readahead used  saved bytes\n");
+		for (i = 0; !blkcache_dev_stats(i, &dstats); i++)
+			blkc_show_dev(&dstats);
+		printf("\n");
+	}
+
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
 	       "entries: %u\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
+	       "max cache entries: %u\n"
+	       "entries/set: %u\n",
 	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       stats.max_blocks_per_entry, stats.max_entries, stats.ways);
+
+	if (IS_ENABLED(CONFIG_BOUNCE_BUFFER)) {
+		struct bounce_stats bstats;
+
+		bounce_buffer_get_stats(&bstats);
+		printf("DMA direct bytes: %llu\n"
+		       "DMA bounced bytes: %llu\n"
+		       "DMA split transfers: %u\n",
+		       (unsigned long long)bstats.direct_bytes,
+		       (unsigned long long)bstats.bounced_bytes,
+		       bstats.splits);
+		bounce_buffer_reset_stats();
+	}
+
 	return 0;
 }
 
@@ -72,4 +114,5 @@ U_BOOT_CMD(
 	"show - show and reset statistics\n"
 	"blkcache configure <blocks> <entries> "
 	"- set max blocks per entry and max cache entries\n"
+	"    (blocks is rounded down to a power of two)\n"
 );
@@ -71,6 +71,8 @@ static int do_cyclic_list(struct cmd_tbl *cmdtp, int flag, int argc,
 		       cyclic->name, cyclic->cpu_time_us,
 		       lldiv(freq, 100), do_div(freq, 100));
 	}
+	if (CONFIG_IS_ENABLED(CYCLIC_JOBS))
+		cyclic_jobs_list();
 
 	return 0;
 }
@@ -38,6 +38,11 @@ U_BOOT_CMD(
 	"      If 'bytes' is 0 or omitted, the file is read until the end.\n"
 	"      'pos' gives the file byte position to start reading from.\n"
 	"      If 'pos' is 0 or omitted, the file is read from the start."
+#if CONFIG_IS_ENABLED(FIT_STREAM)
+	"\nload -f <interface> [<dev[:part]> [<addr> [<filename>]]]\n"
+	"    - Load only the structure of a FIT with external data. bootm\n"
+	"      then reads the data of each image it needs from the file."
+#endif
 );
 
 static int do_save_wrapper(struct cmd_tbl *cmdtp, int flag, int argc,
@@ -110,3 +115,25 @@ U_BOOT_CMD(
 	fstypes, 1, 1, do_fstypes_wrapper,
 	"List supported filesystem types", ""
 );
+
+#if CONFIG_IS_ENABLED(FS_CACHE)
+static int do_fs_cache(struct cmd_tbl *cmdtp, int flag, int argc,
+		       char *const argv[])
+{
+	if (argc == 2 && !strcmp(argv[1], "flush"))
+		fs_cache_flush();
+	else if (argc == 1)
+		fs_cache_show();
+	else
+		return CMD_RET_USAGE;
+
+	return 0;
+}
+
+U_BOOT_LONGHELP(fs,
+	"cache - show filesystems kept mounted between commands\n"
+	"fs cache flush - unmount all cached filesystems");
+
+U_BOOT_CMD_WITH_SUBCMDS(fs, "Filesystem mount cache", fs_help_text,
+	U_BOOT_SUBCMD_MKENT(cache, 2, 1, do_fs_cache));
+#endif
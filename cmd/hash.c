@@ -10,8 +10,14 @@
  */
 
 #include <command.h>
+#include <dm.h>
 #include <hash.h>
+#include <malloc.h>
+#include <time.h>
+#include <vsprintf.h>
+#include <u-boot/hash.h>
 #include <linux/ctype.h>
+#include <linux/sizes.h>
 
 #if IS_ENABLED(CONFIG_HASH_VERIFY)
 #define HARGS 6
@@ -19,12 +25,72 @@
 #define HARGS 5
 #endif
 
+static void hash_bench_show(const char *algo, const char *backend,
+			    ulong size, ulong us)
+{
+	/* bytes per microsecond is the same as MB/s */
+	printf("%-12s %-20s %8lu\n", algo, backend, size / max(us, 1UL));
+}
+
+static int hash_bench(ulong size)
+{
+	u8 output[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	ulong start;
+	u8 *buf;
+	int i;
+
+	buf = malloc(size);
+	if (!buf) {
+		printf("Cannot allocate %#lx bytes\n", size);
+		return CMD_RET_FAILURE;
+	}
+	for (i = 0; i < size; i++)
+		buf[i] = i * 7;
+
+	printf("%-12s %-20s %8s\n", "algorithm", "backend", "MB/s");
+	for (i = 0; !hash_get_soft_algo(i, &algo); i++) {
+		start = timer_get_us();
+		algo->hash_func_ws(buf, size, output, algo->chunk_size);
+		hash_bench_show(algo->name, "software", size,
+				timer_get_us() - start);
+
+		if (CONFIG_IS_ENABLED(DM_HASH)) {
+			enum HASH_ALGO id = hash_algo_lookup_by_name(algo->name);
+			struct udevice *dev;
+			int ret;
+
+			uclass_foreach_dev_probe(UCLASS_HASH, dev) {
+				if (!hash_supports(dev, id))
+					continue;
+				start = timer_get_us();
+				ret = hash_digest_wd(dev, id, buf, size, output,
+						     algo->chunk_size);
+				if (ret) {
+					printf("%-12s %-20s (err=%d)\n",
+					       algo->name, dev->name, ret);
+					continue;
+				}
+				hash_bench_show(algo->name, dev->name, size,
+						timer_get_us() - start);
+			}
+		}
+	}
+	free(buf);
+
+	return 0;
+}
+
 static int do_hash(struct cmd_tbl *cmdtp, int flag, int argc,
 		   char *const argv[])
 {
 	char *s;
 	int flags = HASH_FLAG_ENV;
 
+	if (IS_ENABLED(CONFIG_CMD_HASH_BENCH) && argc >= 2 &&
+	    !strcmp(argv[1], "bench"))
+		return hash_bench(argc > 2 ? hextoul(argv[2], NULL) : SZ_1M);
+
 	if (argc < 4)
 		return CMD_RET_USAGE;
 
@@ -53,4 +119,9 @@ U_BOOT_CMD(
 		"    - verify message digest of memory area to immediate value, \n"
 		"      env var or *address"
 #endif
+#if IS_ENABLED(CONFIG_CMD_HASH_BENCH)
+	"\nhash bench [size]\n"
+		"    - show the throughput of each algorithm and backend, hashing\n"
+		"      size bytes (default 1MiB)"
+#endif
 );
@@ -7,10 +7,48 @@
 #include <blk.h>
 #include <command.h>
 #include <dm.h>
+#include <mapmem.h>
 #include <nvme.h>
+#include <time.h>
+#include <linux/math64.h>
 
 static int nvme_curr_dev;
 
+static int do_nvme_bench(char *const argv[])
+{
+	struct nvme_io_stats stats;
+	struct blk_desc *desc;
+	struct udevice *udev;
+	ulong addr, blk, cnt, n, us;
+	void *buf;
+	int ret;
+
+	ret = blk_get_device(UCLASS_NVME, nvme_curr_dev, &udev);
+	if (ret < 0)
+		return CMD_RET_FAILURE;
+	desc = dev_get_uclass_plat(udev);
+
+	addr = hextoul(argv[2], NULL);
+	blk = hextoul(argv[3], NULL);
+	cnt = hextoul(argv[4], NULL);
+
+	nvme_get_io_stats(udev, &stats, true);
+	buf = map_sysmem(addr, cnt << desc->log2blksz);
+	us = timer_get_us();
+	n = blk_dread(desc, blk, cnt, buf);
+	us = max(timer_get_us() - us, 1UL);
+	unmap_sysmem(buf);
+	nvme_get_io_stats(udev, &stats, false);
+
+	printf("%lu blocks read in %lu us: %llu KiB/s\n", n, us,
+	       div_u64(((u64)n << desc->log2blksz) * 1000000 >> 10, us));
+	printf("queue depth %u: %lu commands, %lu doorbells, %lu reaps, max %u in flight\n",
+	       stats.q_depth, stats.cmds, stats.doorbells, stats.reaps,
+	       stats.max_inflight);
+
+	return n == cnt ? CMD_RET_SUCCESS : CMD_RET_FAILURE;
+}
+
 static int do_nvme(struct cmd_tbl *cmdtp, int flag, int argc,
 		   char *const argv[])
 {
@@ -38,6 +76,9 @@ static int do_nvme(struct cmd_tbl *cmdtp, int flag, int argc,
 		}
 	}
 
+	if (argc == 5 && !strncmp(argv[1], "bench", 5))
+		return do_nvme_bench(argv);
+
 	return blk_common_cmd(argc, argv, UCLASS_NVME, &nvme_curr_dev);
 }
 
@@ -52,5 +93,7 @@ U_BOOT_CMD(
 	"nvme read addr blk# cnt - read `cnt' blocks starting at block\n"
 	"     `blk#' to memory address `addr'\n"
 	"nvme write addr blk# cnt - write `cnt' blocks starting at block\n"
-	"     `blk#' from memory address `addr'"
+	"     `blk#' from memory address `addr'\n"
+	"nvme bench addr blk# cnt - time reading `cnt' blocks starting at\n"
+	"     block `blk#' to memory address `addr'"
 );
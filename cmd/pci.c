@@ -16,6 +16,7 @@
 #include <cli.h>
 #include <command.h>
 #include <console.h>
+#include <cyclic.h>
 #include <dm.h>
 #include <init.h>
 #include <asm/processor.h>
@@ -501,6 +502,9 @@ static int do_pci(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 	int ret = 0;
 	char *endp;
 
+	/* Let a background 'pci' job finish first */
+	cyclic_job_wait_uclass(UCLASS_PCI);
+
 	if (argc > 1)
 		cmd = argv[1][0];
 
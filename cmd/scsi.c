@@ -9,6 +9,7 @@
  */
 #include <blk.h>
 #include <command.h>
+#include <cyclic.h>
 #include <scsi.h>
 
 static int scsi_curr_dev; /* current device */
@@ -30,6 +31,9 @@ static int do_scsi(struct cmd_tbl *cmdtp, int flag, int argc,
 {
 	int ret;
 
+	/* Let a background 'scsi' job finish first */
+	cyclic_job_wait_uclass(UCLASS_SCSI);
+
 	if (argc == 2) {
 		if (strncmp(argv[1], "res", 3) == 0) {
 			printf("\nReset SCSI\n");
@@ -14,6 +14,7 @@
 #include <malloc.h>
 #include <mapmem.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <time.h>
 #include <spi_flash.h>
 #include <asm/cache.h>
@@ -585,6 +586,91 @@ static int do_spi_flash_test(int argc, char *const argv[])
 	return 0;
 }
 
+/**
+ * spi_flash_proto_name() - Get the name of a SPI NOR protocol
+ *
+ * The name gives the bus width of the command, address and data phases, with
+ * a 'D' after each one that uses double transfer rate, e.g. "1-1-4" or
+ * "8D-8D-8D".
+ *
+ * @proto:	Protocol to describe
+ * @buf:	Buffer for the name
+ * @size:	Size of @buf
+ * Return: @buf
+ */
+static char *spi_flash_proto_name(enum spi_nor_protocol proto, char *buf,
+				  int size)
+{
+	const char *dtr = spi_nor_protocol_is_dtr(proto) ? "D" : "";
+
+	snprintf(buf, size, "%u%s-%u%s-%u%s",
+		 spi_nor_get_protocol_inst_nbits(proto), dtr,
+		 spi_nor_get_protocol_addr_nbits(proto), dtr,
+		 spi_nor_get_protocol_data_nbits(proto), dtr);
+
+	return buf;
+}
+
+static int do_spi_flash_bench(int argc, char *const argv[])
+{
+	bool dirmap = false;
+	unsigned long offset;
+	unsigned long len;
+	ulong start, us;
+	char proto[20];
+	u8 *buf;
+	char *endp;
+	u64 speed;
+	int ret;
+
+	if (argc < 3)
+		return CMD_RET_USAGE;
+	offset = hextoul(argv[1], &endp);
+	if (*argv[1] == 0 || *endp != 0)
+		return CMD_RET_USAGE;
+	len = hextoul(argv[2], &endp);
+	if (*argv[2] == 0 || *endp != 0 || !len)
+		return CMD_RET_USAGE;
+
+	if (offset + len > flash->size) {
+		printf("ERROR: attempting %s past flash size (%#x)\n",
+		       argv[0], flash->size);
+		return CMD_RET_FAILURE;
+	}
+
+	buf = memalign(ARCH_DMA_MINALIGN, len);
+	if (!buf) {
+		printf("Cannot allocate memory (%lu bytes)\n", len);
+		return CMD_RET_FAILURE;
+	}
+
+	start = timer_get_us();
+	ret = spi_flash_read(flash, offset, len, buf);
+	us = timer_get_us() - start;
+	free(buf);
+	if (ret) {
+		printf("Read failed (err = %d)\n", ret);
+		return CMD_RET_FAILURE;
+	}
+
+	if (CONFIG_IS_ENABLED(SPI_DIRMAP) && flash->dirmap.rdesc)
+		dirmap = !flash->dirmap.rdesc->nodirmap;
+
+	/*
+	 * Bytes per microsecond are MB/s; keep two decimal places, avoiding a
+	 * division by zero on very fast reads
+	 */
+	speed = (u64)len * 100;
+	do_div(speed, max(us, 1UL));
+
+	printf("SF: read %s, opcode 0x%02x%s: %lu bytes in %lu us, %llu.%02u MB/s\n",
+	       spi_flash_proto_name(flash->read_proto, proto, sizeof(proto)),
+	       flash->read_opcode, dirmap ? ", dirmap" : "", len, us,
+	       speed / 100, (uint)(speed % 100));
+
+	return CMD_RET_SUCCESS;
+}
+
 static int do_spi_flash(struct cmd_tbl *cmdtp, int flag, int argc,
 			char *const argv[])
 {
@@ -617,6 +703,8 @@ static int do_spi_flash(struct cmd_tbl *cmdtp, int flag, int argc,
 		ret = do_spi_protect(argc, argv);
 	else if (IS_ENABLED(CONFIG_CMD_SF_TEST) && !strcmp(cmd, "test"))
 		ret = do_spi_flash_test(argc, argv);
+	else if (IS_ENABLED(CONFIG_CMD_SF_BENCH) && !strcmp(cmd, "bench"))
+		ret = do_spi_flash_bench(argc, argv);
 	else
 		ret = CMD_RET_USAGE;
 
@@ -644,6 +732,9 @@ U_BOOT_LONGHELP(sf,
 #endif
 #ifdef CONFIG_CMD_SF_TEST
 	"\nsf test offset len		- run a very basic destructive test"
+#endif
+#ifdef CONFIG_CMD_SF_BENCH
+	"\nsf bench offset len		- measure the read speed"
 #endif
 	);
 
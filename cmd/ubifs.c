@@ -104,6 +104,19 @@ static int do_ubifs_ls(struct cmd_tbl *cmdtp, int flag, int argc,
 	return ret;
 }
 
+static int do_ubifs_info(struct cmd_tbl *cmdtp, int flag, int argc,
+			 char *const argv[])
+{
+	if (!ubifs_mounted) {
+		printf("UBIFS not mounted, use ubifsmount to mount volume first!\n");
+		return CMD_RET_FAILURE;
+	}
+
+	ubifs_stats();
+
+	return 0;
+}
+
 static int do_ubifs_load(struct cmd_tbl *cmdtp, int flag, int argc,
 			 char *const argv[])
 {
@@ -163,6 +176,12 @@ U_BOOT_CMD(
 	"    - list files in a 'directory' (default '/')"
 );
 
+U_BOOT_CMD(
+	ubifsinfo, 1, 0, do_ubifs_info,
+	"show UBIFS cache statistics",
+	"    - show index cache and bulk-read statistics of the mounted volume"
+);
+
 U_BOOT_CMD(
 	ubifsload, 4, 0, do_ubifs_load,
 	"load file from an UBIFS filesystem",
@@ -14,6 +14,7 @@
 #include <bootstage.h>
 #include <command.h>
 #include <console.h>
+#include <cyclic.h>
 #include <dm.h>
 #include <dm/uclass-internal.h>
 #include <memalign.h>
@@ -607,6 +608,9 @@ static int do_usb(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 	if (argc < 2)
 		return CMD_RET_USAGE;
 
+	/* Let a background 'usb' job finish first */
+	cyclic_job_wait_uclass(UCLASS_USB);
+
 	if (strncmp(argv[1], "start", 5) == 0) {
 		if (usb_started)
 			return 0; /* Already started */
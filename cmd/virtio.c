@@ -7,11 +7,51 @@
 #include <blk.h>
 #include <command.h>
 #include <dm.h>
+#include <mapmem.h>
+#include <time.h>
 #include <virtio_types.h>
 #include <virtio.h>
+#include <linux/math64.h>
 
 static int virtio_curr_dev;
 
+static int do_virtio_bench(char *const argv[])
+{
+	struct virtio_blk_stats old, stats;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	ulong addr, blk, cnt, n, us;
+	void *buf;
+	int ret;
+
+	ret = blk_get_device(UCLASS_VIRTIO, virtio_curr_dev, &dev);
+	if (ret < 0 || virtio_blk_get_stats(dev, &old))
+		return CMD_RET_FAILURE;
+	desc = dev_get_uclass_plat(dev);
+
+	addr = hextoul(argv[2], NULL);
+	blk = hextoul(argv[3], NULL);
+	cnt = hextoul(argv[4], NULL);
+
+	buf = map_sysmem(addr, cnt << desc->log2blksz);
+	us = timer_get_us();
+	n = blk_dread(desc, blk, cnt, buf);
+	us = max(timer_get_us() - us, 1UL);
+	unmap_sysmem(buf);
+	virtio_blk_get_stats(dev, &stats);
+
+	printf("%lu blocks read in %lu us: %llu KiB/s\n", n, us,
+	       div_u64(((u64)n << desc->log2blksz) * 1000000 >> 10, us));
+	printf("%lu chains of up to %u blocks in %u segments, %lu kicks, %lu notifies, max %u in flight\n",
+	       stats.chains - old.chains, stats.chain_blks, stats.seg_max,
+	       stats.kicks - old.kicks, stats.notifies - old.notifies,
+	       stats.max_inflight);
+	printf("indirect descriptors %s, event index %s\n",
+	       stats.indirect ? "on" : "off", stats.event_idx ? "on" : "off");
+
+	return n == cnt ? CMD_RET_SUCCESS : CMD_RET_FAILURE;
+}
+
 static int do_virtio(struct cmd_tbl *cmdtp, int flag, int argc,
 		     char *const argv[])
 {
@@ -36,6 +76,9 @@ static int do_virtio(struct cmd_tbl *cmdtp, int flag, int argc,
 		return CMD_RET_SUCCESS;
 	}
 
+	if (argc == 5 && !strcmp(argv[1], "bench"))
+		return do_virtio_bench(argv);
+
 	return blk_common_cmd(argc, argv, UCLASS_VIRTIO, &virtio_curr_dev);
 }
 
@@ -49,5 +92,7 @@ U_BOOT_CMD(
 	"virtio read addr blk# cnt - read `cnt' blocks starting at block\n"
 	"     `blk#' to memory address `addr'\n"
 	"virtio write addr blk# cnt - write `cnt' blocks starting at block\n"
-	"     `blk#' from memory address `addr'"
+	"     `blk#' from memory address `addr'\n"
+	"virtio bench addr blk# cnt - time reading `cnt' blocks starting at\n"
+	"     block `blk#' to memory address `addr'"
 );
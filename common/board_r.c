@@ -243,6 +243,9 @@ static int initr_dm(void)
 	gd->dm_root = NULL;
 #ifdef CONFIG_TIMER
 	gd->timer = NULL;
+#endif
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	gd->dm_compat_index = NULL;
 #endif
 	bootstage_start(BOOTSTAGE_ID_ACCUM_DM_R, "dm_r");
 	ret = dm_init_and_scan(false);
@@ -570,6 +573,16 @@ static int dm_announce(void)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(CYCLIC_JOBS)
+static int initr_cyclic_jobs(void)
+{
+	/* Not fatal, since the devices are still set up when first needed */
+	cyclic_jobs_start(env_get("bgprobe"));
+
+	return 0;
+}
+#endif
+
 static int run_main_loop(void)
 {
 #ifdef CONFIG_SANDBOX
@@ -769,6 +782,9 @@ static init_fnc_t init_sequence_r[] = {
 	initr_mem,
 #endif
 	initr_boot_led_on,
+#if CONFIG_IS_ENABLED(CYCLIC_JOBS)
+	initr_cyclic_jobs,
+#endif
 	run_main_loop,
 };
 
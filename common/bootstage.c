@@ -220,6 +220,24 @@ uint32_t bootstage_accum(enum bootstage_id id)
 	return duration;
 }
 
+uint32_t bootstage_accum_add(enum bootstage_id id, const char *name,
+			     uint32_t duration)
+{
+	struct bootstage_data *data = gd->bootstage;
+	struct bootstage_record *rec = ensure_id(data, id);
+
+	if (!rec)
+		return 0;
+	/* A start time marks this as an accumulated record in the report */
+	if (!rec->start_us)
+		rec->start_us = timer_get_boot_us();
+	if (name)
+		rec->name = name;
+	rec->time_us += duration;
+
+	return rec->time_us;
+}
+
 /**
  * Get a record name as a printable string
  *
@@ -11,7 +11,22 @@
 #include <errno.h>
 #include <bouncebuf.h>
 #include <asm/cache.h>
+#include <asm/global_data.h>
 #include <linux/dma-mapping.h>
+#include <linux/string.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+static struct bounce_stats bounce_stats;
+
+/* Count a transfer; BSS is not usable before relocation on many boards */
+static void bounce_count(size_t direct, size_t bounced)
+{
+	if (!(gd->flags & GD_FLG_RELOC))
+		return;
+	bounce_stats.direct_bytes += direct;
+	bounce_stats.bounced_bytes += bounced;
+}
 
 static int addr_aligned(struct bounce_buffer *state)
 {
@@ -53,6 +68,9 @@ int bounce_buffer_start_extalign(struct bounce_buffer *state, void *data,
 		if (state->flags & GEN_BB_READ)
 			memcpy(state->bounce_buffer, state->user_buffer,
 				state->len);
+		bounce_count(0, len);
+	} else {
+		bounce_count(len, 0);
 	}
 
 	/*
@@ -93,3 +111,99 @@ int bounce_buffer_stop(struct bounce_buffer *state)
 
 	return 0;
 }
+
+int bounce_split_start(struct bounce_split *state, void *data, size_t len,
+		       unsigned int flags, size_t granule)
+{
+	const ulong align_mask = ARCH_DMA_MINALIGN - 1;
+	size_t head, tail;
+	void *mid;
+
+	head = -(ulong)data & align_mask;
+	tail = ((ulong)data + len) & align_mask;
+	state->split = false;
+
+	/* Bounce the whole buffer if it is aligned, too small or too odd */
+	if ((!head && !tail) || len < 2 * ARCH_DMA_MINALIGN ||
+	    ((ulong)data | len) & (granule - 1)) {
+		int ret;
+
+		ret = bounce_buffer_start(&state->bb, data, len, flags);
+		if (ret)
+			return ret;
+		state->seg[0].addr = state->bb.bounce_buffer;
+		state->seg[0].len = len;
+		state->count = 1;
+
+		return 0;
+	}
+
+	state->split = true;
+	state->bb.user_buffer = data;
+	state->bb.len = len;
+	state->bb.flags = flags;
+	mid = data + head;
+	state->count = 0;
+	if (head) {
+		state->seg[state->count].addr = state->ends;
+		state->seg[state->count++].len = head;
+	}
+	state->seg[state->count].addr = mid;
+	state->seg[state->count++].len = len - head - tail;
+	if (tail) {
+		state->seg[state->count].addr = state->ends + ARCH_DMA_MINALIGN;
+		state->seg[state->count++].len = tail;
+	}
+	if (flags & GEN_BB_READ) {
+		memcpy(state->ends, data, head);
+		memcpy(state->ends + ARCH_DMA_MINALIGN, data + len - tail, tail);
+	}
+
+	/* Only the lines which the DMA engine uses need to be flushed */
+	dma_map_single(state->ends, sizeof(state->ends), DMA_BIDIRECTIONAL);
+	dma_map_single(mid, len - head - tail, DMA_BIDIRECTIONAL);
+	bounce_count(len - head - tail, head + tail);
+	if (gd->flags & GD_FLG_RELOC)
+		bounce_stats.splits++;
+	log_debug("Split %p len %zx: head %zx tail %zx\n", data, len, head,
+		  tail);
+
+	return 0;
+}
+
+int bounce_split_stop(struct bounce_split *state)
+{
+	size_t len = state->bb.len;
+	void *data = state->bb.user_buffer;
+	void *mid;
+	size_t head, tail;
+
+	if (!state->split)
+		return bounce_buffer_stop(&state->bb);
+	if (!(state->bb.flags & GEN_BB_WRITE))
+		return 0;
+
+	head = -(ulong)data & (ARCH_DMA_MINALIGN - 1);
+	tail = ((ulong)data + len) & (ARCH_DMA_MINALIGN - 1);
+	mid = data + head;
+	dma_unmap_single((dma_addr_t)(uintptr_t)state->ends,
+			 sizeof(state->ends), DMA_BIDIRECTIONAL);
+	dma_unmap_single((dma_addr_t)(uintptr_t)mid, len - head - tail,
+			 DMA_BIDIRECTIONAL);
+
+	/* The middle is already in place; copy in the ends */
+	memcpy(data, state->ends, head);
+	memcpy(data + len - tail, state->ends + ARCH_DMA_MINALIGN, tail);
+
+	return 0;
+}
+
+void bounce_buffer_get_stats(struct bounce_stats *stats)
+{
+	*stats = bounce_stats;
+}
+
+void bounce_buffer_reset_stats(void)
+{
+	memset(&bounce_stats, '\0', sizeof(bounce_stats));
+}
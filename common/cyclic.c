@@ -11,7 +11,9 @@
 #include <cyclic.h>
 #include <log.h>
 #include <malloc.h>
+#include <smp_worker.h>
 #include <time.h>
+#include <uthread.h>
 #include <linux/errno.h>
 #include <linux/list.h>
 #include <asm/global_data.h>
@@ -97,9 +99,14 @@ void schedule(void)
 	/*
 	 * schedule() might get called very early before the cyclic IF is
 	 * ready. Make sure to only call cyclic_run() when it's initalized.
+	 * Cyclic functions are not safe to run on a secondary CPU which is
+	 * running jobs for smp_worker_run(), so leave them to the boot CPU.
+	 * The same goes for switching to another uthread.
 	 */
-	if (gd)
+	if (gd && !smp_worker_cpu()) {
 		cyclic_run();
+		uthread_schedule();
+	}
 }
 
 int cyclic_unregister_all(void)
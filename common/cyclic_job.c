@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Background jobs, e.g. probing slow devices while the console and autoboot
+ * are running. Each job runs in its own uthread and makes progress whenever
+ * schedule() is called.
+ */
+
+#define LOG_CATEGORY	LOGC_BOOT
+
+#include <cyclic.h>
+#include <dm.h>
+#include <event.h>
+#include <log.h>
+#include <stdio.h>
+#include <time.h>
+#include <uthread.h>
+#include <linux/errno.h>
+#include <linux/string.h>
+
+static void cyclic_job_thread(void *arg)
+{
+	struct cyclic_job *job = arg;
+
+	job->ret = job->func();
+	job->time_us = timer_get_us() - job->start_us;
+	job->state = CYCLIC_JOB_DONE;
+	log_debug("Job %s done in %lu us (err=%d)\n", job->name, job->time_us,
+		  job->ret);
+}
+
+static int cyclic_job_start(struct cyclic_job *job)
+{
+	int ret;
+
+	if (job->state == CYCLIC_JOB_RUNNING)
+		return 0;
+
+	job->grp_id = uthread_grp_new_id();
+	job->start_us = timer_get_us();
+	job->time_us = 0;
+	job->wait_us = 0;
+	job->state = CYCLIC_JOB_RUNNING;
+	ret = uthread_create(NULL, cyclic_job_thread, job, 0, job->grp_id);
+	if (ret) {
+		job->state = CYCLIC_JOB_IDLE;
+		return log_msg_ret("job", ret);
+	}
+	log_debug("Started job %s\n", job->name);
+
+	return 0;
+}
+
+static struct cyclic_job *cyclic_job_find(const char *name, int len)
+{
+	struct cyclic_job *start, *job;
+	int n_ent;
+
+	start = ll_entry_start(struct cyclic_job, cyclic_job);
+	n_ent = ll_entry_count(struct cyclic_job, cyclic_job);
+	for (job = start; job < start + n_ent; job++) {
+		if (strlen(job->name) == len && !strncmp(job->name, name, len))
+			return job;
+	}
+
+	return NULL;
+}
+
+int cyclic_jobs_start(const char *names)
+{
+	struct cyclic_job *job;
+	const char *p, *end;
+	int ret, err = 0;
+
+	for (p = names; p && *p; p = end) {
+		p += strspn(p, " ");
+		end = p + strcspn(p, " ");
+		if (end == p)
+			break;
+		job = cyclic_job_find(p, end - p);
+		if (!job) {
+			log_err("No background job '%.*s'\n", (int)(end - p), p);
+			err = -ENOENT;
+			continue;
+		}
+		ret = cyclic_job_start(job);
+		if (ret && !err)
+			err = ret;
+	}
+
+	return err;
+}
+
+/* Wait for @job to finish, returning its result */
+static int cyclic_job_finish(struct cyclic_job *job)
+{
+	ulong start;
+
+	if (job->state == CYCLIC_JOB_RUNNING) {
+		start = timer_get_us();
+		uthread_grp_wait(job->grp_id);
+		job->wait_us += timer_get_us() - start;
+	}
+
+	return job->ret;
+}
+
+int cyclic_job_wait(const char *name)
+{
+	struct cyclic_job *job;
+
+	job = cyclic_job_find(name, strlen(name));
+	if (!job || job->state == CYCLIC_JOB_IDLE)
+		return -ESRCH;
+
+	return cyclic_job_finish(job);
+}
+
+int cyclic_job_wait_uclass(enum uclass_id id)
+{
+	struct cyclic_job *start, *job;
+	int n_ent, ret, err = -ESRCH;
+
+	start = ll_entry_start(struct cyclic_job, cyclic_job);
+	n_ent = ll_entry_count(struct cyclic_job, cyclic_job);
+	for (job = start; job < start + n_ent; job++) {
+		if (job->uclass != id || job->state == CYCLIC_JOB_IDLE)
+			continue;
+		ret = cyclic_job_finish(job);
+		if (err == -ESRCH || (ret && !err))
+			err = ret;
+	}
+
+	return err;
+}
+
+/*
+ * Once a device set up by a job is removed, e.g. by 'usb stop', the job's
+ * result no longer says anything about the uclass, so forget it
+ */
+static int cyclic_job_dev_remove(void *ctx, struct event *event)
+{
+	enum uclass_id id = device_get_uclass_id(event->data.dm.dev);
+	struct cyclic_job *start, *job;
+	int n_ent;
+
+	start = ll_entry_start(struct cyclic_job, cyclic_job);
+	n_ent = ll_entry_count(struct cyclic_job, cyclic_job);
+	for (job = start; job < start + n_ent; job++) {
+		if (job->uclass == id && job->state == CYCLIC_JOB_DONE) {
+			log_debug("Job %s no longer current\n", job->name);
+			job->state = CYCLIC_JOB_IDLE;
+		}
+	}
+
+	return 0;
+}
+EVENT_SPY_FULL(EVT_DM_PRE_REMOVE, cyclic_job_dev_remove);
+
+void cyclic_jobs_list(void)
+{
+	static const char *const state_name[] = {
+		[CYCLIC_JOB_IDLE]	= "idle",
+		[CYCLIC_JOB_RUNNING]	= "running",
+		[CYCLIC_JOB_DONE]	= "done",
+	};
+	struct cyclic_job *start, *job;
+	int n_ent;
+
+	start = ll_entry_start(struct cyclic_job, cyclic_job);
+	n_ent = ll_entry_count(struct cyclic_job, cyclic_job);
+	for (job = start; job < start + n_ent; job++) {
+		printf("job: %s, state: %s", job->name, state_name[job->state]);
+		if (job->state == CYCLIC_JOB_DONE)
+			printf(", time: %lu us, waited: %lu us, result: %d",
+			       job->time_us, job->wait_us, job->ret);
+		printf("\n");
+	}
+}
@@ -16,6 +16,7 @@
 #include <malloc.h>
 #include <mapmem.h>
 #include <hw_sha.h>
+#include <watchdog.h>
 #include <asm/cache.h>
 #include <asm/global_data.h>
 #include <asm/io.h>
@@ -34,6 +35,12 @@
 #include <u-boot/sha256.h>
 #include <u-boot/sha512.h>
 #include <u-boot/md5.h>
+#if CONFIG_IS_ENABLED(HASH_OFFLOAD)
+#include <dm.h>
+#include <u-boot/hash.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+#endif
 
 static int __maybe_unused hash_init_sha1(struct hash_algo *algo, void **ctxp)
 {
@@ -162,10 +169,14 @@ static int hash_update_crc16_ccitt(struct hash_algo *algo, void *ctx,
 static int hash_finish_crc16_ccitt(struct hash_algo *algo, void *ctx,
 				   void *dest_buf, int size)
 {
+	uint16_t crc;
+
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint16_t *)dest_buf) = *((uint16_t *)ctx);
+	/* Store big-endian, as crc16_ccitt_wd_buf() does */
+	crc = cpu_to_be16(*((uint16_t *)ctx));
+	memcpy(dest_buf, &crc, sizeof(crc));
 	free(ctx);
 	return 0;
 }
@@ -189,10 +200,14 @@ static int __maybe_unused hash_update_crc32(struct hash_algo *algo, void *ctx,
 static int __maybe_unused hash_finish_crc32(struct hash_algo *algo, void *ctx,
 					    void *dest_buf, int size)
 {
+	uint32_t crc;
+
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint32_t *)dest_buf) = *((uint32_t *)ctx);
+	/* Store big-endian, as crc32_wd_buf() does */
+	crc = cpu_to_be32(*((uint32_t *)ctx));
+	memcpy(dest_buf, &crc, sizeof(crc));
 	free(ctx);
 	return 0;
 }
@@ -327,13 +342,266 @@ static struct hash_algo hash_algo[] = {
 #define multi_hash()	0
 #endif
 
+#if CONFIG_IS_ENABLED(HASH_OFFLOAD)
+/**
+ * struct hash_dev_ctx - context for progressive hashing with a hash device
+ *
+ * @dev: Hash device, or NULL if the software algorithm is used
+ * @sw: Software algorithm, used if no device can handle the hash
+ * @ctx: Context from @dev or @sw
+ * @err: true if an update failed, so that finishing must fail too
+ */
+struct hash_dev_ctx {
+	struct udevice *dev;
+	struct hash_algo *sw;
+	void *ctx;
+	bool err;
+};
+
+/*
+ * Algorithms which use a hash device when there is one, falling back to
+ * software. These are set up from the matching hash_algo[] entry when first
+ * looked up.
+ */
+static struct hash_algo hash_dev_algo[ARRAY_SIZE(hash_algo)];
+
+static bool hash_is_dev_algo(struct hash_algo *algo)
+{
+	return algo >= hash_dev_algo &&
+		algo < hash_dev_algo + ARRAY_SIZE(hash_dev_algo);
+}
+
+/* Wait for any data submitted to the device to be hashed */
+static int hash_dev_wait(struct hash_dev_ctx *ctx)
+{
+	int ret;
+
+	while ((ret = hash_poll(ctx->dev, ctx->ctx)) == -EBUSY)
+		schedule();
+
+	return ret;
+}
+
+static int hash_dev_init(struct hash_algo *algo, void **ctxp)
+{
+	enum HASH_ALGO id = hash_algo_lookup_by_name(algo->name);
+	struct hash_dev_ctx *ctx;
+	int ret;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return -ENOMEM;
+	ctx->sw = &hash_algo[algo - hash_dev_algo];
+
+	if (!hash_find_device(id, &ctx->dev) &&
+	    !hash_init(ctx->dev, id, &ctx->ctx)) {
+		*ctxp = ctx;
+		return 0;
+	}
+
+	/* The device went away or is out of contexts, so use software */
+	ctx->dev = NULL;
+	ret = ctx->sw->hash_init(ctx->sw, &ctx->ctx);
+	if (ret) {
+		free(ctx);
+		return ret;
+	}
+	*ctxp = ctx;
+
+	return 0;
+}
+
+static int hash_dev_update(struct hash_algo *algo, void *vctx,
+			   const void *buf, unsigned int size, int is_last)
+{
+	struct hash_dev_ctx *ctx = vctx;
+	int ret;
+
+	if (ctx->err)
+		return -1;
+	if (!ctx->dev)
+		return ctx->sw->hash_update(ctx->sw, ctx->ctx, buf, size,
+					    is_last);
+
+	ret = hash_dev_wait(ctx);
+	if (!ret)
+		ret = hash_update(ctx->dev, ctx->ctx, buf, size);
+	if (ret) {
+		/*
+		 * The caller still owns the context and must call
+		 * hash_finish(), which releases it
+		 */
+		ctx->err = true;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int hash_dev_finish(struct hash_algo *algo, void *vctx,
+			   void *dest_buf, int size)
+{
+	u8 digest[HASH_MAX_DIGEST_SIZE];
+	struct hash_dev_ctx *ctx = vctx;
+	int ret;
+
+	/* Always finish, so that the device or software context is freed */
+	if (ctx->dev) {
+		ret = hash_dev_wait(ctx);
+		ret = hash_finish(ctx->dev, ctx->ctx, digest) ?: ret;
+	} else {
+		ret = ctx->sw->hash_finish(ctx->sw, ctx->ctx, digest,
+					   sizeof(digest));
+	}
+	if (ctx->err)
+		ret = -1;
+	free(ctx);
+
+	if (size < algo->digest_size)
+		return -ENOSPC;
+	if (ret)
+		return -1;
+	memcpy(dest_buf, digest, algo->digest_size);
+
+	return 0;
+}
+
+static void hash_dev_digest(enum HASH_ALGO id, const unsigned char *input,
+			    unsigned int ilen, unsigned char *output,
+			    unsigned int chunk_sz)
+{
+	struct udevice *dev;
+	int i;
+
+	if (!hash_find_device(id, &dev) &&
+	    !hash_digest_wd(dev, id, input, ilen, output, chunk_sz))
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(hash_algo); i++) {
+		if (!strcmp(hash_algo_name(id), hash_algo[i].name))
+			hash_algo[i].hash_func_ws(input, ilen, output,
+						  chunk_sz);
+	}
+}
+
+#define HASH_DEV_FUNC(_name, _id) \
+	static void _name(const unsigned char *input, unsigned int ilen, \
+			  unsigned char *output, unsigned int chunk_sz) \
+	{ \
+		hash_dev_digest(_id, input, ilen, output, chunk_sz); \
+	}
+
+HASH_DEV_FUNC(hash_dev_crc16_ccitt, HASH_ALGO_CRC16_CCITT)
+HASH_DEV_FUNC(hash_dev_crc32, HASH_ALGO_CRC32)
+HASH_DEV_FUNC(hash_dev_md5, HASH_ALGO_MD5)
+HASH_DEV_FUNC(hash_dev_sha1, HASH_ALGO_SHA1)
+HASH_DEV_FUNC(hash_dev_sha256, HASH_ALGO_SHA256)
+HASH_DEV_FUNC(hash_dev_sha384, HASH_ALGO_SHA384)
+HASH_DEV_FUNC(hash_dev_sha512, HASH_ALGO_SHA512)
+
+static void (*const hash_dev_func[HASH_ALGO_NUM])(const unsigned char *input,
+						   unsigned int ilen,
+						   unsigned char *output,
+						   unsigned int chunk_sz) = {
+	[HASH_ALGO_CRC16_CCITT]	= hash_dev_crc16_ccitt,
+	[HASH_ALGO_CRC32]	= hash_dev_crc32,
+	[HASH_ALGO_MD5]		= hash_dev_md5,
+	[HASH_ALGO_SHA1]	= hash_dev_sha1,
+	[HASH_ALGO_SHA256]	= hash_dev_sha256,
+	[HASH_ALGO_SHA384]	= hash_dev_sha384,
+	[HASH_ALGO_SHA512]	= hash_dev_sha512,
+};
+
+/*
+ * Use a hash device for @sw if there is one which supports it. This is only
+ * done after relocation, since hash_dev_algo[] is in BSS.
+ */
+static struct hash_algo *hash_dev_lookup(struct hash_algo *sw)
+{
+	struct hash_algo *algo = &hash_dev_algo[sw - hash_algo];
+	enum HASH_ALGO id = hash_algo_lookup_by_name(sw->name);
+	struct udevice *dev;
+
+	if (!(gd->flags & GD_FLG_RELOC) || id == HASH_ALGO_INVALID ||
+	    hash_find_device(id, &dev))
+		return sw;
+
+	if (!algo->name) {
+		*algo = *sw;
+		algo->hash_func_ws = hash_dev_func[id];
+		if (sw->hash_init) {
+			algo->hash_init = hash_dev_init;
+			algo->hash_update = hash_dev_update;
+			algo->hash_finish = hash_dev_finish;
+		}
+	}
+
+	return algo;
+}
+
+int hash_progressive_submit(struct hash_algo *algo, void *ctx,
+			    const void *buf, unsigned int size)
+{
+	struct hash_dev_ctx *dctx = ctx;
+
+	if (hash_is_dev_algo(algo) && dctx->dev) {
+		int ret;
+
+		ret = hash_dev_wait(dctx);
+		if (!ret)
+			ret = hash_submit(dctx->dev, dctx->ctx, buf, size);
+
+		return ret;
+	}
+
+	return algo->hash_update(algo, ctx, buf, size, 0);
+}
+
+int hash_progressive_poll(struct hash_algo *algo, void *ctx)
+{
+	struct hash_dev_ctx *dctx = ctx;
+
+	if (hash_is_dev_algo(algo) && dctx->dev)
+		return hash_poll(dctx->dev, dctx->ctx);
+
+	return 0;
+}
+#else
+static struct hash_algo *hash_dev_lookup(struct hash_algo *sw)
+{
+	return sw;
+}
+
+#ifndef USE_HOSTCC
+int hash_progressive_submit(struct hash_algo *algo, void *ctx,
+			    const void *buf, unsigned int size)
+{
+	return algo->hash_update(algo, ctx, buf, size, 0);
+}
+
+int hash_progressive_poll(struct hash_algo *algo, void *ctx)
+{
+	return 0;
+}
+#endif
+#endif /* HASH_OFFLOAD */
+
+int hash_get_soft_algo(int index, struct hash_algo **algop)
+{
+	if (index < 0 || index >= ARRAY_SIZE(hash_algo))
+		return -ENOENT;
+	*algop = &hash_algo[index];
+
+	return 0;
+}
+
 int hash_lookup_algo(const char *algo_name, struct hash_algo **algop)
 {
 	int i;
 
 	for (i = 0; i < ARRAY_SIZE(hash_algo); i++) {
 		if (!strcmp(algo_name, hash_algo[i].name)) {
-			*algop = &hash_algo[i];
+			*algop = hash_dev_lookup(&hash_algo[i]);
 			return 0;
 		}
 	}
@@ -350,7 +618,7 @@ int hash_progressive_lookup_algo(const char *algo_name,
 	for (i = 0; i < ARRAY_SIZE(hash_algo); i++) {
 		if (!strcmp(algo_name, hash_algo[i].name)) {
 			if (hash_algo[i].hash_init) {
-				*algop = &hash_algo[i];
+				*algop = hash_dev_lookup(&hash_algo[i]);
 				return 0;
 			}
 		}
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Running jobs on secondary CPUs
+ */
+
+#define LOG_CATEGORY	LOGC_BOOT
+
+#include <log.h>
+#include <smp_worker.h>
+#include <time.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#define SMP_WORKER_CPUS		(CONFIG_SMP_WORKERS_MAX + 1)
+
+/**
+ * struct smp_worker_batch - jobs being run by smp_worker_run()
+ *
+ * @func: Function to run each job
+ * @ctx: Context to pass to @func
+ * @count: Number of jobs
+ * @cpus: Number of CPUs sharing the jobs
+ * @ret: First error from the jobs run by each CPU
+ * @busy_us: Time spent running jobs by each CPU
+ */
+struct smp_worker_batch {
+	smp_job_func func;
+	void *ctx;
+	int count;
+	int cpus;
+	int ret[SMP_WORKER_CPUS];
+	ulong busy_us[SMP_WORKER_CPUS];
+};
+
+static struct smp_worker_batch batch;
+
+__weak int arch_smp_worker_count(void)
+{
+	return 0;
+}
+
+__weak int arch_smp_worker_start(int cpu, void (*entry)(int cpu))
+{
+	return -ENOSYS;
+}
+
+__weak int arch_smp_worker_park(int cpu)
+{
+	return -ENOSYS;
+}
+
+__weak int arch_smp_worker_cpu(void)
+{
+	return 0;
+}
+
+int smp_worker_cpus(void)
+{
+	return 1 + min(arch_smp_worker_count(), CONFIG_SMP_WORKERS_MAX);
+}
+
+int smp_worker_cpu(void)
+{
+	return arch_smp_worker_cpu();
+}
+
+/* Run the share of the jobs belonging to @cpu: every batch.cpus'th one */
+static void smp_worker_jobs(int cpu)
+{
+	ulong start = timer_get_us();
+	int job, ret;
+
+	for (job = cpu; job < batch.count; job += batch.cpus) {
+		ret = batch.func(batch.ctx, job, cpu);
+		if (ret && !batch.ret[cpu])
+			batch.ret[cpu] = ret;
+	}
+	batch.busy_us[cpu] += timer_get_us() - start;
+}
+
+int smp_worker_run(smp_job_func func, void *ctx, int count, ulong *busy_usp)
+{
+	int cpu, started, ret, err;
+	ulong busy_us = 0;
+
+	batch.func = func;
+	batch.ctx = ctx;
+	batch.count = count;
+	batch.cpus = max(min(smp_worker_cpus(), count), 1);
+	memset(batch.ret, '\0', sizeof(batch.ret));
+	memset(batch.busy_us, '\0', sizeof(batch.busy_us));
+
+	/* Make sure the timer is set up before the other CPUs read it */
+	timer_get_us();
+
+	for (started = 1; started < batch.cpus; started++) {
+		ret = arch_smp_worker_start(started, smp_worker_jobs);
+		if (ret) {
+			log_debug("Cannot start CPU %d (err=%d)\n", started,
+				  ret);
+			break;
+		}
+	}
+
+	smp_worker_jobs(0);
+
+	/* Park the CPUs, running the jobs of any which did not start */
+	ret = 0;
+	for (cpu = 1; cpu < batch.cpus; cpu++) {
+		if (cpu < started) {
+			err = arch_smp_worker_park(cpu);
+			if (err) {
+				log_err("Cannot park CPU %d (err=%d)\n", cpu,
+					err);
+				if (!ret)
+					ret = err;
+			}
+		} else {
+			smp_worker_jobs(cpu);
+		}
+	}
+	if (ret)
+		return ret;
+
+	for (cpu = 0; cpu < batch.cpus; cpu++) {
+		busy_us += batch.busy_us[cpu];
+		if (batch.ret[cpu] && !ret)
+			ret = batch.ret[cpu];
+	}
+	log_debug("%d jobs on %d CPUs, %d started, busy %lu us\n", count,
+		  batch.cpus, started, busy_us);
+	if (busy_usp)
+		*busy_usp = busy_us;
+
+	return ret;
+}
@@ -187,6 +187,63 @@ static int get_aligned_image_size(struct spl_load_info *info, int data_size,
 	return ALIGN(data_size, spl_get_bl_len(info));
 }
 
+/**
+ * struct spl_fit_stream_priv - private data for spl_fit_stream_read()
+ *
+ * @info: Information about the device to load data from
+ * @fit_offset: Offset of the FIT on the device
+ */
+struct spl_fit_stream_priv {
+	struct spl_load_info *info;
+	ulong fit_offset;
+};
+
+static long spl_fit_stream_read(void *priv, ulong offset, ulong size,
+				void *buf)
+{
+	struct spl_fit_stream_priv *sp = priv;
+
+	return sp->info->read(sp->info, sp->fit_offset + offset, size, buf);
+}
+
+/*
+ * Read, hash and decompress the external data for an image in one pass.
+ * Returns -EPROTONOSUPPORT if the image must be loaded the normal way.
+ */
+static int spl_fit_load_stream(struct spl_load_info *info, ulong fit_offset,
+			       const struct spl_fit_info *ctx, int node,
+			       ulong load_addr, size_t *lengthp)
+{
+	struct spl_fit_stream_priv sp = {
+		.info = info,
+		.fit_offset = fit_offset,
+	};
+	u8 comp = IH_COMP_NONE;
+	ulong len;
+	int ret;
+
+	if (!CONFIG_IS_ENABLED(FIT_STREAM))
+		return -EPROTONOSUPPORT;
+
+	/* Only gzip is decompressed on the fly; LZMA needs the whole image */
+	if (spl_decompression_enabled())
+		fit_image_get_comp(ctx->fit, node, &comp);
+	if (comp == IH_COMP_LZMA)
+		return -EPROTONOSUPPORT;
+
+	ret = fit_image_load_stream(ctx->fit, node, ctx->ext_data_offset,
+				    spl_get_bl_len(info),
+				    comp == IH_COMP_GZIP,
+				    spl_fit_stream_read, &sp,
+				    map_sysmem(load_addr, CONFIG_SYS_BOOTM_LEN),
+				    CONFIG_SYS_BOOTM_LEN, &len);
+	if (ret)
+		return ret;
+	*lengthp = len;
+
+	return 0;
+}
+
 /**
  * load_simple_fit(): load the image described in a certain FIT node
  * @info:	points to information about the device to load data from
@@ -217,6 +274,7 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 	const void *data;
 	const void *fit = ctx->fit;
 	bool external_data = false;
+	int ret;
 
 	if (IS_ENABLED(CONFIG_SPL_FPGA) ||
 	    (IS_ENABLED(CONFIG_SPL_OS_BOOT) && spl_decompression_enabled())) {
@@ -261,6 +319,13 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 			return 0;
 		}
 
+		ret = spl_fit_load_stream(info, fit_offset, ctx, node,
+					  load_addr, &length);
+		if (!ret)
+			goto done;
+		if (ret != -EPROTONOSUPPORT)
+			return ret;
+
 		if (spl_decompression_enabled() &&
 		    (image_comp == IH_COMP_GZIP || image_comp == IH_COMP_LZMA))
 			src_ptr = map_sysmem(ALIGN(CONFIG_SYS_LOAD_ADDR, ARCH_DMA_MINALIGN), len);
@@ -325,6 +390,7 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 		memcpy(load_ptr, src, length);
 	}
 
+done:
 	if (image_info) {
 		ulong entry_point;
 
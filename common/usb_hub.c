@@ -29,6 +29,7 @@
 #include <malloc.h>
 #include <memalign.h>
 #include <time.h>
+#include <watchdog.h>
 #include <asm/processor.h>
 #include <asm/unaligned.h>
 #include <linux/ctype.h>
@@ -58,7 +59,25 @@ struct usb_device_scan {
 	struct list_head list;
 };
 
-static LIST_HEAD(usb_scan_list);
+/*
+ * Each bus has its own list of ports waiting to be scanned, so that several
+ * buses can be scanned at once, each in its own uthread
+ */
+#if CONFIG_IS_ENABLED(DM_USB)
+static struct usb_bus_priv *usb_hub_bus(struct usb_device *dev)
+{
+	return dev_get_uclass_priv(dev->controller_dev);
+}
+#else
+static struct usb_bus_priv usb_bus = {
+	.scan_list = LIST_HEAD_INIT(usb_bus.scan_list),
+};
+
+static struct usb_bus_priv *usb_hub_bus(struct usb_device *dev)
+{
+	return &usb_bus;
+}
+#endif
 
 __weak void usb_hub_reset_devices(struct usb_hub_device *hub, int port)
 {
@@ -566,25 +585,24 @@ static int usb_scan_port(struct usb_device_scan *usb_scan)
 	return 0;
 }
 
-static int usb_device_list_scan(void)
+static int usb_device_list_scan(struct usb_bus_priv *bus)
 {
 	struct usb_device_scan *usb_scan;
 	struct usb_device_scan *tmp;
-	static int running;
 	int ret = 0;
 
 	/* Only run this loop once for each controller */
-	if (running)
+	if (bus->scanning)
 		return 0;
 
-	running = 1;
+	bus->scanning = true;
 
 	while (1) {
 		/* We're done, once the list is empty again */
-		if (list_empty(&usb_scan_list))
+		if (list_empty(&bus->scan_list))
 			goto out;
 
-		list_for_each_entry_safe(usb_scan, tmp, &usb_scan_list, list) {
+		list_for_each_entry_safe(usb_scan, tmp, &bus->scan_list, list) {
 			int ret;
 
 			/* Scan this port */
@@ -592,15 +610,18 @@ static int usb_device_list_scan(void)
 			if (ret)
 				goto out;
 		}
+
+		/* Let other buses make progress while these ports settle */
+		schedule();
 	}
 
 out:
 	/*
 	 * This USB controller has finished scanning all its connected
-	 * USB devices. Set "running" back to 0, so that other USB controllers
-	 * will scan their devices too.
+	 * USB devices. Clear "scanning", so that a later scan of this
+	 * controller will scan its devices too.
 	 */
-	running = 0;
+	bus->scanning = false;
 
 	return ret;
 }
@@ -873,13 +894,13 @@ static int usb_hub_configure(struct usb_device *dev)
 		usb_scan->dev = dev;
 		usb_scan->hub = hub;
 		usb_scan->port = i;
-		list_add_tail(&usb_scan->list, &usb_scan_list);
+		list_add_tail(&usb_scan->list, &usb_hub_bus(dev)->scan_list);
 	}
 
 	/*
 	 * And now call the scanning code which loops over the generated list
 	 */
-	ret = usb_device_list_scan();
+	ret = usb_device_list_scan(usb_hub_bus(dev));
 
 	return ret;
 }
@@ -8,6 +8,7 @@
 
 #include <blk.h>
 #include <dm.h>
+#include <fs.h>
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
@@ -429,21 +430,15 @@ static int blk_buffer_aligned(struct bounce_buffer *state)
 	return 1;	/* Default, any buffer is OK */
 }
 
-long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
+static long blk_read_dev(struct udevice *dev, lbaint_t start,
+			 lbaint_t blkcnt, void *buf)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
-	ulong blks_read;
-
-	if (!ops->read)
-		return -ENOSYS;
-
-	if (blkcache_read(desc->uclass_id, desc->devnum,
-			  start, blkcnt, desc->blksz, buf))
-		return blkcnt;
 
 	if (IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb) {
 		struct blk_bounce_buffer bbstate = { .dev = dev };
+		long blks_read;
 		int ret;
 
 		ret = bounce_buffer_start_extalign(&bbstate.state, buf,
@@ -456,10 +451,47 @@ long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
 		blks_read = ops->read(dev, start, blkcnt, bbstate.state.bounce_buffer);
 
 		bounce_buffer_stop(&bbstate.state);
-	} else {
-		blks_read = ops->read(dev, start, blkcnt, buf);
+
+		return blks_read;
 	}
 
+	return ops->read(dev, start, blkcnt, buf);
+}
+
+long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong blks_read;
+	lbaint_t count;
+	char *ra_buf;
+
+	if (!ops->read)
+		return -ENOSYS;
+
+	if (blkcache_read(desc->uclass_id, desc->devnum,
+			  start, blkcnt, desc->blksz, buf))
+		return blkcnt;
+
+	ra_buf = blkcache_readahead(desc->uclass_id, desc->devnum, start,
+				    blkcnt, desc->blksz, desc->lba, &count);
+	if (ra_buf) {
+		/* Read the request and the readahead in one go */
+		blks_read = blk_read_dev(dev, start, count, ra_buf);
+		if (blks_read == count) {
+			memcpy(buf, ra_buf, blkcnt * desc->blksz);
+			blkcache_fill(desc->uclass_id, desc->devnum, start,
+				      blkcnt, desc->blksz, ra_buf);
+			blkcache_fill_readahead(desc->uclass_id, desc->devnum,
+						start + blkcnt, count - blkcnt,
+						desc->blksz,
+						ra_buf + blkcnt * desc->blksz);
+			return blkcnt;
+		}
+		/* Fall back to reading just what was asked for */
+	}
+
+	blks_read = blk_read_dev(dev, start, blkcnt, buf);
 	if (blks_read == blkcnt)
 		blkcache_fill(desc->uclass_id, desc->devnum, start, blkcnt,
 			      desc->blksz, buf);
@@ -478,6 +510,8 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
 		return -ENOSYS;
 
 	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	fs_cache_invalidate(desc);
+	desc->write_gen++;
 
 	if (IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb) {
 		struct blk_bounce_buffer bbstate = { .dev = dev };
@@ -510,10 +544,104 @@ long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
 		return -ENOSYS;
 
 	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	fs_cache_invalidate(desc);
+	desc->write_gen++;
 
 	return ops->erase(dev, start, blkcnt);
 }
 
+static void blk_req_finish(struct blk_req *req, long result)
+{
+	req->result = result;
+	req->complete = true;
+	if (req->done)
+		req->done(req);
+}
+
+void blk_req_complete(struct blk_req *req, long result)
+{
+	struct blk_desc *desc;
+
+	if (req->dev && req->op == BLK_REQ_WRITE) {
+		/* Drop anything filled by reads which overlapped this write */
+		desc = dev_get_uclass_plat(req->dev);
+		blkcache_invalidate(desc->uclass_id, desc->devnum);
+		desc->write_gen++;
+	} else if (req->dev && result == req->blkcnt) {
+		/* Fill only if no write was submitted or completed meanwhile */
+		desc = dev_get_uclass_plat(req->dev);
+		if (req->write_gen == desc->write_gen)
+			blkcache_fill(desc->uclass_id, desc->devnum, req->start,
+				      req->blkcnt, desc->blksz, req->buffer);
+	}
+	blk_req_finish(req, result);
+}
+
+int blk_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	long result;
+
+	req->dev = dev;
+	req->result = 0;
+	req->complete = false;
+
+	/* Without driver support, carry out the request now */
+	if (!ops->submit || (IS_ENABLED(CONFIG_BOUNCE_BUFFER) && desc->bb)) {
+		if (req->op == BLK_REQ_READ)
+			result = blk_read(dev, req->start, req->blkcnt,
+					  req->buffer);
+		else
+			result = blk_write(dev, req->start, req->blkcnt,
+					   req->buffer);
+		if (result == -ENOSYS)
+			return result;
+		blk_req_finish(req, result);
+
+		return 0;
+	}
+
+	if (req->op == BLK_REQ_WRITE) {
+		blkcache_invalidate(desc->uclass_id, desc->devnum);
+		fs_cache_invalidate(desc);
+		desc->write_gen++;
+	} else if (blkcache_read(desc->uclass_id, desc->devnum, req->start,
+				 req->blkcnt, desc->blksz, req->buffer)) {
+		blk_req_finish(req, req->blkcnt);
+
+		return 0;
+	}
+	req->write_gen = desc->write_gen;
+
+	return ops->submit(dev, req);
+}
+
+int blk_poll(struct udevice *dev)
+{
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (!ops->poll)
+		return 0;
+
+	return ops->poll(dev);
+}
+
+long blk_wait(struct udevice *dev, struct blk_req *req)
+{
+	int ret;
+
+	while (!req->complete) {
+		ret = blk_poll(dev);
+		if (ret < 0)
+			return ret;
+		if (!ret && !req->complete)
+			return -EINVAL;
+	}
+
+	return req->result;
+}
+
 ulong blk_dread(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
 		void *buffer)
 {
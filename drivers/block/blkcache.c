@@ -7,144 +7,431 @@
 #include <blk.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
 #include <asm/global_data.h>
+#include <linux/bitmap.h>
 #include <linux/ctype.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 
+/*
+ * The cache is a hash table of sets, each holding CONFIG_BLOCK_CACHE_WAYS
+ * entries. Every entry caches (part of) a 'line', i.e. an aligned run of
+ * max_blocks_per_entry blocks on one device, so that a lookup only has to
+ * inspect the set that each requested line hashes to.
+ */
+#define BLKCACHE_WAYS	CONFIG_BLOCK_CACHE_WAYS
+
+/**
+ * struct block_cache_node - a cache entry holding blocks from one line
+ *
+ * @iftype:	uclass_id of the device, -1 if the entry is unused
+ * @devnum:	device number
+ * @line:	line number, i.e. the first block of the line >> line_shift
+ * @blksz:	block size in bytes of @cache
+ * @lo:		first valid block within the line
+ * @hi:		one after the last valid block within the line
+ * @ra_map:	bitmap of the blocks within the line which were read ahead and
+ *		not yet used, held after the data in @cache
+ * @age:	value of the LRU clock when the entry was last used
+ * @cache:	buffer for the whole line
+ */
 struct block_cache_node {
-	struct list_head lh;
 	int iftype;
 	int devnum;
-	lbaint_t start;
-	lbaint_t blkcnt;
+	lbaint_t line;
 	unsigned long blksz;
+	unsigned int lo;
+	unsigned int hi;
+	unsigned long *ra_map;
+	ulong age;
 	char *cache;
 };
 
-static LIST_HEAD(block_cache);
+/**
+ * struct block_cache_dev - per-device sequential-access state
+ *
+ * @lh:		link in block_cache_devs
+ * @next:	block following the last read, to detect sequential access
+ * @seq_count:	number of consecutive sequential reads seen
+ * @ra_window:	current readahead window in blocks, 0 if none
+ * @stats:	statistics for this device
+ */
+struct block_cache_dev {
+	struct list_head lh;
+	lbaint_t next;
+	uint seq_count;
+	lbaint_t ra_window;
+	struct block_cache_dev_stats stats;
+};
+
+static LIST_HEAD(block_cache_devs);
+
+static struct block_cache_node *block_cache;
+static uint num_sets;
+static uint line_shift;
+static ulong lru_clock;
+static void *ra_buf;
+static size_t ra_buf_size;
 
 static struct block_cache_stats _stats = {
-	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_blocks_per_entry = CONFIG_BLOCK_CACHE_ENTRY_BLOCKS,
+	.max_entries = CONFIG_BLOCK_CACHE_ENTRIES,
+	.ways = BLKCACHE_WAYS,
 };
 
+static bool cache_init(void)
+{
+	uint i;
+
+	if (block_cache)
+		return true;
+	if (!_stats.max_entries || !_stats.max_blocks_per_entry)
+		return false;
+
+	num_sets = DIV_ROUND_UP(_stats.max_entries, BLKCACHE_WAYS);
+	line_shift = ilog2(_stats.max_blocks_per_entry);
+	block_cache = calloc(num_sets * BLKCACHE_WAYS, sizeof(*block_cache));
+	if (!block_cache)
+		return false;
+	for (i = 0; i < num_sets * BLKCACHE_WAYS; i++)
+		block_cache[i].iftype = -1;
+
+	return true;
+}
+
+/* Maximum number of blocks which the cache will hold for a single read */
+static lbaint_t cache_max_blocks(void)
+{
+	return ((lbaint_t)num_sets * BLKCACHE_WAYS << line_shift) / 4;
+}
+
+static struct block_cache_dev *cache_dev(int iftype, int devnum, bool create)
+{
+	struct block_cache_dev *bdev;
+
+	list_for_each_entry(bdev, &block_cache_devs, lh)
+		if (bdev->stats.iftype == iftype && bdev->stats.devnum == devnum)
+			return bdev;
+	if (!create)
+		return NULL;
+
+	bdev = calloc(1, sizeof(*bdev));
+	if (!bdev)
+		return NULL;
+	bdev->stats.iftype = iftype;
+	bdev->stats.devnum = devnum;
+	list_add_tail(&bdev->lh, &block_cache_devs);
+
+	return bdev;
+}
+
+static struct block_cache_node *cache_set(int iftype, int devnum,
+					  lbaint_t line)
+{
+	u32 key;
+
+	key = (u32)line ^ (u32)((u64)line >> 32) ^ (iftype << 24) ^
+		(devnum << 16);
+	key *= 0x9e3779b1;
+
+	return &block_cache[(key % num_sets) * BLKCACHE_WAYS];
+}
+
 static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+					   lbaint_t line, unsigned long blksz)
+{
+	struct block_cache_node *node = cache_set(iftype, devnum, line);
+	int i;
+
+	for (i = 0; i < BLKCACHE_WAYS; i++, node++)
+		if (node->iftype == iftype && node->devnum == devnum &&
+		    node->line == line && node->blksz == blksz)
+			return node;
+
+	return NULL;
+}
+
+/* Pick the entry to replace in a set: an unused one, else the oldest */
+static struct block_cache_node *cache_victim(int iftype, int devnum,
+					     lbaint_t line)
 {
+	struct block_cache_node *node = cache_set(iftype, devnum, line);
+	struct block_cache_node *victim = node;
+	struct block_cache_dev *bdev;
+	int i;
+
+	for (i = 0; i < BLKCACHE_WAYS; i++, node++) {
+		if (node->iftype == -1)
+			return node;
+		if ((long)(node->age - victim->age) < 0)
+			victim = node;
+	}
+
+	debug("drop: line " LBAF "\n", victim->line);
+	if (!bitmap_empty(victim->ra_map, 1 << line_shift)) {
+		/* Some readahead data was never used, so read less next time */
+		bdev = cache_dev(victim->iftype, victim->devnum, false);
+		if (bdev)
+			bdev->ra_window /= 2;
+	}
+	victim->iftype = -1;
+	_stats.entries--;
+
+	return victim;
+}
+
+/*
+ * Work out which part of the line containing @blk is covered by a read that
+ * ends before @end, returning the first block after that part
+ */
+static lbaint_t cache_span(lbaint_t blk, lbaint_t end, lbaint_t *linep,
+			   uint *lop, uint *hip)
+{
+	lbaint_t line = blk >> line_shift;
+	lbaint_t first = line << line_shift;
+
+	*linep = line;
+	*lop = blk - first;
+	*hip = min(end - first, (lbaint_t)1 << line_shift);
+
+	return first + *hip;
+}
+
+static void cache_fill(int iftype, int devnum, lbaint_t start,
+		       lbaint_t blkcnt, unsigned long blksz,
+		       const char *buffer, bool readahead)
+{
+	size_t map_size = BITS_TO_LONGS(1 << line_shift) * sizeof(long);
 	struct block_cache_node *node;
+	lbaint_t line, blk, next;
+	size_t size;
+	uint lo, hi;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
+	for (blk = start; blk < start + blkcnt; blk = next) {
+		next = cache_span(blk, start + blkcnt, &line, &lo, &hi);
+		node = cache_find(iftype, devnum, line, blksz);
+		if (node && hi >= node->lo && lo <= node->hi) {
+			/* merge with the blocks already present */
+			node->lo = min(node->lo, lo);
+			node->hi = max(node->hi, hi);
+			if (readahead)
+				bitmap_set(node->ra_map, lo, hi - lo);
+		} else {
+			if (!node) {
+				node = cache_victim(iftype, devnum, line);
+				if (node->cache && node->blksz != blksz) {
+					free(node->cache);
+					node->cache = NULL;
+				}
+				if (!node->cache) {
+					size = blksz << line_shift;
+					node->cache = malloc(size + map_size);
+					if (!node->cache)
+						return;
+					node->ra_map = (void *)(node->cache +
+								size);
+				}
+				_stats.entries++;
 			}
-			return node;
+			node->iftype = iftype;
+			node->devnum = devnum;
+			node->line = line;
+			node->blksz = blksz;
+			node->lo = lo;
+			node->hi = hi;
+			bitmap_zero(node->ra_map, 1 << line_shift);
+			if (readahead)
+				bitmap_set(node->ra_map, lo, hi - lo);
 		}
-	return 0;
+		memcpy(node->cache + lo * blksz, buffer, (hi - lo) * blksz);
+		buffer += (hi - lo) * blksz;
+		node->age = ++lru_clock;
+	}
 }
 
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
-		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+	struct block_cache_node *node;
+	struct block_cache_dev *bdev;
+	lbaint_t line, blk, next;
+	uint lo, hi, i;
+
+	if (!cache_init() || blkcnt > cache_max_blocks())
+		return 0;
+
+	bdev = cache_dev(iftype, devnum, true);
+	if (!bdev)
+		return 0;
+	if (start == bdev->next) {
+		bdev->seq_count++;
+	} else {
+		bdev->seq_count = 0;
+		bdev->ra_window = 0;
+	}
+	bdev->next = start + blkcnt;
+
+	for (blk = start; blk < start + blkcnt; blk = next) {
+		next = cache_span(blk, start + blkcnt, &line, &lo, &hi);
+		node = cache_find(iftype, devnum, line, blksz);
+		if (!node || node->lo > lo || node->hi < hi) {
+			debug("miss: start " LBAF ", count " LBAFU "\n",
+			      start, blkcnt);
+			++_stats.misses;
+			++bdev->stats.misses;
+			return 0;
+		}
 	}
 
-	debug("miss: start " LBAF ", count " LBAFU "\n",
+	for (blk = start; blk < start + blkcnt; blk = next) {
+		next = cache_span(blk, start + blkcnt, &line, &lo, &hi);
+		node = cache_find(iftype, devnum, line, blksz);
+		memcpy(buffer, node->cache + lo * blksz, (hi - lo) * blksz);
+		buffer += (hi - lo) * blksz;
+		node->age = ++lru_clock;
+
+		/* count only the blocks served, keeping the rest */
+		for (i = lo; i < hi; i++) {
+			if (test_bit(i, node->ra_map))
+				bdev->stats.ra_used++;
+		}
+		bitmap_clear(node->ra_map, lo, hi - lo);
+	}
+
+	debug("hit: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
-	++_stats.misses;
-	return 0;
+	++_stats.hits;
+	++bdev->stats.hits;
+	bdev->stats.bytes_saved += blkcnt * blksz;
+
+	return 1;
 }
 
 void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
-
 	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	if (!cache_init() || blkcnt > cache_max_blocks())
 		return;
 
-	if (_stats.max_entries == 0)
-		return;
+	debug("fill: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+	cache_fill(iftype, devnum, start, blkcnt, blksz, buffer, false);
+}
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
-	}
+void *blkcache_readahead(int iftype, int devnum,
+			 lbaint_t start, lbaint_t blkcnt,
+			 unsigned long blksz, lbaint_t lba_max,
+			 lbaint_t *countp)
+{
+	struct block_cache_dev *bdev;
+	lbaint_t window, end;
+	size_t size;
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
-		}
+	if (!IS_ENABLED(CONFIG_BLOCK_CACHE_READAHEAD) || !cache_init() ||
+	    blkcnt > cache_max_blocks())
+		return NULL;
+
+	bdev = cache_dev(iftype, devnum, false);
+	if (!bdev || !bdev->seq_count)
+		return NULL;
+
+	/* Double the window on each sequential miss */
+	window = bdev->ra_window ? bdev->ra_window * 2 :
+		max(blkcnt, (lbaint_t)1 << line_shift);
+	window = min(window, min((lbaint_t)CONFIG_BLOCK_CACHE_READAHEAD_MAX,
+				 cache_max_blocks() * 2));
+
+	/* Stop at a line boundary if possible, so the last line is complete */
+	end = start + blkcnt + window;
+	if (end >> line_shift << line_shift > start + blkcnt)
+		end = end >> line_shift << line_shift;
+	if (end > lba_max)
+		end = lba_max;
+	if (end <= start + blkcnt)
+		return NULL;
+
+	size = (end - start) * blksz;
+	if (size > ra_buf_size) {
+		free(ra_buf);
+		ra_buf_size = 0;
+		ra_buf = malloc_cache_aligned(size);
+		if (!ra_buf)
+			return NULL;
+		ra_buf_size = size;
 	}
+	*countp = end - start;
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+	return ra_buf;
+}
+
+void blkcache_fill_readahead(int iftype, int devnum,
+			     lbaint_t start, lbaint_t blkcnt,
+			     unsigned long blksz, void const *buffer)
+{
+	struct block_cache_dev *bdev;
+
+	bdev = cache_dev(iftype, devnum, false);
+	if (!bdev || !cache_init())
+		return;
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	debug("readahead: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+	cache_fill(iftype, devnum, start, blkcnt, blksz, buffer, true);
+	bdev->ra_window = blkcnt;
+	bdev->stats.ra_blocks += blkcnt;
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
+	struct block_cache_dev *bdev, *n;
+	uint i;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if (iftype == -1 ||
-		    (node->iftype == iftype && node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
+	if (iftype == -1) {
+		if (block_cache)
+			for (i = 0; i < num_sets * BLKCACHE_WAYS; i++)
+				free(block_cache[i].cache);
+		free(block_cache);
+		block_cache = NULL;
+		free(ra_buf);
+		ra_buf = NULL;
+		ra_buf_size = 0;
+		_stats.entries = 0;
+		list_for_each_entry_safe(bdev, n, &block_cache_devs, lh) {
+			list_del(&bdev->lh);
+			free(bdev);
 		}
+		return;
+	}
+
+	if (block_cache) {
+		for (i = 0; i < num_sets * BLKCACHE_WAYS; i++) {
+			struct block_cache_node *node = &block_cache[i];
+
+			if (node->iftype == iftype && node->devnum == devnum) {
+				node->iftype = -1;
+				--_stats.entries;
+			}
+		}
+	}
+	bdev = cache_dev(iftype, devnum, false);
+	if (bdev) {
+		bdev->next = 0;
+		bdev->seq_count = 0;
+		bdev->ra_window = 0;
 	}
 }
 
 void blkcache_configure(unsigned blocks, unsigned entries)
 {
+	/* lines must be a power of two in size */
+	if (blocks)
+		blocks = rounddown_pow_of_two(blocks);
+
 	/* invalidate cache if there is a change */
 	if ((blocks != _stats.max_blocks_per_entry) ||
 	    (entries != _stats.max_entries))
@@ -159,9 +446,33 @@ void blkcache_configure(unsigned blocks, unsigned entries)
 
 void blkcache_stats(struct block_cache_stats *stats)
 {
+	struct block_cache_dev *bdev;
+
 	memcpy(stats, &_stats, sizeof(*stats));
 	_stats.hits = 0;
 	_stats.misses = 0;
+	list_for_each_entry(bdev, &block_cache_devs, lh) {
+		int iftype = bdev->stats.iftype;
+		int devnum = bdev->stats.devnum;
+
+		memset(&bdev->stats, '\0', sizeof(bdev->stats));
+		bdev->stats.iftype = iftype;
+		bdev->stats.devnum = devnum;
+	}
+}
+
+int blkcache_dev_stats(int index, struct block_cache_dev_stats *stats)
+{
+	struct block_cache_dev *bdev;
+
+	list_for_each_entry(bdev, &block_cache_devs, lh) {
+		if (!index--) {
+			memcpy(stats, &bdev->stats, sizeof(*stats));
+			return 0;
+		}
+	}
+
+	return -ENOENT;
 }
 
 void blkcache_free(void)
@@ -55,13 +55,80 @@ static unsigned long host_block_write(struct udevice *dev,
 	return -EIO;
 }
 
+/*
+ * Asynchronous requests are queued and carried out one at a time as the
+ * device is polled, to behave like a device which works in the background
+ */
+static int host_block_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct host_blk_priv *priv = dev_get_priv(dev);
+
+	if (priv->count == HOST_BLK_MAX_REQS)
+		return -EBUSY;
+	list_add_tail(&req->sibling, &priv->reqs);
+	priv->count++;
+
+	return 0;
+}
+
+static int host_block_poll(struct udevice *dev)
+{
+	struct host_blk_priv *priv = dev_get_priv(dev);
+	struct blk_req *req;
+	long result;
+
+	req = list_first_entry_or_null(&priv->reqs, struct blk_req, sibling);
+	if (!req)
+		return 0;
+	list_del(&req->sibling);
+	priv->count--;
+
+	if (req->op == BLK_REQ_READ)
+		result = host_block_read(dev, req->start, req->blkcnt,
+					 req->buffer);
+	else
+		result = host_block_write(dev, req->start, req->blkcnt,
+					  req->buffer);
+	blk_req_complete(req, result);
+
+	return priv->count;
+}
+
+static int host_block_probe(struct udevice *dev)
+{
+	struct host_blk_priv *priv = dev_get_priv(dev);
+
+	INIT_LIST_HEAD(&priv->reqs);
+
+	return 0;
+}
+
+static int host_block_remove(struct udevice *dev)
+{
+	struct host_blk_priv *priv = dev_get_priv(dev);
+	struct blk_req *req, *next;
+
+	list_for_each_entry_safe(req, next, &priv->reqs, sibling) {
+		list_del(&req->sibling);
+		blk_req_complete(req, -ENODEV);
+	}
+	priv->count = 0;
+
+	return 0;
+}
+
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
 	.name		= "sandbox_host_blk",
 	.id		= UCLASS_BLK,
 	.ops		= &sandbox_host_blk_ops,
+	.probe		= host_block_probe,
+	.remove		= host_block_remove,
+	.priv_auto	= sizeof(struct host_blk_priv),
 };
@@ -8,9 +8,13 @@
 
 #define LOG_CATEGORY LOGC_DM
 
+#include <bootstage.h>
 #include <debug_uart.h>
 #include <errno.h>
 #include <log.h>
+#include <malloc.h>
+#include <sort.h>
+#include <asm/global_data.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -20,6 +24,8 @@
 #include <fdtdec.h>
 #include <linux/compiler.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 struct driver *lists_driver_lookup_name(const char *name)
 {
 	struct driver *drv =
@@ -196,11 +202,149 @@ static int driver_check_compatible(const struct udevice_id *of_match,
 	return -ENOENT;
 }
 
-int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
-		   struct driver *drv, bool pre_reloc_only)
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+/**
+ * struct dm_compat_entry - an entry in the index of compatible strings
+ *
+ * @hash: hash of the compatible string
+ * @drv: index of the driver in the driver linker list
+ * @id: index of the compatible string in the driver's of_match table
+ */
+struct dm_compat_entry {
+	u32 hash;
+	u16 drv;
+	u16 id;
+};
+
+/* FNV-1a hash of a compatible string */
+static u32 compat_hash(const char *compat)
+{
+	u32 hash = 0x811c9dc5;
+
+	while (*compat) {
+		hash ^= (u8)*compat++;
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
+static int compat_entry_cmp(const void *a, const void *b)
+{
+	const struct dm_compat_entry *x = a, *y = b;
+
+	/* Keep the linker-list order of drivers for equal hashes */
+	if (x->hash != y->hash)
+		return x->hash < y->hash ? -1 : 1;
+	if (x->drv != y->drv)
+		return x->drv - y->drv;
+
+	return x->id - y->id;
+}
+
+int lists_compat_index_init(void)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	struct dm_compat_entry *index, *ent;
+	const struct udevice_id *id;
+	int count, i;
+
+	if (gd->dm_compat_index)
+		return 0;
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_DM_INDEX, "dm_index");
+	count = 0;
+	for (i = 0; i < n_ents; i++)
+		for (id = driver[i].of_match; id && id->compatible; id++)
+			count++;
+
+	index = malloc(count * sizeof(*index));
+	if (!index) {
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_DM_INDEX);
+		return log_msg_ret("idx", -ENOMEM);
+	}
+
+	ent = index;
+	for (i = 0; i < n_ents; i++) {
+		for (id = driver[i].of_match; id && id->compatible; id++) {
+			ent->hash = compat_hash(id->compatible);
+			ent->drv = i;
+			ent->id = id - driver[i].of_match;
+			ent++;
+		}
+	}
+	qsort(index, count, sizeof(*index), compat_entry_cmp);
+	gd->dm_compat_index = index;
+	gd->dm_compat_count = count;
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_DM_INDEX);
+	log_debug("compatible index: %d strings from %d drivers\n", count,
+		  n_ents);
+
+	return 0;
+}
+
+/**
+ * lists_compat_lookup() - Look up a compatible string in the index
+ *
+ * @compat: Compatible string to look up
+ * @of_idp: Returns the match that was found
+ * Return: first driver in the linker list which has @compat in its of_match
+ * table, or NULL if none
+ */
+static struct driver *lists_compat_lookup(const char *compat,
+					  const struct udevice_id **of_idp)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const struct dm_compat_entry *index = gd->dm_compat_index;
+	const struct udevice_id *id;
+	u32 hash = compat_hash(compat);
+	int lo = 0, hi = gd->dm_compat_count;
+
+	/* Find the first entry with this hash */
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (index[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < gd->dm_compat_count && index[lo].hash == hash; lo++) {
+		id = &driver[index[lo].drv].of_match[index[lo].id];
+		if (!strcmp(id->compatible, compat)) {
+			*of_idp = id;
+			return &driver[index[lo].drv];
+		}
+	}
+
+	return NULL;
+}
+#endif /* DM_COMPAT_INDEX */
+
+struct driver *lists_driver_lookup_compat(const char *compat,
+					  const struct udevice_id **of_idp)
 {
 	struct driver *driver = ll_entry_start(struct driver, driver);
 	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver *entry;
+
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	if (gd->dm_compat_index)
+		return lists_compat_lookup(compat, of_idp);
+#endif
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		if (!driver_check_compatible(entry->of_match, of_idp, compat))
+			return entry;
+	}
+
+	return NULL;
+}
+
+int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
+		   struct driver *drv, bool pre_reloc_only)
+{
 	const struct udevice_id *id;
 	struct driver *entry;
 	struct udevice *dev;
@@ -238,20 +382,16 @@ int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 			  compat);
 
 		id = NULL;
-		for (entry = driver; entry != driver + n_ents; entry++) {
-			if (drv) {
-				if (drv != entry)
-					continue;
-				if (!entry->of_match)
-					break;
-			}
-			ret = driver_check_compatible(entry->of_match, &id,
-						      compat);
-			if (!ret)
-				break;
+		if (drv) {
+			entry = drv;
+			if (drv->of_match &&
+			    driver_check_compatible(drv->of_match, &id, compat))
+				continue;
+		} else {
+			entry = lists_driver_lookup_compat(compat, &id);
+			if (!entry)
+				continue;
 		}
-		if (entry == driver + n_ents)
-			continue;
 
 		if (pre_reloc_only) {
 			if (!ofnode_pre_reloc(node) &&
@@ -126,6 +126,11 @@ int dm_init(bool of_live)
 
 	INIT_LIST_HEAD((struct list_head *)&gd->dmtag_list);
 
+	/* Binding falls back to a linear search if there is no index */
+	ret = lists_compat_index_init();
+	if (ret)
+		log_debug("Cannot set up compatible index: %d\n", ret);
+
 	return 0;
 }
 
@@ -324,6 +324,19 @@ static int aspeed_hace_digest(struct udevice *dev, enum HASH_ALGO algo,
 	return aspeed_hace_digest_wd(dev, algo, ibuf, ilen, obuf, ilen);
 }
 
+static bool aspeed_hace_supports(struct udevice *dev, enum HASH_ALGO algo)
+{
+	switch (algo) {
+	case HASH_ALGO_SHA1:
+	case HASH_ALGO_SHA256:
+	case HASH_ALGO_SHA384:
+	case HASH_ALGO_SHA512:
+		return true;
+	default:
+		return false;
+	}
+}
+
 static int aspeed_hace_probe(struct udevice *dev)
 {
 	int rc;
@@ -361,6 +374,7 @@ static const struct hash_ops aspeed_hace_ops = {
 	.hash_finish = aspeed_hace_finish,
 	.hash_digest_wd = aspeed_hace_digest_wd,
 	.hash_digest = aspeed_hace_digest,
+	.hash_supports = aspeed_hace_supports,
 };
 
 static const struct udevice_id aspeed_hace_ids[] = {
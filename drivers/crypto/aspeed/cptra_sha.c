@@ -215,6 +215,11 @@ static int cptra_sha_digest(struct udevice *dev, enum HASH_ALGO algo,
 	return cptra_sha_digest_wd(dev, algo, ibuf, ilen, obuf, ilen);
 }
 
+static bool cptra_sha_supports(struct udevice *dev, enum HASH_ALGO algo)
+{
+	return algo == HASH_ALGO_SHA384 || algo == HASH_ALGO_SHA512;
+}
+
 static int cptra_sha_probe(struct udevice *dev)
 {
 	struct cptra_sha *cs = dev_get_priv(dev);
@@ -239,6 +244,7 @@ static const struct hash_ops cptra_sha_ops = {
 	.hash_finish = cptra_sha_finish,
 	.hash_digest_wd = cptra_sha_digest_wd,
 	.hash_digest = cptra_sha_digest,
+	.hash_supports = cptra_sha_supports,
 };
 
 static const struct udevice_id cptra_sha_ids[] = {
@@ -8,6 +8,7 @@
 
 #include <dm.h>
 #include <asm/global_data.h>
+#include <dm/device-internal.h>
 #include <u-boot/hash.h>
 #include <errno.h>
 #include <fdtdec.h>
@@ -114,6 +115,53 @@ int hash_finish(struct udevice *dev, void *ctx, void *obuf)
 	return ops->hash_finish(dev, ctx, obuf);
 }
 
+bool hash_supports(struct udevice *dev, enum HASH_ALGO algo)
+{
+	struct hash_ops *ops = (struct hash_ops *)device_get_ops(dev);
+
+	if (!ops->hash_supports || algo >= HASH_ALGO_NUM)
+		return false;
+
+	return ops->hash_supports(dev, algo);
+}
+
+int hash_find_device(enum HASH_ALGO algo, struct udevice **devp)
+{
+	struct udevice *dev;
+	struct uclass *uc;
+
+	/* Only probe the device which is picked, not every one on the way */
+	uclass_id_foreach_dev(UCLASS_HASH, dev, uc) {
+		if (hash_supports(dev, algo)) {
+			*devp = dev;
+			return device_probe(dev);
+		}
+	}
+
+	return -ENODEV;
+}
+
+int hash_submit(struct udevice *dev, void *ctx, const void *ibuf,
+		const uint32_t ilen)
+{
+	struct hash_ops *ops = (struct hash_ops *)device_get_ops(dev);
+
+	if (!ops->hash_submit)
+		return hash_update(dev, ctx, ibuf, ilen);
+
+	return ops->hash_submit(dev, ctx, ibuf, ilen);
+}
+
+int hash_poll(struct udevice *dev, void *ctx)
+{
+	struct hash_ops *ops = (struct hash_ops *)device_get_ops(dev);
+
+	if (!ops->hash_poll)
+		return 0;
+
+	return ops->hash_poll(dev, ctx);
+}
+
 UCLASS_DRIVER(hash) = {
 	.id	= UCLASS_HASH,
 	.name	= "hash",
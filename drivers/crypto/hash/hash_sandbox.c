@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Sandbox hash device
+ *
+ * This emulates a hash engine which works in the background: data submitted
+ * with hash_submit() is only hashed once enough time has passed for the
+ * configured throughput. The hashing itself uses the software algorithms.
+ */
+
+#define LOG_CATEGORY UCLASS_HASH
+
+#include <dm.h>
+#include <hash.h>
+#include <malloc.h>
+#include <time.h>
+#include <watchdog.h>
+#include <asm/test.h>
+#include <u-boot/hash.h>
+
+/* Longest time to wait for a submitted buffer to be hashed */
+#define SANDBOX_HASH_TIMEOUT_MS	10000
+
+/**
+ * struct sandbox_hash_priv - private data for the sandbox hash device
+ *
+ * @rate: Emulated throughput in bytes per microsecond (i.e. MB/s), or 0 to
+ *	hash data as soon as it is polled
+ * @bytes: Number of bytes hashed since the device was probed
+ */
+struct sandbox_hash_priv {
+	uint rate;
+	ulong bytes;
+};
+
+/**
+ * struct sandbox_hash_ctx - context for a hash operation
+ *
+ * @algo: Software algorithm used to calculate the hash
+ * @ctx: Context for @algo
+ * @buf: Data submitted but not yet hashed, or NULL if none
+ * @len: Number of bytes at @buf
+ * @done_us: Time at which the hardware would have finished hashing @buf
+ */
+struct sandbox_hash_ctx {
+	struct hash_algo *algo;
+	void *ctx;
+	const void *buf;
+	uint len;
+	ulong done_us;
+};
+
+static struct hash_algo *sandbox_hash_algo(enum HASH_ALGO algo)
+{
+	struct hash_algo *sw;
+	int i;
+
+	for (i = 0; !hash_get_soft_algo(i, &sw); i++) {
+		if (!strcmp(sw->name, hash_algo_name(algo)))
+			return sw->hash_init ? sw : NULL;
+	}
+
+	return NULL;
+}
+
+static bool sandbox_hash_supports(struct udevice *dev, enum HASH_ALGO algo)
+{
+	return sandbox_hash_algo(algo);
+}
+
+static int sandbox_hash_init(struct udevice *dev, enum HASH_ALGO algo,
+			     void **ctxp)
+{
+	struct sandbox_hash_ctx *ctx;
+	int ret;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return -ENOMEM;
+
+	ctx->algo = sandbox_hash_algo(algo);
+	if (!ctx->algo) {
+		free(ctx);
+		return -EINVAL;
+	}
+	ret = ctx->algo->hash_init(ctx->algo, &ctx->ctx);
+	if (ret) {
+		free(ctx);
+		return -ENOMEM;
+	}
+	*ctxp = ctx;
+
+	return 0;
+}
+
+static int sandbox_hash_submit(struct udevice *dev, void *vctx,
+			       const void *ibuf, const uint32_t ilen)
+{
+	struct sandbox_hash_priv *priv = dev_get_priv(dev);
+	struct sandbox_hash_ctx *ctx = vctx;
+
+	if (ctx->buf)
+		return -EBUSY;
+
+	ctx->buf = ibuf;
+	ctx->len = ilen;
+	ctx->done_us = timer_get_us() + (priv->rate ? ilen / priv->rate : 0);
+
+	return 0;
+}
+
+static int sandbox_hash_poll(struct udevice *dev, void *vctx)
+{
+	struct sandbox_hash_priv *priv = dev_get_priv(dev);
+	struct sandbox_hash_ctx *ctx = vctx;
+	int ret;
+
+	if (!ctx->buf)
+		return 0;
+	if ((long)(timer_get_us() - ctx->done_us) < 0)
+		return -EBUSY;
+
+	ret = ctx->algo->hash_update(ctx->algo, ctx->ctx, ctx->buf, ctx->len,
+				     0);
+	if (ret)
+		return -EIO;
+	priv->bytes += ctx->len;
+	ctx->buf = NULL;
+
+	return 0;
+}
+
+/* Wait for the submitted data to be hashed */
+static int sandbox_hash_wait(struct udevice *dev, void *ctx)
+{
+	ulong start = get_timer(0);
+	int ret;
+
+	while ((ret = sandbox_hash_poll(dev, ctx)) == -EBUSY) {
+		if (get_timer(start) > SANDBOX_HASH_TIMEOUT_MS)
+			return -ETIMEDOUT;
+		schedule();
+	}
+
+	return ret;
+}
+
+static int sandbox_hash_update(struct udevice *dev, void *ctx,
+			       const void *ibuf, const uint32_t ilen)
+{
+	int ret;
+
+	ret = sandbox_hash_wait(dev, ctx);
+	if (!ret)
+		ret = sandbox_hash_submit(dev, ctx, ibuf, ilen);
+	if (!ret)
+		ret = sandbox_hash_wait(dev, ctx);
+
+	return ret;
+}
+
+static int sandbox_hash_finish(struct udevice *dev, void *vctx, void *obuf)
+{
+	struct sandbox_hash_ctx *ctx = vctx;
+	int ret;
+
+	ret = sandbox_hash_wait(dev, ctx);
+	if (!ret)
+		ret = ctx->algo->hash_finish(ctx->algo, ctx->ctx, obuf,
+					     ctx->algo->digest_size);
+	free(ctx);
+
+	return ret ? -EIO : 0;
+}
+
+static int sandbox_hash_digest_wd(struct udevice *dev, enum HASH_ALGO algo,
+				  const void *ibuf, const uint32_t ilen,
+				  void *obuf, uint32_t chunk_sz)
+{
+	const void *end = ibuf + ilen;
+	uint32_t len;
+	void *ctx;
+	int ret;
+
+	ret = sandbox_hash_init(dev, algo, &ctx);
+	if (ret)
+		return ret;
+
+	if (!chunk_sz)
+		chunk_sz = ilen;
+	for (; ibuf < end; ibuf += len) {
+		len = min_t(uint32_t, chunk_sz, end - ibuf);
+		ret = sandbox_hash_update(dev, ctx, ibuf, len);
+		if (ret)
+			break;
+		schedule();
+	}
+
+	if (ret) {
+		sandbox_hash_finish(dev, ctx, obuf);
+		return ret;
+	}
+
+	return sandbox_hash_finish(dev, ctx, obuf);
+}
+
+static int sandbox_hash_digest(struct udevice *dev, enum HASH_ALGO algo,
+			       const void *ibuf, const uint32_t ilen,
+			       void *obuf)
+{
+	return sandbox_hash_digest_wd(dev, algo, ibuf, ilen, obuf, ilen);
+}
+
+void sandbox_hash_set_rate(struct udevice *dev, uint rate)
+{
+	struct sandbox_hash_priv *priv = dev_get_priv(dev);
+
+	priv->rate = rate;
+}
+
+ulong sandbox_hash_get_bytes(struct udevice *dev)
+{
+	struct sandbox_hash_priv *priv = dev_get_priv(dev);
+
+	return priv->bytes;
+}
+
+static int sandbox_hash_probe(struct udevice *dev)
+{
+	struct sandbox_hash_priv *priv = dev_get_priv(dev);
+
+	priv->rate = dev_read_u32_default(dev, "sandbox,rate-mbps", 0);
+
+	return 0;
+}
+
+static const struct hash_ops sandbox_hash_ops = {
+	.hash_init = sandbox_hash_init,
+	.hash_update = sandbox_hash_update,
+	.hash_finish = sandbox_hash_finish,
+	.hash_digest_wd = sandbox_hash_digest_wd,
+	.hash_digest = sandbox_hash_digest,
+	.hash_submit = sandbox_hash_submit,
+	.hash_poll = sandbox_hash_poll,
+	.hash_supports = sandbox_hash_supports,
+};
+
+static const struct udevice_id sandbox_hash_ids[] = {
+	{ .compatible = "sandbox,hash" },
+	{ }
+};
+
+U_BOOT_DRIVER(sandbox_hash) = {
+	.name = "sandbox_hash",
+	.id = UCLASS_HASH,
+	.of_match = sandbox_hash_ids,
+	.ops = &sandbox_hash_ops,
+	.probe = sandbox_hash_probe,
+	.priv_auto = sizeof(struct sandbox_hash_priv),
+};
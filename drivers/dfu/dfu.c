@@ -6,6 +6,7 @@
  * author: Lukasz Majewski <l.majewski@samsung.com>
  */
 
+#include <div64.h>
 #include <env.h>
 #include <errno.h>
 #include <log.h>
@@ -14,6 +15,8 @@
 #include <fat.h>
 #include <dfu.h>
 #include <hash.h>
+#include <time.h>
+#include <uthread.h>
 #include <linux/list.h>
 #include <linux/compiler.h>
 #include <linux/printk.h>
@@ -199,8 +202,68 @@ static unsigned char *dfu_buf;
 static unsigned long dfu_buf_size;
 static enum dfu_device_type dfu_buf_device_type;
 
+#if CONFIG_IS_ENABLED(DFU_WRITE_ASYNC)
+#define DFU_WRITE_BUFS	CONFIG_DFU_WRITE_BUFS
+#else
+#define DFU_WRITE_BUFS	1
+#endif
+
+/**
+ * struct dfu_writer - state for writing received data to the medium
+ *
+ * With DFU_WRITE_ASYNC, a full buffer is queued and written by a uthread
+ * while the next buffer is filled, so that the host does not have to wait for
+ * the medium. The buffers are used in turn, so they are written in the order
+ * in which they were filled.
+ *
+ * @buf: Buffers, the first being dfu_buf; the others are NULL until needed
+ * @len: Number of bytes queued for writing in each buffer, 0 if it is free
+ * @nbufs: Number of buffers in use for this transfer
+ * @cur: Buffer being filled
+ * @head: Next buffer to write
+ * @queued: Number of buffers waiting to be written
+ * @busy: true while the writer thread is running
+ * @err: First error from writing a queued buffer, 0 if none
+ * @start: Time the transfer started, in ms
+ * @bytes: Number of bytes received
+ * @stall: Time spent waiting for the medium, in ms
+ */
+static struct dfu_writer {
+	u8 *buf[DFU_WRITE_BUFS];
+	long len[DFU_WRITE_BUFS];
+	int nbufs;
+	int cur;
+	int head;
+	int queued;
+	bool busy;
+	int err;
+	ulong start;
+	u64 bytes;
+	ulong stall;
+} dfu_wr;
+
+/* Wait until buffer @slot is free, or all buffers are if @slot is -1 */
+static void dfu_writer_wait(int slot)
+{
+	ulong start;
+
+	if (!dfu_wr.queued)
+		return;
+	start = get_timer(0);
+	while (dfu_wr.busy && (slot < 0 || dfu_wr.len[slot]))
+		schedule();
+	dfu_wr.stall += get_timer(start);
+}
+
 unsigned char *dfu_free_buf(void)
 {
+	int i;
+
+	dfu_writer_wait(-1);
+	for (i = 1; i < DFU_WRITE_BUFS; i++) {
+		free(dfu_wr.buf[i]);
+		dfu_wr.buf[i] = NULL;
+	}
 	free(dfu_buf);
 	dfu_buf = NULL;
 	return dfu_buf;
@@ -258,6 +321,82 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
+static int dfu_write_one(struct dfu_entity *dfu, void *buf, long w_size)
+{
+	int ret;
+
+	ret = dfu->write_medium(dfu, dfu->offset, buf, &w_size);
+	if (ret)
+		debug("%s: Write error!\n", __func__);
+
+	/* update offset */
+	dfu->offset += w_size;
+
+	puts("#");
+
+	return ret;
+}
+
+/* Write out the queued buffers in order; runs as a uthread */
+static void dfu_writer_thread(void *arg)
+{
+	struct dfu_entity *dfu = arg;
+	int slot, ret;
+
+	while (dfu_wr.queued) {
+		slot = dfu_wr.head;
+		/* after an error, just drop the data */
+		if (!dfu_wr.err) {
+			ret = dfu_write_one(dfu, dfu_wr.buf[slot],
+					    dfu_wr.len[slot]);
+			if (ret)
+				dfu_wr.err = ret;
+		}
+		dfu_wr.len[slot] = 0;
+		dfu_wr.head = (slot + 1) % dfu_wr.nbufs;
+		dfu_wr.queued--;
+	}
+	dfu_wr.busy = false;
+}
+
+/*
+ * Set up the buffers for a new write transfer. The data arrives in @buf, which
+ * is dfu_buf itself for some callers (e.g. thor). In that case the caller
+ * overwrites the buffer as soon as dfu_write() returns, so it must be written
+ * out straight away.
+ */
+static void dfu_writer_start(struct dfu_entity *dfu, const void *buf)
+{
+	const u8 *ptr = buf;
+	int i;
+
+	dfu_wr.buf[0] = dfu->i_buf_start;
+	dfu_wr.nbufs = 1;
+	dfu_wr.cur = 0;
+	dfu_wr.head = 0;
+	dfu_wr.queued = 0;
+	dfu_wr.err = 0;
+	dfu_wr.start = get_timer(0);
+	dfu_wr.bytes = 0;
+	dfu_wr.stall = 0;
+
+	if (DFU_WRITE_BUFS == 1 ||
+	    (ptr >= dfu_buf && ptr < dfu_buf + dfu_buf_size))
+		return;
+
+	for (i = 1; i < DFU_WRITE_BUFS; i++) {
+		if (!dfu_wr.buf[i]) {
+			dfu_wr.buf[i] = memalign(CONFIG_SYS_CACHELINE_SIZE,
+						 dfu_buf_size);
+			if (!dfu_wr.buf[i]) {
+				debug("%s: Using %d buffers\n", __func__, i);
+				break;
+			}
+		}
+	}
+	dfu_wr.nbufs = i;
+}
+
 static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 {
 	long w_size;
@@ -268,27 +407,53 @@ static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 	if (w_size == 0)
 		return 0;
 
-	if (dfu_hash_algo)
-		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
-					   dfu->i_buf_start, w_size, 0);
+	if (dfu_wr.nbufs < 2) {
+		ret = dfu_write_one(dfu, dfu->i_buf_start, w_size);
 
-	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
-	if (ret)
-		debug("%s: Write error!\n", __func__);
+		/* point back */
+		dfu->i_buf = dfu->i_buf_start;
 
-	/* point back */
+		return ret;
+	}
+
+	/* queue this buffer, making sure that the writer thread is running */
+	dfu_wr.len[dfu_wr.cur] = w_size;
+	dfu_wr.queued++;
+	if (!dfu_wr.busy) {
+		dfu_wr.busy = true;
+		if (uthread_create(NULL, dfu_writer_thread, dfu, 0, 0))
+			dfu_writer_thread(dfu);
+	}
+
+	/* move on to the next buffer, once it has been written */
+	dfu_wr.cur = (dfu_wr.cur + 1) % dfu_wr.nbufs;
+	dfu_writer_wait(dfu_wr.cur);
+	dfu->i_buf_start = dfu_wr.buf[dfu_wr.cur];
+	dfu->i_buf_end = dfu->i_buf_start + dfu_get_buf_size();
 	dfu->i_buf = dfu->i_buf_start;
 
-	/* update offset */
-	dfu->offset += w_size;
+	return dfu_wr.err;
+}
 
-	puts("#");
+/* Report how long the transfer took and how much of it was spent waiting */
+static void dfu_writer_report(struct dfu_entity *dfu)
+{
+	ulong ms = get_timer(dfu_wr.start);
 
-	return ret;
+	if (!dfu_wr.bytes)
+		return;
+	printf("\nDFU %s: wrote %llu bytes in %lu ms", dfu->name,
+	       dfu_wr.bytes, ms);
+	if (ms)
+		printf(" (%llu KiB/s)", lldiv(dfu_wr.bytes * 1000, ms) / 1024);
+	printf(", %lu ms waiting for the medium\n", dfu_wr.stall);
 }
 
 void dfu_transaction_cleanup(struct dfu_entity *dfu)
 {
+	/* finish any writes still in progress */
+	dfu_writer_wait(-1);
+
 	/* clear everything */
 	dfu->crc = 0;
 	dfu->offset = 0;
@@ -335,6 +500,9 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	int ret = 0;
 
 	ret = dfu_write_buffer_drain(dfu);
+	dfu_writer_wait(-1);
+	if (!ret)
+		ret = dfu_wr.err;
 	if (ret)
 		return ret;
 
@@ -344,6 +512,7 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	if (dfu_hash_algo)
 		printf("\nDFU complete %s: 0x%08x\n", dfu_hash_algo->name,
 		       dfu->crc);
+	dfu_writer_report(dfu);
 
 	dfu_flush_callback(dfu);
 
@@ -354,6 +523,7 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 
 int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
+	bool start = !dfu->inited;
 	int ret;
 
 	debug("%s: name: %s buf: 0x%p size: 0x%x p_num: 0x%x offset: 0x%llx bufoffset: 0x%lx\n",
@@ -363,6 +533,8 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	ret = dfu_transaction_initiate(dfu, false);
 	if (ret < 0)
 		return ret;
+	if (start)
+		dfu_writer_start(dfu, buf);
 
 	if (dfu->i_blk_seq_num != blk_seq_num) {
 		printf("%s: Wrong sequence number! [%d] [%d]\n",
@@ -408,7 +580,12 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	}
 
 	memcpy(dfu->i_buf, buf, size);
+	/* hash the data now, while it is in the cache */
+	if (dfu_hash_algo)
+		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
+					   dfu->i_buf, size, 0);
 	dfu->i_buf += size;
+	dfu_wr.bytes += size;
 
 	/* if end or if buffer full flush */
 	if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end) {
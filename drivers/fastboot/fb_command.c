@@ -30,6 +30,27 @@ static u32 fastboot_bytes_received;
  */
 static u32 fastboot_bytes_expected;
 
+/**
+ * stream_part - partition to write the next download to as it arrives, or
+ * empty to use the download buffer. This is cleared once used.
+ */
+static char stream_part[PART_NAME_LEN];
+
+/**
+ * streamed_part - partition written by the last download, if it was streamed
+ */
+static char streamed_part[PART_NAME_LEN];
+
+/**
+ * stream_response - result of writing the last streamed download
+ */
+static char stream_response[FASTBOOT_RESPONSE_LEN];
+
+/**
+ * streaming - true while a download is being written as it arrives
+ */
+static bool streaming;
+
 static void okay(char *, char *);
 static void getvar(char *, char *);
 static void download(char *, char *);
@@ -43,6 +64,7 @@ static void oem_partconf(char *, char *);
 static void oem_bootbus(char *, char *);
 static void oem_console(char *, char *);
 static void oem_board(char *, char *);
+static void oem_stream(char *, char *);
 static void run_ucmd(char *, char *);
 static void run_acmd(char *, char *);
 
@@ -118,6 +140,10 @@ static const struct {
 		.command = "oem board",
 		.dispatch = CONFIG_IS_ENABLED(FASTBOOT_OEM_BOARD, (oem_board), (NULL))
 	},
+	[FASTBOOT_COMMAND_OEM_STREAM] = {
+		.command = "oem stream",
+		.dispatch = CONFIG_IS_ENABLED(FASTBOOT_STREAM_FLASH, (oem_stream), (NULL))
+	},
 	[FASTBOOT_COMMAND_UCMD] = {
 		.command = "UCmd",
 		.dispatch = CONFIG_IS_ENABLED(FASTBOOT_UUU_SUPPORT, (run_ucmd), (NULL))
@@ -238,6 +264,37 @@ static void download(char *cmd_parameter, char *response)
 		fastboot_fail("Expected nonzero image size", response);
 		return;
 	}
+	if (CONFIG_IS_ENABLED(FASTBOOT_STREAM_FLASH)) {
+		/*
+		 * An earlier download was abandoned part-way, so the partition
+		 * holds a truncated image. Do not write out what is left, but
+		 * tell the host that the image is incomplete.
+		 */
+		if (streaming) {
+			fastboot_mmc_stream_abort();
+			streaming = false;
+			*stream_part = '\0';
+			*streamed_part = '\0';
+			fastboot_fail("earlier streamed image incomplete",
+				      response);
+			return;
+		}
+		*streamed_part = '\0';
+		if (*stream_part) {
+			if (fastboot_mmc_stream_start(stream_part,
+						      fastboot_buf_addr,
+						      fastboot_buf_size,
+						      response))
+				return;
+			streaming = true;
+			*stream_response = '\0';
+			printf("Starting download of %d bytes to '%s'\n",
+			       fastboot_bytes_expected, stream_part);
+			fastboot_response("DATA", response, "%s",
+					  cmd_parameter);
+			return;
+		}
+	}
 	/*
 	 * Nothing to download yet. Response is of the form:
 	 * [DATA|FAIL]$cmd_parameter
@@ -291,9 +348,17 @@ void fastboot_data_download(const void *fastboot_data,
 			      response);
 		return;
 	}
-	/* Download data to fastboot_buf_addr */
-	memcpy(fastboot_buf_addr + fastboot_bytes_received,
-	       fastboot_data, fastboot_data_len);
+	if (streaming) {
+		/* After an error, just swallow the rest of the data */
+		if (!*stream_response)
+			fastboot_mmc_stream_write(fastboot_data,
+						  fastboot_data_len,
+						  stream_response);
+	} else {
+		/* Download data to fastboot_buf_addr */
+		memcpy(fastboot_buf_addr + fastboot_bytes_received,
+		       fastboot_data, fastboot_data_len);
+	}
 
 	pre_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
 	fastboot_bytes_received += fastboot_data_len;
@@ -313,6 +378,9 @@ void fastboot_data_download(const void *fastboot_data,
  * @response: Pointer to fastboot response buffer
  *
  * Set image_size and ${filesize} to the total size of the downloaded image.
+ * If the image was written as it arrived, finish writing it and respond with
+ * the result. In that case the image is not in the download buffer, so the
+ * size is set to 0.
  */
 void fastboot_data_complete(char *response)
 {
@@ -320,6 +388,14 @@ void fastboot_data_complete(char *response)
 	fastboot_okay(NULL, response);
 	printf("\ndownloading of %d bytes finished\n", fastboot_bytes_received);
 	image_size = fastboot_bytes_received;
+	if (CONFIG_IS_ENABLED(FASTBOOT_STREAM_FLASH) && streaming) {
+		fastboot_mmc_stream_finish(stream_response);
+		strlcpy(response, stream_response, FASTBOOT_RESPONSE_LEN);
+		strlcpy(streamed_part, stream_part, sizeof(streamed_part));
+		*stream_part = '\0';
+		streaming = false;
+		image_size = 0;
+	}
 	env_set_hex("filesize", image_size);
 	fastboot_bytes_expected = 0;
 	fastboot_bytes_received = 0;
@@ -333,9 +409,21 @@ void fastboot_data_complete(char *response)
  *
  * Writes the previously downloaded image to the partition indicated by
  * cmd_parameter. Writes to response.
+ *
+ * If the image was written as it downloaded, just report the result.
  */
 static void __maybe_unused flash(char *cmd_parameter, char *response)
 {
+	if (CONFIG_IS_ENABLED(FASTBOOT_STREAM_FLASH) && *streamed_part) {
+		if (!cmd_parameter || strcmp(cmd_parameter, streamed_part))
+			fastboot_fail("image was streamed to another partition",
+				      response);
+		else
+			strlcpy(response, stream_response,
+				FASTBOOT_RESPONSE_LEN);
+		return;
+	}
+
 	if (IS_ENABLED(CONFIG_FASTBOOT_FLASH_MMC))
 		fastboot_mmc_flash_write(cmd_parameter, fastboot_buf_addr,
 					 image_size, response);
@@ -572,3 +660,28 @@ static void __maybe_unused oem_board(char *cmd_parameter, char *response)
 {
 	fastboot_oem_board(cmd_parameter, (void *)fastboot_buf_addr, image_size, response);
 }
+
+/**
+ * oem_stream() - Execute the OEM stream command
+ *
+ * This makes the next download be written to the given partition as it
+ * arrives. Later downloads go to the buffer as usual, as do all downloads if
+ * no partition is given.
+ *
+ * @cmd_parameter: Pointer to partition name
+ * @response: Pointer to fastboot response buffer
+ */
+static void __maybe_unused oem_stream(char *cmd_parameter, char *response)
+{
+	if (!cmd_parameter) {
+		*stream_part = '\0';
+		fastboot_okay(NULL, response);
+		return;
+	}
+	if (strlen(cmd_parameter) >= sizeof(stream_part)) {
+		fastboot_fail("partition name too long", response);
+		return;
+	}
+	strlcpy(stream_part, cmd_parameter, sizeof(stream_part));
+	fastboot_okay(NULL, response);
+}
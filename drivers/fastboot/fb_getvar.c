@@ -26,6 +26,7 @@ static void getvar_has_slot(char *var_parameter, char *response);
 static void getvar_partition_type(char *part_name, char *response);
 static void getvar_partition_size(char *part_name, char *response);
 static void getvar_is_userspace(char *var_parameter, char *response);
+static void getvar_stream_flash(char *var_parameter, char *response);
 
 static const struct {
 	const char *variable;
@@ -90,6 +91,12 @@ static const struct {
 		.variable = "is-userspace",
 		.dispatch = getvar_is_userspace,
 		.list = true
+#if CONFIG_IS_ENABLED(FASTBOOT_STREAM_FLASH)
+	}, {
+		.variable = "stream-flash",
+		.dispatch = getvar_stream_flash,
+		.list = true
+#endif
 	}
 };
 
@@ -253,6 +260,12 @@ static void getvar_is_userspace(char *var_parameter, char *response)
 }
 
 static int current_all_dispatch;
+static void __maybe_unused getvar_stream_flash(char *var_parameter,
+					       char *response)
+{
+	fastboot_okay("yes", response);
+}
+
 void fastboot_getvar_all(char *response)
 {
 	/*
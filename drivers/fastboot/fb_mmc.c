@@ -22,6 +22,7 @@
 
 struct fb_mmc_sparse {
 	struct blk_desc	*dev_desc;
+	struct blk_req	req;
 };
 
 static int raw_part_get_info_by_name(struct blk_desc *dev_desc,
@@ -164,6 +165,34 @@ static lbaint_t fb_mmc_sparse_reserve(struct sparse_storage *info,
 	return blkcnt;
 }
 
+/*
+ * Start writing a chunk. The MMC queue carries out writes directly, so at
+ * present this only returns once the chunk has been written.
+ */
+static int __maybe_unused fb_mmc_sparse_submit(struct sparse_storage *info,
+		lbaint_t blk, lbaint_t blkcnt, const void *buffer)
+{
+	struct fb_mmc_sparse *sparse = info->priv;
+	struct blk_req *req = &sparse->req;
+
+	if (fastboot_progress_callback)
+		fastboot_progress_callback("writing");
+	memset(req, '\0', sizeof(*req));
+	req->op = BLK_REQ_WRITE;
+	req->start = blk;
+	req->blkcnt = blkcnt;
+	req->buffer = (void *)buffer;
+
+	return blk_submit(sparse->dev_desc->bdev, req);
+}
+
+static lbaint_t __maybe_unused fb_mmc_sparse_wait(struct sparse_storage *info)
+{
+	struct fb_mmc_sparse *sparse = info->priv;
+
+	return blk_wait(sparse->dev_desc->bdev, &sparse->req);
+}
+
 static void write_raw_image(struct blk_desc *dev_desc,
 			    struct disk_partition *info, const char *part_name,
 			    void *buffer, u32 download_bytes, char *response)
@@ -636,6 +665,127 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 	}
 }
 
+#if CONFIG_IS_ENABLED(FASTBOOT_STREAM_FLASH)
+/**
+ * struct fb_mmc_stream - State of an image being written as it downloads
+ *
+ * @priv: Private data for the sparse-image writer
+ * @sparse: Storage the image is written to
+ * @ss: Sparse-image stream
+ * @part_name: Partition being written
+ */
+static struct fb_mmc_stream {
+	struct fb_mmc_sparse priv;
+	struct sparse_storage sparse;
+	struct sparse_stream ss;
+	char part_name[PART_NAME_LEN];
+} fb_mmc_stream;
+
+/* Check for names which fastboot_mmc_flash_write() handles specially */
+static bool fb_mmc_special_name(const char *cmd)
+{
+#ifdef CONFIG_FASTBOOT_MMC_BOOT_SUPPORT
+	if (!strcmp(cmd, CONFIG_FASTBOOT_MMC_BOOT1_NAME) ||
+	    !strcmp(cmd, CONFIG_FASTBOOT_MMC_BOOT2_NAME))
+		return true;
+#endif
+#if CONFIG_IS_ENABLED(EFI_PARTITION)
+	if (!strcmp(cmd, CONFIG_FASTBOOT_GPT_NAME))
+		return true;
+#endif
+#if CONFIG_IS_ENABLED(DOS_PARTITION)
+	if (!strcmp(cmd, CONFIG_FASTBOOT_MBR_NAME))
+		return true;
+#endif
+#ifdef CONFIG_ANDROID_BOOT_IMAGE
+	if (!strncasecmp(cmd, "zimage", 6))
+		return true;
+#endif
+
+	return false;
+}
+
+int fastboot_mmc_stream_start(const char *cmd, void *buf, u32 size,
+			      char *response)
+{
+	struct fb_mmc_stream *st = &fb_mmc_stream;
+	struct blk_desc *dev_desc;
+	struct disk_partition info = {0};
+	int ret;
+
+	if (fb_mmc_special_name(cmd)) {
+		fastboot_fail("cannot stream to this partition", response);
+		return -EINVAL;
+	}
+
+#if IS_ENABLED(CONFIG_FASTBOOT_MMC_USER_SUPPORT)
+	if (strcmp(cmd, CONFIG_FASTBOOT_MMC_USER_NAME) == 0) {
+		dev_desc = fastboot_mmc_get_dev(response);
+		if (!dev_desc)
+			return -ENODEV;
+
+		strlcpy((char *)&info.name, cmd, sizeof(info.name));
+		info.size	= dev_desc->lba;
+		info.blksz	= dev_desc->blksz;
+	}
+#endif
+
+	if (!info.name[0]) {
+		ret = fastboot_mmc_get_part_info(cmd, &dev_desc, &info,
+						 response);
+		if (ret < 0)
+			return ret;
+	}
+
+	st->priv.dev_desc = dev_desc;
+	st->sparse.blksz = info.blksz;
+	st->sparse.start = info.start;
+	st->sparse.size = info.size;
+	st->sparse.write = fb_mmc_sparse_write;
+	st->sparse.reserve = fb_mmc_sparse_reserve;
+	st->sparse.submit = fb_mmc_sparse_submit;
+	st->sparse.wait = fb_mmc_sparse_wait;
+	st->sparse.mssg = fastboot_fail;
+	st->sparse.priv = &st->priv;
+	strlcpy(st->part_name, cmd, sizeof(st->part_name));
+
+	ret = sparse_stream_start(&st->ss, &st->sparse, buf, size);
+	if (ret) {
+		fastboot_fail("download buffer too small to stream", response);
+		return ret;
+	}
+	printf("Streaming image to '%s' at offset " LBAFU "\n", cmd,
+	       info.start);
+
+	return 0;
+}
+
+int fastboot_mmc_stream_write(const void *data, u32 len, char *response)
+{
+	return sparse_stream_write(&fb_mmc_stream.ss, data, len, response);
+}
+
+int fastboot_mmc_stream_finish(char *response)
+{
+	struct fb_mmc_stream *st = &fb_mmc_stream;
+	int ret;
+
+	ret = sparse_stream_finish(&st->ss, st->part_name, response);
+	if (!ret)
+		fastboot_okay(NULL, response);
+
+	return ret;
+}
+
+void fastboot_mmc_stream_abort(void)
+{
+	struct fb_mmc_stream *st = &fb_mmc_stream;
+
+	sparse_stream_abort(&st->ss);
+	printf("Abandoned incomplete image in '%s'\n", st->part_name);
+}
+#endif
+
 /**
  * fastboot_mmc_flash_erase() - Erase eMMC for fastboot
  *
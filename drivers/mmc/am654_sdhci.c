@@ -17,6 +17,9 @@
 #include <linux/bitops.h>
 #include <linux/err.h>
 
+/* Command-queueing engine, relative to the SDHCI registers */
+#define AM654_SDHCI_CQE_BASE	0x200
+
 /* CTL_CFG Registers */
 #define CTL_CFG_2		0x14
 
@@ -520,10 +523,38 @@ static int am654_sdhci_execute_tuning(struct mmc *mmc, u8 opcode)
 
 	return 0;
 }
+
+static int am654_sdhci_get_tuning(struct sdhci_host *host, u32 *tapp)
+{
+	struct am654_sdhci_plat *plat = dev_get_plat(host->mmc->dev);
+	int mode = host->mmc->selected_mode;
+
+	if (!plat->itap_del_ena[mode])
+		return -ENOENT;
+	*tapp = plat->itap_del_sel[mode];
+
+	return 0;
+}
+
+static int am654_sdhci_set_tuning(struct sdhci_host *host, u32 tap)
+{
+	struct am654_sdhci_plat *plat = dev_get_plat(host->mmc->dev);
+	int mode = host->mmc->selected_mode;
+
+	if (tap > ITAPDLY_LAST_INDEX)
+		return -EINVAL;
+	plat->itap_del_ena[mode] = ENABLE;
+	plat->itap_del_sel[mode] = tap;
+	am654_sdhci_write_itapdly(plat, tap, ENABLE);
+
+	return 0;
+}
 #endif
 const struct sdhci_ops am654_sdhci_ops = {
 #if CONFIG_IS_ENABLED(MMC_SUPPORTS_TUNING)
 	.platform_execute_tuning = am654_sdhci_execute_tuning,
+	.platform_get_tuning	= am654_sdhci_get_tuning,
+	.platform_set_tuning	= am654_sdhci_set_tuning,
 #endif
 	.deferred_probe		= am654_sdhci_deferred_probe,
 	.set_ios_post		= &am654_sdhci_set_ios_post,
@@ -584,6 +615,8 @@ static int j721e_4bit_sdhci_set_ios_post(struct sdhci_host *host)
 const struct sdhci_ops j721e_4bit_sdhci_ops = {
 #if CONFIG_IS_ENABLED(MMC_SUPPORTS_TUNING)
 	.platform_execute_tuning = am654_sdhci_execute_tuning,
+	.platform_get_tuning	= am654_sdhci_get_tuning,
+	.platform_set_tuning	= am654_sdhci_set_tuning,
 #endif
 	.deferred_probe		= am654_sdhci_deferred_probe,
 	.set_ios_post		= &j721e_4bit_sdhci_set_ios_post,
@@ -686,6 +719,11 @@ static int am654_sdhci_probe(struct udevice *dev)
 	if (ret)
 		return ret;
 
+	ret = sdhci_cqe_setup(cfg, host, host->ioaddr + AM654_SDHCI_CQE_BASE,
+			      SDHCI_CQE_SHORT_TRANS_DESC);
+	if (ret)
+		return ret;
+
 	ret = sdhci_am654_get_otap_delay(dev, cfg);
 	if (ret)
 		return ret;
@@ -104,44 +104,51 @@ static void dwmci_set_idma_desc64(struct dwmci_idmac64 *desc, u32 control,
 	desc->des7 = next_desc_phys >> 32;
 }
 
+/* Largest buffer for one descriptor */
+#define DWMCI_DESC_MAX_LEN	PAGE_SIZE
+
+/* Each buffer must be a multiple of the width of the host data bus */
+#define DWMCI_DMA_GRANULE	8
+
 static void dwmci_prepare_desc(struct dwmci_host *host, struct mmc_data *data,
-			       void *cur_idmac, void *bounce_buffer)
+			       void *cur_idmac, struct bounce_split *bbstate)
 {
 	struct dwmci_idmac32 *desc32 = cur_idmac;
 	struct dwmci_idmac64 *desc64 = cur_idmac;
 	ulong data_start, data_end;
-	unsigned int blk_cnt, i;
+	bool first = true;
+	int seg;
 
 	data_start = (ulong)cur_idmac;
-	blk_cnt = data->blocks;
-
-	for (i = 0;; i++) {
-		phys_addr_t buf_phys = virt_to_phys(bounce_buffer);
-		unsigned int flags, cnt;
-
-		flags = DWMCI_IDMAC_OWN | DWMCI_IDMAC_CH;
-		if (i == 0)
-			flags |= DWMCI_IDMAC_FS;
-		if (blk_cnt <= 8) {
-			flags |= DWMCI_IDMAC_LD;
-			cnt = data->blocksize * blk_cnt;
-		} else {
-			cnt = data->blocksize * 8;
-		}
 
-		if (host->dma_64bit_address) {
-			dwmci_set_idma_desc64(desc64, flags, cnt,
-					      buf_phys + i * PAGE_SIZE);
-			desc64++;
-		} else {
-			dwmci_set_idma_desc32(desc32, flags, cnt,
-					      buf_phys + i * PAGE_SIZE);
-			desc32++;
+	/* Each segment of the buffer needs one descriptor per page */
+	for (seg = 0; seg < bbstate->count; seg++) {
+		phys_addr_t buf_phys = virt_to_phys(bbstate->seg[seg].addr);
+		size_t left = bbstate->seg[seg].len;
+
+		while (left) {
+			unsigned int flags, cnt;
+
+			flags = DWMCI_IDMAC_OWN | DWMCI_IDMAC_CH;
+			if (first)
+				flags |= DWMCI_IDMAC_FS;
+			first = false;
+			cnt = min_t(size_t, left, DWMCI_DESC_MAX_LEN);
+			left -= cnt;
+			if (!left && seg == bbstate->count - 1)
+				flags |= DWMCI_IDMAC_LD;
+
+			if (host->dma_64bit_address) {
+				dwmci_set_idma_desc64(desc64, flags, cnt,
+						      buf_phys);
+				desc64++;
+			} else {
+				dwmci_set_idma_desc32(desc32, flags, cnt,
+						      buf_phys);
+				desc32++;
+			}
+			buf_phys += cnt;
 		}
-
-		if (blk_cnt <= 8)
-			break;
-		blk_cnt -= 8;
 	}
 
 	if (host->dma_64bit_address)
@@ -152,7 +159,7 @@ static void dwmci_prepare_desc(struct dwmci_host *host, struct mmc_data *data,
 }
 
 static void dwmci_prepare_data(struct dwmci_host *host, struct mmc_data *data,
-			       void *cur_idmac, void *bounce_buffer)
+			       void *cur_idmac, struct bounce_split *bbstate)
 {
 	const u32 idmacl = virt_to_phys(cur_idmac) & 0xffffffff;
 	const u32 idmacu = (u64)virt_to_phys(cur_idmac) >> 32;
@@ -167,7 +174,7 @@ static void dwmci_prepare_data(struct dwmci_host *host, struct mmc_data *data,
 	if (host->dma_64bit_address)
 		dwmci_writel(host, host->regs->dbaddru, idmacu);
 
-	dwmci_prepare_desc(host, data, cur_idmac, bounce_buffer);
+	dwmci_prepare_desc(host, data, cur_idmac, bbstate);
 
 	ctrl = dwmci_readl(host, DWMCI_CTRL);
 	ctrl |= DWMCI_IDMAC_EN | DWMCI_DMA_EN;
@@ -306,7 +313,7 @@ static int dwmci_data_transfer(struct dwmci_host *host, struct mmc_data *data)
 }
 
 static int dwmci_dma_transfer(struct dwmci_host *host, uint flags,
-			      struct bounce_buffer *bbstate)
+			      struct bounce_split *bbstate)
 {
 	int ret;
 	u32 mask, ctrl;
@@ -328,7 +335,7 @@ static int dwmci_dma_transfer(struct dwmci_host *host, uint flags,
 	ctrl &= ~DWMCI_DMA_EN;
 	dwmci_writel(host, DWMCI_CTRL, ctrl);
 
-	bounce_buffer_stop(bbstate);
+	bounce_split_stop(bbstate);
 	return ret;
 }
 
@@ -365,7 +372,7 @@ static int dwmci_send_cmd_common(struct dwmci_host *host, struct mmc_cmd *cmd,
 	int ret, flags = 0, i;
 	u32 retry = 100000;
 	u32 mask;
-	struct bounce_buffer bbstate;
+	struct bounce_split bbstate;
 
 	dwmci_wait_while_busy(host, cmd);
 	dwmci_writel(host, DWMCI_RINTSTS, DWMCI_INTMSK_ALL);
@@ -377,23 +384,28 @@ static int dwmci_send_cmd_common(struct dwmci_host *host, struct mmc_cmd *cmd,
 				     data->blocksize * data->blocks);
 			dwmci_wait_reset(host, DWMCI_CTRL_FIFO_RESET);
 		} else {
+			/*
+			 * The IDMAC takes a list of buffers, so only the ends
+			 * of an unaligned buffer need to be bounced
+			 */
 			if (data->flags == MMC_DATA_READ) {
-				ret = bounce_buffer_start(&bbstate,
+				ret = bounce_split_start(&bbstate,
 						(void *)data->dest,
 						data->blocksize *
-						data->blocks, GEN_BB_WRITE);
+						data->blocks, GEN_BB_WRITE,
+						DWMCI_DMA_GRANULE);
 			} else {
-				ret = bounce_buffer_start(&bbstate,
+				ret = bounce_split_start(&bbstate,
 						(void *)data->src,
 						data->blocksize *
-						data->blocks, GEN_BB_READ);
+						data->blocks, GEN_BB_READ,
+						DWMCI_DMA_GRANULE);
 			}
 
 			if (ret)
 				return ret;
 
-			dwmci_prepare_data(host, data, cur_idmac,
-					   bbstate.bounce_buffer);
+			dwmci_prepare_data(host, data, cur_idmac, &bbstate);
 		}
 	}
 
@@ -492,7 +504,10 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 {
 #endif
 	struct dwmci_host *host = mmc->priv;
-	const size_t buf_size = data ? DIV_ROUND_UP(data->blocks, 8) : 0;
+	/* Splitting off the ends of the buffer may need two more descriptors */
+	const size_t buf_size = data ?
+		DIV_ROUND_UP(data->blocks * data->blocksize,
+			     DWMCI_DESC_MAX_LEN) + BOUNCE_SPLIT_SEGS - 1 : 0;
 
 	if (host->dma_64bit_address) {
 		ALLOC_CACHE_ALIGN_BUFFER(struct dwmci_idmac64, idmac, buf_size);
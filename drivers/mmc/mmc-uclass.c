@@ -10,6 +10,7 @@
 #include <bootdev.h>
 #include <log.h>
 #include <mmc.h>
+#include <uthread.h>
 #include <dm.h>
 #include <dm/device-internal.h>
 #include <dm/device_compat.h>
@@ -52,6 +53,10 @@ static int dm_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 
 int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
+	/* Commands cannot be sent while the card is queueing tasks */
+	if (mmc_cqe_is_on(mmc))
+		mmc_cqe_off(mmc);
+
 	return dm_mmc_send_cmd(mmc->dev, cmd, data);
 }
 
@@ -125,9 +130,15 @@ int mmc_execute_tuning(struct mmc *mmc, uint opcode)
 {
 	int ret;
 
+	/* If this card was tuned before, try the same result */
+	if (!mmc_cache_restore_tuning(mmc))
+		return 0;
+
 	mmc->tuning = true;
 	ret = dm_mmc_execute_tuning(mmc->dev, opcode);
 	mmc->tuning = false;
+	if (!ret)
+		mmc_cache_note_tuning(mmc);
 
 	return ret;
 }
@@ -179,6 +190,38 @@ int mmc_host_power_cycle(struct mmc *mmc)
 	return dm_mmc_host_power_cycle(mmc->dev);
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+int mmc_cqe_enable(struct mmc *mmc, bool enable)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!ops->cqe_enable)
+		return -ENOSYS;
+
+	return ops->cqe_enable(mmc->dev, enable);
+}
+
+int mmc_cqe_submit(struct mmc *mmc, struct mmc_cqe_task *task)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!ops->cqe_submit)
+		return -ENOSYS;
+
+	return ops->cqe_submit(mmc->dev, task);
+}
+
+int mmc_cqe_poll(struct mmc *mmc, u32 *donep)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!ops->cqe_poll)
+		return -ENOSYS;
+
+	return ops->cqe_poll(mmc->dev, donep);
+}
+#endif
+
 static int dm_mmc_deferred_probe(struct udevice *dev)
 {
 	struct dm_mmc_ops *ops = mmc_get_ops(dev);
@@ -274,6 +317,9 @@ int mmc_of_parse(struct udevice *dev, struct mmc_config *cfg)
 			cfg->host_caps |= MMC_CAP_NEEDS_POLL;
 	}
 
+	if (dev_read_bool(dev, "supports-cqe"))
+		cfg->host_caps |= MMC_CAP_CQE;
+
 	if (dev_read_bool(dev, "no-1-8-v")) {
 		cfg->host_caps &= ~(UHS_CAPS | MMC_MODE_HS200 |
 				    MMC_MODE_HS400 | MMC_MODE_HS400_ES);
@@ -351,15 +397,23 @@ struct blk_desc *mmc_get_blk_desc(struct mmc *mmc)
 	return desc;
 }
 
+static void mmc_preinit_thread(void *arg)
+{
+	mmc_init(arg);
+}
+
 void mmc_do_preinit(void)
 {
 	struct udevice *dev;
 	struct uclass *uc;
+	uint grp_id = 0;
 	int ret;
 
 	ret = uclass_get(UCLASS_MMC, &uc);
 	if (ret)
 		return;
+	if (CONFIG_IS_ENABLED(MMC_UTHREAD))
+		grp_id = uthread_grp_new_id();
 	uclass_foreach_dev(dev, uc) {
 		struct mmc *m = mmc_get_mmc_dev(dev);
 
@@ -368,9 +422,20 @@ void mmc_do_preinit(void)
 
 		m->user_speed_mode = MMC_MODES_END;  /* Initialising user set speed mode */
 
-		if (m->preinit)
-			mmc_start_init(m);
+		if (!m->preinit)
+			continue;
+
+		/*
+		 * Initialise the card completely in its own thread, so that
+		 * waiting for it to power up overlaps with the other cards
+		 */
+		if (grp_id &&
+		    !uthread_create(NULL, mmc_preinit_thread, m, 0, grp_id))
+			continue;
+		mmc_start_init(m);
 	}
+	if (grp_id)
+		uthread_grp_wait(grp_id);
 }
 
 #if !defined(CONFIG_XPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
@@ -516,6 +581,8 @@ static int mmc_blk_remove(struct udevice *dev)
 	struct mmc_uclass_priv *upriv = dev_get_uclass_priv(mmc_dev);
 	struct mmc *mmc = upriv->mmc;
 
+	mmc_queue_remove(mmc);
+
 	return mmc_deinit(mmc);
 }
 
@@ -526,6 +593,10 @@ static const struct blk_ops mmc_blk_ops = {
 	.erase	= mmc_berase,
 #endif
 	.select_hwpart	= mmc_select_hwpart,
+#if CONFIG_IS_ENABLED(MMC_QUEUE)
+	.submit	= mmc_queue_submit,
+	.poll	= mmc_queue_poll,
+#endif
 };
 
 U_BOOT_DRIVER(mmc_blk) = {
@@ -541,6 +541,16 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 		return 0;
 	}
 
+	/*
+	 * Large reads go to the command queue, if there is one. This must be
+	 * checked before CMD16, which takes the card out of queueing mode.
+	 */
+	if (mmc_cqe_wanted(mmc, dst, blkcnt)) {
+		if (mmc_cqe_read(mmc, start, blkcnt, dst) == blkcnt)
+			return blkcnt;
+		pr_debug("%s: Queued read failed, retrying\n", __func__);
+	}
+
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
 		pr_debug("%s: Failed to set blocklen\n", __func__);
 		return 0;
@@ -562,6 +572,74 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	return blkcnt;
 }
 
+#if CONFIG_IS_ENABLED(MMC_PACKED)
+int mmc_read_packed(struct mmc *mmc, struct blk_req **reqs, int count,
+		    void *dst)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(__le32, hdr, MMC_MAX_BLOCK_LEN / 4);
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	lbaint_t total = 0;
+	int i, err;
+
+	/* The header holds two words for the header and each read */
+	if (count < 2 || count > mmc->max_packed_reads ||
+	    (count + 1) * 8 > MMC_MAX_BLOCK_LEN)
+		return -EINVAL;
+
+	memset(hdr, '\0', MMC_MAX_BLOCK_LEN);
+	hdr[0] = cpu_to_le32(count << 16 | MMC_PACKED_READ << 8 |
+			     MMC_PACKED_VERSION);
+	for (i = 0; i < count; i++) {
+		struct blk_req *req = reqs[i];
+
+		hdr[(i + 1) * 2] = cpu_to_le32(req->blkcnt);
+		hdr[(i + 1) * 2 + 1] = cpu_to_le32(mmc->high_capacity ?
+			req->start : req->start * mmc->read_bl_len);
+		total += req->blkcnt;
+	}
+
+	/* Send the header as a packed write of one block */
+	cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	cmd.cmdarg = MMC_CMD23_ARG_PACKED | 1;
+	cmd.resp_type = MMC_RSP_R1;
+	err = mmc_send_cmd(mmc, &cmd, NULL);
+	if (err)
+		return err;
+
+	cmd.cmdidx = MMC_CMD_WRITE_MULTIPLE_BLOCK;
+	cmd.cmdarg = mmc->high_capacity ? reqs[0]->start :
+		reqs[0]->start * mmc->read_bl_len;
+	cmd.resp_type = MMC_RSP_R1;
+	data.src = (const char *)hdr;
+	data.blocks = 1;
+	data.blocksize = MMC_MAX_BLOCK_LEN;
+	data.flags = MMC_DATA_WRITE;
+	err = mmc_send_cmd(mmc, &cmd, &data);
+	if (err)
+		return err;
+
+	/* Now read the data for all the entries in one go */
+	cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	cmd.cmdarg = MMC_CMD23_ARG_PACKED | total;
+	cmd.resp_type = MMC_RSP_R1;
+	err = mmc_send_cmd(mmc, &cmd, NULL);
+	if (err)
+		return err;
+
+	cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
+	cmd.cmdarg = mmc->high_capacity ? reqs[0]->start :
+		reqs[0]->start * mmc->read_bl_len;
+	cmd.resp_type = MMC_RSP_R1;
+	data.dest = dst;
+	data.blocks = total;
+	data.blocksize = mmc->read_bl_len;
+	data.flags = MMC_DATA_READ;
+
+	return mmc_send_cmd(mmc, &cmd, &data);
+}
+#endif
+
 static int mmc_go_idle(struct mmc *mmc)
 {
 	struct mmc_cmd cmd;
@@ -751,14 +829,20 @@ static int mmc_send_op_cond(struct mmc *mmc)
 	int err, i;
 	int timeout = 1000;
 	uint start;
+	u32 ocr;
 
 	/* Some cards seem to need this */
 	mmc_go_idle(mmc);
 
+	/* For a known card, the capabilities need not be asked for first */
+	ocr = mmc_cache_ocr(mmc);
+	if (ocr)
+		mmc->ocr = ocr;
+
 	start = get_timer(0);
 	/* Asking to the card its capabilities */
 	for (i = 0; ; i++) {
-		err = mmc_send_op_cond_iter(mmc, i != 0);
+		err = mmc_send_op_cond_iter(mmc, i != 0 || ocr);
 		if (err)
 			return err;
 
@@ -2153,6 +2237,115 @@ static int mmc_select_hs400es(struct mmc *mmc)
 	    ecbv++) \
 		if ((ddr == ecbv->is_ddr) && (caps & ecbv->cap))
 
+/* Try a bus mode and width, going back to a safe mode if it does not work */
+static int mmc_try_mode_and_width(struct mmc *mmc,
+				  const struct mode_width_tuning *mwt,
+				  const struct ext_csd_bus_width *ecbw)
+{
+	enum mmc_voltage old_voltage;
+	int err;
+
+	pr_debug("trying mode %s width %d (at %d MHz)\n",
+		 mmc_mode_name(mwt->mode), bus_width(ecbw->cap),
+		 mmc_mode2freq(mmc, mwt->mode) / 1000000);
+	old_voltage = mmc->signal_voltage;
+	err = mmc_set_lowest_voltage(mmc, mwt->mode, MMC_ALL_SIGNAL_VOLTAGE);
+	if (err)
+		return err;
+
+	/* configure the bus width (card + host) */
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BUS_WIDTH,
+			 ecbw->ext_csd_bits & ~EXT_CSD_DDR_FLAG);
+	if (err)
+		goto error;
+	mmc_set_bus_width(mmc, bus_width(ecbw->cap));
+
+	if (mwt->mode == MMC_HS_400) {
+		err = mmc_select_hs400(mmc);
+		if (err) {
+			printf("Select HS400 failed %d\n", err);
+			goto error;
+		}
+	} else if (mwt->mode == MMC_HS_400_ES) {
+		err = mmc_select_hs400es(mmc);
+		if (err) {
+			printf("Select HS400ES failed %d\n", err);
+			goto error;
+		}
+	} else {
+		/* configure the bus speed (card) */
+		err = mmc_set_card_speed(mmc, mwt->mode, false);
+		if (err)
+			goto error;
+
+		/*
+		 * configure the bus width AND the ddr mode (card). The host
+		 * side will be taken care of in the next step
+		 */
+		if (ecbw->ext_csd_bits & EXT_CSD_DDR_FLAG) {
+			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
+					 EXT_CSD_BUS_WIDTH,
+					 ecbw->ext_csd_bits);
+			if (err)
+				goto error;
+		}
+
+		/* configure the bus mode (host) */
+		mmc_select_mode(mmc, mwt->mode);
+		mmc_set_clock(mmc, mmc->tran_speed, MMC_CLK_ENABLE);
+#if CONFIG_IS_ENABLED(MMC_SUPPORTS_TUNING)
+
+		/* execute tuning if needed */
+		if (mwt->tuning) {
+			err = mmc_execute_tuning(mmc, mwt->tuning);
+			if (err) {
+				pr_debug("tuning failed : %d\n", err);
+				goto error;
+			}
+		}
+#endif
+	}
+
+	/* do a transfer to check the configuration */
+	err = mmc_read_and_compare_ext_csd(mmc);
+	if (!err)
+		return 0;
+error:
+	mmc_set_signal_voltage(mmc, old_voltage);
+	/* if an error occurred, revert to a safer bus mode */
+	mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
+		   EXT_CSD_BUS_WIDTH, EXT_CSD_BUS_WIDTH_1);
+	mmc_select_mode(mmc, MMC_LEGACY);
+	mmc_set_clock(mmc, mmc->legacy_speed, MMC_CLK_ENABLE);
+	mmc_set_bus_width(mmc, 1);
+
+	return err;
+}
+
+/* Try the bus mode and width which worked last time, if the card is known */
+static int mmc_try_recorded_mode(struct mmc *mmc, uint card_caps)
+{
+	const struct mode_width_tuning *mwt;
+	const struct ext_csd_bus_width *ecbw;
+	enum bus_mode mode;
+	uint width;
+
+	if (mmc_cache_mode(mmc, &mode, &width))
+		return -ENOENT;
+
+	for_each_mmc_mode_by_pref(card_caps, mwt) {
+		if (mwt->mode != mode)
+			continue;
+		for_each_supported_width(card_caps & mwt->widths,
+					 mmc_is_mode_ddr(mwt->mode), ecbw) {
+			if (bus_width(ecbw->cap) == width)
+				return mmc_try_mode_and_width(mmc, mwt, ecbw);
+		}
+	}
+
+	return -ENOENT;
+}
+
 static int mmc_select_mode_and_width(struct mmc *mmc, uint card_caps)
 {
 	int err = 0;
@@ -2199,91 +2392,17 @@ static int mmc_select_mode_and_width(struct mmc *mmc, uint card_caps)
 #endif
 		mmc_set_clock(mmc, mmc->legacy_speed, MMC_CLK_ENABLE);
 
+	/* A known card is likely to work in the same mode as before */
+	if (!mmc_try_recorded_mode(mmc, card_caps))
+		return 0;
+	mmc_cache_drop(mmc);
+
 	for_each_mmc_mode_by_pref(card_caps, mwt) {
 		for_each_supported_width(card_caps & mwt->widths,
 					 mmc_is_mode_ddr(mwt->mode), ecbw) {
-			enum mmc_voltage old_voltage;
-			pr_debug("trying mode %s width %d (at %d MHz)\n",
-				 mmc_mode_name(mwt->mode),
-				 bus_width(ecbw->cap),
-				 mmc_mode2freq(mmc, mwt->mode) / 1000000);
-			old_voltage = mmc->signal_voltage;
-			err = mmc_set_lowest_voltage(mmc, mwt->mode,
-						     MMC_ALL_SIGNAL_VOLTAGE);
-			if (err)
-				continue;
-
-			/* configure the bus width (card + host) */
-			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
-				    EXT_CSD_BUS_WIDTH,
-				    ecbw->ext_csd_bits & ~EXT_CSD_DDR_FLAG);
-			if (err)
-				goto error;
-			mmc_set_bus_width(mmc, bus_width(ecbw->cap));
-
-			if (mwt->mode == MMC_HS_400) {
-				err = mmc_select_hs400(mmc);
-				if (err) {
-					printf("Select HS400 failed %d\n", err);
-					goto error;
-				}
-			} else if (mwt->mode == MMC_HS_400_ES) {
-				err = mmc_select_hs400es(mmc);
-				if (err) {
-					printf("Select HS400ES failed %d\n",
-					       err);
-					goto error;
-				}
-			} else {
-				/* configure the bus speed (card) */
-				err = mmc_set_card_speed(mmc, mwt->mode, false);
-				if (err)
-					goto error;
-
-				/*
-				 * configure the bus width AND the ddr mode
-				 * (card). The host side will be taken care
-				 * of in the next step
-				 */
-				if (ecbw->ext_csd_bits & EXT_CSD_DDR_FLAG) {
-					err = mmc_switch(mmc,
-							 EXT_CSD_CMD_SET_NORMAL,
-							 EXT_CSD_BUS_WIDTH,
-							 ecbw->ext_csd_bits);
-					if (err)
-						goto error;
-				}
-
-				/* configure the bus mode (host) */
-				mmc_select_mode(mmc, mwt->mode);
-				mmc_set_clock(mmc, mmc->tran_speed,
-					      MMC_CLK_ENABLE);
-#if CONFIG_IS_ENABLED(MMC_SUPPORTS_TUNING)
-
-				/* execute tuning if needed */
-				if (mwt->tuning) {
-					err = mmc_execute_tuning(mmc,
-								 mwt->tuning);
-					if (err) {
-						pr_debug("tuning failed : %d\n", err);
-						goto error;
-					}
-				}
-#endif
-			}
-
-			/* do a transfer to check the configuration */
-			err = mmc_read_and_compare_ext_csd(mmc);
+			err = mmc_try_mode_and_width(mmc, mwt, ecbw);
 			if (!err)
 				return 0;
-error:
-			mmc_set_signal_voltage(mmc, old_voltage);
-			/* if an error occurred, revert to a safer bus mode */
-			mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
-				   EXT_CSD_BUS_WIDTH, EXT_CSD_BUS_WIDTH_1);
-			mmc_select_mode(mmc, MMC_LEGACY);
-			mmc_set_clock(mmc, mmc->legacy_speed, MMC_CLK_ENABLE);
-			mmc_set_bus_width(mmc, 1);
 		}
 	}
 
@@ -2359,6 +2478,7 @@ static int mmc_startup_v4(struct mmc *mmc)
 		return -ENOMEM;
 	memcpy(mmc->ext_csd, ext_csd, MMC_MAX_BLOCK_LEN);
 #endif
+	mmc_cache_check(mmc, ext_csd);
 	if (ext_csd[EXT_CSD_REV] >= ARRAY_SIZE(mmc_versions))
 		return -EINVAL;
 
@@ -2505,6 +2625,20 @@ static int mmc_startup_v4(struct mmc *mmc)
 	mmc->can_trim =
 		!!(ext_csd[EXT_CSD_SEC_FEATURE] & EXT_CSD_SEC_FEATURE_TRIM_EN);
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	/* Command queueing needs block addressing, see JESD84-B51 6.6.39 */
+	mmc->cqe_depth = 0;
+	if (mmc->version >= MMC_VERSION_5_1 && mmc->high_capacity &&
+	    (ext_csd[EXT_CSD_CMDQ_SUPPORT] & EXT_CSD_CMDQ_SUPPORTED))
+		mmc->cqe_depth = (ext_csd[EXT_CSD_CMDQ_DEPTH] &
+				  EXT_CSD_CMDQ_DEPTH_MASK) + 1;
+#endif
+#if CONFIG_IS_ENABLED(MMC_PACKED)
+	mmc->max_packed_reads = 0;
+	if (mmc->version >= MMC_VERSION_4_5)
+		mmc->max_packed_reads = ext_csd[EXT_CSD_MAX_PACKED_READS];
+#endif
+
 	return 0;
 error:
 	if (mmc->ext_csd) {
@@ -2706,6 +2840,7 @@ static int mmc_startup(struct mmc *mmc)
 		return err;
 
 	mmc->best_mode = mmc->selected_mode;
+	mmc_cache_save(mmc);
 
 	/* Fix the block length for DDR mode */
 	if (mmc->ddr_mode) {
@@ -2911,6 +3046,8 @@ int mmc_get_op_cond(struct mmc *mmc, bool quiet)
 	if (err)
 		return err;
 
+	mmc_cache_load(mmc);
+
 #if CONFIG_IS_ENABLED(DM_MMC)
 	/*
 	 * Re-initialization is needed to clear old configuration for
@@ -2937,6 +3074,13 @@ retry:
 	/* The internal partition reset to user partition(0) at every CMD0 */
 	mmc_get_blk_desc(mmc)->hwpart = 0;
 
+	/* A known eMMC need not be probed as an SD card first */
+	if (mmc_cache_ocr(mmc)) {
+		if (!mmc_send_op_cond(mmc))
+			return 0;
+		mmc_cache_drop(mmc);
+	}
+
 	/* Test for SD version 2 */
 	err = mmc_send_if_cond(mmc);
 
@@ -3093,6 +3237,9 @@ int mmc_deinit(struct mmc *mmc)
 	if (CONFIG_IS_ENABLED(CYCLIC, (mmc->cyclic.func), (NULL)))
 		CONFIG_IS_ENABLED(CYCLIC, (cyclic_unregister(&mmc->cyclic)));
 
+	/* Leave the card ready for commands, for whatever runs next */
+	mmc_cqe_off(mmc);
+
 	if (!CONFIG_IS_ENABLED(MMC_UHS_SUPPORT) &&
 	    !CONFIG_IS_ENABLED(MMC_HS200_SUPPORT) &&
 	    !CONFIG_IS_ENABLED(MMC_HS400_SUPPORT))
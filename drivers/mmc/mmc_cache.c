@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Remembering eMMC devices between boot phases
+ *
+ * Setting up an eMMC involves probing it as an SD card first, waiting for it
+ * to power up, trying bus modes from the fastest down and tuning the sampling
+ * point for the fastest ones. Once this has been done, the result is recorded
+ * in the bloblist, so that a later phase (or a later boot, if the bloblist
+ * survives reset) can go straight to the mode which worked.
+ *
+ * The card is identified by its CID and the EXT_CSD fields which affect the
+ * bus mode. If these do not match, or the card does not work in the recorded
+ * mode, it is set up from scratch and the record is updated.
+ */
+
+#define LOG_CATEGORY UCLASS_MMC
+
+#include <bloblist.h>
+#include <dm.h>
+#include <log.h>
+#include <mmc.h>
+#include <u-boot/crc.h>
+#include <linux/string.h>
+#include "mmc_private.h"
+
+/* EXT_CSD fields which affect how the card is set up; all read-only */
+static const u16 mmc_cache_ext_csd_fields[] = {
+	EXT_CSD_REV,
+	EXT_CSD_CARD_TYPE,
+	EXT_CSD_STROBE_SUPPORT,
+	EXT_CSD_SEC_CNT,
+	EXT_CSD_SEC_CNT + 1,
+	EXT_CSD_SEC_CNT + 2,
+	EXT_CSD_SEC_CNT + 3,
+	EXT_CSD_PARTITIONING_SUPPORT,
+	EXT_CSD_HC_WP_GRP_SIZE,
+	EXT_CSD_HC_ERASE_GRP_SIZE,
+};
+
+static u32 mmc_cache_ext_csd_crc(const u8 *ext_csd)
+{
+	u8 vals[ARRAY_SIZE(mmc_cache_ext_csd_fields)];
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(vals); i++)
+		vals[i] = ext_csd[mmc_cache_ext_csd_fields[i]];
+
+	return crc32(0, vals, sizeof(vals));
+}
+
+static struct mmc_cache_entry *mmc_cache_find(struct mmc_cache *cache,
+					      int seq)
+{
+	struct mmc_cache_entry *ent;
+
+	for (ent = cache->entry; ent < cache->entry + MMC_CACHE_ENTRIES;
+	     ent++) {
+		if ((ent->flags & MMC_CACHE_VALID) && ent->seq == seq)
+			return ent;
+	}
+
+	return NULL;
+}
+
+void mmc_cache_load(struct mmc *mmc)
+{
+	struct mmc_cache_entry *ent = NULL;
+	struct mmc_cache *cache;
+
+	mmc_cache_drop(mmc);
+	cache = bloblist_find(BLOBLISTT_U_BOOT_MMC_CACHE, sizeof(*cache));
+	if (cache)
+		ent = mmc_cache_find(cache, dev_seq(mmc->dev));
+	if (ent) {
+		mmc->cache = *ent;
+		log_debug("%s: recorded mode %s, width %d\n", mmc->dev->name,
+			  mmc_mode_name(ent->mode), ent->bus_width);
+	}
+}
+
+u32 mmc_cache_ocr(struct mmc *mmc)
+{
+	if (!(mmc->cache.flags & MMC_CACHE_VALID) ||
+	    !(mmc->cfg->host_caps & MMC_CAP_NONREMOVABLE))
+		return 0;
+
+	return mmc->cache.ocr;
+}
+
+void mmc_cache_check(struct mmc *mmc, const u8 *ext_csd)
+{
+	if (!(mmc->cache.flags & MMC_CACHE_VALID))
+		return;
+	if (memcmp(mmc->cache.cid, mmc->cid, sizeof(mmc->cache.cid)) ||
+	    mmc->cache.ext_csd_crc != mmc_cache_ext_csd_crc(ext_csd)) {
+		log_debug("%s: card does not match record\n", mmc->dev->name);
+		mmc_cache_drop(mmc);
+		return;
+	}
+	mmc->cache_hit = true;
+}
+
+void mmc_cache_drop(struct mmc *mmc)
+{
+	memset(&mmc->cache, '\0', sizeof(mmc->cache));
+	mmc->cache_hit = false;
+}
+
+int mmc_cache_mode(struct mmc *mmc, enum bus_mode *modep, uint *widthp)
+{
+	if (!mmc->cache_hit)
+		return -ENOENT;
+	*modep = mmc->cache.mode;
+	*widthp = mmc->cache.bus_width;
+
+	return 0;
+}
+
+int mmc_cache_save(struct mmc *mmc)
+{
+	struct mmc_cache_entry *ent;
+	struct mmc_cache *cache;
+	int seq = dev_seq(mmc->dev);
+
+	if (IS_SD(mmc) || mmc_host_is_spi(mmc) || !mmc->ext_csd)
+		return 0;
+	cache = bloblist_ensure(BLOBLISTT_U_BOOT_MMC_CACHE, sizeof(*cache));
+	if (!cache)
+		return log_msg_ret("mcs", -ENOSPC);
+
+	/* Use this device's entry, else a free one, else the last one */
+	ent = mmc_cache_find(cache, seq);
+	if (!ent) {
+		for (ent = cache->entry;
+		     ent < cache->entry + MMC_CACHE_ENTRIES - 1; ent++) {
+			if (!(ent->flags & MMC_CACHE_VALID))
+				break;
+		}
+	}
+
+	/* The tuning result was either restored or found just now */
+	memcpy(ent->cid, mmc->cid, sizeof(ent->cid));
+	ent->ocr = mmc->ocr;
+	ent->ext_csd_crc = mmc_cache_ext_csd_crc(mmc->ext_csd);
+	ent->seq = seq;
+	ent->flags = MMC_CACHE_VALID | (mmc->cache.flags & MMC_CACHE_TUNED);
+	ent->mode = mmc->selected_mode;
+	ent->bus_width = mmc->bus_width;
+	ent->tuning = mmc->cache.tuning;
+	mmc->cache = *ent;
+
+	return 0;
+}
+
+#if CONFIG_IS_ENABLED(MMC_SUPPORTS_TUNING)
+int mmc_cache_restore_tuning(struct mmc *mmc)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!mmc->cache_hit || !(mmc->cache.flags & MMC_CACHE_TUNED))
+		return -ENOENT;
+	if (!ops->set_tuning)
+		return -ENOSYS;
+
+	return ops->set_tuning(mmc->dev, mmc->cache.tuning);
+}
+
+void mmc_cache_note_tuning(struct mmc *mmc)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+	u32 tap;
+
+	if (ops->get_tuning && !ops->get_tuning(mmc->dev, &tap)) {
+		mmc->cache.tuning = tap;
+		mmc->cache.flags |= MMC_CACHE_TUNED;
+	} else {
+		mmc->cache.flags &= ~MMC_CACHE_TUNED;
+	}
+}
+#endif
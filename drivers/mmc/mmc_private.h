@@ -132,4 +132,244 @@ int mmc_switch_part(struct mmc *mmc, unsigned int part_num);
  */
 int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value);
 
+/**
+ * mmc_read_packed() - Read several ranges of blocks with one packed command
+ *
+ * The data for the requests is read into @dst one after the other, in the
+ * order given. The caller must make sure that the total fits in a single
+ * transfer.
+ *
+ * @mmc:	MMC device
+ * @reqs:	Read requests to carry out (the result is not updated)
+ * @count:	Number of requests, at least 2
+ * @dst:	Buffer for all the data
+ * Return: 0 if OK, -EINVAL if the card cannot pack this many reads, other
+ * -ve on error
+ */
+int mmc_read_packed(struct mmc *mmc, struct blk_req **reqs, int count,
+		    void *dst);
+
+#if CONFIG_IS_ENABLED(MMC_QUEUE)
+/**
+ * mmc_queue_submit() - Queue an asynchronous request on an MMC block device
+ *
+ * @dev:	MMC block device
+ * @req:	Request to queue
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int mmc_queue_submit(struct udevice *dev, struct blk_req *req);
+
+/**
+ * mmc_queue_poll() - Make progress with queued requests
+ *
+ * @dev:	MMC block device
+ * Return: number of requests still queued
+ */
+int mmc_queue_poll(struct udevice *dev);
+
+/**
+ * mmc_queue_remove() - Fail any queued requests and free the queue
+ *
+ * @mmc:	MMC device
+ */
+void mmc_queue_remove(struct mmc *mmc);
+#else
+static inline void mmc_queue_remove(struct mmc *mmc)
+{
+}
+#endif
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/**
+ * mmc_cqe_wanted() - Check whether a read should use command queueing
+ *
+ * This is true if the host and card both support command queueing and
+ * either the card is already in queueing mode or the read is too large for
+ * a single legacy transfer.
+ *
+ * @mmc:	MMC device
+ * @dst:	Buffer for the read
+ * @blkcnt:	Number of blocks to read
+ * Return: true to use mmc_cqe_read()
+ */
+bool mmc_cqe_wanted(struct mmc *mmc, void *dst, lbaint_t blkcnt);
+
+/**
+ * mmc_cqe_read() - Read blocks using command queueing
+ *
+ * This splits the read into tasks and waits for them all to finish, along
+ * with any requests queued before it.
+ *
+ * @mmc:	MMC device
+ * @start:	First block to read
+ * @blkcnt:	Number of blocks to read
+ * @dst:	Buffer for the data
+ * Return: number of blocks read, or -ve on error
+ */
+long mmc_cqe_read(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+		  void *dst);
+
+/**
+ * mmc_cqe_off() - Take the card and host out of command-queueing mode
+ *
+ * This waits for any tasks in the queue to finish first. It does nothing if
+ * queueing is not in use.
+ *
+ * @mmc:	MMC device
+ * Return: 0 if OK, -ve on error
+ */
+int mmc_cqe_off(struct mmc *mmc);
+
+/**
+ * mmc_cqe_is_on() - Check whether the card is in command-queueing mode
+ *
+ * @mmc:	MMC device
+ * Return: true if it is, in which case a command must not be sent until
+ * mmc_cqe_off() is called
+ */
+static inline bool mmc_cqe_is_on(struct mmc *mmc)
+{
+	return mmc->cqe_on;
+}
+#else
+static inline bool mmc_cqe_wanted(struct mmc *mmc, void *dst,
+				  lbaint_t blkcnt)
+{
+	return false;
+}
+
+static inline long mmc_cqe_read(struct mmc *mmc, lbaint_t start,
+				lbaint_t blkcnt, void *dst)
+{
+	return -ENOSYS;
+}
+
+static inline int mmc_cqe_off(struct mmc *mmc)
+{
+	return 0;
+}
+
+static inline bool mmc_cqe_is_on(struct mmc *mmc)
+{
+	return false;
+}
+#endif
+
+#if CONFIG_IS_ENABLED(MMC_CACHE)
+/**
+ * mmc_cache_load() - Look up what is known about the card in a device
+ *
+ * This copies the device's entry in the bloblist, if any, to @mmc->cache. It
+ * is not used for the bus mode or tuning until mmc_cache_check() has found
+ * that the card is the same.
+ *
+ * @mmc:	MMC device
+ */
+void mmc_cache_load(struct mmc *mmc);
+
+/**
+ * mmc_cache_ocr() - Get the OCR of a known eMMC
+ *
+ * @mmc:	MMC device
+ * Return: OCR recorded for the card, or 0 if there is none or the device is
+ * removable, in which case the card must be identified as usual
+ */
+u32 mmc_cache_ocr(struct mmc *mmc);
+
+/**
+ * mmc_cache_check() - Check that the card is the one which was recorded
+ *
+ * This compares the CID and the EXT_CSD fields which affect the bus mode. If
+ * they match, the recorded bus mode and tuning can be used.
+ *
+ * @mmc:	MMC device, whose CID has been read
+ * @ext_csd:	EXT_CSD read from the card
+ */
+void mmc_cache_check(struct mmc *mmc, const u8 *ext_csd);
+
+/**
+ * mmc_cache_drop() - Stop using what was recorded about the card
+ *
+ * This is used when the card does not behave as recorded, so that it is set
+ * up from scratch.
+ *
+ * @mmc:	MMC device
+ */
+void mmc_cache_drop(struct mmc *mmc);
+
+/**
+ * mmc_cache_mode() - Get the bus mode and width recorded for the card
+ *
+ * @mmc:	MMC device
+ * @modep:	Returns the bus mode
+ * @widthp:	Returns the bus width (1, 4 or 8)
+ * Return: 0 if OK, -ENOENT if the card was not recognised
+ */
+int mmc_cache_mode(struct mmc *mmc, enum bus_mode *modep, uint *widthp);
+
+/**
+ * mmc_cache_save() - Record the card in the bloblist
+ *
+ * This is called once the bus mode has been selected. Only eMMC devices are
+ * recorded.
+ *
+ * @mmc:	MMC device
+ * Return: 0 if OK, -ENOSPC if the bloblist is full
+ */
+int mmc_cache_save(struct mmc *mmc);
+
+/**
+ * mmc_cache_restore_tuning() - Restore the recorded tuning result
+ *
+ * @mmc:	MMC device
+ * Return: 0 if OK, -ENOENT if there is none, other -ve value if the host
+ * cannot restore it
+ */
+int mmc_cache_restore_tuning(struct mmc *mmc);
+
+/**
+ * mmc_cache_note_tuning() - Note the result of tuning, to be recorded
+ *
+ * @mmc:	MMC device, which has just been tuned
+ */
+void mmc_cache_note_tuning(struct mmc *mmc);
+#else
+static inline void mmc_cache_load(struct mmc *mmc)
+{
+}
+
+static inline u32 mmc_cache_ocr(struct mmc *mmc)
+{
+	return 0;
+}
+
+static inline void mmc_cache_check(struct mmc *mmc, const u8 *ext_csd)
+{
+}
+
+static inline void mmc_cache_drop(struct mmc *mmc)
+{
+}
+
+static inline int mmc_cache_mode(struct mmc *mmc, enum bus_mode *modep,
+				 uint *widthp)
+{
+	return -ENOENT;
+}
+
+static inline int mmc_cache_save(struct mmc *mmc)
+{
+	return 0;
+}
+
+static inline int mmc_cache_restore_tuning(struct mmc *mmc)
+{
+	return -ENOENT;
+}
+
+static inline void mmc_cache_note_tuning(struct mmc *mmc)
+{
+}
+#endif
+
 #endif /* _MMC_PRIVATE_H_ */
@@ -0,0 +1,546 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Asynchronous block requests and command queueing for MMC devices
+ *
+ * Requests passed to blk_submit() are queued and carried out as the device is
+ * polled. If the host and card support command queueing (eMMC 5.1), reads are
+ * split into tasks which are handed to the host's queueing engine, so that
+ * the card can work through them without waiting for a command between each
+ * one. Otherwise reads which are queued together are combined into a packed
+ * command, if the card supports that, or carried out one at a time. Writes
+ * wait for the reads before them to finish and are then carried out directly.
+ *
+ * The card cannot accept ordinary commands while it is in queueing mode, so
+ * it leaves that mode before any other command is sent (see mmc_send_cmd()).
+ */
+
+#define LOG_CATEGORY UCLASS_MMC
+
+#include <blk.h>
+#include <dm.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <mmc.h>
+#include <time.h>
+#include <linux/bitops.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include "mmc_private.h"
+
+/* Most blocks in one task or packed read, limited by the 16-bit count */
+#define MMC_QUEUE_MAX_BLOCKS	65535
+
+/* Most reads to combine into one packed command */
+#define MMC_PACKED_MAX_READS	16
+
+/* Time to wait for a task to finish before giving up on the queue */
+#define MMC_CQE_TIMEOUT_MS	5000
+
+/**
+ * struct mmc_queue - asynchronous requests for an MMC device
+ *
+ * While a read is in progress its @result field counts the blocks read so
+ * far. It completes once they have all been read.
+ *
+ * @pending: Requests which have not been started, apart perhaps from part of
+ *	the first one
+ * @active: Reads whose tasks have all been started
+ * @issued: Number of blocks of the first pending request which have been
+ *	started
+ * @count: Number of requests in @pending and @active
+ * @busy: Mask of the tags in use
+ * @last_ms: Time when a task last started or finished
+ * @cqe_failed: true if command queueing did not work, so is not used again
+ * @tasks: Task for each tag
+ * @reqs: Request which each tag belongs to
+ */
+struct mmc_queue {
+	struct list_head pending;
+	struct list_head active;
+	lbaint_t issued;
+	int count;
+	u32 busy;
+	ulong last_ms;
+	bool cqe_failed;
+	struct mmc_cqe_task tasks[MMC_CQE_MAX_TASKS];
+	struct blk_req *reqs[MMC_CQE_MAX_TASKS];
+};
+
+static struct mmc_queue *mmc_queue_get(struct mmc *mmc)
+{
+	struct mmc_queue *q = mmc->queue;
+
+	if (!q) {
+		q = calloc(1, sizeof(*q));
+		if (!q)
+			return NULL;
+		INIT_LIST_HEAD(&q->pending);
+		INIT_LIST_HEAD(&q->active);
+		mmc->queue = q;
+	}
+
+	return q;
+}
+
+/* Take @req off the queue and complete it */
+static void mmc_queue_complete(struct mmc_queue *q, struct blk_req *req,
+			       long result)
+{
+	list_del(&req->sibling);
+	q->count--;
+	blk_req_complete(req, result);
+}
+
+/* Check that the blocks in @req are on the device, failing it if not */
+static bool mmc_queue_check(struct mmc *mmc, struct mmc_queue *q,
+			    struct blk_req *req)
+{
+	struct blk_desc *desc = mmc_get_blk_desc(mmc);
+
+	if (req->start + req->blkcnt <= desc->lba)
+		return true;
+	log_err("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
+		req->start + req->blkcnt, desc->lba);
+	mmc_queue_complete(q, req, -EINVAL);
+
+	return false;
+}
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/* Get the number of tasks which can be queued, or 0 if queueing is not used */
+static uint mmc_cqe_depth(struct mmc *mmc)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(mmc->dev);
+
+	if (!(mmc->cfg->host_caps & MMC_CAP_CQE) || !ops->cqe_submit ||
+	    (mmc->queue && mmc->queue->cqe_failed))
+		return 0;
+
+	return min3((uint)mmc->cqe_depth, mmc->cfg->cqe_depth,
+		    (uint)MMC_CQE_MAX_TASKS);
+}
+
+bool mmc_cqe_wanted(struct mmc *mmc, void *dst, lbaint_t blkcnt)
+{
+	if (!mmc_cqe_depth(mmc))
+		return false;
+
+	return mmc->cqe_on || blkcnt > mmc_get_b_max(mmc, dst, blkcnt);
+}
+
+static int mmc_cqe_on(struct mmc *mmc)
+{
+	int ret;
+
+	if (mmc->cqe_on)
+		return 0;
+
+	ret = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 1);
+	if (ret)
+		return log_msg_ret("cqs", ret);
+	ret = mmc_cqe_enable(mmc, true);
+	if (ret) {
+		mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 0);
+		return log_msg_ret("cqe", ret);
+	}
+	mmc->cqe_on = true;
+	log_debug("%s: command queueing on\n", mmc->dev->name);
+
+	return 0;
+}
+
+/* Leave queueing mode, discarding any tasks if @discard is true */
+static int mmc_cqe_exit(struct mmc *mmc, bool discard)
+{
+	struct mmc_cmd cmd;
+	int ret;
+
+	/* Clear this first, so the commands below can be sent */
+	mmc->cqe_on = false;
+	ret = mmc_cqe_enable(mmc, false);
+	if (ret)
+		discard = true;
+	if (discard) {
+		cmd.cmdidx = MMC_CMD_CMDQ_TASK_MGMT;
+		cmd.cmdarg = MMC_CMDQ_DISCARD_ALL;
+		cmd.resp_type = MMC_RSP_R1b;
+		mmc_send_cmd(mmc, &cmd, NULL);
+	}
+	ret = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 0);
+	if (ret)
+		return log_msg_ret("cqx", ret);
+	log_debug("%s: command queueing off\n", mmc->dev->name);
+
+	return 0;
+}
+
+/*
+ * Fail all the requests with tasks in the queue, and stop using command
+ * queueing, since the state of the queue is no-longer known
+ */
+static void mmc_cqe_fail(struct mmc *mmc, struct mmc_queue *q, int err)
+{
+	struct blk_req *req;
+	uint tag;
+
+	log_err("%s: command queue failed (err=%d)\n", mmc->dev->name, err);
+	if (q->issued) {
+		req = list_first_entry(&q->pending, struct blk_req, sibling);
+		q->issued = 0;
+		mmc_queue_complete(q, req, err);
+	}
+	for (tag = 0; tag < MMC_CQE_MAX_TASKS; tag++) {
+		if (!(q->busy & BIT(tag)))
+			continue;
+		q->busy &= ~BIT(tag);
+		req = q->reqs[tag];
+		if (!req->complete)
+			mmc_queue_complete(q, req, err);
+	}
+	q->cqe_failed = true;
+	mmc_cqe_exit(mmc, true);
+}
+
+/* Start tasks for pending reads, while there are free tags */
+static int mmc_cqe_issue(struct mmc *mmc, struct mmc_queue *q, uint depth)
+{
+	struct mmc_cqe_task *task;
+	struct blk_req *req;
+	uint tag, max_blocks;
+	int ret;
+
+	max_blocks = min_t(uint, mmc->cfg->b_max, MMC_QUEUE_MAX_BLOCKS);
+	while (q->busy != GENMASK(depth - 1, 0)) {
+		req = list_first_entry_or_null(&q->pending, struct blk_req,
+					       sibling);
+		if (!req || req->op != BLK_REQ_READ)
+			break;
+		if (!q->issued && !mmc_queue_check(mmc, q, req))
+			continue;
+
+		if (!mmc->cqe_on) {
+			ret = blk_dselect_hwpart(mmc_get_blk_desc(mmc),
+						 mmc_get_blk_desc(mmc)->hwpart);
+			if (!ret)
+				ret = mmc_cqe_on(mmc);
+			if (ret)
+				return ret;
+		}
+
+		tag = ffs(~q->busy) - 1;
+		task = &q->tasks[tag];
+		task->tag = tag;
+		task->start = req->start + q->issued;
+		task->blocks = min_t(lbaint_t, req->blkcnt - q->issued,
+				     max_blocks);
+		task->dest = req->buffer + q->issued * mmc->read_bl_len;
+		ret = mmc_cqe_submit(mmc, task);
+		if (ret)
+			return log_msg_ret("sub", ret);
+		q->busy |= BIT(tag);
+		q->reqs[tag] = req;
+		q->last_ms = get_timer(0);
+
+		q->issued += task->blocks;
+		if (q->issued == req->blkcnt) {
+			list_move_tail(&req->sibling, &q->active);
+			q->issued = 0;
+		}
+	}
+
+	return 0;
+}
+
+/* Complete the requests whose tasks have all finished */
+static int mmc_cqe_collect(struct mmc *mmc, struct mmc_queue *q)
+{
+	struct blk_req *req;
+	u32 done;
+	uint tag;
+	int ret;
+
+	ret = mmc_cqe_poll(mmc, &done);
+	if (ret)
+		return log_msg_ret("pol", ret);
+	done &= q->busy;
+	if (!done) {
+		if (get_timer(q->last_ms) > MMC_CQE_TIMEOUT_MS)
+			return log_msg_ret("tim", -ETIMEDOUT);
+		return 0;
+	}
+	q->last_ms = get_timer(0);
+
+	for (tag = 0; done; tag++, done >>= 1) {
+		if (!(done & 1))
+			continue;
+		q->busy &= ~BIT(tag);
+		req = q->reqs[tag];
+		req->result += q->tasks[tag].blocks;
+		if (req->result == req->blkcnt)
+			mmc_queue_complete(q, req, req->blkcnt);
+	}
+
+	return 0;
+}
+
+/* Wait for the tasks in the queue to finish */
+static int mmc_cqe_drain(struct mmc *mmc, struct mmc_queue *q)
+{
+	int ret;
+
+	while (q->busy) {
+		ret = mmc_cqe_collect(mmc, q);
+		if (ret) {
+			mmc_cqe_fail(mmc, q, ret);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+int mmc_cqe_off(struct mmc *mmc)
+{
+	if (!mmc->cqe_on)
+		return 0;
+	if (mmc->queue && mmc_cqe_drain(mmc, mmc->queue))
+		return 0;	/* already discarded */
+
+	return mmc_cqe_exit(mmc, false);
+}
+
+/* Make progress with the queue using command queueing */
+static int mmc_cqe_run(struct mmc *mmc, struct mmc_queue *q, uint depth)
+{
+	int ret;
+
+	ret = mmc_cqe_issue(mmc, q, depth);
+	if (!ret && q->busy)
+		ret = mmc_cqe_collect(mmc, q);
+	if (ret) {
+		if (!q->busy) {
+			/* Nothing was started, so try without queueing */
+			log_debug("%s: cannot use command queue (err=%d)\n",
+				  mmc->dev->name, ret);
+			q->cqe_failed = true;
+			if (mmc->cqe_on)
+				mmc_cqe_exit(mmc, true);
+			return 0;
+		}
+		mmc_cqe_fail(mmc, q, ret);
+	}
+
+	return 0;
+}
+
+/* Drop any tasks and leave queueing mode, e.g. when the device is removed */
+static void mmc_cqe_reset(struct mmc *mmc, struct mmc_queue *q)
+{
+	q->busy = 0;
+	if (mmc->cqe_on)
+		mmc_cqe_exit(mmc, true);
+}
+#else
+static uint mmc_cqe_depth(struct mmc *mmc)
+{
+	return 0;
+}
+
+static int mmc_cqe_run(struct mmc *mmc, struct mmc_queue *q, uint depth)
+{
+	return -ENOSYS;
+}
+
+static void mmc_cqe_reset(struct mmc *mmc, struct mmc_queue *q)
+{
+}
+#endif /* MMC_CQE */
+
+#if CONFIG_IS_ENABLED(MMC_PACKED)
+static bool mmc_queue_can_pack(struct mmc *mmc)
+{
+	return mmc->max_packed_reads >= 2;
+}
+
+/*
+ * Read the first few pending requests with a packed command. Returns the
+ * number of requests completed, or 0 if packing is not possible
+ */
+static int mmc_queue_packed(struct mmc *mmc, struct mmc_queue *q)
+{
+	struct blk_req *reqs[MMC_PACKED_MAX_READS], *req;
+	struct blk_desc *desc = mmc_get_blk_desc(mmc);
+	lbaint_t total = 0, limit;
+	int count = 0, max, i;
+	void *buf, *ptr;
+	int ret;
+
+	max = min_t(int, mmc->max_packed_reads, MMC_PACKED_MAX_READS);
+	limit = min_t(lbaint_t, mmc->cfg->b_max, MMC_QUEUE_MAX_BLOCKS);
+	list_for_each_entry(req, &q->pending, sibling) {
+		if (req->op != BLK_REQ_READ || count == max ||
+		    total + req->blkcnt > limit ||
+		    req->start + req->blkcnt > desc->lba)
+			break;
+		reqs[count++] = req;
+		total += req->blkcnt;
+	}
+	if (count < 2)
+		return 0;
+
+	buf = malloc_cache_aligned(total * mmc->read_bl_len);
+	if (!buf)
+		return 0;
+	ret = blk_dselect_hwpart(desc, desc->hwpart);
+	if (!ret)
+		ret = mmc_set_blocklen(mmc, mmc->read_bl_len);
+	if (!ret)
+		ret = mmc_read_packed(mmc, reqs, count, buf);
+	if (ret) {
+		log_debug("%s: packed read failed (err=%d)\n", mmc->dev->name,
+			  ret);
+		free(buf);
+		return 0;
+	}
+
+	for (i = 0, ptr = buf; i < count; i++) {
+		req = reqs[i];
+		memcpy(req->buffer, ptr, req->blkcnt * mmc->read_bl_len);
+		ptr += req->blkcnt * mmc->read_bl_len;
+		mmc_queue_complete(q, req, req->blkcnt);
+	}
+	free(buf);
+
+	return count;
+}
+#else
+static bool mmc_queue_can_pack(struct mmc *mmc)
+{
+	return false;
+}
+
+static int mmc_queue_packed(struct mmc *mmc, struct mmc_queue *q)
+{
+	return 0;
+}
+#endif /* MMC_PACKED */
+
+/* Carry out the first pending request directly */
+static void mmc_queue_run_one(struct mmc *mmc, struct mmc_queue *q)
+{
+	struct blk_desc *desc = mmc_get_blk_desc(mmc);
+	struct blk_req *req;
+	ulong count;
+
+	req = list_first_entry(&q->pending, struct blk_req, sibling);
+	if (req->op == BLK_REQ_READ)
+		count = mmc_bread(desc->bdev, req->start, req->blkcnt,
+				  req->buffer);
+	else
+		count = mmc_bwrite(desc->bdev, req->start, req->blkcnt,
+				   req->buffer);
+	mmc_queue_complete(q, req, count == req->blkcnt ? count : -EIO);
+}
+
+/* Make some progress with the requests in the queue */
+static int mmc_queue_run(struct mmc *mmc, struct mmc_queue *q)
+{
+	struct blk_req *req;
+	uint depth;
+
+	depth = mmc_cqe_depth(mmc);
+	if (depth) {
+		mmc_cqe_run(mmc, q, depth);
+
+		/* Anything else must wait for the tasks to finish */
+		if (q->busy)
+			return q->count;
+	}
+
+	/* Reads are left for the command queue, if it is still usable */
+	req = list_first_entry_or_null(&q->pending, struct blk_req, sibling);
+	if (!req || (req->op == BLK_REQ_READ && mmc_cqe_depth(mmc)))
+		return q->count;
+	if (req->op == BLK_REQ_WRITE || !mmc_queue_packed(mmc, q))
+		mmc_queue_run_one(mmc, q);
+
+	return q->count;
+}
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+long mmc_cqe_read(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+		  void *dst)
+{
+	struct blk_req req = {
+		.op	= BLK_REQ_READ,
+		.start	= start,
+		.blkcnt	= blkcnt,
+		.buffer	= dst,
+	};
+	struct mmc_queue *q;
+
+	q = mmc_queue_get(mmc);
+	if (!q)
+		return -ENOMEM;
+	list_add_tail(&req.sibling, &q->pending);
+	q->count++;
+	while (!req.complete) {
+		/* Once queueing stops working, leave this to the caller */
+		if (!mmc_cqe_depth(mmc) && !q->busy &&
+		    list_first_entry(&q->pending, struct blk_req,
+				     sibling) == &req) {
+			list_del(&req.sibling);
+			q->count--;
+			return -EIO;
+		}
+		mmc_queue_run(mmc, q);
+	}
+
+	return req.result;
+}
+#endif
+
+int mmc_queue_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev_get_parent(dev));
+	struct mmc_queue *q;
+
+	q = mmc_queue_get(mmc);
+	if (!q)
+		return -ENOMEM;
+	list_add_tail(&req->sibling, &q->pending);
+	q->count++;
+
+	/* With no way to overlap or combine requests, carry this one out now */
+	if (!mmc_cqe_depth(mmc) && !mmc_queue_can_pack(mmc))
+		mmc_queue_run(mmc, q);
+
+	return 0;
+}
+
+int mmc_queue_poll(struct udevice *dev)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev_get_parent(dev));
+
+	if (!mmc->queue)
+		return 0;
+
+	return mmc_queue_run(mmc, mmc->queue);
+}
+
+void mmc_queue_remove(struct mmc *mmc)
+{
+	struct mmc_queue *q = mmc->queue;
+	struct blk_req *req, *next;
+
+	if (!q)
+		return;
+	mmc_cqe_reset(mmc, q);
+	list_for_each_entry_safe(req, next, &q->active, sibling)
+		mmc_queue_complete(q, req, -ENODEV);
+	list_for_each_entry_safe(req, next, &q->pending, sibling)
+		mmc_queue_complete(q, req, -ENODEV);
+	free(q);
+	mmc->queue = NULL;
+}
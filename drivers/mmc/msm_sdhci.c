@@ -211,6 +211,10 @@ static int msm_sdc_probe(struct udevice *dev)
 	host->mmc = &plat->mmc;
 	host->mmc->dev = dev;
 	ret = sdhci_setup_cfg(&plat->cfg, host, 0, 0);
+	if (ret)
+		return ret;
+	ret = sdhci_cqe_setup(&plat->cfg, host,
+			      dev_read_addr_name_ptr(dev, "cqhci"), 0);
 	if (ret)
 		return ret;
 	host->mmc->priv = &prv->host;
@@ -45,8 +45,11 @@
 
 #define ARASAN_VENDOR_REGISTER		0x78
 #define ARASAN_VENDOR_ENHANCED_STROBE	BIT(0)
+#define ARASAN_CQE_BASE			0x200
 
 /* Rockchip specific Registers */
+#define DWCMSHC_P_VENDOR_AREA2		0xea
+#define DWCMSHC_AREA_BASE_MASK		GENMASK(11, 0)
 #define DWCMSHC_EMMC_EMMC_CTRL		0x52c
 #define DWCMSHC_CARD_IS_EMMC		BIT(0)
 #define DWCMSHC_ENHANCED_STROBE		BIT(8)
@@ -153,6 +156,14 @@ struct sdhci_data {
 	 */
 	int (*set_enhanced_strobe)(struct sdhci_host *host);
 
+	/**
+	 * get_cqe_base() - Get the address of the command-queueing engine
+	 *
+	 * @host: SDHCI host structure
+	 * Return: address of the CQHCI registers
+	 */
+	void *(*get_cqe_base)(struct sdhci_host *host);
+
 	u32 flags;
 	u8 hs200_txclk_tapnum;
 	u8 hs400_txclk_tapnum;
@@ -554,6 +565,19 @@ static int rockchip_sdhci_set_enhanced_strobe(struct sdhci_host *host)
 	return 0;
 }
 
+static void *rk3399_sdhci_get_cqe_base(struct sdhci_host *host)
+{
+	return host->ioaddr + ARASAN_CQE_BASE;
+}
+
+/* The engine is in the second vendor area, which the controller reports */
+static void *rk3568_sdhci_get_cqe_base(struct sdhci_host *host)
+{
+	u16 area = sdhci_readw(host, DWCMSHC_P_VENDOR_AREA2);
+
+	return host->ioaddr + (area & DWCMSHC_AREA_BASE_MASK);
+}
+
 static struct sdhci_ops rockchip_sdhci_ops = {
 	.set_control_reg = rockchip_sdhci_set_control_reg,
 	.set_ios_post = rockchip_sdhci_set_ios_post,
@@ -604,6 +628,10 @@ static int rockchip_sdhci_probe(struct udevice *dev)
 	if (ret)
 		return ret;
 
+	ret = sdhci_cqe_setup(cfg, host, data->get_cqe_base(host), 0);
+	if (ret)
+		return ret;
+
 	/*
 	 * Disable use of DMA and force use of PIO mode in SPL to fix an issue
 	 * where loading part of TF-A into SRAM using DMA silently fails.
@@ -645,12 +673,14 @@ static const struct sdhci_data rk3399_data = {
 	.set_control_reg = rk3399_sdhci_set_control_reg,
 	.set_ios_post = rk3399_sdhci_set_ios_post,
 	.set_enhanced_strobe = rk3399_sdhci_set_enhanced_strobe,
+	.get_cqe_base = rk3399_sdhci_get_cqe_base,
 };
 
 static const struct sdhci_data rk3568_data = {
 	.set_ios_post = rk3568_sdhci_set_ios_post,
 	.set_clock = rk3568_sdhci_set_clock,
 	.config_dll = rk3568_sdhci_config_dll,
+	.get_cqe_base = rk3568_sdhci_get_cqe_base,
 	.flags = FLAG_INVERTER_FLAG_IN_RXCLK,
 	.hs200_txclk_tapnum = DLL_TXCLK_TAPNUM_DEFAULT,
 	.hs400_txclk_tapnum = 0x8,
@@ -660,6 +690,7 @@ static const struct sdhci_data rk3588_data = {
 	.set_ios_post = rk3568_sdhci_set_ios_post,
 	.set_clock = rk3568_sdhci_set_clock,
 	.config_dll = rk3568_sdhci_config_dll,
+	.get_cqe_base = rk3568_sdhci_get_cqe_base,
 	.hs200_txclk_tapnum = DLL_TXCLK_TAPNUM_DEFAULT,
 	.hs400_txclk_tapnum = 0x9,
 };
@@ -12,6 +12,8 @@
 #include <mmc.h>
 #include <os.h>
 #include <asm/test.h>
+#include <asm/unaligned.h>
+#include <linux/bitops.h>
 
 struct sandbox_mmc_plat {
 	struct mmc_config cfg;
@@ -26,12 +28,151 @@ struct sandbox_mmc_plat {
 /* Granularity of priv->csize - this is 1MB */
 #define SIZE_MULTIPLE		((1 << (MMC_CMULT + 2)) * MMC_BL_LEN)
 
+/* Largest transfer for an eMMC, so that bigger reads use the command queue */
+#define SANDBOX_EMMC_B_MAX	64
+
+/* Number of tasks which the emulated host's queue can hold */
+#define SANDBOX_EMMC_CQE_DEPTH	8
+
+/* Most reads which the emulated eMMC accepts in one packed command */
+#define SANDBOX_EMMC_MAX_PACKED	8
+
 struct sandbox_mmc_priv {
 	char *buf;
 	int csize;	/* CSIZE value to report */
 	int size;
+	bool emmc;	/* true to emulate an eMMC, false for an SD card */
+	u8 ext_csd[MMC_MAX_BLOCK_LEN];
+	bool packed;	/* next read/write is part of a packed command */
+	bool packed_hdr_ok;	/* packed header has been received */
+	__le32 packed_hdr[MMC_MAX_BLOCK_LEN / 4];
+	bool cqe_on;	/* host's command queue is enabled */
+	u32 busy;	/* mask of queued tasks */
+	struct mmc_cqe_task tasks[SANDBOX_EMMC_CQE_DEPTH];
+	int cqe_tasks;	/* number of tasks carried out */
+	int cqe_max_tasks;	/* most tasks queued at once */
+	int packed_reads;	/* number of packed reads carried out */
+	int cmds;	/* number of commands received */
 };
 
+/* Check that a transfer is within the emulated media */
+static bool sandbox_mmc_in_range(struct sandbox_mmc_priv *priv, ulong start,
+				 ulong blocks)
+{
+	return (u64)(start + blocks) * MMC_MAX_BLOCK_LEN <= priv->size;
+}
+
+/*
+ * Handle the data commands of a packed read: a one-block write of the header
+ * followed by a read of all the blocks it lists
+ */
+static int sandbox_emmc_packed(struct sandbox_mmc_priv *priv,
+			       struct mmc_cmd *cmd, struct mmc_data *data)
+{
+	u32 word0, count, blocks, addr, total = 0;
+	char *dest = data->dest;
+	int i;
+
+	if (cmd->cmdidx == MMC_CMD_WRITE_MULTIPLE_BLOCK) {
+		if (data->blocks != 1)
+			return -EIO;
+		memcpy(priv->packed_hdr, data->src, MMC_MAX_BLOCK_LEN);
+		priv->packed_hdr_ok = true;
+		return 0;
+	}
+	if (cmd->cmdidx != MMC_CMD_READ_MULTIPLE_BLOCK || !priv->packed_hdr_ok)
+		return -EIO;
+	priv->packed_hdr_ok = false;
+
+	word0 = le32_to_cpu(priv->packed_hdr[0]);
+	count = (word0 >> 16) & 0xff;
+	if ((word0 & 0xffff) != (MMC_PACKED_READ << 8 | MMC_PACKED_VERSION) ||
+	    !count || count > priv->ext_csd[EXT_CSD_MAX_PACKED_READS] ||
+	    le32_to_cpu(priv->packed_hdr[3]) != cmd->cmdarg)
+		return -EIO;
+
+	for (i = 0; i < count; i++) {
+		blocks = le32_to_cpu(priv->packed_hdr[(i + 1) * 2]);
+		addr = le32_to_cpu(priv->packed_hdr[(i + 1) * 2 + 1]);
+		if (!sandbox_mmc_in_range(priv, addr, blocks) ||
+		    total + blocks > data->blocks)
+			return -EIO;
+		memcpy(dest + total * MMC_MAX_BLOCK_LEN,
+		       &priv->buf[addr * MMC_MAX_BLOCK_LEN],
+		       blocks * MMC_MAX_BLOCK_LEN);
+		total += blocks;
+	}
+	if (total != data->blocks)
+		return -EIO;
+	priv->packed_reads++;
+
+	return 0;
+}
+
+/**
+ * sandbox_emmc_send_cmd() - Emulate the eMMC commands which differ from SD
+ *
+ * Return: 0 if OK, -ENOENT if the command is the same as for an SD card, other
+ *	-ve value on error
+ */
+static int sandbox_emmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
+				 struct mmc_data *data)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	u8 *ext_csd = priv->ext_csd;
+	uint index, value;
+
+	switch (cmd->cmdidx) {
+	case MMC_CMD_APP_CMD:
+		return -ETIMEDOUT;
+	case MMC_CMD_SEND_OP_COND:
+		cmd->response[0] = OCR_BUSY | OCR_HCS | MMC_VDD_32_33 |
+				   MMC_VDD_33_34;
+		return 0;
+	case MMC_CMD_SEND_EXT_CSD:
+		/* Without data, this is the SD SEND_IF_COND */
+		if (!data)
+			return -ETIMEDOUT;
+		memcpy(data->dest, ext_csd, MMC_MAX_BLOCK_LEN);
+		return 0;
+	case MMC_CMD_SWITCH:
+		index = (cmd->cmdarg >> 16) & 0xff;
+		value = (cmd->cmdarg >> 8) & 0xff;
+		/* Queued tasks must be finished or discarded first */
+		if (data || (index == EXT_CSD_CMDQ_MODE_EN && !value &&
+			     priv->busy))
+			return -EIO;
+		ext_csd[index] = value;
+		return 0;
+	case MMC_CMD_SEND_STATUS:
+		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA | MMC_STATE_TRANS;
+		return 0;
+	case MMC_CMD_SET_BLOCK_COUNT:
+		priv->packed = cmd->cmdarg & MMC_CMD23_ARG_PACKED;
+		return 0;
+	case MMC_CMD_CMDQ_TASK_MGMT:
+		if (cmd->cmdarg == MMC_CMDQ_DISCARD_ALL)
+			priv->busy = 0;
+		return 0;
+	case MMC_CMD_READ_SINGLE_BLOCK:
+	case MMC_CMD_READ_MULTIPLE_BLOCK:
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
+		/* These are not allowed while the card is queueing commands */
+		if (ext_csd[EXT_CSD_CMDQ_MODE_EN])
+			return -EIO;
+		if (priv->packed) {
+			priv->packed = false;
+			return sandbox_emmc_packed(priv, cmd, data);
+		}
+		if (!sandbox_mmc_in_range(priv, cmd->cmdarg, data->blocks))
+			return -EIO;
+		break;
+	}
+
+	return -ENOENT;
+}
+
 /**
  * sandbox_mmc_send_cmd() - Emulate SD commands
  *
@@ -43,6 +184,14 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 {
 	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
 	static ulong erase_start, erase_end;
+	int ret;
+
+	priv->cmds++;
+	if (priv->emmc) {
+		ret = sandbox_emmc_send_cmd(dev, cmd, data);
+		if (ret != -ENOENT)
+			return ret;
+	}
 
 	switch (cmd->cmdidx) {
 	case MMC_CMD_ALL_SEND_CID:
@@ -66,6 +215,11 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 				   ((priv->csize >> 16) & 0x3f);
 		cmd->response[2] = (priv->csize & 0xffff) << 16;
 		cmd->response[3] = 0;
+		if (priv->emmc) {
+			/* Version 4, which has EXT_CSD, with 512-byte writes */
+			cmd->response[0] |= 4 << 26;
+			cmd->response[3] |= 9 << 22;
+		}
 		break;
 	case SD_CMD_SWITCH_FUNC: {
 		if (!data)
@@ -138,10 +292,91 @@ static int sandbox_mmc_get_cd(struct udevice *dev)
 	return 1;
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+static int sandbox_mmc_cqe_enable(struct udevice *dev, bool enable)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	/* The card must be put into queueing mode first */
+	if (enable && !priv->ext_csd[EXT_CSD_CMDQ_MODE_EN])
+		return -EPROTO;
+	priv->cqe_on = enable;
+
+	return 0;
+}
+
+static int sandbox_mmc_cqe_submit(struct udevice *dev,
+				  struct mmc_cqe_task *task)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (!priv->cqe_on || task->tag >= SANDBOX_EMMC_CQE_DEPTH ||
+	    !sandbox_mmc_in_range(priv, task->start, task->blocks))
+		return -EINVAL;
+	if (priv->busy & BIT(task->tag))
+		return -EBUSY;
+	priv->tasks[task->tag] = *task;
+	priv->busy |= BIT(task->tag);
+	priv->cqe_tasks++;
+	priv->cqe_max_tasks = max_t(int, priv->cqe_max_tasks,
+				    hweight32(priv->busy));
+
+	return 0;
+}
+
+/*
+ * Finish one task on each call, taking the newest first, since a card may
+ * carry out its tasks in any order
+ */
+static int sandbox_mmc_cqe_poll(struct udevice *dev, u32 *donep)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	struct mmc_cqe_task *task;
+	uint tag;
+
+	*donep = 0;
+	if (!priv->cqe_on)
+		return -EPROTO;
+	if (!priv->busy)
+		return 0;
+
+	tag = fls(priv->busy) - 1;
+	task = &priv->tasks[tag];
+	memcpy(task->dest, &priv->buf[task->start * MMC_MAX_BLOCK_LEN],
+	       task->blocks * MMC_MAX_BLOCK_LEN);
+	priv->busy &= ~BIT(tag);
+	*donep = BIT(tag);
+
+	return 0;
+}
+#endif
+
+void sandbox_mmc_get_queue_stats(struct udevice *dev, int *tasksp,
+				 int *max_tasksp, int *packedp)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	*tasksp = priv->cqe_tasks;
+	*max_tasksp = priv->cqe_max_tasks;
+	*packedp = priv->packed_reads;
+}
+
+int sandbox_mmc_get_cmd_count(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	return priv->cmds;
+}
+
 static const struct dm_mmc_ops sandbox_mmc_ops = {
 	.send_cmd = sandbox_mmc_send_cmd,
 	.set_ios = sandbox_mmc_set_ios,
 	.get_cd = sandbox_mmc_get_cd,
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	.cqe_enable = sandbox_mmc_cqe_enable,
+	.cqe_submit = sandbox_mmc_cqe_submit,
+	.cqe_poll = sandbox_mmc_cqe_poll,
+#endif
 };
 
 static int sandbox_mmc_of_to_plat(struct udevice *dev)
@@ -159,10 +394,29 @@ static int sandbox_mmc_of_to_plat(struct udevice *dev)
 	blk = mmc_get_blk_desc(&plat->mmc);
 	if (blk)
 		blk->removable = !(cfg->host_caps & MMC_CAP_NONREMOVABLE);
+	if (cfg->host_caps & MMC_CAP_CQE)
+		cfg->cqe_depth = SANDBOX_EMMC_CQE_DEPTH;
 
 	return 0;
 }
 
+/* Set up the EXT_CSD of an eMMC version 5.1 */
+static void sandbox_emmc_init_ext_csd(struct sandbox_mmc_priv *priv)
+{
+	u8 *ext_csd = priv->ext_csd;
+
+	memset(ext_csd, '\0', MMC_MAX_BLOCK_LEN);
+	ext_csd[EXT_CSD_REV] = 8;
+	ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26 |
+		EXT_CSD_CARD_TYPE_52;
+	put_unaligned_le32(priv->size / MMC_MAX_BLOCK_LEN,
+			   &ext_csd[EXT_CSD_SEC_CNT]);
+	ext_csd[EXT_CSD_MAX_PACKED_READS] = SANDBOX_EMMC_MAX_PACKED;
+	ext_csd[EXT_CSD_MAX_PACKED_WRITES] = SANDBOX_EMMC_MAX_PACKED;
+	ext_csd[EXT_CSD_CMDQ_SUPPORT] = EXT_CSD_CMDQ_SUPPORTED;
+	ext_csd[EXT_CSD_CMDQ_DEPTH] = 15;	/* 16 tasks */
+}
+
 static int sandbox_mmc_probe(struct udevice *dev)
 {
 	struct sandbox_mmc_plat *plat = dev_get_plat(dev);
@@ -189,6 +443,9 @@ static int sandbox_mmc_probe(struct udevice *dev)
 			return -ENOMEM;
 		}
 	}
+	priv->emmc = dev_get_driver_data(dev);
+	if (priv->emmc)
+		sandbox_emmc_init_ext_csd(priv);
 
 	return mmc_init(&plat->mmc);
 }
@@ -216,7 +473,7 @@ static int sandbox_mmc_bind(struct udevice *dev)
 	cfg->voltages = MMC_VDD_165_195 | MMC_VDD_32_33 | MMC_VDD_33_34;
 	cfg->f_min = 1000000;
 	cfg->f_max = 52000000;
-	cfg->b_max = U32_MAX;
+	cfg->b_max = dev_get_driver_data(dev) ? SANDBOX_EMMC_B_MAX : U32_MAX;
 
 	return mmc_bind(dev, &plat->mmc, cfg);
 }
@@ -230,6 +487,7 @@ static int sandbox_mmc_unbind(struct udevice *dev)
 
 static const struct udevice_id sandbox_mmc_ids[] = {
 	{ .compatible = "sandbox,mmc" },
+	{ .compatible = "sandbox,emmc", .data = true },
 	{ }
 };
 
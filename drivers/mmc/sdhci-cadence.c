@@ -221,7 +221,7 @@ static int sdhci_cdns_probe(struct udevice *dev)
 	if (base == FDT_ADDR_T_NONE)
 		return -EINVAL;
 
-	plat->hrs_addr = devm_ioremap(dev, base, SZ_1K);
+	plat->hrs_addr = devm_ioremap(dev, base, SZ_2K);
 	if (!plat->hrs_addr)
 		return -ENOMEM;
 
@@ -250,6 +250,12 @@ static int sdhci_cdns_probe(struct udevice *dev)
 	ret = sdhci_setup_cfg(&plat->cfg, host, 0, 0);
 	if (ret)
 		return ret;
+	if (device_is_compatible(dev, "cdns,sd6hc")) {
+		ret = sdhci_cqe_setup(&plat->cfg, host,
+				      plat->hrs_addr + SDHCI_CDNS_CQRS_BASE, 0);
+		if (ret)
+			return ret;
+	}
 
 	upriv->mmc = &plat->mmc;
 	host->mmc->priv = host;
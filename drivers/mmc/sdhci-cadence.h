@@ -34,6 +34,8 @@
 
 /* SRS - Slot Register Set (SDHCI-compatible) */
 #define SDHCI_CDNS_SRS_BASE		0x200
+/* Command-queueing engine (SD6HC) */
+#define SDHCI_CDNS_CQRS_BASE		0x400
 
 /* Cadence V4 PHY Setting*/
 #define SDHCI_CDNS_PHY_DLY_SD_HS	0x00
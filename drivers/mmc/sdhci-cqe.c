@@ -0,0 +1,350 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Command-queueing engine (CQHCI) for SDHCI controllers
+ *
+ * The engine sits alongside the SDHCI registers and fetches eMMC tasks from a
+ * list of descriptors in memory, sending the queueing commands (CMD44-47) to
+ * the card itself. Each task descriptor links to a list of transfer
+ * descriptors, which have the same layout as ADMA2 descriptors. Only reads
+ * are queued, and completion is found by polling rather than by interrupt.
+ */
+
+#define LOG_CATEGORY UCLASS_MMC
+
+#include <cpu_func.h>
+#include <dm.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <mmc.h>
+#include <phys2bus.h>
+#include <sdhci.h>
+#include <asm/cache.h>
+#include <asm/io.h>
+#include <linux/bitops.h>
+#include <linux/dma-mapping.h>
+#include <linux/iopoll.h>
+
+/* CQHCI registers, relative to the base of the engine */
+#define CQHCI_VER		0x00
+#define CQHCI_CFG		0x08
+#define  CQHCI_CFG_ENABLE	BIT(0)
+#define  CQHCI_CFG_TASK_DESC_SZ	BIT(8)
+#define  CQHCI_CFG_DCMD		BIT(12)
+#define CQHCI_CTL		0x0c
+#define  CQHCI_CTL_HALT		BIT(0)
+#define  CQHCI_CTL_CLEAR_ALL	BIT(8)
+#define CQHCI_IS		0x10
+#define  CQHCI_IS_HAC		BIT(0)
+#define  CQHCI_IS_TCC		BIT(1)
+#define  CQHCI_IS_RED		BIT(2)
+#define  CQHCI_IS_TCL		BIT(3)
+#define  CQHCI_IS_MASK		(CQHCI_IS_HAC | CQHCI_IS_TCC | CQHCI_IS_RED | \
+				 CQHCI_IS_TCL)
+#define CQHCI_ISTE		0x14
+#define CQHCI_ISGE		0x18
+#define CQHCI_IC		0x1c
+#define CQHCI_TDLBA		0x20
+#define CQHCI_TDLBAU		0x24
+#define CQHCI_TDBR		0x28
+#define CQHCI_TCN		0x2c
+#define CQHCI_SSC2		0x44
+#define CQHCI_TERRI		0x54
+
+/* Descriptor fields */
+#define CQHCI_VALID		BIT(0)
+#define CQHCI_END		BIT(1)
+#define CQHCI_INT		BIT(2)
+#define CQHCI_ACT(x)		(((x) & 7) << 3)
+#define  CQHCI_ACT_TRAN		4
+#define  CQHCI_ACT_TASK		5
+#define  CQHCI_ACT_LINK		6
+#define CQHCI_DATA_DIR_READ	BIT(12)
+#define CQHCI_LENGTH(x)		(((x) & 0xffff) << 16)
+
+/* The engine has a slot in its task list for every possible tag */
+#define CQHCI_NUM_SLOTS		32
+#define CQHCI_TASK_DESC_LEN	8
+
+/* Tasks queued at once, which limits the memory used for descriptors */
+#define CQHCI_DEPTH		8
+
+#define CQHCI_HALT_TIMEOUT_US	100000
+
+/**
+ * struct sdhci_cqe - state of the command-queueing engine
+ *
+ * The descriptor memory holds the task list, with a task descriptor and a
+ * link descriptor in each slot, followed by a list of transfer descriptors
+ * for each tag.
+ *
+ * @base: Address of the CQHCI registers
+ * @desc: Descriptor memory
+ * @desc_size: Size of @desc in bytes
+ * @dma64: true if descriptors hold 64-bit addresses
+ * @slot_len: Length of a slot in the task list
+ * @trans_len: Length of a transfer descriptor
+ * @buf: Buffer mapped for the task with each tag
+ * @len: Length of that buffer
+ */
+struct sdhci_cqe {
+	void *base;
+	void *desc;
+	uint desc_size;
+	bool dma64;
+	uint slot_len;
+	uint trans_len;
+	dma_addr_t buf[CQHCI_DEPTH];
+	uint len[CQHCI_DEPTH];
+};
+
+static u32 cqhci_readl(struct sdhci_cqe *cqe, int reg)
+{
+	return readl(cqe->base + reg);
+}
+
+static void cqhci_writel(struct sdhci_cqe *cqe, u32 val, int reg)
+{
+	writel(val, cqe->base + reg);
+}
+
+static struct sdhci_host *sdhci_cqe_host(struct udevice *dev)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+
+	return mmc->priv;
+}
+
+/* Write a transfer or link descriptor */
+static void cqhci_write_desc(struct sdhci_cqe *cqe, void *desc, u32 attr,
+			     dma_addr_t addr)
+{
+	__le32 *ptr = desc;
+
+	ptr[0] = cpu_to_le32(attr);
+	ptr[1] = cpu_to_le32(lower_32_bits(addr));
+	if (cqe->dma64)
+		ptr[2] = cpu_to_le32(upper_32_bits(addr));
+}
+
+static void cqhci_flush(void *start, uint len)
+{
+	ulong addr = (ulong)start;
+
+	flush_dcache_range(rounddown(addr, ARCH_DMA_MINALIGN),
+			   roundup(addr + len, ARCH_DMA_MINALIGN));
+}
+
+static void *cqhci_trans_list(struct sdhci_cqe *cqe, uint tag)
+{
+	return cqe->desc + CQHCI_NUM_SLOTS * cqe->slot_len +
+		tag * ADMA_TABLE_NO_ENTRIES * cqe->trans_len;
+}
+
+static int sdhci_cqe_disable(struct sdhci_host *host)
+{
+	struct sdhci_cqe *cqe = host->cqe;
+	u32 val;
+	int ret;
+
+	cqhci_writel(cqe, CQHCI_CTL_HALT, CQHCI_CTL);
+	ret = readl_poll_timeout(cqe->base + CQHCI_CTL, val,
+				 val & CQHCI_CTL_HALT, CQHCI_HALT_TIMEOUT_US);
+
+	/* Drop any tasks which have not finished */
+	cqhci_writel(cqe, CQHCI_CTL_HALT | CQHCI_CTL_CLEAR_ALL, CQHCI_CTL);
+	val = cqhci_readl(cqe, CQHCI_CFG);
+	cqhci_writel(cqe, val & ~CQHCI_CFG_ENABLE, CQHCI_CFG);
+	cqhci_writel(cqe, CQHCI_IS_MASK, CQHCI_IS);
+	if (ret) {
+		log_debug("%s: engine did not halt\n", host->name);
+		sdhci_reset(host, SDHCI_RESET_CMD);
+		sdhci_reset(host, SDHCI_RESET_DATA);
+	}
+
+	/* Go back to the interrupts used for sending commands */
+	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+	sdhci_writel(host, SDHCI_INT_DATA_MASK | SDHCI_INT_CMD_MASK,
+		     SDHCI_INT_ENABLE);
+
+	return ret;
+}
+
+int sdhci_cqe_enable(struct udevice *dev, bool enable)
+{
+	struct sdhci_host *host = sdhci_cqe_host(dev);
+	struct sdhci_cqe *cqe = host->cqe;
+	dma_addr_t addr;
+	u32 val;
+	u8 ctrl;
+
+	if (!cqe)
+		return -ENOSYS;
+	if (!enable)
+		return sdhci_cqe_disable(host);
+
+	/* The engine uses the ADMA unit and 512-byte blocks */
+	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
+	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	ctrl |= cqe->dma64 ? SDHCI_CTRL_ADMA64 : SDHCI_CTRL_ADMA32;
+	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+	sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
+					    MMC_MAX_BLOCK_LEN),
+		     SDHCI_BLOCK_SIZE);
+	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+	sdhci_writel(host, SDHCI_INT_ERROR_MASK | SDHCI_INT_CQE,
+		     SDHCI_INT_ENABLE);
+
+	val = cqhci_readl(cqe, CQHCI_CFG);
+	if (val & CQHCI_CFG_ENABLE)
+		cqhci_writel(cqe, val & ~CQHCI_CFG_ENABLE, CQHCI_CFG);
+	val &= ~(CQHCI_CFG_ENABLE | CQHCI_CFG_DCMD | CQHCI_CFG_TASK_DESC_SZ);
+	cqhci_writel(cqe, val, CQHCI_CFG);
+
+	addr = dev_phys_to_bus(dev, virt_to_phys(cqe->desc));
+	cqhci_writel(cqe, lower_32_bits(addr), CQHCI_TDLBA);
+	cqhci_writel(cqe, upper_32_bits(addr), CQHCI_TDLBAU);
+	cqhci_writel(cqe, host->mmc->rca, CQHCI_SSC2);
+	cqhci_writel(cqe, 0, CQHCI_IC);
+	cqhci_writel(cqe, CQHCI_IS_MASK, CQHCI_ISTE);
+	cqhci_writel(cqe, 0, CQHCI_ISGE);
+	cqhci_writel(cqe, CQHCI_IS_MASK, CQHCI_IS);
+
+	cqhci_writel(cqe, val | CQHCI_CFG_ENABLE, CQHCI_CFG);
+	cqhci_writel(cqe, 0, CQHCI_CTL);
+
+	return 0;
+}
+
+int sdhci_cqe_submit(struct udevice *dev, struct mmc_cqe_task *task)
+{
+	struct sdhci_host *host = sdhci_cqe_host(dev);
+	struct sdhci_cqe *cqe = host->cqe;
+	void *slot, *trans, *desc;
+	uint left, len, tag = task->tag;
+	dma_addr_t addr;
+	__le32 *ptr;
+
+	if (!cqe)
+		return -ENOSYS;
+	if (tag >= CQHCI_DEPTH || !task->blocks ||
+	    task->blocks > CONFIG_SYS_MMC_MAX_BLK_COUNT)
+		return -EINVAL;
+
+	left = task->blocks * MMC_MAX_BLOCK_LEN;
+	cqe->len[tag] = left;
+	cqe->buf[tag] = dma_map_single(task->dest, left, DMA_FROM_DEVICE);
+	addr = dev_phys_to_bus(dev, cqe->buf[tag]);
+
+	trans = cqhci_trans_list(cqe, tag);
+	for (desc = trans; left; desc += cqe->trans_len) {
+		len = min_t(uint, left, ADMA_MAX_LEN);
+		left -= len;
+		cqhci_write_desc(cqe, desc, CQHCI_VALID | CQHCI_LENGTH(len) |
+				 CQHCI_ACT(CQHCI_ACT_TRAN) |
+				 (left ? 0 : CQHCI_END), addr);
+		addr += len;
+	}
+	cqhci_flush(trans, desc - trans);
+
+	slot = cqe->desc + tag * cqe->slot_len;
+	ptr = slot;
+	ptr[0] = cpu_to_le32(CQHCI_VALID | CQHCI_END | CQHCI_INT |
+			     CQHCI_ACT(CQHCI_ACT_TASK) | CQHCI_DATA_DIR_READ |
+			     CQHCI_LENGTH(task->blocks));
+	ptr[1] = cpu_to_le32(task->start);
+	cqhci_write_desc(cqe, slot + CQHCI_TASK_DESC_LEN,
+			 CQHCI_VALID | CQHCI_ACT(CQHCI_ACT_LINK),
+			 dev_phys_to_bus(dev, virt_to_phys(trans)));
+	cqhci_flush(slot, cqe->slot_len);
+
+	cqhci_writel(cqe, BIT(tag), CQHCI_TDBR);
+
+	return 0;
+}
+
+int sdhci_cqe_poll(struct udevice *dev, u32 *donep)
+{
+	struct sdhci_host *host = sdhci_cqe_host(dev);
+	struct sdhci_cqe *cqe = host->cqe;
+	u32 status, int_status, done;
+	uint tag;
+
+	*donep = 0;
+	if (!cqe)
+		return -ENOSYS;
+
+	status = cqhci_readl(cqe, CQHCI_IS);
+	int_status = sdhci_readl(host, SDHCI_INT_STATUS);
+	if ((status & (CQHCI_IS_RED | CQHCI_IS_TCL)) ||
+	    (int_status & SDHCI_INT_ERROR)) {
+		log_debug("%s: error: status %x, int_status %x, terri %x\n",
+			  host->name, status, int_status,
+			  cqhci_readl(cqe, CQHCI_TERRI));
+		cqhci_writel(cqe, status, CQHCI_IS);
+		sdhci_writel(host, int_status, SDHCI_INT_STATUS);
+		return -EIO;
+	}
+	if (!(status & CQHCI_IS_TCC))
+		return 0;
+
+	/* Clear this first so that later completions set it again */
+	cqhci_writel(cqe, CQHCI_IS_TCC, CQHCI_IS);
+	done = cqhci_readl(cqe, CQHCI_TCN);
+	cqhci_writel(cqe, done, CQHCI_TCN);
+	sdhci_writel(host, int_status, SDHCI_INT_STATUS);
+
+	done &= GENMASK(CQHCI_DEPTH - 1, 0);
+	for (tag = 0; tag < CQHCI_DEPTH; tag++) {
+		if (done & BIT(tag))
+			dma_unmap_single(cqe->buf[tag], cqe->len[tag],
+					 DMA_FROM_DEVICE);
+	}
+	*donep = done;
+
+	return 0;
+}
+
+int sdhci_cqe_setup(struct mmc_config *cfg, struct sdhci_host *host,
+		    void *base, uint flags)
+{
+	struct sdhci_cqe *cqe;
+
+	if (!(cfg->host_caps & MMC_CAP_CQE))
+		return 0;
+	if (!base || !(host->flags & (USE_ADMA | USE_ADMA64))) {
+		log_warning("%s: Command queueing needs ADMA and CQHCI\n",
+			    host->name);
+		cfg->host_caps &= ~MMC_CAP_CQE;
+		return 0;
+	}
+
+	cqe = calloc(1, sizeof(*cqe));
+	if (!cqe)
+		return -ENOMEM;
+	cqe->base = base;
+	cqe->dma64 = host->flags & USE_ADMA64;
+	cqe->slot_len = CQHCI_TASK_DESC_LEN + (cqe->dma64 ? 16 : 8);
+	if (!cqe->dma64)
+		cqe->trans_len = 8;
+	else if (flags & SDHCI_CQE_SHORT_TRANS_DESC)
+		cqe->trans_len = 12;
+	else
+		cqe->trans_len = 16;
+	cqe->desc_size = CQHCI_NUM_SLOTS * cqe->slot_len +
+		CQHCI_DEPTH * ADMA_TABLE_NO_ENTRIES * cqe->trans_len;
+	cqe->desc = memalign(ARCH_DMA_MINALIGN, cqe->desc_size);
+	if (!cqe->desc) {
+		free(cqe);
+		return -ENOMEM;
+	}
+	memset(cqe->desc, '\0', cqe->desc_size);
+	cqhci_flush(cqe->desc, cqe->desc_size);
+
+	host->cqe = cqe;
+	cfg->cqe_depth = CQHCI_DEPTH;
+	log_debug("%s: CQHCI version %x, depth %d\n", host->name,
+		  cqhci_readl(cqe, CQHCI_VER), CQHCI_DEPTH);
+
+	return 0;
+}
@@ -23,7 +23,7 @@
 #include <phys2bus.h>
 #include <power/regulator.h>
 
-static void sdhci_reset(struct sdhci_host *host, u8 mask)
+void sdhci_reset(struct sdhci_host *host, u8 mask)
 {
 	unsigned long timeout;
 
@@ -366,6 +366,30 @@ static int sdhci_execute_tuning(struct udevice *dev, uint opcode)
 	}
 	return 0;
 }
+
+#if CONFIG_IS_ENABLED(MMC_CACHE)
+static int sdhci_get_tuning(struct udevice *dev, u32 *tapp)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+
+	if (!host->ops || !host->ops->platform_get_tuning)
+		return -ENOSYS;
+
+	return host->ops->platform_get_tuning(host, tapp);
+}
+
+static int sdhci_set_tuning(struct udevice *dev, u32 tap)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+
+	if (!host->ops || !host->ops->platform_set_tuning)
+		return -ENOSYS;
+
+	return host->ops->platform_set_tuning(host, tap);
+}
+#endif
 #endif
 int sdhci_set_clock(struct mmc *mmc, unsigned int clock)
 {
@@ -845,11 +869,20 @@ const struct dm_mmc_ops sdhci_ops = {
 	.deferred_probe	= sdhci_deferred_probe,
 #if CONFIG_IS_ENABLED(MMC_SUPPORTS_TUNING)
 	.execute_tuning	= sdhci_execute_tuning,
+#if CONFIG_IS_ENABLED(MMC_CACHE)
+	.get_tuning	= sdhci_get_tuning,
+	.set_tuning	= sdhci_set_tuning,
+#endif
 #endif
 	.wait_dat0	= sdhci_wait_dat0,
 #if CONFIG_IS_ENABLED(MMC_HS400_ES_SUPPORT)
 	.set_enhanced_strobe = sdhci_set_enhanced_strobe,
 #endif
+#if CONFIG_IS_ENABLED(MMC_SDHCI_CQE)
+	.cqe_enable	= sdhci_cqe_enable,
+	.cqe_submit	= sdhci_cqe_submit,
+	.cqe_poll	= sdhci_cqe_poll,
+#endif
 };
 #else
 static const struct mmc_ops sdhci_ops = {
@@ -79,6 +79,7 @@
 #include <u-boot/crc.h>
 #else
 #include <div64.h>
+#include <time.h>
 #include <linux/bug.h>
 #include <linux/err.h>
 #include <linux/printk.h>
@@ -833,6 +834,11 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
+	ubi->attach_pebs++;
+	err = ubi_io_read_hdrs(ubi, pnum);
+	if (err < 0)
+		return err;
+
 	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 	if (err < 0)
 		return err;
@@ -1288,12 +1294,14 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	if (err)
 		goto out_vidh;
 
+	ubi_io_free_hdrs(ubi);
 	ubi_free_vid_hdr(ubi, vidh);
 	kfree(ech);
 
 	return 0;
 
 out_vidh:
+	ubi_io_free_hdrs(ubi);
 	ubi_free_vid_hdr(ubi, vidh);
 out_ech:
 	kfree(ech);
@@ -1367,6 +1375,7 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 		}
 	}
 
+	ubi_io_free_hdrs(ubi);
 	ubi_free_vid_hdr(ubi, vidh);
 	kfree(ech);
 
@@ -1381,6 +1390,7 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 	return ubi_scan_fastmap(ubi, *ai, fm_anchor);
 
 out_vidh:
+	ubi_io_free_hdrs(ubi);
 	ubi_free_vid_hdr(ubi, vidh);
 out_ech:
 	kfree(ech);
@@ -1402,7 +1412,9 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 {
 	int err;
 	struct ubi_attach_info *ai;
+	ulong start = get_timer(0);
 
+	ubi->attach_pebs = 0;
 	ai = alloc_ai();
 	if (!ai)
 		return -ENOMEM;
@@ -1426,6 +1438,12 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 					return -ENOMEM;
 
 				err = scan_all(ubi, ai, 0);
+
+				/*
+				 * This image uses fastmap, so write a fresh one
+				 * on detach rather than scanning again next time
+				 */
+				ubi->fm_disabled = 0;
 			} else {
 				err = scan_all(ubi, ai, UBI_FM_MAX_START);
 			}
@@ -1456,6 +1474,10 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	if (err)
 		goto out_wl;
 
+	ubi_msg(ubi, "attach %s: %d PEBs scanned in %lu ms",
+		ubi->fm ? "from fastmap" : "by scanning", ubi->attach_pebs,
+		get_timer(start));
+
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	if (ubi->fm && ubi_dbg_chk_fastmap(ubi)) {
 		struct ubi_attach_info *scan_ai;
@@ -1129,8 +1129,9 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	/* If we don't write a new fastmap at detach time we lose all
 	 * EC updates that have been made since the last written fastmap.
 	 * In case of fastmap debugging we omit the update to simulate an
-	 * unclean shutdown. */
-	if (!ubi_dbg_chk_fastmap(ubi))
+	 * unclean shutdown. If the flash has not changed since the fastmap
+	 * was written, it is still valid, so leave it alone. */
+	if (!ubi_dbg_chk_fastmap(ubi) && (ubi->fm_dirty || !ubi->fm))
 		ubi_update_fastmap(ubi);
 #endif
 	/*
@@ -497,6 +497,7 @@ static int scan_pool(struct ubi_device *ubi, struct ubi_attach_info *ai,
 			goto out;
 		}
 
+		ubi->attach_pebs++;
 		err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 		if (err && err != UBI_IO_BITFLIPS) {
 			ubi_err(ubi, "unable to read EC header! PEB:%i err:%i",
@@ -961,6 +962,9 @@ int ubi_scan_fastmap(struct ubi_device *ubi, struct ubi_attach_info *ai,
 			goto free_hdr;
 		}
 
+		/* The anchor was counted when it was found */
+		if (i)
+			ubi->attach_pebs++;
 		ret = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 		if (ret && ret != UBI_IO_BITFLIPS) {
 			ubi_err(ubi, "unable to read fastmap block# %i EC (PEB: %i)",
@@ -1629,6 +1633,7 @@ int ubi_update_fastmap(struct ubi_device *ubi)
 
 	if (ret)
 		goto err;
+	ubi->fm_dirty = 0;
 
 out_unlock:
 	up_write(&ubi->fm_protect);
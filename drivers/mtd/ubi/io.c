@@ -211,6 +211,17 @@ retry:
 	return err;
 }
 
+/*
+ * The flash is about to change, so the headers read when attaching may no
+ * longer be valid and the fastmap needs to be written again.
+ */
+static void io_changed(struct ubi_device *ubi, int pnum)
+{
+	if (pnum == ubi->hdrs_pnum)
+		ubi->hdrs_pnum = -1;
+	ubi->fm_dirty = 1;
+}
+
 /**
  * ubi_io_write - write data to a physical eraseblock.
  * @ubi: UBI device description object
@@ -276,6 +287,7 @@ int ubi_io_write(struct ubi_device *ubi, const void *buf, int pnum, int offset,
 		return -EIO;
 	}
 
+	io_changed(ubi, pnum);
 	addr = (loff_t)pnum * ubi->peb_size + offset;
 	err = mtd_write(ubi->mtd, addr, len, &written, buf);
 	if (err) {
@@ -562,6 +574,7 @@ int ubi_io_sync_erase(struct ubi_device *ubi, int pnum, int torture)
 		ubi_err(ubi, "read-only mode");
 		return -EROFS;
 	}
+	io_changed(ubi, pnum);
 
 	/*
 	 * If the flash is ECC-ed then we have to erase the ECC block before we
@@ -697,6 +710,69 @@ bad:
 	return 1;
 }
 
+/**
+ * ubi_io_read_hdrs - read the EC and VID headers of a PEB in one go.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock to read from
+ *
+ * Attaching by scanning reads both headers of every PEB. When the VID header
+ * is in the min. I/O unit after the EC header (or in the same one, with
+ * sub-pages), this reads both with a single multi-page read, which saves a
+ * command per PEB and lets the controller stream the pages. The headers are
+ * kept so that 'ubi_io_read_ec_hdr()' and 'ubi_io_read_vid_hdr()' do not need
+ * to read them again.
+ *
+ * If there is an ECC error, nothing is kept, so that the header reads can tell
+ * which header is affected. Returns zero in that case and on success, or a
+ * negative error code if the read failed otherwise.
+ */
+int ubi_io_read_hdrs(struct ubi_device *ubi, int pnum)
+{
+	int len = ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize;
+	int err;
+
+	ubi->hdrs_pnum = -1;
+	if (len > 2 * ubi->min_io_size)
+		return 0;
+
+	if (!ubi->hdrs_buf) {
+		ubi->hdrs_buf = kmalloc(len, GFP_KERNEL);
+		if (!ubi->hdrs_buf)
+			return 0;
+	}
+
+	err = ubi_io_read(ubi, ubi->hdrs_buf, pnum, 0, len);
+	if (err && err != UBI_IO_BITFLIPS)
+		return mtd_is_eccerr(err) ? 0 : err;
+	ubi->hdrs_pnum = pnum;
+	ubi->hdrs_err = err;
+
+	return 0;
+}
+
+/**
+ * ubi_io_free_hdrs - free the buffer used by 'ubi_io_read_hdrs()'.
+ * @ubi: UBI device description object
+ */
+void ubi_io_free_hdrs(struct ubi_device *ubi)
+{
+	kfree(ubi->hdrs_buf);
+	ubi->hdrs_buf = NULL;
+	ubi->hdrs_pnum = -1;
+}
+
+/* Read part of a header, using the data from 'ubi_io_read_hdrs()' if possible */
+static int read_hdr(struct ubi_device *ubi, void *buf, int pnum, int offset,
+		    int len)
+{
+	if (ubi->hdrs_buf && pnum == ubi->hdrs_pnum) {
+		memcpy(buf, ubi->hdrs_buf + offset, len);
+		return ubi->hdrs_err;
+	}
+
+	return ubi_io_read(ubi, buf, pnum, offset, len);
+}
+
 /**
  * ubi_io_read_ec_hdr - read and check an erase counter header.
  * @ubi: UBI device description object
@@ -728,7 +804,7 @@ int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 	dbg_io("read EC header from PEB %d", pnum);
 	ubi_assert(pnum >= 0 && pnum < ubi->peb_count);
 
-	read_err = ubi_io_read(ubi, ec_hdr, pnum, 0, UBI_EC_HDR_SIZE);
+	read_err = read_hdr(ubi, ec_hdr, pnum, 0, UBI_EC_HDR_SIZE);
 	if (read_err) {
 		if (read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 			return read_err;
@@ -1003,8 +1079,8 @@ int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 	ubi_assert(pnum >= 0 &&  pnum < ubi->peb_count);
 
 	p = (char *)vid_hdr - ubi->vid_hdr_shift;
-	read_err = ubi_io_read(ubi, p, pnum, ubi->vid_hdr_aloffset,
-			  ubi->vid_hdr_alsize);
+	read_err = read_hdr(ubi, p, pnum, ubi->vid_hdr_aloffset,
+			    ubi->vid_hdr_alsize);
 	if (read_err && read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 		return read_err;
 
@@ -467,6 +467,7 @@ struct ubi_debug_info {
  * @fm_eba_sem: allows ubi_update_fastmap() to block EBA table changes
  * @fm_work: fastmap work queue
  * @fm_work_scheduled: non-zero if fastmap work was scheduled
+ * @fm_dirty: non-zero if the flash was changed since the fastmap was written
  *
  * @used: RB-tree of used physical eraseblocks
  * @erroneous: RB-tree of erroneous used physical eraseblocks
@@ -524,6 +525,11 @@ struct ubi_debug_info {
  * @max_write_size: maximum amount of bytes the underlying flash can write at a
  *                  time (MTD write buffer size)
  * @mtd: MTD device descriptor
+ * @hdrs_buf: EC and VID headers of PEB @hdrs_pnum, read together when
+ *            attaching
+ * @hdrs_pnum: PEB whose headers are in @hdrs_buf, -1 if none
+ * @hdrs_err: result of reading @hdrs_buf, 0 or %UBI_IO_BITFLIPS
+ * @attach_pebs: number of PEBs whose headers were read when attaching
  *
  * @peb_buf: a buffer of PEB size used for different purposes
  * @buf_mutex: protects @peb_buf
@@ -577,6 +583,7 @@ struct ubi_device {
 	struct work_struct fm_work;
 #endif
 	int fm_work_scheduled;
+	int fm_dirty;
 
 	/* Wear-leveling sub-system's stuff */
 	struct rb_root used;
@@ -623,6 +630,10 @@ struct ubi_device {
 	unsigned int nor_flash:1;
 	int max_write_size;
 	struct mtd_info *mtd;
+	void *hdrs_buf;
+	int hdrs_pnum;
+	int hdrs_err;
+	int attach_pebs;
 
 	void *peb_buf;
 	struct mutex buf_mutex;
@@ -899,6 +910,8 @@ int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 			struct ubi_vid_hdr *vid_hdr, int verbose);
 int ubi_io_write_vid_hdr(struct ubi_device *ubi, int pnum,
 			 struct ubi_vid_hdr *vid_hdr);
+int ubi_io_read_hdrs(struct ubi_device *ubi, int pnum);
+void ubi_io_free_hdrs(struct ubi_device *ubi);
 
 /* build.c */
 int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
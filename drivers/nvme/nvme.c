@@ -15,17 +15,17 @@
 #include <time.h>
 #include <dm/device-internal.h>
 #include <linux/compat.h>
+#include <linux/log2.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		CONFIG_NVME_QUEUE_DEPTH
 #define NVME_AQ_DEPTH		2
-#define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
-#define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
-#define NVME_CQ_ALLOCATION	ALIGN(NVME_CQ_SIZE(NVME_Q_DEPTH), \
-				      ARCH_DMA_MINALIGN)
+#define NVME_SQ_SIZE(depth)	((depth) * sizeof(struct nvme_command))
+#define NVME_CQ_SIZE(depth)	((depth) * sizeof(struct nvme_completion))
+#define NVME_CQ_ALLOCATION(depth)	ALIGN(NVME_CQ_SIZE(depth), \
+					      ARCH_DMA_MINALIGN)
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
-#define MAX_PRP_POOL		512
 
 static int nvme_wait_csts(struct nvme_dev *dev, u32 mask, u32 val)
 {
@@ -44,68 +44,50 @@ static int nvme_wait_csts(struct nvme_dev *dev, u32 mask, u32 val)
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
-			   int total_len, u64 dma_addr)
+/**
+ * nvme_setup_prps() - set up the PRP entries for a transfer
+ *
+ * The PRP list, if needed, is written to @prp_list, which is one page long.
+ * The caller must limit @total_len so that the list fits in that page, i.e.
+ * to (page_size / 8) pages.
+ *
+ * @dev:	NVMe device
+ * @prp_list:	Page to use for the PRP list
+ * @prp2:	Returns the value to use for PRP entry 2
+ * @total_len:	Number of bytes to transfer
+ * @dma_addr:	Address of the buffer
+ */
+static void nvme_setup_prps(struct nvme_dev *dev, u64 *prp_list, u64 *prp2,
+			    int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
 	int offset = dma_addr & (page_size - 1);
-	u64 *prp_pool;
 	int length = total_len;
 	int i, nprps;
-	u32 prps_per_page = page_size >> 3;
-	u32 num_pages;
 
 	length -= (page_size - offset);
 
 	if (length <= 0) {
 		*prp2 = 0;
-		return 0;
+		return;
 	}
 
-	if (length)
-		dma_addr += (page_size - offset);
+	dma_addr += (page_size - offset);
 
 	if (length <= page_size) {
 		*prp2 = dma_addr;
-		return 0;
+		return;
 	}
 
 	nprps = DIV_ROUND_UP(length, page_size);
-	num_pages = DIV_ROUND_UP(nprps - 1, prps_per_page - 1);
-
-	if (nprps > dev->prp_entry_num) {
-		free(dev->prp_pool);
-		/*
-		 * Always increase in increments of pages.  It doesn't waste
-		 * much memory and reduces the number of allocations.
-		 */
-		dev->prp_pool = memalign(page_size, num_pages * page_size);
-		if (!dev->prp_pool) {
-			printf("Error: malloc prp_pool fail\n");
-			return -ENOMEM;
-		}
-		dev->prp_entry_num = num_pages * (prps_per_page - 1) + 1;
-	}
-
-	prp_pool = dev->prp_pool;
-	i = 0;
-	while (nprps) {
-		if ((i == (prps_per_page - 1)) && nprps > 1) {
-			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
-					page_size);
-			i = 0;
-			prp_pool += page_size;
-		}
-		*(prp_pool + i++) = cpu_to_le64(dma_addr);
+	for (i = 0; i < nprps; i++) {
+		prp_list[i] = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
-		nprps--;
 	}
-	*prp2 = (ulong)dev->prp_pool;
-
-	flush_dcache_range((ulong)dev->prp_pool, (ulong)dev->prp_pool +
-			   num_pages * page_size);
+	*prp2 = (ulong)prp_list;
 
-	return 0;
+	flush_dcache_range((ulong)prp_list, (ulong)prp_list +
+			   ALIGN(nprps * sizeof(u64), ARCH_DMA_MINALIGN));
 }
 
 static __le16 nvme_get_cmd_id(void)
@@ -120,17 +102,33 @@ static u16 nvme_read_completion_status(struct nvme_queue *nvmeq, u16 index)
 	/*
 	 * Single CQ entries are always smaller than a cache line, so we
 	 * can't invalidate them individually. However CQ entries are
-	 * read only by the CPU, so it's safe to always invalidate all of them,
-	 * as the cache line should never become dirty.
+	 * read only by the CPU, so it's safe to invalidate the whole line
+	 * holding this entry, as the cache line should never become dirty.
 	 */
-	ulong start = (ulong)&nvmeq->cqes[0];
-	ulong stop = start + NVME_CQ_ALLOCATION;
+	ulong start = ALIGN_DOWN((ulong)&nvmeq->cqes[index], ARCH_DMA_MINALIGN);
 
-	invalidate_dcache_range(start, stop);
+	invalidate_dcache_range(start, start + ARCH_DMA_MINALIGN);
 
 	return readw(&(nvmeq->cqes[index].status));
 }
 
+/**
+ * nvme_write_cmd() - copy a command into the queue slot at the tail
+ *
+ * This does not move the tail or ring the doorbell.
+ *
+ * @nvmeq:	The queue to use
+ * @cmd:	The command to write
+ */
+static void nvme_write_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+{
+	u16 tail = nvmeq->sq_tail;
+
+	memcpy(&nvmeq->sq_cmds[tail], cmd, sizeof(*cmd));
+	flush_dcache_range((ulong)&nvmeq->sq_cmds[tail],
+			   (ulong)&nvmeq->sq_cmds[tail] + sizeof(*cmd));
+}
+
 /**
  * nvme_submit_cmd() - copy a command into a queue and ring the doorbell
  *
@@ -142,9 +140,7 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 	struct nvme_ops *ops;
 	u16 tail = nvmeq->sq_tail;
 
-	memcpy(&nvmeq->sq_cmds[tail], cmd, sizeof(*cmd));
-	flush_dcache_range((ulong)&nvmeq->sq_cmds[tail],
-			   (ulong)&nvmeq->sq_cmds[tail] + sizeof(*cmd));
+	nvme_write_cmd(nvmeq, cmd);
 
 	ops = (struct nvme_ops *)nvmeq->dev->udev->driver->ops;
 	if (ops && ops->submit_cmd) {
@@ -229,11 +225,13 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 {
 	struct nvme_ops *ops;
 	struct nvme_queue *nvmeq = malloc(sizeof(*nvmeq));
+	int i;
+
 	if (!nvmeq)
 		return NULL;
 	memset(nvmeq, 0, sizeof(*nvmeq));
 
-	nvmeq->cqes = (void *)memalign(4096, NVME_CQ_ALLOCATION);
+	nvmeq->cqes = (void *)memalign(4096, NVME_CQ_ALLOCATION(depth));
 	if (!nvmeq->cqes)
 		goto free_nvmeq;
 	memset((void *)nvmeq->cqes, 0, NVME_CQ_SIZE(depth));
@@ -243,6 +241,18 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 		goto free_queue;
 	memset((void *)nvmeq->sq_cmds, 0, NVME_SQ_SIZE(depth));
 
+	/* Each I/O slot has its own PRP list, so none need be built twice */
+	if (qid != NVME_ADMIN_Q) {
+		nvmeq->slots = calloc(depth, sizeof(*nvmeq->slots));
+		nvmeq->prp_pool = memalign(dev->page_size,
+					   depth * dev->page_size);
+		if (!nvmeq->slots || !nvmeq->prp_pool)
+			goto free_slots;
+		for (i = 0; i < depth; i++)
+			nvmeq->slots[i].prp_list = nvmeq->prp_pool +
+				i * dev->page_size;
+	}
+
 	nvmeq->dev = dev;
 
 	nvmeq->cq_head = 0;
@@ -259,6 +269,10 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 
 	return nvmeq;
 
+ free_slots:
+	free(nvmeq->prp_pool);
+	free(nvmeq->slots);
+	free(nvmeq->sq_cmds);
  free_queue:
 	free((void *)nvmeq->cqes);
  free_nvmeq:
@@ -319,6 +333,8 @@ static void nvme_free_queue(struct nvme_queue *nvmeq)
 {
 	free((void *)nvmeq->cqes);
 	free(nvmeq->sq_cmds);
+	free(nvmeq->prp_pool);
+	free(nvmeq->slots);
 	free(nvmeq);
 }
 
@@ -338,13 +354,19 @@ static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 {
 	struct nvme_dev *dev = nvmeq->dev;
 
+	nvmeq->sq_head = 0;
 	nvmeq->sq_tail = 0;
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
+	nvmeq->inflight = 0;
+	if (nvmeq->slots) {
+		for (int i = 0; i < nvmeq->q_depth; i++)
+			nvmeq->slots[i].busy = false;
+	}
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
 	memset((void *)nvmeq->cqes, 0, NVME_CQ_SIZE(nvmeq->q_depth));
-	flush_dcache_range((ulong)nvmeq->cqes,
-			   (ulong)nvmeq->cqes + NVME_CQ_ALLOCATION);
+	flush_dcache_range((ulong)nvmeq->cqes, (ulong)nvmeq->cqes +
+			   NVME_CQ_ALLOCATION(nvmeq->q_depth));
 	dev->online_queues++;
 }
 
@@ -741,65 +763,222 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
+int nvme_get_io_stats(struct udevice *udev, struct nvme_io_stats *stats,
+		      bool reset)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_dev *dev = ns->dev;
+
+	*stats = dev->stats;
+	stats->q_depth = dev->q_depth;
+	if (reset)
+		memset(&dev->stats, '\0', sizeof(dev->stats));
+
+	return 0;
+}
+
+/*
+ * Controllers with their own submission hooks move the queue tail themselves
+ * and can only track one command at a time
+ */
+static bool nvme_has_queue_ops(struct nvme_dev *dev)
+{
+	struct nvme_ops *ops = (struct nvme_ops *)dev->udev->driver->ops;
+
+	return ops && (ops->submit_cmd || ops->complete_cmd);
+}
+
+/**
+ * nvme_setup_rw() - fill in a read / write command for part of a request
+ *
+ * @ns:		Namespace to access
+ * @c:		Command to fill in, with the opcode and namespace already set
+ * @slot:	Slot whose PRP list to use
+ * @blknr:	First block to transfer
+ * @count:	Number of blocks to transfer
+ * @addr:	Buffer address
+ */
+static void nvme_setup_rw(struct nvme_ns *ns, struct nvme_command *c,
+			  struct nvme_io_slot *slot, u64 blknr, u32 count,
+			  ulong addr)
+{
+	u64 prp2;
+
+	nvme_setup_prps(ns->dev, slot->prp_list, &prp2, count << ns->lba_shift,
+			addr);
+	c->rw.slba = cpu_to_le64(blknr);
+	c->rw.length = cpu_to_le16(count - 1);
+	c->rw.prp1 = cpu_to_le64(addr);
+	c->rw.prp2 = cpu_to_le64(prp2);
+}
+
+/**
+ * nvme_io_reap() - wait for I/O completions and retire all those ready
+ *
+ * This waits for at least one command to complete, then retires every
+ * completion that is available, writing the completion-queue doorbell once
+ * for all of them.
+ *
+ * @nvmeq:	I/O queue
+ * @failed:	Updated to the lowest request offset (in blocks) of any command
+ *		which failed
+ * Return: number of commands retired, -ETIMEDOUT if none completed in time
+ */
+static int nvme_io_reap(struct nvme_queue *nvmeq, u64 *failed)
+{
+	struct nvme_dev *dev = nvmeq->dev;
+	u16 head = nvmeq->cq_head;
+	u16 phase = nvmeq->cq_phase;
+	struct nvme_io_slot *slot;
+	ulong start_time;
+	int count = 0;
+	u16 status, id;
+
+	start_time = timer_get_us();
+	for (;;) {
+		status = nvme_read_completion_status(nvmeq, head);
+		if ((status & 0x01) != phase) {
+			if (count)
+				break;
+			if (timer_get_us() - start_time >=
+			    IO_TIMEOUT * 1000000UL)
+				return -ETIMEDOUT;
+			continue;
+		}
+
+		nvmeq->sq_head = readw(&nvmeq->cqes[head].sq_head);
+		id = readw(&nvmeq->cqes[head].command_id);
+		if (id < nvmeq->q_depth && nvmeq->slots[id].busy) {
+			slot = &nvmeq->slots[id];
+			slot->busy = false;
+			nvmeq->inflight--;
+			status >>= 1;
+			if (status) {
+				printf("ERROR: status = %x, phase = %d, head = %d\n",
+				       status, phase, head);
+				*failed = min(*failed, slot->start);
+			}
+		}
+		count++;
+
+		if (++head == nvmeq->q_depth) {
+			head = 0;
+			phase = !phase;
+		}
+	}
+
+	writel(head, nvmeq->q_db + dev->db_stride);
+	nvmeq->cq_head = head;
+	nvmeq->cq_phase = phase;
+	dev->stats.reaps++;
+
+	return count;
+}
+
+/* Check that the slot at the tail is free and the queue is not full */
+static bool nvme_io_slot_free(struct nvme_queue *nvmeq)
+{
+	u16 tail = nvmeq->sq_tail;
+	u16 next = tail + 1 == nvmeq->q_depth ? 0 : tail + 1;
+
+	return !nvmeq->slots[tail].busy && next != nvmeq->sq_head;
+}
+
 static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 			 lbaint_t blkcnt, void *buffer, bool read)
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
 	struct nvme_dev *dev = ns->dev;
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
 	struct nvme_command c;
 	struct blk_desc *desc = dev_get_uclass_plat(udev);
-	int status;
-	u64 prp2;
 	u64 total_len = blkcnt << desc->log2blksz;
-	u64 temp_len = total_len;
-	uintptr_t temp_buffer = (uintptr_t)buffer;
+	u32 page_shift = ilog2(dev->page_size);
+	u32 max_shift, lbas, count;
+	u64 next = 0, failed = blkcnt;
+	int queued, ret, i;
 
-	u64 slba = blknr;
-	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
-	u64 total_lbas = blkcnt;
+	/* Keep each command's PRP list within its one page */
+	max_shift = min(dev->max_transfer_shift, 2 * page_shift - 3);
+	lbas = 1 << (max_shift - ns->lba_shift);
 
 	flush_dcache_range((unsigned long)buffer,
 			   (unsigned long)buffer + total_len);
 
+	memset(&c, '\0', sizeof(c));
 	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
-	c.rw.flags = 0;
 	c.rw.nsid = cpu_to_le32(ns->ns_id);
-	c.rw.control = 0;
-	c.rw.dsmgmt = 0;
-	c.rw.reftag = 0;
-	c.rw.apptag = 0;
-	c.rw.appmask = 0;
-	c.rw.metadata = 0;
-
-	while (total_lbas) {
-		if (total_lbas < lbas) {
-			lbas = (u16)total_lbas;
-			total_lbas = 0;
-		} else {
-			total_lbas -= lbas;
+
+	if (nvme_has_queue_ops(dev)) {
+		while (next < blkcnt) {
+			count = min_t(u64, blkcnt - next, lbas);
+			nvme_setup_rw(ns, &c, &nvmeq->slots[0], blknr + next,
+				      count, (ulong)buffer +
+				      (next << ns->lba_shift));
+			ret = nvme_submit_sync_cmd(nvmeq, &c, NULL, IO_TIMEOUT);
+			if (ret)
+				break;
+			dev->stats.cmds++;
+			dev->stats.doorbells++;
+			dev->stats.reaps++;
+			dev->stats.max_inflight = 1;
+			next += count;
+		}
+		failed = next;
+		goto done;
+	}
+
+	/*
+	 * Fill as many slots as are free, ringing the doorbell once for all
+	 * of them, then retire whatever has completed and go round again. Once
+	 * a command fails, no more are sent but those in flight are drained.
+	 */
+	while (nvmeq->inflight || (next < blkcnt && failed == blkcnt)) {
+		queued = 0;
+		while (next < blkcnt && failed == blkcnt &&
+		       nvme_io_slot_free(nvmeq)) {
+			struct nvme_io_slot *slot = &nvmeq->slots[nvmeq->sq_tail];
+
+			count = min_t(u64, blkcnt - next, lbas);
+			nvme_setup_rw(ns, &c, slot, blknr + next, count,
+				      (ulong)buffer + (next << ns->lba_shift));
+			c.common.command_id = cpu_to_le16(nvmeq->sq_tail);
+			nvme_write_cmd(nvmeq, &c);
+			slot->start = next;
+			slot->busy = true;
+			next += count;
+			queued++;
+			if (++nvmeq->sq_tail == nvmeq->q_depth)
+				nvmeq->sq_tail = 0;
+		}
+		if (queued) {
+			writel(nvmeq->sq_tail, nvmeq->q_db);
+			nvmeq->inflight += queued;
+			dev->stats.cmds += queued;
+			dev->stats.doorbells++;
+			dev->stats.max_inflight = max_t(uint,
+							dev->stats.max_inflight,
+							nvmeq->inflight);
 		}
 
-		if (nvme_setup_prps(dev, &prp2,
-				    lbas << ns->lba_shift, temp_buffer))
-			return -EIO;
-		c.rw.slba = cpu_to_le64(slba);
-		slba += lbas;
-		c.rw.length = cpu_to_le16(lbas - 1);
-		c.rw.prp1 = cpu_to_le64(temp_buffer);
-		c.rw.prp2 = cpu_to_le64(prp2);
-		status = nvme_submit_sync_cmd(dev->queues[NVME_IO_Q],
-				&c, NULL, IO_TIMEOUT);
-		if (status)
+		ret = nvme_io_reap(nvmeq, &failed);
+		if (ret < 0) {
+			printf("Error: I/O timed out\n");
+			for (i = 0; i < nvmeq->q_depth; i++) {
+				if (nvmeq->slots[i].busy)
+					failed = min(failed,
+						     nvmeq->slots[i].start);
+			}
 			break;
-		temp_len -= (u32)lbas << ns->lba_shift;
-		temp_buffer += lbas << ns->lba_shift;
+		}
 	}
 
+done:
 	if (read)
 		invalidate_dcache_range((unsigned long)buffer,
 					(unsigned long)buffer + total_len);
 
-	return (total_len - temp_len) >> desc->log2blksz;
+	return failed;
 }
 
 static ulong nvme_blk_read(struct udevice *udev, lbaint_t blknr,
@@ -851,6 +1030,8 @@ int nvme_init(struct udevice *udev)
 
 	ndev->cap = nvme_readq(&ndev->bar->cap);
 	ndev->q_depth = min_t(int, NVME_CAP_MQES(ndev->cap) + 1, NVME_Q_DEPTH);
+	if (nvme_has_queue_ops(ndev))
+		ndev->q_depth = min(ndev->q_depth, NVME_AQ_DEPTH);
 	ndev->db_stride = 1 << NVME_CAP_STRIDE(ndev->cap);
 	ndev->dbs = ((void __iomem *)ndev->bar) + 4096;
 
@@ -860,15 +1041,6 @@ int nvme_init(struct udevice *udev)
 		goto free_queue;
 	}
 
-	/* Allocate after the page size is known */
-	ndev->prp_pool = memalign(ndev->page_size, MAX_PRP_POOL);
-	if (!ndev->prp_pool) {
-		ret = -ENOMEM;
-		printf("Error: %s: Out of memory!\n", udev->name);
-		goto free_nvme;
-	}
-	ndev->prp_entry_num = MAX_PRP_POOL >> 3;
-
 	ret = nvme_setup_io_queues(ndev);
 	if (ret) {
 		log_debug("Unable to setup I/O queues(err=%dE)\n", ret);
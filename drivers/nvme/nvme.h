@@ -7,6 +7,7 @@
 #ifndef __DRIVER_NVME_H__
 #define __DRIVER_NVME_H__
 
+#include <nvme.h>
 #include <asm/io.h>
 
 struct nvme_id_power_state {
@@ -618,9 +619,8 @@ struct nvme_dev {
 	u32 stripe_size;
 	u32 page_size;
 	u8 vwc;
-	u64 *prp_pool;
-	u32 prp_entry_num;
 	u32 nn;
+	struct nvme_io_stats stats;
 };
 
 /* Admin queue and a single I/O queue. */
@@ -630,6 +630,19 @@ enum nvme_queue_id {
 	NVME_Q_NUM,
 };
 
+/**
+ * struct nvme_io_slot - state of one I/O submission queue entry
+ *
+ * @prp_list:	Page holding the PRP list for the command in this slot
+ * @start:	Offset in blocks of this command from the start of the request
+ * @busy:	true if the command has been submitted and not yet completed
+ */
+struct nvme_io_slot {
+	u64 *prp_list;
+	u64 start;
+	bool busy;
+};
+
 /*
  * An NVM Express queue. Each device has at least two (one for admin
  * commands and one for I/O commands).
@@ -647,6 +660,9 @@ struct nvme_queue {
 	u16 qid;
 	u8 cq_phase;
 	u8 cqe_seen;
+	u16 inflight;
+	struct nvme_io_slot *slots;
+	void *prp_pool;
 	unsigned long cmdid_data[];
 };
 
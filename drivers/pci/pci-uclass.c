@@ -6,6 +6,7 @@
 
 #define LOG_CATEGORY UCLASS_PCI
 
+#include <cyclic.h>
 #include <dm.h>
 #include <errno.h>
 #include <init.h>
@@ -1921,3 +1922,11 @@ int pci_init(void)
 
 	return 0;
 }
+
+#if CONFIG_IS_ENABLED(CYCLIC_JOBS)
+CYCLIC_JOB(pci) = {
+	.name		= "pci",
+	.uclass		= UCLASS_PCI,
+	.func		= pci_init,
+};
+#endif
@@ -9,8 +9,10 @@
 #include <blk.h>
 #include <bootdev.h>
 #include <bootstage.h>
+#include <cyclic.h>
 #include <dm.h>
 #include <env.h>
+#include <init.h>
 #include <libata.h>
 #include <log.h>
 #include <memalign.h>
@@ -589,6 +591,25 @@ int scsi_scan(bool verbose)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(CYCLIC_JOBS)
+/* Scan quietly, since this runs while the console is in use */
+static int scsi_scan_job(void)
+{
+	/* Let a PCI job finish rather than probing the same buses here */
+	if (IS_ENABLED(CONFIG_PCI) &&
+	    cyclic_job_wait_uclass(UCLASS_PCI) == -ESRCH)
+		pci_init();
+
+	return scsi_scan(false);
+}
+
+CYCLIC_JOB(scsi) = {
+	.name		= "scsi",
+	.uclass		= UCLASS_SCSI,
+	.func		= scsi_scan_job,
+};
+#endif
+
 static const struct blk_ops scsi_blk_ops = {
 	.read	= scsi_read,
 	.write	= scsi_write,
@@ -11,6 +11,7 @@
 #include <errno.h>
 #include <asm/io.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <spi.h>
 #include <spi-mem.h>
 #include <linux/bug.h>
@@ -165,10 +166,23 @@
 
 #define HW_TEST(x)		(0xe0 + ((x) * 4))
 
+/**
+ * struct mxic_spi_priv - private data for the controller
+ *
+ * @send_clk: Clock for sending data
+ * @send_dly_clk: Delayed clock for sending data
+ * @regs: Controller registers
+ * @linear_map: Window through which the flash can be read in linear mode, or
+ *	NULL if the device tree does not provide one
+ * @linear_size: Size of @linear_map in bytes
+ * @cur_speed_hz: Current bus speed
+ */
 struct mxic_spi_priv {
 	struct clk *send_clk;
 	struct clk *send_dly_clk;
 	void __iomem *regs;
+	void __iomem *linear_map;
+	fdt_size_t linear_size;
 	u32 cur_speed_hz;
 };
 
@@ -348,15 +362,11 @@ static bool mxic_spi_mem_supports_op(struct spi_slave *slave,
 	return spi_mem_default_supports_op(slave, op);
 }
 
-static int mxic_spi_mem_exec_op(struct spi_slave *slave,
-				const struct spi_mem_op *op)
+/* Host configuration for talking to @slave, with the chip select automatic */
+static u32 mxic_spi_prep_hc_cfg(struct spi_slave *slave)
 {
 	struct dm_spi_slave_plat *slave_plat = dev_get_parent_plat(slave->dev);
-	struct udevice *bus = slave->dev->parent;
-	struct mxic_spi_priv *priv = dev_get_priv(bus);
-	int nio = 1, i, ret;
-	u32 ss_ctrl;
-	u8 addr[8], dummy_bytes = 0;
+	int nio = 1;
 
 	if (slave->mode & (SPI_TX_OCTAL | SPI_RX_OCTAL))
 		nio = 8;
@@ -365,38 +375,63 @@ static int mxic_spi_mem_exec_op(struct spi_slave *slave,
 	else if (slave->mode & (SPI_TX_DUAL | SPI_RX_DUAL))
 		nio = 2;
 
-	writel(HC_CFG_NIO(nio) |
+	return HC_CFG_NIO(nio) |
 	       HC_CFG_TYPE(slave_plat->cs[0], HC_CFG_TYPE_SPI_NOR) |
-	       HC_CFG_SLV_ACT(slave_plat->cs[0]) | HC_CFG_IDLE_SIO_LVL(1) |
-	       HC_CFG_MAN_CS_EN,
-	       priv->regs + HC_CFG);
-	writel(HC_EN_BIT, priv->regs + HC_EN);
+	       HC_CFG_SLV_ACT(slave_plat->cs[0]) | HC_CFG_IDLE_SIO_LVL(1);
+}
 
-	ss_ctrl = OP_CMD_BYTES(1) | OP_CMD_BUSW(fls(op->cmd.buswidth) - 1);
+/*
+ * Since the SPI MXIC dummy buswidth is aligned with the data buswidth, the
+ * dummy byte needs to be recalculated to send out the correct dummy cycle.
+ */
+static u8 mxic_spi_dummy_bytes(const struct spi_mem_op *op)
+{
+	if (!op->dummy.nbytes)
+		return 0;
+
+	return op->dummy.nbytes / op->addr.buswidth * op->data.buswidth;
+}
+
+/* Operation configuration for @op, as used by SS_CTRL and LRD_CFG */
+static u32 mxic_spi_mem_prep_op_cfg(const struct spi_mem_op *op)
+{
+	u32 cfg;
+
+	cfg = OP_CMD_BYTES(1) | OP_CMD_BUSW(fls(op->cmd.buswidth) - 1);
 
 	if (op->addr.nbytes)
-		ss_ctrl |= OP_ADDR_BYTES(op->addr.nbytes) |
-			   OP_ADDR_BUSW(fls(op->addr.buswidth) - 1);
+		cfg |= OP_ADDR_BYTES(op->addr.nbytes) |
+		       OP_ADDR_BUSW(fls(op->addr.buswidth) - 1);
 
-	/*
-	 * Since the SPI MXIC dummy buswidth is aligned with the data buswidth,
-	 * the dummy byte needs to be recalculated to send out the correct
-	 * dummy cycle.
-	 */
-	if (op->dummy.nbytes) {
-		dummy_bytes = op->dummy.nbytes /
-			      op->addr.buswidth *
-			      op->data.buswidth;
-		ss_ctrl |= OP_DUMMY_CYC(dummy_bytes);
-	}
+	if (op->dummy.nbytes)
+		cfg |= OP_DUMMY_CYC(mxic_spi_dummy_bytes(op));
 
-	if (op->data.nbytes) {
-		ss_ctrl |= OP_DATA_BUSW(fls(op->data.buswidth) - 1);
+	/* data.nbytes is not set in the template for a direct mapping */
+	if (op->data.dir != SPI_MEM_NO_DATA) {
+		cfg |= OP_DATA_BUSW(fls(op->data.buswidth) - 1);
 		if (op->data.dir == SPI_MEM_DATA_IN)
-			ss_ctrl |= OP_READ;
+			cfg |= OP_READ;
 	}
 
-	writel(ss_ctrl, priv->regs + SS_CTRL(slave_plat->cs[0]));
+	return cfg;
+}
+
+static int mxic_spi_mem_exec_op(struct spi_slave *slave,
+				const struct spi_mem_op *op)
+{
+	struct dm_spi_slave_plat *slave_plat = dev_get_parent_plat(slave->dev);
+	struct udevice *bus = slave->dev->parent;
+	struct mxic_spi_priv *priv = dev_get_priv(bus);
+	u8 addr[8], dummy_bytes;
+	int i, ret;
+
+	writel(mxic_spi_prep_hc_cfg(slave) | HC_CFG_MAN_CS_EN,
+	       priv->regs + HC_CFG);
+	writel(HC_EN_BIT, priv->regs + HC_EN);
+
+	dummy_bytes = mxic_spi_dummy_bytes(op);
+	writel(mxic_spi_mem_prep_op_cfg(op),
+	       priv->regs + SS_CTRL(slave_plat->cs[0]));
 
 	writel(readl(priv->regs + HC_CFG) | HC_CFG_MAN_CS_ASSERT,
 	       priv->regs + HC_CFG);
@@ -431,9 +466,68 @@ out:
 	return ret;
 }
 
+static int mxic_spi_mem_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	struct mxic_spi_priv *priv = dev_get_priv(desc->slave->dev->parent);
+
+	/* Only reads use the linear mode */
+	if (!priv->linear_map || desc->info.op_tmpl.data.dir != SPI_MEM_DATA_IN)
+		return -EOPNOTSUPP;
+
+	if (desc->info.offset + desc->info.length > U32_MAX)
+		return -EINVAL;
+
+	if (!mxic_spi_mem_supports_op(desc->slave, &desc->info.op_tmpl))
+		return -EOPNOTSUPP;
+
+	return 0;
+}
+
+/*
+ * Read through the linear window: the controller sends the command, address
+ * and dummy cycles itself for each access, so the data can simply be copied
+ */
+static ssize_t mxic_spi_mem_dirmap_read(struct spi_mem_dirmap_desc *desc,
+					u64 offs, size_t len, void *buf)
+{
+	struct dm_spi_slave_plat *slave_plat;
+	struct mxic_spi_priv *priv;
+	u32 sts;
+	int ret;
+
+	slave_plat = dev_get_parent_plat(desc->slave->dev);
+	priv = dev_get_priv(desc->slave->dev->parent);
+	if (desc->info.offset + offs + len > U32_MAX)
+		return -EINVAL;
+
+	writel(mxic_spi_prep_hc_cfg(desc->slave), priv->regs + HC_CFG);
+	writel(mxic_spi_mem_prep_op_cfg(&desc->info.op_tmpl),
+	       priv->regs + LRD_CFG);
+	writel(desc->info.offset + offs, priv->regs + LRD_ADDR);
+	len = min_t(size_t, len, priv->linear_size);
+	writel(len, priv->regs + LRD_RANGE);
+	writel(LMODE_CMD0(desc->info.op_tmpl.cmd.opcode) |
+	       LMODE_SLV_ACT(slave_plat->cs[0]) | LMODE_EN,
+	       priv->regs + LRD_CTRL);
+
+	memcpy_fromio(buf, priv->linear_map, len);
+
+	writel(INT_LRD_DIS, priv->regs + INT_STS);
+	writel(0, priv->regs + LRD_CTRL);
+
+	ret = readl_poll_timeout(priv->regs + INT_STS, sts,
+				 sts & INT_LRD_DIS, 1000000);
+	if (ret)
+		return ret;
+
+	return len;
+}
+
 static const struct spi_controller_mem_ops mxic_spi_mem_ops = {
 	.supports_op = mxic_spi_mem_supports_op,
 	.exec_op = mxic_spi_mem_exec_op,
+	.dirmap_create = mxic_spi_mem_dirmap_create,
+	.dirmap_read = mxic_spi_mem_dirmap_read,
 };
 
 static int mxic_spi_claim_bus(struct udevice *dev)
@@ -506,9 +600,15 @@ static int mxic_spi_xfer(struct udevice *dev, unsigned int bitlen,
 static int mxic_spi_probe(struct udevice *bus)
 {
 	struct mxic_spi_priv *priv = dev_get_priv(bus);
+	fdt_addr_t addr;
 
 	priv->regs = dev_read_addr_ptr(bus);
 
+	/* The optional window for linear reads, used for direct mapping */
+	addr = dev_read_addr_size_name(bus, "dirmap", &priv->linear_size);
+	if (addr != FDT_ADDR_T_NONE && priv->linear_size)
+		priv->linear_map = map_sysmem(addr, priv->linear_size);
+
 	priv->send_clk = devm_clk_get(bus, "send_clk");
 	if (IS_ERR(priv->send_clk))
 		return PTR_ERR(priv->send_clk);
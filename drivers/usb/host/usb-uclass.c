@@ -9,11 +9,14 @@
 #define LOG_CATEGORY UCLASS_USB
 
 #include <bootdev.h>
+#include <cyclic.h>
 #include <dm.h>
 #include <errno.h>
 #include <log.h>
+#include <malloc.h>
 #include <memalign.h>
 #include <usb.h>
+#include <uthread.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
@@ -221,25 +224,106 @@ int usb_stop(void)
 	return err;
 }
 
+/* Show the result of scanning a bus */
+static void usb_show_scan(struct udevice *bus, int ret)
+{
+	struct usb_bus_priv *priv = dev_get_uclass_priv(bus);
+
+	if (ret)
+		printf("failed, error %d\n", ret);
+	else if (priv->next_addr == 0)
+		printf("No USB Device found\n");
+	else
+		printf("%d USB Device(s) found\n", priv->next_addr);
+}
+
 static void usb_scan_bus(struct udevice *bus, bool recurse)
 {
-	struct usb_bus_priv *priv;
 	struct udevice *dev;
 	int ret;
 
-	priv = dev_get_uclass_priv(bus);
-
 	assert(recurse);	/* TODO: Support non-recusive */
 
 	printf("scanning bus %s for devices... ", bus->name);
 	debug("\n");
 	ret = usb_scan_device(bus, 0, USB_SPEED_FULL, &dev);
-	if (ret)
-		printf("failed, error %d\n", ret);
-	else if (priv->next_addr == 0)
-		printf("No USB Device found\n");
-	else
-		printf("%d USB Device(s) found\n", priv->next_addr);
+	usb_show_scan(bus, ret);
+}
+
+/**
+ * struct usb_bus_scan - a bus being scanned in its own uthread
+ *
+ * @bus: USB controller to scan
+ * @ret: Result of scanning it
+ */
+struct usb_bus_scan {
+	struct udevice *bus;
+	int ret;
+};
+
+static void usb_scan_bus_thread(void *arg)
+{
+	struct usb_bus_scan *scan = arg;
+	struct udevice *dev;
+
+	scan->ret = usb_scan_device(scan->bus, 0, USB_SPEED_FULL, &dev);
+}
+
+/* Check whether @bus is active and is (or is not) a companion controller */
+static bool usb_bus_to_scan(struct udevice *bus, bool companion)
+{
+	struct usb_bus_priv *priv = dev_get_uclass_priv(bus);
+
+	return device_active(bus) && priv->companion == companion;
+}
+
+/*
+ * Scan the active primary buses, or the companion buses if @companion is
+ * true. With USB_UTHREAD each bus is scanned in its own thread, so that the
+ * waits for ports to power up and reset overlap. The results are shown
+ * afterwards, in bus order.
+ */
+static void usb_scan_buses(struct uclass *uc, bool companion)
+{
+	struct usb_bus_scan *scans = NULL;
+	struct udevice *bus;
+	int count = 0, i;
+	uint grp_id;
+
+	if (CONFIG_IS_ENABLED(USB_UTHREAD)) {
+		uclass_foreach_dev(bus, uc) {
+			if (usb_bus_to_scan(bus, companion))
+				count++;
+		}
+		if (count > 1)
+			scans = calloc(count, sizeof(*scans));
+	}
+	if (!scans) {
+		uclass_foreach_dev(bus, uc) {
+			if (usb_bus_to_scan(bus, companion))
+				usb_scan_bus(bus, true);
+		}
+		return;
+	}
+
+	grp_id = uthread_grp_new_id();
+	i = 0;
+	uclass_foreach_dev(bus, uc) {
+		if (!usb_bus_to_scan(bus, companion))
+			continue;
+		scans[i].bus = bus;
+		if (uthread_create(NULL, usb_scan_bus_thread, &scans[i], 0,
+				   grp_id))
+			usb_scan_bus_thread(&scans[i]);
+		i++;
+	}
+	uthread_grp_wait(grp_id);
+
+	for (i = 0; i < count; i++) {
+		printf("scanning bus %s for devices... ", scans[i].bus->name);
+		usb_show_scan(scans[i].bus, scans[i].ret);
+	}
+	free(scans);
 }
 
 static void remove_inactive_children(struct uclass *uc, struct udevice *bus)
@@ -291,7 +375,6 @@ int usb_init(void)
 {
 	int controllers_initialized = 0;
 	struct usb_uclass_priv *uc_priv;
-	struct usb_bus_priv *priv;
 	struct udevice *bus;
 	struct uclass *uc;
 	int ret;
@@ -350,30 +433,15 @@ int usb_init(void)
 	 * lowlevel init done, now scan the bus for devices i.e. search HUBs
 	 * and configure them, first scan primary controllers.
 	 */
-	uclass_foreach_dev(bus, uc) {
-		if (!device_active(bus))
-			continue;
-
-		priv = dev_get_uclass_priv(bus);
-		if (!priv->companion)
-			usb_scan_bus(bus, true);
-	}
+	usb_scan_buses(uc, false);
 
 	/*
 	 * Now that the primary controllers have been scanned and have handed
 	 * over any devices they do not understand to their companions, scan
 	 * the companions if necessary.
 	 */
-	if (uc_priv->companion_device_count) {
-		uclass_foreach_dev(bus, uc) {
-			if (!device_active(bus))
-				continue;
-
-			priv = dev_get_uclass_priv(bus);
-			if (priv->companion)
-				usb_scan_bus(bus, true);
-		}
-	}
+	if (uc_priv->companion_device_count)
+		usb_scan_buses(uc, true);
 
 	debug("scan end\n");
 
@@ -851,11 +919,29 @@ int usb_child_pre_probe(struct udevice *dev)
 	return 0;
 }
 
+static int usb_pre_probe(struct udevice *bus)
+{
+	struct usb_bus_priv *priv = dev_get_uclass_priv(bus);
+
+	INIT_LIST_HEAD(&priv->scan_list);
+
+	return 0;
+}
+
+#if CONFIG_IS_ENABLED(CYCLIC_JOBS)
+CYCLIC_JOB(usb) = {
+	.name		= "usb",
+	.uclass		= UCLASS_USB,
+	.func		= usb_init,
+};
+#endif
+
 UCLASS_DRIVER(usb) = {
 	.id		= UCLASS_USB,
 	.name		= "usb",
 	.flags		= DM_UC_FLAG_SEQ_ALIAS,
 	.post_bind	= dm_scan_fdt_dev,
+	.pre_probe	= usb_pre_probe,
 	.priv_auto	= sizeof(struct usb_uclass_priv),
 	.per_child_auto	= sizeof(struct usb_device),
 	.per_device_auto	= sizeof(struct usb_bus_priv),
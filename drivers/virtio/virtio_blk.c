@@ -12,14 +12,82 @@
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
+#include <linux/sizes.h>
 #include "virtio_blk.h"
 
+/* Maximum number of requests accepted at once */
+#define VIRTIO_BLK_MAX_REQS	16
+/* Maximum number of descriptor chains in flight at once */
+#define VIRTIO_BLK_MAX_CHAINS	16
+/* Maximum number of data segments in one chain */
+#define VIRTIO_BLK_MAX_SEGS	32
+/*
+ * Largest transfer placed in one chain, so that a large read is split into
+ * several chains which the device can work on together
+ */
+#define VIRTIO_BLK_CHAIN_SIZE	SZ_256K
+
+/**
+ * struct virtio_blk_io - a request being split into descriptor chains
+ *
+ * @req: Request, or NULL if this record is free
+ * @type: VIRTIO_BLK_T_... type of the request
+ * @next: Next block of the request to add to the virtqueue, relative to its
+ *	start
+ * @chains: Number of chains of this request in flight
+ * @err: First error seen, or 0 if none
+ */
+struct virtio_blk_io {
+	struct blk_req *req;
+	u32 type;
+	lbaint_t next;
+	int chains;
+	int err;
+};
+
+/**
+ * struct virtio_blk_chain - a descriptor chain in the virtqueue
+ *
+ * The headers and status must stay in place until the device has finished
+ * with the chain, so each chain in flight has a slot.
+ *
+ * @out_hdr: Request header
+ * @wz_hdr: Write-zeroes header, used for erase
+ * @status: Status written by the device
+ * @io: Request this chain belongs to, or NULL if the slot is free
+ */
+struct virtio_blk_chain {
+	struct virtio_blk_outhdr out_hdr;
+	struct virtio_blk_discard_write_zeroes wz_hdr;
+	u8 status;
+	struct virtio_blk_io *io;
+};
+
+/**
+ * struct virtio_blk_priv - private data for a virtio-blk device
+ *
+ * @vq: Request virtqueue
+ * @ios: Requests accepted and not yet completed
+ * @chains: Descriptor chains
+ * @inflight: Number of chains in flight
+ * @seg_blks: Largest number of blocks in one data segment
+ * @stats: Request statistics; this also holds the chain limits
+ */
 struct virtio_blk_priv {
 	struct virtqueue *vq;
+	struct virtio_blk_io ios[VIRTIO_BLK_MAX_REQS];
+	struct virtio_blk_chain chains[VIRTIO_BLK_MAX_CHAINS];
+	int inflight;
+	uint seg_blks;
+	struct virtio_blk_stats stats;
 };
 
 static const u32 feature[] = {
-	VIRTIO_BLK_F_WRITE_ZEROES
+	VIRTIO_BLK_F_SIZE_MAX,
+	VIRTIO_BLK_F_SEG_MAX,
+	VIRTIO_BLK_F_WRITE_ZEROES,
+	VIRTIO_RING_F_INDIRECT_DESC,
+	VIRTIO_RING_F_EVENT_IDX,
 };
 
 static void virtio_blk_init_header_sg(struct udevice *dev, u64 sector, u32 type,
@@ -59,57 +127,216 @@ static void virtio_blk_init_data_sg(void *buffer, lbaint_t blkcnt, struct virtio
 	sg->length = blkcnt * 512;
 }
 
-static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
-			       lbaint_t blkcnt, void *buffer, u32 type)
+/**
+ * virtio_blk_add_chain() - add the next part of a request to the virtqueue
+ *
+ * The part covers as many blocks as fit in one chain, each data segment
+ * being no larger than the device allows. The device is not notified.
+ *
+ * @dev:	Block device
+ * @io:		Request to add
+ * Return: 0 if OK, -EBUSY if there is no room until a chain completes
+ */
+static int virtio_blk_add_chain(struct udevice *dev, struct virtio_blk_io *io)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
-	struct virtio_blk_outhdr out_hdr;
-	struct virtio_blk_discard_write_zeroes wz_hdr;
+	struct virtio_sg hdr_sg, wz_sg, status_sg;
+	struct virtio_sg data_sg[VIRTIO_BLK_MAX_SEGS];
+	struct virtio_sg *sgs[VIRTIO_BLK_MAX_SEGS + 2];
+	struct virtio_blk_chain *chain = NULL;
+	struct blk_req *req = io->req;
 	unsigned int num_out = 0, num_in = 0;
-	struct virtio_sg hdr_sg, wz_sg, data_sg, status_sg;
-	struct virtio_sg *sgs[3];
-	u8 status;
-	int ret;
+	lbaint_t blkcnt, done, count;
+	int ret, i;
+
+	for (i = 0; i < VIRTIO_BLK_MAX_CHAINS; i++) {
+		if (!priv->chains[i].io) {
+			chain = &priv->chains[i];
+			break;
+		}
+	}
+	if (!chain)
+		return -EBUSY;
 
-	virtio_blk_init_header_sg(dev, sector, type, &out_hdr, &hdr_sg);
+	virtio_blk_init_header_sg(dev, req->start + io->next, io->type,
+				  &chain->out_hdr, &hdr_sg);
 	sgs[num_out++] = &hdr_sg;
 
-	switch (type) {
-	case VIRTIO_BLK_T_IN:
-	case VIRTIO_BLK_T_OUT:
-		virtio_blk_init_data_sg(buffer, blkcnt, &data_sg);
-		if (type & VIRTIO_BLK_T_OUT)
-			sgs[num_out++] = &data_sg;
-		else
-			sgs[num_out + num_in++] = &data_sg;
-		break;
-
-	case VIRTIO_BLK_T_WRITE_ZEROES:
-		virtio_blk_init_write_zeroes_sg(dev, sector, blkcnt, &wz_hdr, &wz_sg);
+	if (io->type == VIRTIO_BLK_T_WRITE_ZEROES) {
+		blkcnt = req->blkcnt;
+		virtio_blk_init_write_zeroes_sg(dev, req->start, blkcnt,
+						&chain->wz_hdr, &wz_sg);
 		sgs[num_out++] = &wz_sg;
-		break;
-
-	default:
-		return -EINVAL;
+	} else {
+		blkcnt = min_t(lbaint_t, req->blkcnt - io->next,
+			       priv->stats.chain_blks);
+		for (done = 0, i = 0; done < blkcnt; done += count, i++) {
+			count = min_t(lbaint_t, blkcnt - done, priv->seg_blks);
+			virtio_blk_init_data_sg(req->buffer +
+						(io->next + done) * 512,
+						count, &data_sg[i]);
+			if (io->type == VIRTIO_BLK_T_OUT)
+				sgs[num_out++] = &data_sg[i];
+			else
+				sgs[num_out + num_in++] = &data_sg[i];
+		}
 	}
 
-	virtio_blk_init_status_sg(&status, &status_sg);
+	virtio_blk_init_status_sg(&chain->status, &status_sg);
 	sgs[num_out + num_in++] = &status_sg;
-	log_debug("dev=%s, active=%d, priv=%p, priv->vq=%p\n", dev->name,
-		  device_active(dev), priv, priv->vq);
 
+	/*
+	 * Check for room first, since virtqueue_add() notifies the device when
+	 * the ring is full
+	 */
+	if (priv->vq->num_free < (priv->vq->indirect ? 1 : num_out + num_in))
+		return -EBUSY;
 	ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
 	if (ret)
-		return ret;
+		return -EBUSY;
+	chain->io = io;
+	io->chains++;
+	io->next += blkcnt;
+	priv->inflight++;
+	priv->stats.chains++;
+	priv->stats.max_inflight = max_t(uint, priv->stats.max_inflight,
+					 priv->inflight);
+
+	return 0;
+}
+
+/**
+ * virtio_blk_fill() - add as many chains as will fit, then kick the device
+ *
+ * Requests are added in the order of their records, so the device has all
+ * the chains of a request available together where possible. The virtqueue
+ * is kicked once for all of them.
+ *
+ * @dev:	Block device
+ */
+static void virtio_blk_fill(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_io *io;
+	int added = 0;
+	int i;
+
+	for (i = 0; i < VIRTIO_BLK_MAX_REQS; i++) {
+		io = &priv->ios[i];
+		if (!io->req)
+			continue;
+		while (io->next < io->req->blkcnt) {
+			if (virtio_blk_add_chain(dev, io))
+				goto kick;
+			added++;
+		}
+	}
+
+kick:
+	if (added) {
+		log_debug("dev=%s, chains=%d, inflight=%d\n", dev->name, added,
+			  priv->inflight);
+		priv->stats.kicks++;
+		if (virtqueue_kick(priv->vq))
+			priv->stats.notifies++;
+	}
+}
+
+static int virtio_blk_start(struct udevice *dev, struct blk_req *req, u32 type)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_io *io;
+	int i;
+
+	for (i = 0; i < VIRTIO_BLK_MAX_REQS; i++) {
+		io = &priv->ios[i];
+		if (!io->req) {
+			io->req = req;
+			io->type = type;
+			io->next = 0;
+			io->chains = 0;
+			io->err = 0;
+			priv->stats.reqs++;
+			virtio_blk_fill(dev);
+
+			return 0;
+		}
+	}
+
+	return -EBUSY;
+}
+
+static int virtio_blk_poll(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_outhdr *hdr;
+	struct virtio_blk_chain *chain;
+	struct virtio_blk_io *io;
+	struct blk_req *req;
+	int i, count;
+
+	while ((hdr = virtqueue_get_buf(priv->vq, NULL))) {
+		chain = container_of(hdr, struct virtio_blk_chain, out_hdr);
+		if (chain < priv->chains ||
+		    chain >= priv->chains + VIRTIO_BLK_MAX_CHAINS ||
+		    !chain->io) {
+			log_err("%s: unexpected buffer %p\n", dev->name, hdr);
+			continue;
+		}
+		io = chain->io;
+		chain->io = NULL;
+		priv->inflight--;
+		io->chains--;
+		if (chain->status != VIRTIO_BLK_S_OK && !io->err)
+			io->err = -EIO;
+		if (io->chains || io->next < io->req->blkcnt)
+			continue;
+
+		/* The record may be reused by the completion callback */
+		req = io->req;
+		io->req = NULL;
+		blk_req_complete(req, io->err ? io->err : req->blkcnt);
+	}
 
-	virtqueue_kick(priv->vq);
+	/* Chains have completed, so there may be room for more */
+	virtio_blk_fill(dev);
+
+	for (i = 0, count = 0; i < VIRTIO_BLK_MAX_REQS; i++) {
+		if (priv->ios[i].req)
+			count++;
+	}
+
+	return count;
+}
+
+static int virtio_blk_submit(struct udevice *dev, struct blk_req *req)
+{
+	return virtio_blk_start(dev, req, req->op == BLK_REQ_READ ?
+				VIRTIO_BLK_T_IN : VIRTIO_BLK_T_OUT);
+}
+
+static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
+			       lbaint_t blkcnt, void *buffer, u32 type)
+{
+	struct blk_req req = {
+		.start	= sector,
+		.blkcnt	= blkcnt,
+		.buffer	= buffer,
+	};
+
+	if (!blkcnt)
+		return 0;
+
+	/* Wait for a free record if asynchronous requests fill them all */
+	while (virtio_blk_start(dev, &req, type) == -EBUSY)
+		virtio_blk_poll(dev);
 
 	log_debug("wait...");
-	while (!virtqueue_get_buf(priv->vq, NULL))
-		;
+	while (!req.complete)
+		virtio_blk_poll(dev);
 	log_debug("done\n");
 
-	return status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
+	return req.result;
 }
 
 static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
@@ -136,6 +363,18 @@ static ulong virtio_blk_erase(struct udevice *dev, lbaint_t start,
 	return virtio_blk_do_req(dev, start, blkcnt, NULL, VIRTIO_BLK_T_WRITE_ZEROES);
 }
 
+int virtio_blk_get_stats(struct udevice *dev, struct virtio_blk_stats *stats)
+{
+	struct virtio_blk_priv *priv;
+
+	if (dev->driver != DM_DRIVER_GET(virtio_blk))
+		return -ENOSYS;
+	priv = dev_get_priv(dev);
+	*stats = priv->stats;
+
+	return 0;
+}
+
 static int virtio_blk_bind(struct udevice *dev)
 {
 	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(dev->parent);
@@ -175,6 +414,8 @@ static int virtio_blk_probe(struct udevice *dev)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	struct virtio_blk_stats *stats = &priv->stats;
+	u32 seg_max, size_max;
 	u64 cap;
 	int ret;
 
@@ -187,13 +428,66 @@ static int virtio_blk_probe(struct udevice *dev)
 	virtio_cread(dev, struct virtio_blk_config, capacity, &cap);
 	desc->lba = cap;
 
+	/* Without SEG_MAX the device takes one data segment per chain */
+	if (virtio_cread_feature(dev, VIRTIO_BLK_F_SEG_MAX,
+				 struct virtio_blk_config, seg_max, &seg_max) ||
+	    !seg_max)
+		seg_max = 1;
+	if (virtio_cread_feature(dev, VIRTIO_BLK_F_SIZE_MAX,
+				 struct virtio_blk_config, size_max,
+				 &size_max) || size_max < 512)
+		size_max = VIRTIO_BLK_CHAIN_SIZE;
+
+	stats->indirect = priv->vq->indirect;
+	stats->event_idx = virtio_has_feature(dev, VIRTIO_RING_F_EVENT_IDX);
+
+	/* Each chain also needs a header and status descriptor */
+	BUILD_BUG_ON(VIRTIO_BLK_MAX_SEGS + 2 > VRING_INDIRECT_MAX);
+	stats->seg_max = min(seg_max, (u32)VIRTIO_BLK_MAX_SEGS);
+	if (!stats->indirect)
+		stats->seg_max = min(stats->seg_max,
+				     virtqueue_get_vring_size(priv->vq) - 2);
+	priv->seg_blks = min(size_max, (u32)VIRTIO_BLK_CHAIN_SIZE) / 512;
+	stats->chain_blks = min(stats->seg_max * priv->seg_blks,
+				(uint)VIRTIO_BLK_CHAIN_SIZE / 512);
+	log_debug("%s: seg_max %u, seg_blks %u, chain_blks %u, indirect %d\n",
+		  dev->name, stats->seg_max, priv->seg_blks, stats->chain_blks,
+		  stats->indirect);
+
 	return 0;
 }
 
+static int virtio_blk_remove(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct blk_req *req;
+	int ret, i;
+
+	for (i = 0; i < VIRTIO_BLK_MAX_CHAINS; i++)
+		priv->chains[i].io = NULL;
+	priv->inflight = 0;
+	for (i = 0; i < VIRTIO_BLK_MAX_REQS; i++) {
+		req = priv->ios[i].req;
+		if (req) {
+			priv->ios[i].req = NULL;
+			blk_req_complete(req, -ENODEV);
+		}
+	}
+
+	ret = virtio_reset(dev);
+	if (ret)
+		return ret;
+
+	/* The virtqueue is set up again if the device is probed */
+	return virtio_del_vqs(dev);
+}
+
 static const struct blk_ops virtio_blk_ops = {
 	.read	= virtio_blk_read,
 	.write	= virtio_blk_write,
 	.erase	= virtio_blk_erase,
+	.submit	= virtio_blk_submit,
+	.poll	= virtio_blk_poll,
 };
 
 U_BOOT_DRIVER(virtio_blk) = {
@@ -202,7 +496,7 @@ U_BOOT_DRIVER(virtio_blk) = {
 	.ops	= &virtio_blk_ops,
 	.bind	= virtio_blk_bind,
 	.probe	= virtio_blk_probe,
-	.remove	= virtio_reset,
+	.remove	= virtio_blk_remove,
 	.priv_auto	= sizeof(struct virtio_blk_priv),
 	.flags	= DM_FLAG_ACTIVE_DMA,
 };
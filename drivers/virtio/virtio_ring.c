@@ -95,12 +95,47 @@ static void virtqueue_detach_desc(struct virtqueue *vq, unsigned int idx)
 	bb = &vq->vring.bouncebufs[idx];
 	bounce_buffer_stop(bb);
 	desc->addr = cpu_to_virtio64(vq->vdev, (u64)(uintptr_t)bb->user_buffer);
+	/* virtqueue_get_buf() returns the caller's buffer, not the bounce */
+	vq->vring_desc_shadow[idx].addr = (u64)(uintptr_t)bb->user_buffer;
+}
+
+/*
+ * Fill in the indirect table for a chain starting at descriptor @head,
+ * returning NULL if the chain is too long, in which case it is put in the
+ * ring directly
+ */
+static struct vring_desc *virtqueue_fill_indirect(struct virtqueue *vq,
+						  unsigned int head,
+						  struct virtio_sg *sgs[],
+						  unsigned int out_sgs,
+						  unsigned int total)
+{
+	struct vring_desc *table;
+	unsigned int n;
+	u16 flags;
+
+	if (total > VRING_INDIRECT_MAX)
+		return NULL;
+	table = vq->indir_tables + head * VRING_INDIRECT_MAX;
+
+	for (n = 0; n < total; n++) {
+		flags = n + 1 < total ? VRING_DESC_F_NEXT : 0;
+		if (n >= out_sgs)
+			flags |= VRING_DESC_F_WRITE;
+		table[n].addr = cpu_to_virtio64(vq->vdev,
+						(u64)(uintptr_t)sgs[n]->addr);
+		table[n].len = cpu_to_virtio32(vq->vdev, sgs[n]->length);
+		table[n].flags = cpu_to_virtio16(vq->vdev, flags);
+		table[n].next = cpu_to_virtio16(vq->vdev, n + 1);
+	}
+
+	return table;
 }
 
 int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 		  unsigned int out_sgs, unsigned int in_sgs)
 {
-	struct vring_desc *desc;
+	struct vring_desc *desc, *indir = NULL;
 	unsigned int descs_used = out_sgs + in_sgs;
 	unsigned int i, n, avail, uninitialized_var(prev);
 	int head;
@@ -112,6 +147,13 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 	desc = vq->vring.desc;
 	i = head;
 
+	if (vq->indirect && descs_used > 1) {
+		indir = virtqueue_fill_indirect(vq, head, sgs, out_sgs,
+						descs_used);
+		if (indir)
+			descs_used = 1;
+	}
+
 	if (vq->num_free < descs_used) {
 		debug("Can't add buf len %i - avail = %i\n",
 		      descs_used, vq->num_free);
@@ -125,13 +167,24 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 		return -ENOSPC;
 	}
 
-	for (n = 0; n < descs_used; n++) {
-		u16 flags = VRING_DESC_F_NEXT;
+	if (indir) {
+		struct virtio_sg sg = {
+			.addr	= indir,
+			.length	= (out_sgs + in_sgs) * sizeof(*indir),
+		};
 
-		if (n >= out_sgs)
-			flags |= VRING_DESC_F_WRITE;
 		prev = i;
-		i = virtqueue_attach_desc(vq, i, sgs[n], flags);
+		i = virtqueue_attach_desc(vq, i, &sg, VRING_DESC_F_INDIRECT |
+					  VRING_DESC_F_NEXT);
+	} else {
+		for (n = 0; n < descs_used; n++) {
+			u16 flags = VRING_DESC_F_NEXT;
+
+			if (n >= out_sgs)
+				flags |= VRING_DESC_F_WRITE;
+			prev = i;
+			i = virtqueue_attach_desc(vq, i, sgs[n], flags);
+		}
 	}
 	/* Last one doesn't continue */
 	vq->vring_desc_shadow[prev].flags &= ~VRING_DESC_F_NEXT;
@@ -145,6 +198,7 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 
 	/* Mark the descriptor as the head of a chain. */
 	vq->vring_desc_shadow[head].chain_head = true;
+	vq->vring_desc_shadow[head].indir = indir;
 
 	/*
 	 * Put entry in available array (but don't update avail->idx
@@ -198,10 +252,13 @@ static bool virtqueue_kick_prepare(struct virtqueue *vq)
 	return needs_kick;
 }
 
-void virtqueue_kick(struct virtqueue *vq)
+bool virtqueue_kick(struct virtqueue *vq)
 {
-	if (virtqueue_kick_prepare(vq))
-		virtio_notify(vq->vdev, vq);
+	if (!virtqueue_kick_prepare(vq))
+		return false;
+	virtio_notify(vq->vdev, vq);
+
+	return true;
 }
 
 static void detach_buf(struct virtqueue *vq, unsigned int head)
@@ -210,6 +267,7 @@ static void detach_buf(struct virtqueue *vq, unsigned int head)
 
 	/* Unmark the descriptor as the head of a chain. */
 	vq->vring_desc_shadow[head].chain_head = false;
+	vq->vring_desc_shadow[head].indir = NULL;
 
 	/* Put back on free list: unmap first-level descriptors and find end */
 	i = head;
@@ -236,8 +294,10 @@ static inline bool more_used(const struct virtqueue *vq)
 
 void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 {
+	struct vring_desc *indir;
 	unsigned int i;
 	u16 last_used;
+	void *buf;
 
 	if (!more_used(vq)) {
 		debug("(%s.%d): No more buffers in queue\n",
@@ -269,6 +329,13 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 		return NULL;
 	}
 
+	/* Return the first buffer of the chain, not the indirect table */
+	indir = vq->vring_desc_shadow[i].indir;
+	if (indir)
+		buf = (void *)(uintptr_t)virtio64_to_cpu(vq->vdev, indir[0].addr);
+	else
+		buf = (void *)(uintptr_t)vq->vring_desc_shadow[i].addr;
+
 	detach_buf(vq, i);
 	vq->last_used_idx++;
 	/*
@@ -280,7 +347,7 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 		virtio_store_mb(&vring_used_event(&vq->vring),
 				cpu_to_virtio16(vq->vdev, vq->last_used_idx));
 
-	return (void *)(uintptr_t)vq->vring_desc_shadow[i].addr;
+	return buf;
 }
 
 static struct virtqueue *__vring_new_virtqueue(unsigned int index,
@@ -315,6 +382,15 @@ static struct virtqueue *__vring_new_virtqueue(unsigned int index,
 	list_add_tail(&vq->list, &uc_priv->vqs);
 
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) &&
+		!vring.bouncebufs;
+	vq->indir_tables = NULL;
+	if (vq->indirect) {
+		vq->indir_tables = malloc(vring.num * VRING_INDIRECT_MAX *
+					  sizeof(struct vring_desc));
+		if (!vq->indir_tables)
+			vq->indirect = false;
+	}
 
 	/* Tell other side not to bother us */
 	vq->avail_flags_shadow |= VRING_AVAIL_F_NO_INTERRUPT;
@@ -397,6 +473,7 @@ void vring_del_virtqueue(struct virtqueue *vq)
 	virtio_free_pages(vq->vdev, vq->vring.desc,
 			  DIV_ROUND_UP(vq->vring.size, PAGE_SIZE));
 	free(vq->vring_desc_shadow);
+	free(vq->indir_tables);
 	list_del(&vq->list);
 	free(vq->vring.bouncebufs);
 	free(vq);
@@ -6,14 +6,33 @@
  */
 
 #include <dm.h>
+#include <malloc.h>
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
+#include <asm/test.h>
 #include <linux/bug.h>
 #include <linux/compat.h>
 #include <linux/err.h>
 #include <linux/io.h>
+#include <linux/sizes.h>
+#include "virtio_blk.h"
 
+/* Longest descriptor chain handled by the block-device emulation */
+#define SANDBOX_BLK_MAX_DESCS	64
+
+/**
+ * struct virtio_sandbox_priv - private data for the sandbox transport
+ *
+ * The blk_... members are only used when emulating a block device
+ *
+ * @blk_config: Configuration space of the block device
+ * @blk_disk: Disk contents, or NULL if there is no disk
+ * @blk_last_avail: Next entry in the available ring to process
+ * @blk_notifies: Number of times the driver notified the device
+ * @blk_chains: Number of descriptor chains processed
+ * @blk_indirect: Number of those chains which were indirect
+ */
 struct virtio_sandbox_priv {
 	u8 id;
 	u8 status;
@@ -22,11 +41,32 @@ struct virtio_sandbox_priv {
 	ulong queue_desc;
 	ulong queue_available;
 	ulong queue_used;
+	struct virtio_blk_config blk_config;
+	u8 *blk_disk;
+	u16 blk_last_avail;
+	ulong blk_notifies;
+	ulong blk_chains;
+	ulong blk_indirect;
 };
 
+static bool virtio_sandbox_is_blk(struct udevice *udev)
+{
+	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(udev);
+
+	return uc_priv->device == VIRTIO_ID_BLOCK;
+}
+
 static int virtio_sandbox_get_config(struct udevice *udev, unsigned int offset,
 				     void *buf, unsigned int len)
 {
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+
+	if (!virtio_sandbox_is_blk(udev))
+		return 0;
+	if (offset + len > sizeof(priv->blk_config))
+		return -EINVAL;
+	memcpy(buf, (void *)&priv->blk_config + offset, len);
+
 	return 0;
 }
 
@@ -103,6 +143,7 @@ static struct virtqueue *virtio_sandbox_setup_vq(struct udevice *udev,
 
 	addr = virtqueue_get_desc_addr(vq);
 	priv->queue_desc = addr;
+	priv->blk_last_avail = 0;
 
 	addr = virtqueue_get_avail_addr(vq);
 	priv->queue_available = addr;
@@ -148,11 +189,178 @@ static int virtio_sandbox_find_vqs(struct udevice *udev, unsigned int nvqs,
 	return 0;
 }
 
+/* Check that a request lies within the disk */
+static bool virtio_sandbox_blk_valid(struct virtio_sandbox_priv *priv,
+				     u64 sector, u64 len)
+{
+	u64 capacity = __virtio64_to_cpu(true, priv->blk_config.capacity);
+
+	return priv->blk_disk && sector <= capacity &&
+		len <= (capacity - sector) * 512;
+}
+
+/**
+ * virtio_sandbox_blk_chain() - carry out the request in a descriptor chain
+ *
+ * @priv:	Transport private data
+ * @vdev:	virtio device, used for byte-order conversion
+ * @vr:		Ring holding the chain
+ * @head:	Index of the first descriptor in the chain
+ * Return: number of bytes written to the chain's buffers
+ */
+static u32 virtio_sandbox_blk_chain(struct virtio_sandbox_priv *priv,
+				    struct udevice *vdev, struct vring *vr,
+				    uint head)
+{
+	struct vring_desc *descs[SANDBOX_BLK_MAX_DESCS];
+	struct vring_desc *table = vr->desc;
+	struct virtio_blk_discard_write_zeroes *wz;
+	struct virtio_blk_outhdr *hdr;
+	uint num = vr->num, i = head;
+	u32 type, len, written = 0;
+	int count, n;
+	u8 status;
+	u64 sector;
+	void *buf;
+
+	if (virtio16_to_cpu(vdev, table[i].flags) & VRING_DESC_F_INDIRECT) {
+		num = virtio32_to_cpu(vdev, table[i].len) / sizeof(*table);
+		table = (void *)(uintptr_t)virtio64_to_cpu(vdev, table[i].addr);
+		i = 0;
+		priv->blk_indirect++;
+	}
+	priv->blk_chains++;
+
+	for (count = 0; count < SANDBOX_BLK_MAX_DESCS;) {
+		if (i >= num)
+			return 0;
+		descs[count++] = &table[i];
+		if (!(virtio16_to_cpu(vdev, table[i].flags) & VRING_DESC_F_NEXT))
+			break;
+		i = virtio16_to_cpu(vdev, table[i].next);
+	}
+	if (count < 2)
+		return 0;
+
+	hdr = (void *)(uintptr_t)virtio64_to_cpu(vdev, descs[0]->addr);
+	type = virtio32_to_cpu(vdev, hdr->type);
+	sector = virtio64_to_cpu(vdev, hdr->sector);
+	status = VIRTIO_BLK_S_OK;
+	for (n = 1; n < count - 1; n++) {
+		buf = (void *)(uintptr_t)virtio64_to_cpu(vdev, descs[n]->addr);
+		len = virtio32_to_cpu(vdev, descs[n]->len);
+		switch (type) {
+		case VIRTIO_BLK_T_IN:
+			if (!virtio_sandbox_blk_valid(priv, sector, len)) {
+				status = VIRTIO_BLK_S_IOERR;
+				break;
+			}
+			memcpy(buf, priv->blk_disk + sector * 512, len);
+			written += len;
+			break;
+		case VIRTIO_BLK_T_OUT:
+			if (!virtio_sandbox_blk_valid(priv, sector, len)) {
+				status = VIRTIO_BLK_S_IOERR;
+				break;
+			}
+			memcpy(priv->blk_disk + sector * 512, buf, len);
+			break;
+		case VIRTIO_BLK_T_WRITE_ZEROES:
+			wz = buf;
+			sector = virtio64_to_cpu(vdev, wz->sector);
+			len = virtio32_to_cpu(vdev, wz->num_sectors);
+			if (!virtio_sandbox_blk_valid(priv, sector,
+						      (u64)len * 512)) {
+				status = VIRTIO_BLK_S_IOERR;
+				break;
+			}
+			memset(priv->blk_disk + sector * 512, '\0',
+			       (u64)len * 512);
+			break;
+		default:
+			status = VIRTIO_BLK_S_UNSUPP;
+			break;
+		}
+		sector += len / 512;
+	}
+
+	buf = (void *)(uintptr_t)virtio64_to_cpu(vdev, descs[count - 1]->addr);
+	*(u8 *)buf = status;
+
+	return written + 1;
+}
+
 static int virtio_sandbox_notify(struct udevice *udev, struct virtqueue *vq)
 {
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+	struct udevice *vdev = vq->vdev;
+	struct vring *vr = &vq->vring;
+	struct vring_used_elem *elem;
+	u16 avail_idx, used_idx;
+	uint head;
+
+	if (!virtio_sandbox_is_blk(udev))
+		return 0;
+
+	/* Process the new chains straight away, like a very fast device */
+	priv->blk_notifies++;
+	avail_idx = virtio16_to_cpu(vdev, vr->avail->idx);
+	used_idx = virtio16_to_cpu(vdev, vr->used->idx);
+	while (priv->blk_last_avail != avail_idx) {
+		head = virtio16_to_cpu(vdev, vr->avail->ring[priv->blk_last_avail &
+							     (vr->num - 1)]);
+		elem = &vr->used->ring[used_idx & (vr->num - 1)];
+		elem->len = cpu_to_virtio32(vdev, virtio_sandbox_blk_chain(priv,
+							vdev, vr, head));
+		elem->id = cpu_to_virtio32(vdev, head);
+		used_idx++;
+		priv->blk_last_avail++;
+	}
+	vr->used->idx = cpu_to_virtio16(vdev, used_idx);
+
+	/* Ask to be notified when anything more is added */
+	vring_avail_event(vr) = cpu_to_virtio16(vdev, priv->blk_last_avail);
+
 	return 0;
 }
 
+int sandbox_virtio_blk_setup(struct udevice *udev, ulong blocks, uint seg_max,
+			     uint size_max, bool indirect)
+{
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+	struct virtio_blk_config *config = &priv->blk_config;
+
+	free(priv->blk_disk);
+	priv->blk_disk = NULL;
+	if (blocks) {
+		priv->blk_disk = calloc(blocks, 512);
+		if (!priv->blk_disk)
+			return -ENOMEM;
+	}
+	config->capacity = __cpu_to_virtio64(true, blocks);
+	config->seg_max = __cpu_to_virtio32(true, seg_max);
+	config->size_max = __cpu_to_virtio32(true, size_max);
+	if (indirect)
+		priv->device_features |= BIT_ULL(VIRTIO_RING_F_INDIRECT_DESC);
+	else
+		priv->device_features &= ~BIT_ULL(VIRTIO_RING_F_INDIRECT_DESC);
+	priv->blk_notifies = 0;
+	priv->blk_chains = 0;
+	priv->blk_indirect = 0;
+
+	return 0;
+}
+
+void sandbox_virtio_blk_get_counts(struct udevice *udev, ulong *notifiesp,
+				   ulong *chainsp, ulong *indirectp)
+{
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+
+	*notifiesp = priv->blk_notifies;
+	*chainsp = priv->blk_chains;
+	*indirectp = priv->blk_indirect;
+}
+
 static int virtio_sandbox_probe(struct udevice *udev)
 {
 	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
@@ -164,6 +372,26 @@ static int virtio_sandbox_probe(struct udevice *udev)
 					       VIRTIO_ID_RNG);
 	uc_priv->vendor = ('u' << 24) | ('b' << 16) | ('o' << 8) | 't';
 
+	/* The block device starts with a small blank disk */
+	if (virtio_sandbox_is_blk(udev)) {
+		priv->device_features |= BIT_ULL(VIRTIO_BLK_F_SIZE_MAX) |
+			BIT_ULL(VIRTIO_BLK_F_SEG_MAX) |
+			BIT_ULL(VIRTIO_BLK_F_WRITE_ZEROES) |
+			BIT_ULL(VIRTIO_RING_F_EVENT_IDX);
+		return sandbox_virtio_blk_setup(udev, SZ_1M / 512, 8, SZ_64K,
+						true);
+	}
+
+	return 0;
+}
+
+static int virtio_sandbox_remove(struct udevice *udev)
+{
+	struct virtio_sandbox_priv *priv = dev_get_priv(udev);
+
+	free(priv->blk_disk);
+	priv->blk_disk = NULL;
+
 	return 0;
 }
 
@@ -191,6 +419,7 @@ U_BOOT_DRIVER(virtio_sandbox1) = {
 	.of_match = virtio_sandbox1_ids,
 	.ops	= &virtio_sandbox1_ops,
 	.probe	= virtio_sandbox_probe,
+	.remove	= virtio_sandbox_remove,
 	.priv_auto	= sizeof(struct virtio_sandbox_priv),
 };
 
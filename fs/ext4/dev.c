@@ -34,18 +34,33 @@ lbaint_t part_offset;
 
 static struct blk_desc *ext4fs_blk_desc;
 static struct disk_partition *part_info;
+/* Copy of the partition, since the caller's may be reused for another one */
+static struct disk_partition ext4fs_part;
+/* Value of ext4fs_blk_desc->write_gen when the partition was set */
+static uint ext4fs_write_gen;
 
 void ext4fs_set_blk_dev(struct blk_desc *rbdd, struct disk_partition *info)
 {
 	assert(rbdd->blksz == (1 << rbdd->log2blksz));
 	ext4fs_blk_desc = rbdd;
+	ext4fs_write_gen = rbdd->write_gen;
 	get_fs()->dev_desc = rbdd;
-	part_info = info;
+	ext4fs_part = *info;
+	part_info = &ext4fs_part;
 	part_offset = info->start;
 	get_fs()->total_sect = ((uint64_t)info->size * info->blksz) >>
 		get_fs()->dev_desc->log2blksz;
 }
 
+bool ext4fs_is_mounted(struct blk_desc *fs_dev_desc,
+		       struct disk_partition *fs_partition)
+{
+	return ext4fs_root && ext4fs_blk_desc == fs_dev_desc &&
+	       ext4fs_write_gen == fs_dev_desc->write_gen &&
+	       ext4fs_part.start == fs_partition->start &&
+	       ext4fs_part.size == fs_partition->size;
+}
+
 int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len,
 		   char *buffer)
 {
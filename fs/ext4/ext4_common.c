@@ -208,6 +208,9 @@ void put_ext4(uint64_t off, const void *buf, uint32_t size)
 	if (fs->dev_desc == NULL)
 		return;
 
+	/* An extent-tree block may be overwritten */
+	ext4fs_extent_cache_flush();
+
 	if ((startblock + (size >> log2blksz)) >
 	    (part_offset + fs->total_sect)) {
 		printf("part_offset is " LBAFU "\n", part_offset);
@@ -1523,6 +1526,148 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 
 #endif
 
+/* Number of extent-tree blocks kept in memory between lookups */
+#define EXT4_EXTENT_CACHE_SIZE	8
+
+/* Maximum depth of an extent tree */
+#define EXT4_EXTENT_MAX_DEPTH	5
+
+/* Extents longer than this are unwritten, i.e. read as zeroes */
+#define EXT4_EXT_INIT_MAX_LEN	(1 << 15)
+
+/**
+ * struct ext4_extent_cache_ent - an extent-tree block held in memory
+ *
+ * @block: Sector number of the block
+ * @last_used: Value of ext4_extent_cache_tick when the block was last used
+ * @buf: Contents of the block, or NULL if the entry is not in use
+ */
+struct ext4_extent_cache_ent {
+	lbaint_t block;
+	ulong last_used;
+	char *buf;
+};
+
+/*
+ * Index and leaf blocks of extent trees, so that looking up each run of a
+ * file does not read them again. The least-recently used block is replaced.
+ */
+static struct ext4_extent_cache_ent ext4_extent_cache[EXT4_EXTENT_CACHE_SIZE];
+static ulong ext4_extent_cache_tick;
+static int ext4_extent_cache_blksz;
+
+void ext4fs_extent_cache_flush(void)
+{
+	int i;
+
+	for (i = 0; i < EXT4_EXTENT_CACHE_SIZE; i++) {
+		free(ext4_extent_cache[i].buf);
+		ext4_extent_cache[i].buf = NULL;
+	}
+}
+
+static struct ext4_extent_header *ext4fs_extent_cache_read(lbaint_t block,
+							   int blksz)
+{
+	struct ext4_extent_cache_ent *ent, *victim = NULL;
+	int i;
+
+	if (blksz != ext4_extent_cache_blksz) {
+		ext4fs_extent_cache_flush();
+		ext4_extent_cache_blksz = blksz;
+	}
+
+	for (i = 0; i < EXT4_EXTENT_CACHE_SIZE; i++) {
+		ent = &ext4_extent_cache[i];
+		if (ent->buf && ent->block == block) {
+			ent->last_used = ++ext4_extent_cache_tick;
+			return (struct ext4_extent_header *)ent->buf;
+		}
+		if (!victim || !ent->buf ||
+		    (victim->buf && ent->last_used < victim->last_used))
+			victim = ent;
+	}
+
+	if (!victim->buf) {
+		victim->buf = memalign(ARCH_DMA_MINALIGN, blksz);
+		if (!victim->buf)
+			return NULL;
+	}
+	if (!ext4fs_devread(block, 0, blksz, victim->buf)) {
+		free(victim->buf);
+		victim->buf = NULL;
+		return NULL;
+	}
+	victim->block = block;
+	victim->last_used = ++ext4_extent_cache_tick;
+
+	return (struct ext4_extent_header *)victim->buf;
+}
+
+int ext4fs_find_extent(struct ext2_inode *inode, uint32_t fileblock,
+		       struct ext4_extent_run *run)
+{
+	struct ext4_extent_header *ext_block;
+	int blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+			 get_fs()->dev_desc->log2blksz;
+	struct ext4_extent_idx *index;
+	struct ext4_extent *extent;
+	uint64_t end = 1ULL << 32;
+	uint64_t block;
+	uint32_t start, len;
+	int entries, depth, i;
+
+	ext_block = (struct ext4_extent_header *)inode->b.blocks.dir_blocks;
+	for (depth = 0; ; depth++) {
+		if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC ||
+		    depth > EXT4_EXTENT_MAX_DEPTH)
+			return -EINVAL;
+		entries = le16_to_cpu(ext_block->eh_entries);
+		if (!ext_block->eh_depth || !entries)
+			break;
+
+		/* The last index starting at or before the block */
+		index = (struct ext4_extent_idx *)(ext_block + 1);
+		for (i = 0; i + 1 < entries &&
+		     le32_to_cpu(index[i + 1].ei_block) <= fileblock; i++)
+			;
+		if (i + 1 < entries)
+			end = le32_to_cpu(index[i + 1].ei_block);
+
+		block = le16_to_cpu(index[i].ei_leaf_hi);
+		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
+		ext_block = ext4fs_extent_cache_read(block << log2_blksz, blksz);
+		if (!ext_block)
+			return -EIO;
+	}
+
+	run->lblk = fileblock;
+	run->pblk = 0;
+	extent = (struct ext4_extent *)(ext_block + 1);
+	for (i = 0; ext_block->eh_depth == 0 && i < entries; i++) {
+		start = le32_to_cpu(extent[i].ee_block);
+		len = le16_to_cpu(extent[i].ee_len);
+		if (fileblock < start) {
+			end = start;
+			break;
+		}
+		if (len > EXT4_EXT_INIT_MAX_LEN)
+			len -= EXT4_EXT_INIT_MAX_LEN;
+		else if (fileblock < start + len)
+			run->pblk = ((uint64_t)le16_to_cpu(extent[i].ee_start_hi)
+				     << 32) + le32_to_cpu(extent[i].ee_start_lo) +
+				    fileblock - start;
+		if (fileblock < start + len) {
+			end = start + len;
+			break;
+		}
+	}
+	run->len = end - fileblock;
+
+	return 0;
+}
+
 static struct ext4_extent_header *ext4fs_get_extent_block
 	(struct ext2_data *data, struct ext_block_cache *cache,
 		struct ext4_extent_header *ext_block,
@@ -2007,6 +2152,7 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
  */
 void ext4fs_reinit_global(void)
 {
+	ext4fs_extent_cache_flush();
 	if (ext4fs_indir1_block != NULL) {
 		free(ext4fs_indir1_block);
 		ext4fs_indir1_block = NULL;
@@ -2040,6 +2186,15 @@ void ext4fs_close(void)
 	ext4fs_reinit_global();
 }
 
+/* Drop the file opened by the last operation, but stay mounted */
+void ext4fs_release(void)
+{
+	if (ext4fs_file && ext4fs_root) {
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+		ext4fs_file = NULL;
+	}
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -2344,6 +2499,8 @@ int ext4fs_mount(void)
 	if (!data)
 		return 0;
 
+	ext4fs_extent_cache_flush();
+
 	/* Read the superblock. */
 	status = ext4_read_superblock((char *)&data->sblock);
 
@@ -47,6 +47,43 @@ static inline void *zalloc(size_t size)
 	return kzalloc(size, 0);
 }
 
+/**
+ * struct ext4_extent_run - a run of blocks in a file which uses extents
+ *
+ * @lblk: First block of the run within the file
+ * @pblk: Filesystem block holding @lblk, or 0 if the run is a hole or is
+ *	unwritten, so reads as zeroes
+ * @len: Number of blocks in the run
+ */
+struct ext4_extent_run {
+	uint32_t lblk;
+	uint64_t pblk;
+	uint64_t len;
+};
+
+/**
+ * ext4fs_find_extent() - find the run of blocks holding a file block
+ *
+ * Index and leaf blocks of the extent tree are cached between calls, so
+ * walking a file run by run reads each of them only once.
+ *
+ * @inode: Inode of the file, which must have EXT4_EXTENTS_FL set
+ * @fileblock: Block within the file to look up
+ * @run: Returns the run, which starts at @fileblock and extends to the end
+ *	of its extent (or of the hole)
+ * Return: 0 if OK, -EINVAL if the extent tree is corrupt, -EIO if a block
+ *	could not be read
+ */
+int ext4fs_find_extent(struct ext2_inode *inode, uint32_t fileblock,
+		       struct ext4_extent_run *run);
+
+/**
+ * ext4fs_extent_cache_flush() - drop all cached extent-tree blocks
+ *
+ * This must be called when the filesystem changes, or is unmounted.
+ */
+void ext4fs_extent_cache_flush(void);
+
 int ext4fs_read_inode(struct ext2_data *data, int ino,
 		      struct ext2_inode *inode);
 int ext4fs_read_file(struct ext2fs_node *node, loff_t pos, loff_t len,
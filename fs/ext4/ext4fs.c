@@ -25,8 +25,10 @@
 #include <errno.h>
 #include <ext_common.h>
 #include <ext4fs.h>
+#include <log.h>
 #include <malloc.h>
 #include <part.h>
+#include <linux/sizes.h>
 #include <u-boot/uuid.h>
 #include "ext4_common.h"
 
@@ -62,6 +64,62 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 		free(node);
 }
 
+/* Largest read passed to ext4fs_devread(), which takes an int length */
+#define EXT4_MAX_READ	SZ_1G
+
+/*
+ * Read part of a file which uses extents. Each run of contiguous blocks is
+ * read with as few ext4fs_devread() calls as possible, and holes and
+ * unwritten extents are zeroed without touching the device.
+ */
+static int ext4fs_read_extents(struct ext2fs_node *node, loff_t pos,
+			       loff_t len, char *buf)
+{
+	struct ext_filesystem *fs = get_fs();
+	int log2blksz = fs->dev_desc->log2blksz;
+	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
+	int blocksize = 1 << (log2_fs_blocksize + log2blksz);
+	struct ext4_extent_run run;
+	loff_t end = pos + len;
+	uint runs = 0, reads = 0;
+
+	while (pos < end) {
+		uint32_t fileblock = lldiv(pos, blocksize);
+		loff_t off, size, chunk;
+		lbaint_t sector;
+		int ret;
+
+		ret = ext4fs_find_extent(&node->inode, fileblock, &run);
+		if (ret)
+			return ret;
+		runs++;
+
+		off = pos - (loff_t)fileblock * blocksize;
+		size = min_t(loff_t, run.len * blocksize - off, end - pos);
+		if (!run.pblk) {
+			memset(buf, '\0', size);
+		} else {
+			sector = (lbaint_t)run.pblk << log2_fs_blocksize;
+			for (chunk = 0; chunk < size; chunk += EXT4_MAX_READ) {
+				loff_t ofs = off + chunk;
+
+				if (!ext4fs_devread(sector + (ofs >> log2blksz),
+						    ofs & ((1 << log2blksz) - 1),
+						    min_t(loff_t, size - chunk,
+							  EXT4_MAX_READ),
+						    buf + chunk))
+					return -EIO;
+				reads++;
+			}
+		}
+		buf += size;
+		pos += size;
+	}
+	log_debug("%u runs, %u reads\n", runs, reads);
+
+	return 0;
+}
+
 /*
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
@@ -98,6 +156,14 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		return -1;
 	}
 
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL) {
+		ext_cache_fini(&cache);
+		if (ext4fs_read_extents(node, pos, len, buf))
+			return -1;
+		*actread = len;
+		return 0;
+	}
+
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
 	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
@@ -25,10 +25,17 @@
 #include <linux/compiler.h>
 #include <linux/ctype.h>
 #include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
 
 /* maximum number of clusters for FAT12 */
 #define MAX_FAT12	0xFF4
 
+/* FAT12 entries must not straddle two FAT buffers */
+#if FATBUFBLOCKS % 3
+#error "The number of FAT buffer sectors must be a multiple of 3"
+#endif
+
 /*
  * Convert a string to lowercase.  Converts at most 'len' characters,
  * 'len' may be larger than the length of 'str' if 'str' is NULL
@@ -44,6 +51,44 @@ static void downcase(char *str, size_t len)
 
 static struct blk_desc *cur_dev;
 static struct disk_partition cur_part_info;
+/* Value of cur_dev->write_gen when the filesystem was found */
+static uint cur_write_gen;
+
+/**
+ * struct fat_mount - parameters of the current filesystem, kept between uses
+ *
+ * The boot sector and the FAT window read by one operation are kept for the
+ * next, so that commands on the same partition do not read them again. They
+ * are dropped when the device is written, another filesystem is selected or
+ * the filesystem is closed.
+ *
+ * Only one operation at a time can use @fsdata.fatbuf, since each has its own
+ * copy of @fsdata.fatbufnum. Any other (e.g. while a directory stream is
+ * open) gets a buffer of its own.
+ *
+ * @valid: true if @fsdata and @volinfo are for the current filesystem
+ * @busy: true while an operation is using @fsdata.fatbuf
+ * @write_gen: Value of cur_dev->write_gen when they were read
+ * @fsdata: Filesystem parameters, with the FAT window in @fsdata.fatbuf
+ * @volinfo: Volume information from the boot sector
+ */
+static struct fat_mount {
+	bool valid;
+	bool busy;
+	uint write_gen;
+	fsdata fsdata;
+	volume_info volinfo;
+} fat_mount;
+
+/* Drop the kept filesystem parameters, freeing the FAT window unless in use */
+static void fat_mount_drop(void)
+{
+	fat_mount.valid = false;
+	if (fat_mount.busy)
+		return;	/* freed by fat_put_fs_info() */
+	free(fat_mount.fsdata.fatbuf);
+	fat_mount.fsdata.fatbuf = NULL;
+}
 
 #define DOS_BOOT_MAGIC_OFFSET	0x1fe
 #define DOS_FS_TYPE_OFFSET	0x36
@@ -68,8 +113,10 @@ int fat_set_blk_dev(struct blk_desc *dev_desc, struct disk_partition *info)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, buffer, dev_desc->blksz);
 
+	fat_mount_drop();
 	cur_dev = dev_desc;
 	cur_part_info = *info;
+	cur_write_gen = dev_desc->write_gen;
 
 	/* Make sure it has a valid FAT header */
 	if (disk_read(0, 1, buffer) != 1) {
@@ -99,6 +146,7 @@ int fat_register_device(struct blk_desc *dev_desc, int part_no)
 
 	/* First close any currently found FAT filesystem */
 	cur_dev = NULL;
+	fat_mount_drop();
 
 	/* Read the partition table, if present */
 	if (part_get_info(dev_desc, part_no, &info)) {
@@ -245,63 +293,257 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	return ret;
 }
 
+/* Maximum number of cluster runs remembered for the file being read */
+#define FAT_MAX_RUNS	32
+
+/* Largest bounce buffer used when reading into a misaligned buffer */
+#define FAT_BOUNCE_SIZE	SZ_64K
+
+/**
+ * struct fat_run - a run of consecutive clusters in a file
+ *
+ * @clust: First cluster of the run
+ * @count: Number of clusters in the run
+ */
+struct fat_run {
+	__u32 clust;
+	__u32 count;
+};
+
+/**
+ * struct fat_run_cache - runs of consecutive clusters in a file
+ *
+ * This holds the cluster chain of the file last read as a list of runs of
+ * consecutive clusters. Each run can then be read with a single request, and
+ * reads at increasing offsets within the file (e.g. the images in a FIT) do
+ * not need to follow the chain from the start each time. Once @runs is full,
+ * the oldest run is dropped to make room for each new one.
+ *
+ * The cache is dropped whenever the device is written, since a raw write (e.g.
+ * 'mmc write' or 'ums') may change the FAT or the file's data.
+ *
+ * @dev: Block device holding the filesystem
+ * @part_start: Start sector of the partition
+ * @write_gen: Value of @dev->write_gen when the cache was checked
+ * @vol_id: Volume ID of the filesystem
+ * @start: First cluster of the file, or 0 if nothing is cached
+ * @base: Index within the file of the first cluster in @runs
+ * @clusters: Number of clusters in @runs
+ * @count: Number of entries in @runs
+ * @end: true if the end of the cluster chain has been reached
+ * @runs: Runs of clusters, in file order
+ */
+static struct fat_run_cache {
+	struct blk_desc *dev;
+	lbaint_t part_start;
+	uint write_gen;
+	__u8 vol_id[4];
+	__u32 start;
+	__u32 base;
+	__u32 clusters;
+	int count;
+	bool end;
+	struct fat_run runs[FAT_MAX_RUNS];
+} fat_runs;
+
+/* Forget the cached cluster runs, e.g. because the FAT has changed */
+static void fat_runs_reset(void)
+{
+	fat_runs.start = 0;
+}
+
 /*
- * Read at most 'size' bytes from the specified cluster into 'buffer'.
- * Return 0 on success, -1 otherwise.
+ * Drop the cached cluster runs if they are from a different filesystem or the
+ * device has been written since they were cached
  */
-static int
-get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
+static void fat_runs_check_fs(const volume_info *volinfo)
 {
-	__u32 startsect;
-	int ret;
+	if (fat_runs.dev == cur_dev &&
+	    fat_runs.part_start == cur_part_info.start &&
+	    fat_runs.write_gen == cur_dev->write_gen &&
+	    !memcmp(fat_runs.vol_id, volinfo->volume_id,
+		    sizeof(fat_runs.vol_id)))
+		return;
+
+	fat_runs.dev = cur_dev;
+	fat_runs.part_start = cur_part_info.start;
+	fat_runs.write_gen = cur_dev->write_gen;
+	memcpy(fat_runs.vol_id, volinfo->volume_id, sizeof(fat_runs.vol_id));
+	fat_runs_reset();
+}
 
-	if (clustnum > 0) {
-		startsect = clust_to_sect(mydata, clustnum);
+/* Add the next cluster in the chain to the cached runs */
+static void fat_runs_step(fsdata *mydata)
+{
+	struct fat_run *run = &fat_runs.runs[fat_runs.count - 1];
+	__u32 clust = run->clust + run->count - 1;
+	__u32 next;
+
+	next = get_fatent(mydata, clust);
+	if (CHECK_CLUST(next, mydata->fatsize)) {
+		fat_runs.end = true;
+		return;
+	}
+
+	if (next == clust + 1) {
+		run->count++;
 	} else {
-		startsect = mydata->rootdir_sect;
+		if (fat_runs.count == FAT_MAX_RUNS) {
+			fat_runs.base += fat_runs.runs[0].count;
+			fat_runs.clusters -= fat_runs.runs[0].count;
+			memmove(fat_runs.runs, fat_runs.runs + 1,
+				(FAT_MAX_RUNS - 1) * sizeof(*run));
+			fat_runs.count--;
+		}
+		run = &fat_runs.runs[fat_runs.count++];
+		run->clust = next;
+		run->count = 1;
 	}
+	fat_runs.clusters++;
+}
 
-	debug("gc - clustnum: %d, startsect: %d\n", clustnum, startsect);
+/**
+ * fat_get_run() - find the run of consecutive clusters at part of a file
+ *
+ * @mydata:	file system description
+ * @start:	first cluster of the file
+ * @index:	index within the file of the first cluster wanted
+ * @want:	number of clusters wanted
+ * @run:	returns the run starting at cluster @index, which is at most
+ *		@want clusters long
+ * Return:	0 on success, -EIO if the chain ends before cluster @index
+ */
+static int fat_get_run(fsdata *mydata, __u32 start, __u32 index, __u32 want,
+		       struct fat_run *run)
+{
+	__u32 first, base;
+	int i;
 
-	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1)) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
+	if (fat_runs.start != start || index < fat_runs.base) {
+		fat_runs.start = start;
+		fat_runs.base = 0;
+		fat_runs.clusters = 1;
+		fat_runs.count = 1;
+		fat_runs.end = false;
+		fat_runs.runs[0].clust = start;
+		fat_runs.runs[0].count = 1;
+	}
 
-		debug("FAT: Misaligned buffer address (%p)\n", buffer);
+	/* Follow the chain as far as the cluster */
+	while (fat_runs.base + fat_runs.clusters <= index) {
+		if (fat_runs.end)
+			return -EIO;
+		fat_runs_step(mydata);
+	}
 
-		while (size >= mydata->sect_size) {
-			ret = disk_read(startsect++, 1, tmpbuf);
-			if (ret != 1) {
-				debug("Error reading data (got %d)\n", ret);
-				return -1;
-			}
+	first = fat_runs.base;
+	for (i = 0; index >= first + fat_runs.runs[i].count; i++)
+		first += fat_runs.runs[i].count;
+
+	/* Extend the last run while the clusters are consecutive */
+	while (i == fat_runs.count - 1 && !fat_runs.end &&
+	       first + fat_runs.runs[i].count < index + want) {
+		base = fat_runs.base;
+		fat_runs_step(mydata);
+		if (fat_runs.base != base)
+			i--;
+	}
+
+	run->clust = fat_runs.runs[i].clust + index - first;
+	run->count = min(fat_runs.runs[i].count - (index - first), want);
 
-			memcpy(buffer, tmpbuf, mydata->sect_size);
-			buffer += mydata->sect_size;
-			size -= mydata->sect_size;
+	return 0;
+}
+
+/**
+ * get_sectors() - read from consecutive sectors
+ *
+ * Whole sectors are read straight into 'buffer' when it is suitably aligned
+ * and through a bounce buffer otherwise.
+ *
+ * @mydata:	file system description
+ * @sect:	first sector to read
+ * @skip:	number of bytes to skip at the start of the first sector
+ * @buffer:	buffer into which to read
+ * @size:	number of bytes to read
+ * @reads:	incremented by the number of disk reads issued
+ * Return:	0 on success, -1 otherwise
+ */
+static int get_sectors(fsdata *mydata, __u32 sect, __u32 skip, __u8 *buffer,
+		       loff_t size, uint *reads)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
+	__u32 count, max, len;
+	__u8 *bounce = tmpbuf;
+	int ret;
+
+	/* Partial sector at the start */
+	if (skip || size < mydata->sect_size) {
+		(*reads)++;
+		ret = disk_read(sect++, 1, tmpbuf);
+		if (ret != 1) {
+			debug("Error reading data (got %d)\n", ret);
+			return -1;
 		}
-	} else if (size >= mydata->sect_size) {
-		__u32 bytes_read;
-		__u32 sect_count = size / mydata->sect_size;
+		len = min(size, (loff_t)(mydata->sect_size - skip));
+		memcpy(buffer, tmpbuf + skip, len);
+		buffer += len;
+		size -= len;
+	}
 
-		ret = disk_read(startsect, sect_count, buffer);
-		if (ret != sect_count) {
+	count = size / mydata->sect_size;
+	if (count && !((ulong)buffer & (ARCH_DMA_MINALIGN - 1))) {
+		(*reads)++;
+		ret = disk_read(sect, count, buffer);
+		if (ret != count) {
 			debug("Error reading data (got %d)\n", ret);
 			return -1;
 		}
-		bytes_read = sect_count * mydata->sect_size;
-		startsect += sect_count;
-		buffer += bytes_read;
-		size -= bytes_read;
+		sect += count;
+		buffer += count * mydata->sect_size;
+		size -= count * mydata->sect_size;
+	} else if (count) {
+		debug("FAT: Misaligned buffer address (%p)\n", buffer);
+
+		/* A simple malloc() cannot free the bounce buffer */
+		max = 1;
+		if (!CONFIG_IS_ENABLED(SYS_MALLOC_SIMPLE)) {
+			max = min_t(__u32, count,
+				    FAT_BOUNCE_SIZE / mydata->sect_size);
+			bounce = malloc_cache_aligned(max * mydata->sect_size);
+			if (!bounce) {
+				max = 1;
+				bounce = tmpbuf;
+			}
+		}
+		while (count) {
+			len = min(count, max);
+			(*reads)++;
+			ret = disk_read(sect, len, bounce);
+			if (ret != len) {
+				debug("Error reading data (got %d)\n", ret);
+				break;
+			}
+			memcpy(buffer, bounce, len * mydata->sect_size);
+			sect += len;
+			count -= len;
+			buffer += len * mydata->sect_size;
+			size -= len * mydata->sect_size;
+		}
+		if (bounce != tmpbuf)
+			free(bounce);
+		if (count)
+			return -1;
 	}
-	if (size) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
 
-		ret = disk_read(startsect, 1, tmpbuf);
+	/* Partial sector at the end */
+	if (size) {
+		(*reads)++;
+		ret = disk_read(sect, 1, tmpbuf);
 		if (ret != 1) {
 			debug("Error reading data (got %d)\n", ret);
 			return -1;
 		}
-
 		memcpy(buffer, tmpbuf, size);
 	}
 
@@ -315,6 +557,9 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
  * into 'buffer'. Update the number of bytes read in *gotsize or return -1 on
  * fatal errors.
  *
+ * Each run of consecutive clusters is read with a single request where
+ * possible, see struct fat_run_cache.
+ *
  * @mydata:	file system description
  * @dentprt:	directory entry pointer
  * @pos:	position from where to read
@@ -328,8 +573,10 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
+	__u32 start = START(dentptr);
+	uint runs = 0, reads = 0;
+	struct fat_run run;
+	__u32 index, offset;
 	loff_t actsize;
 
 	*gotsize = 0;
@@ -345,101 +592,40 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
-
-	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize += bytesperclust;
+	if (CHECK_CLUST(start, mydata->fatsize)) {
+		debug("curclust: 0x%x\n", start);
+		printf("Invalid FAT entry\n");
+		return -1;
 	}
 
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
-
-	/* align to beginning of next cluster if any */
-	if (pos) {
-		__u8 *tmp_buffer;
-
-		actsize = min(filesize, (loff_t)bytesperclust);
-		tmp_buffer = malloc_cache_aligned(actsize);
-		if (!tmp_buffer) {
-			debug("Error: allocating buffer\n");
-			return -1;
-		}
-
-		if (get_cluster(mydata, curclust, tmp_buffer, actsize) != 0) {
-			printf("Error reading cluster\n");
-			free(tmp_buffer);
-			return -1;
-		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, tmp_buffer + pos, actsize);
-		free(tmp_buffer);
-		*gotsize += actsize;
-		if (!filesize)
-			return 0;
-		buffer += actsize;
-
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
+	while (pos < filesize) {
+		index = div_u64_rem(pos, bytesperclust, &offset);
+		if (fat_get_run(mydata, start, index,
+				div_u64(filesize - pos + offset +
+					bytesperclust - 1, bytesperclust),
+				&run)) {
 			printf("Invalid FAT entry\n");
 			return -1;
 		}
-	}
-
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				printf("Invalid FAT entry\n");
-				return -1;
-			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		actsize = min(filesize - pos,
+			      (loff_t)run.count * bytesperclust - offset);
+		if (get_sectors(mydata, clust_to_sect(mydata, run.clust) +
+				offset / mydata->sect_size,
+				offset % mydata->sect_size, buffer, actsize,
+				&reads)) {
 			printf("Error reading cluster\n");
 			return -1;
 		}
 		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
-		filesize -= actsize;
 		buffer += actsize;
+		pos += actsize;
+		runs++;
+	}
+	debug("Read %llu bytes from %u runs of clusters in %u reads\n",
+	      *gotsize, runs, reads);
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	return 0;
 }
 
 /*
@@ -615,17 +801,30 @@ out_free:
 	return ret;
 }
 
+/*
+ * Set up @mydata for the current filesystem. The caller must pass it to
+ * fat_put_fs_info() when done.
+ */
 static int get_fs_info(fsdata *mydata)
 {
 	boot_sector bs;
 	volume_info volinfo;
 	int ret;
 
+	if (fat_mount.valid && !fat_mount.busy && cur_dev &&
+	    fat_mount.write_gen == cur_dev->write_gen) {
+		*mydata = fat_mount.fsdata;
+		fat_mount.busy = true;
+		fat_runs_check_fs(&fat_mount.volinfo);
+		return 0;
+	}
+
 	ret = read_bootsectandvi(&bs, &volinfo, &mydata->fatsize);
 	if (ret) {
 		debug("Error: reading boot sector\n");
 		return ret;
 	}
+	fat_runs_check_fs(&volinfo);
 
 	if (mydata->fatsize == 32) {
 		mydata->fatlength = bs.fat32_length;
@@ -691,6 +890,16 @@ static int get_fs_info(fsdata *mydata)
 		return -1;
 	}
 
+	/* Keep these for the next operation, unless another is using them */
+	if (!fat_mount.busy) {
+		fat_mount_drop();
+		fat_mount.fsdata = *mydata;
+		fat_mount.volinfo = volinfo;
+		fat_mount.write_gen = cur_dev->write_gen;
+		fat_mount.valid = true;
+		fat_mount.busy = true;
+	}
+
 	debug("FAT%d, fat_sect: %d, fatlength: %d\n",
 	       mydata->fatsize, mydata->fat_sect, mydata->fatlength);
 	debug("Rootdir begins at cluster: %d, sector: %d, offset: %x\n"
@@ -704,6 +913,25 @@ static int get_fs_info(fsdata *mydata)
 	return 0;
 }
 
+/*
+ * Finish with @mydata from get_fs_info(). The FAT window is kept for the next
+ * operation if neither it nor the device has been written meanwhile.
+ */
+static void fat_put_fs_info(fsdata *mydata)
+{
+	if (fat_mount.busy && mydata->fatbuf == fat_mount.fsdata.fatbuf) {
+		fat_mount.busy = false;
+		if (fat_mount.valid && !mydata->fat_dirty && cur_dev &&
+		    fat_mount.write_gen == cur_dev->write_gen) {
+			fat_mount.fsdata.fatbufnum = mydata->fatbufnum;
+			return;
+		}
+		fat_mount.valid = false;
+		fat_mount.fsdata.fatbuf = NULL;
+	}
+	free(mydata->fatbuf);
+}
+
 /**
  * struct fat_itr - directory iterator, to simplify filesystem traversal
  *
@@ -1237,7 +1465,7 @@ int fat_exists(const char *filename)
 		goto out;
 
 	ret = fat_itr_resolve(itr, filename, TYPE_ANY);
-	free(fsdata.fatbuf);
+	fat_put_fs_info(&fsdata);
 out:
 	free(itr);
 	return ret == 0;
@@ -1284,7 +1512,7 @@ int fat_size(const char *filename, loff_t *size)
 		 * Directories don't have size, but fs_size() is not
 		 * expected to fail if passed a directory path:
 		 */
-		free(fsdata.fatbuf);
+		fat_put_fs_info(&fsdata);
 		ret = fat_itr_root(itr, &fsdata);
 		if (ret)
 			goto out_free_itr;
@@ -1296,7 +1524,7 @@ int fat_size(const char *filename, loff_t *size)
 
 	*size = FAT2CPU32(itr->dent->size);
 out_free_both:
-	free(fsdata.fatbuf);
+	fat_put_fs_info(&fsdata);
 out_free_itr:
 	free(itr);
 	return ret;
@@ -1328,7 +1556,7 @@ int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 	ret = get_contents(&fsdata, dentptr, offset, buf, len, actread);
 
 out_free_both:
-	free(fsdata.fatbuf);
+	fat_put_fs_info(&fsdata);
 out_free_itr:
 	free(itr);
 	return ret;
@@ -1375,7 +1603,7 @@ int fat_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	return 0;
 
 fail_free_both:
-	free(dir->fsdata.fatbuf);
+	fat_put_fs_info(&dir->fsdata);
 fail_free_dir:
 	free(dir);
 	return ret;
@@ -1415,12 +1643,32 @@ int fat_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp)
 void fat_closedir(struct fs_dir_stream *dirs)
 {
 	fat_dir *dir = (fat_dir *)dirs;
-	free(dir->fsdata.fatbuf);
+	fat_put_fs_info(&dir->fsdata);
 	free(dir);
 }
 
 void fat_close(void)
 {
+	cur_dev = NULL;
+	fat_mount_drop();
+	fat_runs_reset();
+}
+
+/*
+ * The boot sector, FAT window and cluster-run cache stay while the filesystem
+ * is mounted, unless the device has been written
+ */
+void fat_release(void)
+{
+	if (cur_dev && fat_mount.write_gen != cur_dev->write_gen)
+		fat_mount_drop();
+}
+
+bool fat_is_mounted(struct blk_desc *dev_desc, struct disk_partition *info)
+{
+	return cur_dev == dev_desc && cur_write_gen == dev_desc->write_gen &&
+	       cur_part_info.start == info->start &&
+	       cur_part_info.size == info->size;
 }
 
 int fat_uuid(char *uuid_str)
@@ -213,17 +213,17 @@ static int disk_write(__u32 block, __u32 nr_blocks, void *buf)
 }
 
 /*
- * Write fat buffer into block device
+ * Write the modified sectors of the fat buffer into block device
  */
 static int flush_dirty_fat_buffer(fsdata *mydata)
 {
-	int getsize = FATBUFBLOCKS;
+	int getsize = mydata->dirty_hi - mydata->dirty_lo;
 	__u32 fatlength = mydata->fatlength;
-	__u8 *bufptr = mydata->fatbuf;
-	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
+	__u8 *bufptr = mydata->fatbuf + mydata->dirty_lo * mydata->sect_size;
+	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS + mydata->dirty_lo;
 
-	debug("debug: evicting %d, dirty: %d\n", mydata->fatbufnum,
-	      (int)mydata->fat_dirty);
+	debug("debug: evicting %d, dirty: %d (%d..%d)\n", mydata->fatbufnum,
+	      (int)mydata->fat_dirty, mydata->dirty_lo, mydata->dirty_hi);
 
 	if ((!mydata->fat_dirty) || (mydata->fatbufnum == -1))
 		return 0;
@@ -438,6 +438,26 @@ fill_dir_slot(fat_itr *itr, const char *l_name, const char *shortname)
 /*
  * Set the entry at index 'entry' in a FAT (12/16/32) table.
  */
+/*
+ * Mark the sectors of the fat buffer holding bytes [pos, pos + len) as
+ * modified, so that only those are written back
+ */
+static void mark_fat_dirty(fsdata *mydata, __u32 pos, __u32 len)
+{
+	__u16 lo = pos / mydata->sect_size;
+	__u16 hi = min((pos + len - 1) / mydata->sect_size + 1,
+		       (__u32)FATBUFBLOCKS);
+
+	if (!mydata->fat_dirty) {
+		mydata->dirty_lo = lo;
+		mydata->dirty_hi = hi;
+		mydata->fat_dirty = 1;
+		return;
+	}
+	mydata->dirty_lo = min(mydata->dirty_lo, lo);
+	mydata->dirty_hi = max(mydata->dirty_hi, hi);
+}
+
 static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 {
 	__u32 bufnum, offset, off16;
@@ -461,6 +481,9 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		return -1;
 	}
 
+	/* The cluster chain of a file may change */
+	fat_runs_reset();
+
 	/* Read a new block of FAT entries into the cache. */
 	if (bufnum != mydata->fatbufnum) {
 		int getsize = FATBUFBLOCKS;
@@ -484,19 +507,20 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		mydata->fatbufnum = bufnum;
 	}
 
-	/* Mark as dirty */
-	mydata->fat_dirty = 1;
-
 	/* Set the actual entry */
 	switch (mydata->fatsize) {
 	case 32:
+		mark_fat_dirty(mydata, offset * 4, 4);
 		((__u32 *) mydata->fatbuf)[offset] = cpu_to_le32(entry_value);
 		break;
 	case 16:
+		mark_fat_dirty(mydata, offset * 2, 2);
 		((__u16 *) mydata->fatbuf)[offset] = cpu_to_le16(entry_value);
 		break;
 	case 12:
 		off16 = (offset * 3) / 4;
+		/* The entry may be split over two 16-bit words */
+		mark_fat_dirty(mydata, off16 * 2, 4);
 
 		switch (offset & 0x3) {
 		case 0:
@@ -1474,7 +1498,7 @@ int file_fat_write_at(const char *filename, loff_t pos, void *buffer,
 
 exit:
 	free(filename_copy);
-	free(mydata->fatbuf);
+	fat_put_fs_info(mydata);
 	free(itr);
 	return ret;
 }
@@ -1664,7 +1688,7 @@ int fat_unlink(const char *filename)
 	ret = delete_dentry_long(itr);
 
 exit:
-	free(fsdata.fatbuf);
+	fat_put_fs_info(&fsdata);
 	free(itr);
 	free(filename_copy);
 
@@ -1808,7 +1832,7 @@ int fat_mkdir(const char *dirname)
 
 exit:
 	free(dirname_copy);
-	free(mydata->fatbuf);
+	fat_put_fs_info(mydata);
 	free(itr);
 	free(dotdent);
 	return ret;
@@ -5,11 +5,14 @@
 
 #define LOG_CATEGORY LOGC_CORE
 
+#include <blk.h>
 #include <command.h>
 #include <config.h>
 #include <display_options.h>
+#include <dm.h>
 #include <errno.h>
 #include <env.h>
+#include <event.h>
 #include <lmb.h>
 #include <log.h>
 #include <malloc.h>
@@ -18,6 +21,7 @@
 #include <ext4fs.h>
 #include <fat.h>
 #include <fs.h>
+#include <image.h>
 #include <sandboxfs.h>
 #include <semihostingfs.h>
 #include <time.h>
@@ -27,6 +31,7 @@
 #include <asm/global_data.h>
 #include <asm/io.h>
 #include <div64.h>
+#include <linux/libfdt.h>
 #include <linux/math64.h>
 #include <linux/sizes.h>
 #include <efi_loader.h>
@@ -165,6 +170,15 @@ struct fstype_info {
 	int (*write)(const char *filename, void *buf, loff_t offset,
 		     loff_t len, loff_t *actwrite);
 	void (*close)(void);
+	/*
+	 * Drop state kept for the last operation, but leave the filesystem
+	 * mounted so that the mount cache can use it again. Filesystems
+	 * which set this must also set .is_mounted
+	 */
+	void (*release)(void);
+	/* Check whether the filesystem is still mounted on this partition */
+	bool (*is_mounted)(struct blk_desc *fs_dev_desc,
+			   struct disk_partition *fs_partition);
 	int (*uuid)(char *uuid_str);
 	/*
 	 * Open a directory stream.  On success return 0 and directory
@@ -193,6 +207,8 @@ static struct fstype_info fstypes[] = {
 		.null_dev_desc_ok = false,
 		.probe = fat_set_blk_dev,
 		.close = fat_close,
+		.release = fat_release,
+		.is_mounted = fat_is_mounted,
 		.ls = fs_ls_generic,
 		.exists = fat_exists,
 		.size = fat_size,
@@ -221,6 +237,8 @@ static struct fstype_info fstypes[] = {
 		.null_dev_desc_ok = false,
 		.probe = ext4fs_probe,
 		.close = ext4fs_close,
+		.release = ext4fs_release,
+		.is_mounted = ext4fs_is_mounted,
 		.ls = fs_ls_generic,
 		.exists = ext4fs_exists,
 		.size = ext4fs_size,
@@ -332,6 +350,8 @@ static struct fstype_info fstypes[] = {
 		.read = sqfs_read,
 		.size = sqfs_size,
 		.close = sqfs_close,
+		.release = sqfs_release,
+		.is_mounted = sqfs_is_mounted,
 		.closedir = sqfs_closedir,
 		.exists = sqfs_exists,
 		.uuid = fs_uuid_unsupported,
@@ -421,15 +441,225 @@ const char *fs_get_type_name(void)
 	return fs_get_info(fs_type)->name;
 }
 
-int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
+#if CONFIG_IS_ENABLED(FS_CACHE)
+/**
+ * struct fs_cache_ent - a filesystem found on a partition
+ *
+ * @desc: Block device, or NULL if the entry is not in use. This must not be
+ *	used once @stale is set, since the device may have gone away
+ * @uclass_id: Uclass of the device's parent, for display
+ * @devnum: Device number, for display
+ * @start: First block of the partition
+ * @size: Number of blocks in the partition
+ * @part: Partition number
+ * @fstype: Filesystem type found on the partition (FS_TYPE_...)
+ * @mounted: true if the filesystem driver is still mounted on the partition
+ * @stale: true if the device has changed since the filesystem was probed
+ * @probe_us: Time taken to probe the filesystem, in microseconds
+ * @hits: Number of times the entry has been used without probing
+ * @last_used: Value of fs_cache_tick when the entry was last used
+ */
+struct fs_cache_ent {
+	struct blk_desc *desc;
+	enum uclass_id uclass_id;
+	int devnum;
+	lbaint_t start;
+	lbaint_t size;
+	int part;
+	int fstype;
+	bool mounted;
+	bool stale;
+	ulong probe_us;
+	ulong hits;
+	ulong last_used;
+};
+
+/*
+ * Filesystems found by fs_set_blk_dev() and friends. A filesystem whose
+ * driver provides .release is left mounted by fs_close(), so the next command
+ * using the partition does not probe it again. Each driver keeps its state in
+ * globals, so at most one entry of each type can be mounted.
+ */
+static struct fs_cache_ent fs_cache[CONFIG_FS_CACHE_ENTRIES];
+static struct fs_cache_ent *fs_cache_cur;
+static ulong fs_cache_tick;
+
+static bool fs_cache_match(struct fs_cache_ent *ent, struct blk_desc *desc,
+			   struct disk_partition *info)
+{
+	return ent->desc == desc && !ent->stale && ent->start == info->start &&
+	       ent->size == info->size;
+}
+
+static void fs_cache_unmount(struct fs_cache_ent *ent)
+{
+	if (ent->mounted) {
+		fs_get_info(ent->fstype)->close();
+		ent->mounted = false;
+	}
+}
+
+/* Unmount any cached filesystem of a type, so its driver can be reused */
+static void fs_cache_unmount_type(int fstype)
+{
+	struct fs_cache_ent *ent;
+
+	for (ent = fs_cache; ent < fs_cache + ARRAY_SIZE(fs_cache); ent++) {
+		if (ent->desc && ent->fstype == fstype)
+			fs_cache_unmount(ent);
+	}
+}
+
+/* Drop entries for devices which have changed */
+static void fs_cache_purge(void)
+{
+	struct fs_cache_ent *ent;
+
+	for (ent = fs_cache; ent < fs_cache + ARRAY_SIZE(fs_cache); ent++) {
+		if (ent->desc && ent->stale) {
+			fs_cache_unmount(ent);
+			ent->desc = NULL;
+		}
+	}
+}
+
+static void fs_cache_add(struct fstype_info *info, int part, ulong probe_us)
+{
+	struct fs_cache_ent *ent, *victim = fs_cache;
+
+	for (ent = fs_cache; ent < fs_cache + ARRAY_SIZE(fs_cache); ent++) {
+		if (!ent->desc) {
+			victim = ent;
+			break;
+		}
+		if (ent->last_used < victim->last_used)
+			victim = ent;
+	}
+	if (victim->desc)
+		fs_cache_unmount(victim);
+
+	victim->desc = fs_dev_desc;
+	victim->uclass_id = fs_dev_desc->uclass_id;
+	victim->devnum = fs_dev_desc->devnum;
+	victim->start = fs_partition.start;
+	victim->size = fs_partition.size;
+	victim->part = part;
+	victim->fstype = info->fstype;
+	victim->mounted = !!info->release;
+	victim->stale = false;
+	victim->probe_us = probe_us;
+	victim->hits = 0;
+	victim->last_used = ++fs_cache_tick;
+	fs_cache_cur = victim;
+}
+
+/*
+ * Use a cached filesystem for the current partition, if there is one. If the
+ * driver is no longer mounted there, only the cached type is probed.
+ */
+static int fs_cache_lookup(int part, int fstype)
 {
 	struct fstype_info *info;
-	int part, i;
+	struct fs_cache_ent *ent;
 
-	part = part_get_info_by_dev_and_name_or_num(ifname, dev_part_str, &fs_dev_desc,
-						    &fs_partition, 1);
-	if (part < 0)
-		return -1;
+	fs_cache_purge();
+	if (!fs_dev_desc)
+		return -ENOENT;
+
+	for (ent = fs_cache; ent < fs_cache + ARRAY_SIZE(fs_cache); ent++) {
+		if (fs_cache_match(ent, fs_dev_desc, &fs_partition))
+			break;
+	}
+	if (ent == fs_cache + ARRAY_SIZE(fs_cache) ||
+	    (fstype != FS_TYPE_ANY && fstype != ent->fstype))
+		return -ENOENT;
+
+	info = fs_get_info(ent->fstype);
+	if (!ent->mounted || !info->is_mounted(fs_dev_desc, &fs_partition)) {
+		ulong start = timer_get_us();
+
+		ent->mounted = false;
+		fs_cache_unmount_type(ent->fstype);
+		if (info->probe(fs_dev_desc, &fs_partition)) {
+			ent->desc = NULL;
+			return -ENOENT;
+		}
+		ent->probe_us = timer_get_us() - start;
+		ent->mounted = !!info->release;
+	} else {
+		ent->hits++;
+	}
+	ent->part = part;
+	ent->last_used = ++fs_cache_tick;
+	fs_cache_cur = ent;
+	fs_type = ent->fstype;
+	fs_dev_part = part;
+
+	return 0;
+}
+
+void fs_cache_invalidate(struct blk_desc *desc)
+{
+	struct fs_cache_ent *ent;
+
+	for (ent = fs_cache; ent < fs_cache + ARRAY_SIZE(fs_cache); ent++) {
+		if (ent->desc && (!desc || ent->desc == desc))
+			ent->stale = true;
+	}
+}
+
+void fs_cache_flush(void)
+{
+	fs_cache_invalidate(NULL);
+	fs_cache_purge();
+}
+
+void fs_cache_show(void)
+{
+	struct fs_cache_ent *ent;
+
+	printf("Device       Part  Type         Mounted  Hits  Probe us\n");
+	for (ent = fs_cache; ent < fs_cache + ARRAY_SIZE(fs_cache); ent++) {
+		if (!ent->desc)
+			continue;
+		printf("%-8s %3d  %4d  %-12s %-7s %5lu  %8lu\n",
+		       blk_get_uclass_name(ent->uclass_id), ent->devnum,
+		       ent->part,
+		       fs_get_info(ent->fstype)->name,
+		       ent->stale ? "stale" : ent->mounted ? "yes" : "no",
+		       ent->hits, ent->probe_us);
+	}
+}
+
+static int fs_cache_blk_remove(void *ctx, struct event *event)
+{
+	struct udevice *dev = event->data.dm.dev;
+
+	if (device_get_uclass_id(dev) == UCLASS_BLK)
+		fs_cache_invalidate(dev_get_uclass_plat(dev));
+
+	return 0;
+}
+EVENT_SPY_FULL(EVT_DM_PRE_REMOVE, fs_cache_blk_remove);
+#else
+static int fs_cache_lookup(int part, int fstype)
+{
+	return -ENOENT;
+}
+
+static void fs_cache_unmount_type(int fstype) {}
+static void fs_cache_add(struct fstype_info *info, int part, ulong probe_us) {}
+#endif
+
+/* Find the filesystem on fs_dev_desc / fs_partition */
+static int fs_probe(int part, int fstype)
+{
+	struct fstype_info *info;
+	ulong start;
+	int i;
+
+	if (!fs_cache_lookup(part, fstype))
+		return 0;
 
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (fstype != FS_TYPE_ANY && info->fstype != FS_TYPE_ANY &&
@@ -439,9 +669,13 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 		if (!fs_dev_desc && !info->null_dev_desc_ok)
 			continue;
 
+		fs_cache_unmount_type(info->fstype);
+		start = timer_get_us();
 		if (!info->probe(fs_dev_desc, &fs_partition)) {
 			fs_type = info->fstype;
 			fs_dev_part = part;
+			if (fs_dev_desc && info->fstype != FS_TYPE_ANY)
+				fs_cache_add(info, part, timer_get_us() - start);
 			return 0;
 		}
 	}
@@ -449,11 +683,22 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 	return -1;
 }
 
+int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
+{
+	int part;
+
+	part = part_get_info_by_dev_and_name_or_num(ifname, dev_part_str, &fs_dev_desc,
+						    &fs_partition, 1);
+	if (part < 0)
+		return -1;
+
+	return fs_probe(part, fstype);
+}
+
 /* set current blk device w/ blk_desc + partition # */
 int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 {
-	struct fstype_info *info;
-	int ret, i;
+	int ret;
 
 	if (part >= 1)
 		ret = part_get_info(desc, part, &fs_partition);
@@ -463,22 +708,25 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 		return ret;
 	fs_dev_desc = desc;
 
-	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
-		if (!info->probe(fs_dev_desc, &fs_partition)) {
-			fs_type = info->fstype;
-			fs_dev_part = part;
-			return 0;
-		}
-	}
-
-	return -1;
+	return fs_probe(part, FS_TYPE_ANY);
 }
 
 void fs_close(void)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 
+#if CONFIG_IS_ENABLED(FS_CACHE)
+	if (fs_cache_cur && fs_cache_cur->mounted && !fs_cache_cur->stale) {
+		info->release();
+	} else {
+		info->close();
+		if (fs_cache_cur)
+			fs_cache_cur->mounted = false;
+	}
+	fs_cache_cur = NULL;
+#else
 	info->close();
+#endif
 
 	fs_type = FS_TYPE_ANY;
 }
@@ -732,6 +980,87 @@ int do_size(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(FIT_STREAM)
+/**
+ * struct fs_fit_source - file holding a FIT loaded with 'load -f'
+ *
+ * @ifname: Interface name
+ * @dev_part: Device and partition, or NULL for the default
+ * @filename: Path of the file
+ * @fstype: Filesystem type (FS_TYPE_...)
+ */
+struct fs_fit_source {
+	char *ifname;
+	char *dev_part;
+	char *filename;
+	int fstype;
+};
+
+static struct fs_fit_source fs_fit_source;
+
+/* Read part of the FIT file, for fit_image_load() */
+static long fs_fit_read(void *priv, ulong offset, ulong size, void *buf)
+{
+	struct fs_fit_source *src = priv;
+	loff_t actread;
+
+	if (fs_set_blk_dev(src->ifname, src->dev_part, src->fstype))
+		return -ENODEV;
+	if (fs_read(src->filename, map_to_sysmem(buf), offset, size, &actread))
+		return -EIO;
+
+	return actread;
+}
+
+/*
+ * Load only the structure of a FIT, leaving the external data of each image
+ * to be read by fit_image_load() when it is needed
+ */
+static int fs_load_fit(const char *ifname, const char *dev_part, int fstype,
+		       const char *filename, ulong addr, loff_t *len_read)
+{
+	struct fs_fit_source *src = &fs_fit_source;
+	struct fdt_header *hdr;
+	loff_t len;
+	int ret;
+
+	fit_stream_set_source(NULL, NULL, NULL);
+	ret = _fs_read(filename, addr, 0, sizeof(*hdr), 1, &len);
+	if (ret < 0)
+		return ret;
+	hdr = map_sysmem(addr, sizeof(*hdr));
+	if (len < sizeof(*hdr) || fdt_magic(hdr) != FDT_MAGIC) {
+		log_err("'%s' is not a FIT\n", filename);
+		return -ENOEXEC;
+	}
+
+	if (fs_set_blk_dev(ifname, dev_part, fstype))
+		return -ENODEV;
+	ret = _fs_read(filename, addr, 0, fdt_totalsize(hdr), 1, len_read);
+	if (ret < 0)
+		return ret;
+
+	free(src->ifname);
+	free(src->dev_part);
+	free(src->filename);
+	src->ifname = strdup(ifname);
+	src->dev_part = dev_part ? strdup(dev_part) : NULL;
+	src->filename = strdup(filename);
+	src->fstype = fstype;
+	if (!src->ifname || (dev_part && !src->dev_part) || !src->filename)
+		return -ENOMEM;
+	fit_stream_set_source(hdr, fs_fit_read, src);
+
+	return 0;
+}
+#else
+static int fs_load_fit(const char *ifname, const char *dev_part, int fstype,
+		       const char *filename, ulong addr, loff_t *len_read)
+{
+	return -ENOSYS;
+}
+#endif
+
 int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	    int fstype)
 {
@@ -741,13 +1070,20 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	loff_t bytes;
 	loff_t pos;
 	loff_t len_read;
+	bool fit = false;
 	int ret;
 	unsigned long time;
 	char *ep;
 
+	if (CONFIG_IS_ENABLED(FIT_STREAM) && argc > 1 &&
+	    !strcmp(argv[1], "-f")) {
+		fit = true;
+		argc--;
+		argv++;
+	}
 	if (argc < 2)
 		return CMD_RET_USAGE;
-	if (argc > 7)
+	if (argc > (fit ? 5 : 7))
 		return CMD_RET_USAGE;
 
 	if (fs_set_blk_dev(argv[1], cmd_arg2(argc, argv), fstype)) {
@@ -785,7 +1121,11 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 		pos = 0;
 
 	time = get_timer(0);
-	ret = _fs_read(filename, addr, pos, bytes, 1, &len_read);
+	if (fit)
+		ret = fs_load_fit(argv[1], cmd_arg2(argc, argv), fstype,
+				  filename, addr, &len_read);
+	else
+		ret = _fs_read(filename, addr, pos, bytes, 1, &len_read);
 	time = get_timer(time);
 	if (ret < 0) {
 		log_err("Failed to load '%s'\n", filename);
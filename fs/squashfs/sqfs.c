@@ -81,133 +81,382 @@ static int sqfs_count_tokens(const char *filename)
 	return token_count;
 }
 
-/*
- * Calculates how many blocks are needed for the buffer used in sqfs_disk_read.
- * The memory section (e.g. inode table) start offset and its end (i.e. the next
- * table start) must be specified. It also calculates the offset from which to
- * start reading the buffer.
- */
-static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
+static void sqfs_cache_init(struct sqfs_cache *cache, int count, u32 block_size)
+{
+	cache->entries = calloc(count, sizeof(*cache->entries));
+	cache->count = cache->entries ? count : 0;
+	cache->block_size = block_size;
+	cache->clock = 0;
+	cache->hits = 0;
+	cache->misses = 0;
+}
+
+/* Free the data held by each entry of @cache, leaving the entries empty */
+static void sqfs_cache_empty(struct sqfs_cache *cache)
+{
+	int i;
+
+	for (i = 0; i < cache->count; i++) {
+		free(cache->entries[i].data);
+		cache->entries[i].data = NULL;
+		cache->entries[i].lru = 0;
+	}
+}
+
+static void sqfs_cache_free(struct sqfs_cache *cache)
+{
+	sqfs_cache_empty(cache);
+	free(cache->entries);
+	cache->entries = NULL;
+	cache->count = 0;
+}
+
+/* Find the block at @pos in @cache, marking it as the most recently used */
+static struct sqfs_cache_entry *sqfs_cache_lookup(struct sqfs_cache *cache,
+						  u64 pos)
 {
-	u64 start_, table_size;
+	struct sqfs_cache_entry *e;
+	int i;
 
-	table_size = le64_to_cpu(end) - le64_to_cpu(start);
-	start_ = lldiv(le64_to_cpu(start), ctxt.cur_dev->blksz);
-	*offset = le64_to_cpu(start) - (start_ * ctxt.cur_dev->blksz);
+	for (i = 0; i < cache->count; i++) {
+		e = &cache->entries[i];
+		if (e->lru && e->pos == pos) {
+			e->lru = ++cache->clock;
+			cache->hits++;
+			return e;
+		}
+	}
+	cache->misses++;
 
-	return DIV_ROUND_UP(table_size + *offset, ctxt.cur_dev->blksz);
+	return NULL;
 }
 
 /*
- * Retrieves fragment block entry and returns true if the fragment block is
- * compressed
+ * Pick an empty or the least recently used entry of @cache to hold a new
+ * block. The entry stays empty until the caller calls sqfs_cache_fill()
  */
-static int sqfs_frag_lookup(u32 inode_fragment_index,
-			    struct squashfs_fragment_block_entry *e)
+static struct sqfs_cache_entry *sqfs_cache_victim(struct sqfs_cache *cache)
 {
-	u64 start, end, exp_tbl, n_blks, src_len, table_offset, start_block;
-	unsigned char *metadata_buffer, *metadata, *table;
-	struct squashfs_fragment_block_entry *entries;
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	unsigned long dest_len;
-	int block, offset, ret;
-	u16 header;
+	struct sqfs_cache_entry *e, *victim = NULL;
+	int i;
 
-	metadata_buffer = NULL;
-	entries = NULL;
-	table = NULL;
+	for (i = 0; i < cache->count; i++) {
+		e = &cache->entries[i];
+		if (!victim || e->lru < victim->lru)
+			victim = e;
+	}
+	if (!victim)
+		return NULL;
 
-	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
-		return -EINVAL;
+	if (!victim->data) {
+		victim->data = malloc(cache->block_size);
+		if (!victim->data)
+			return NULL;
+	}
+	victim->lru = 0;
 
-	start = get_unaligned_le64(&sblk->fragment_table_start);
-	end = get_unaligned_le64(&sblk->id_table_start);
-	exp_tbl = get_unaligned_le64(&sblk->export_table_start);
+	return victim;
+}
 
-	if (exp_tbl > start && exp_tbl < end)
-		end = exp_tbl;
+static void sqfs_cache_fill(struct sqfs_cache *cache,
+			    struct sqfs_cache_entry *e, u64 pos, u32 size)
+{
+	e->pos = pos;
+	e->size = size;
+	e->lru = ++cache->clock;
+}
 
-	n_blks = sqfs_calc_n_blks(sblk->fragment_table_start,
-				  cpu_to_le64(end), &table_offset);
+/*
+ * Read @len bytes at byte offset @pos of the filesystem into a newly allocated
+ * buffer. Returns a pointer to the data in *@datap and the buffer to free.
+ */
+static void *sqfs_read_bytes(u64 pos, u64 len, void **datap)
+{
+	u64 start, n_blks, offset;
+	void *buf;
 
-	start /= ctxt.cur_dev->blksz;
+	start = lldiv(pos, ctxt.cur_dev->blksz);
+	offset = pos - start * ctxt.cur_dev->blksz;
+	n_blks = DIV_ROUND_UP(len + offset, ctxt.cur_dev->blksz);
 
-	/* Allocate a proper sized buffer to store the fragment index table */
-	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!table) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	buf = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	if (!buf)
+		return NULL;
 
-	if (sqfs_disk_read(start, n_blks, table) < 0) {
-		ret = -EINVAL;
-		goto out;
+	if (sqfs_disk_read(start, n_blks, buf) < 0) {
+		free(buf);
+		return NULL;
 	}
+	*datap = buf + offset;
 
-	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
-	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
-
-	/*
-	 * Get the start offset of the metadata block that contains the right
-	 * fragment block entry
-	 */
-	start_block = get_unaligned_le64(table + table_offset + block *
-					 sizeof(u64));
+	return buf;
+}
 
-	start = start_block / ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
-				  sblk->fragment_table_start, &table_offset);
+/*
+ * Get the metadata block whose header is at byte offset @pos of the
+ * filesystem, reading and decompressing it unless it is already cached
+ */
+static int sqfs_get_metablock(u64 pos, struct sqfs_cache_entry **entryp)
+{
+	struct sqfs_cache *cache = &ctxt.meta_cache;
+	struct sqfs_cache_entry *e;
+	unsigned long dest_len;
+	u64 bytes_used, len;
+	void *buf, *data;
+	u32 src_len;
+	bool comp;
+	int ret;
 
-	metadata_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!metadata_buffer) {
-		ret = -ENOMEM;
-		goto out;
+	e = sqfs_cache_lookup(cache, pos);
+	if (e) {
+		*entryp = e;
+		return 0;
 	}
 
-	if (sqfs_disk_read(start, n_blks, metadata_buffer) < 0) {
-		ret = -EINVAL;
-		goto out;
-	}
+	e = sqfs_cache_victim(cache);
+	if (!e)
+		return -ENOMEM;
 
-	/* Every metadata block starts with a 16-bit header */
-	header = get_unaligned_le16(metadata_buffer + table_offset);
-	metadata = metadata_buffer + table_offset + SQFS_HEADER_SIZE;
+	/* The block is no larger than its header and 8KiB of data */
+	bytes_used = get_unaligned_le64(&ctxt.sblk->bytes_used);
+	if (pos + SQFS_HEADER_SIZE > bytes_used)
+		return -EINVAL;
+	len = min_t(u64, SQFS_HEADER_SIZE + SQFS_METADATA_BLOCK_SIZE,
+		    bytes_used - pos);
 
-	if (!metadata || !header) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	buf = sqfs_read_bytes(pos, len, &data);
+	if (!buf)
+		return -EIO;
 
-	entries = malloc(SQFS_METADATA_BLOCK_SIZE);
-	if (!entries) {
-		ret = -ENOMEM;
+	ret = sqfs_read_metablock(data, 0, &comp, &src_len);
+	if (ret)
+		goto out;
+	if (SQFS_HEADER_SIZE + src_len > len) {
+		ret = -EINVAL;
 		goto out;
 	}
 
-	if (SQFS_COMPRESSED_METADATA(header)) {
-		src_len = SQFS_METADATA_SIZE(header);
+	data += SQFS_HEADER_SIZE;
+	if (comp) {
 		dest_len = SQFS_METADATA_BLOCK_SIZE;
-		ret = sqfs_decompress(&ctxt, entries, &dest_len, metadata,
-				      src_len);
+		ret = sqfs_decompress(&ctxt, e->data, &dest_len, data, src_len);
 		if (ret) {
 			ret = -EINVAL;
 			goto out;
 		}
 	} else {
-		memcpy(entries, metadata, SQFS_METADATA_SIZE(header));
+		memcpy(e->data, data, src_len);
+		dest_len = src_len;
 	}
 
-	*e = entries[offset];
-	ret = SQFS_COMPRESSED_BLOCK(e->size);
+	e->next = pos + SQFS_HEADER_SIZE + src_len;
+	sqfs_cache_fill(cache, e, pos, dest_len);
+	*entryp = e;
 
 out:
-	free(entries);
-	free(metadata_buffer);
-	free(table);
+	free(buf);
 
 	return ret;
 }
 
+/*
+ * Copy @len bytes of metadata to @dest, starting at byte *@offsetp of the
+ * decompressed block whose header is at byte *@blockp of the filesystem. The
+ * data may continue into the following blocks. On success, the position is
+ * moved past the data that was read.
+ */
+static int sqfs_read_metadata(void *dest, u64 *blockp, u32 *offsetp,
+			      size_t len)
+{
+	struct sqfs_cache_entry *e;
+	size_t count;
+	int ret;
+
+	while (len) {
+		ret = sqfs_get_metablock(*blockp, &e);
+		if (ret)
+			return ret;
+		if (!e->size)
+			return -EINVAL;
+
+		if (*offsetp >= e->size) {
+			*offsetp -= e->size;
+			*blockp = e->next;
+			continue;
+		}
+
+		count = min_t(size_t, len, e->size - *offsetp);
+		memcpy(dest, e->data + *offsetp, count);
+		dest += count;
+		len -= count;
+		*offsetp += count;
+	}
+
+	return 0;
+}
+
+/*
+ * Read the inode with reference @ref (the position of its metadata block in
+ * the inode table, and its offset in that block) into a newly allocated
+ * buffer. The block list of a regular file and the target of a symlink are
+ * included, but not the index of an extended directory.
+ */
+static int sqfs_read_inode(u64 ref, void **inodep)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	union {
+		struct squashfs_base_inode base;
+		struct squashfs_lreg_inode lreg;
+		struct squashfs_ldir_inode ldir;
+		struct squashfs_ldev_inode ldev;
+		struct squashfs_lipc_inode lipc;
+	} fixed;
+	int fixed_size, size, ret;
+	u32 offset;
+	void *inode;
+	u64 block;
+	u16 type;
+
+	block = get_unaligned_le64(&sblk->inode_table_start) + (ref >> 16);
+	offset = ref & 0xffff;
+
+	ret = sqfs_read_metadata(&fixed, &block, &offset, sizeof(fixed.base));
+	if (ret)
+		return ret;
+
+	type = get_unaligned_le16(&fixed.base.inode_type);
+	fixed_size = sqfs_inode_fixed_size(type);
+	if (fixed_size < 0)
+		return fixed_size;
+
+	ret = sqfs_read_metadata((void *)&fixed + sizeof(fixed.base), &block,
+				 &offset, fixed_size - sizeof(fixed.base));
+	if (ret)
+		return ret;
+
+	if (type == SQFS_LDIR_TYPE)
+		size = fixed_size;
+	else
+		size = sqfs_inode_size(&fixed.base,
+				       get_unaligned_le32(&sblk->block_size));
+	if (size < fixed_size)
+		return -EINVAL;
+
+	inode = malloc(size);
+	if (!inode)
+		return -ENOMEM;
+
+	memcpy(inode, &fixed, fixed_size);
+	ret = sqfs_read_metadata(inode + fixed_size, &block, &offset,
+				 size - fixed_size);
+	if (ret) {
+		free(inode);
+		return ret;
+	}
+	*inodep = inode;
+
+	return 0;
+}
+
+/* Reference of the inode of the directory entry last read from @dirs */
+static u64 sqfs_entry_ref(struct squashfs_dir_stream *dirs)
+{
+	return (u64)dirs->dir_header->start << 16 | dirs->entry->offset;
+}
+
+/*
+ * Retrieves fragment block entry and returns true if the fragment block is
+ * compressed
+ */
+static int sqfs_frag_lookup(u32 inode_fragment_index,
+			    struct squashfs_fragment_block_entry *e)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u32 fragments, index, index_size, offset;
+	void *buf, *data;
+	u64 start, block;
+	int ret;
+
+	fragments = get_unaligned_le32(&sblk->fragments);
+	if (inode_fragment_index >= fragments)
+		return -EINVAL;
+
+	/* The index holds the position of each metadata block of entries */
+	if (!ctxt.frag_index) {
+		index_size = DIV_ROUND_UP(fragments, SQFS_MAX_ENTRIES) *
+			sizeof(u64);
+		start = get_unaligned_le64(&sblk->fragment_table_start);
+		buf = sqfs_read_bytes(start, index_size, &data);
+		if (!buf)
+			return -EIO;
+
+		ctxt.frag_index = malloc(index_size);
+		if (ctxt.frag_index)
+			memcpy(ctxt.frag_index, data, index_size);
+		free(buf);
+		if (!ctxt.frag_index)
+			return -ENOMEM;
+	}
+
+	index = SQFS_FRAGMENT_INDEX(inode_fragment_index);
+	block = get_unaligned_le64(&ctxt.frag_index[index]);
+	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index) * sizeof(*e);
+	ret = sqfs_read_metadata(e, &block, &offset, sizeof(*e));
+	if (ret)
+		return ret;
+
+	return SQFS_COMPRESSED_BLOCK(e->size);
+}
+
+/*
+ * Get the contents of the fragment block described by @e, reading and
+ * decompressing it unless it is already cached
+ */
+static int sqfs_get_fragment(struct squashfs_fragment_block_entry *e,
+			     bool comp, struct sqfs_cache_entry **entryp)
+{
+	struct sqfs_cache *cache = &ctxt.frag_cache;
+	struct sqfs_cache_entry *entry;
+	unsigned long dest_len;
+	void *buf, *data;
+	u32 src_len;
+	int ret = 0;
+
+	entry = sqfs_cache_lookup(cache, e->start);
+	if (entry) {
+		*entryp = entry;
+		return 0;
+	}
+
+	entry = sqfs_cache_victim(cache);
+	if (!entry)
+		return -ENOMEM;
+
+	src_len = SQFS_BLOCK_SIZE(e->size);
+	buf = sqfs_read_bytes(e->start, src_len, &data);
+	if (!buf)
+		return -EIO;
+
+	dest_len = cache->block_size;
+	if (comp) {
+		ret = sqfs_decompress(&ctxt, entry->data, &dest_len, data,
+				      src_len);
+	} else if (src_len <= dest_len) {
+		memcpy(entry->data, data, src_len);
+		dest_len = src_len;
+	} else {
+		ret = -EINVAL;
+	}
+	free(buf);
+	if (ret)
+		return ret;
+
+	sqfs_cache_fill(cache, entry, e->start, dest_len);
+	*entryp = entry;
+
+	return 0;
+}
+
 /*
  * The entry name is a flexible array member, and we don't know its size before
  * actually reading the entry. So we need a first copy to retrieve this size so
@@ -451,22 +700,85 @@ static char *sqfs_resolve_symlink(struct squashfs_symlink_inode *sym,
 }
 
 /*
- * m_list contains each metadata block's position, and m_count is the number of
- * elements of m_list. Those metadata blocks come from the compressed directory
- * table.
+ * Read the listing of directory inode @dir_i into dirs->dir_table, and set up
+ * @dirs to read its first header. Returns SQFS_EMPTY_DIR if it has no entries.
+ */
+static int sqfs_read_dir_listing(struct squashfs_dir_stream *dirs,
+				 void *dir_i)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	struct squashfs_base_inode *base = dir_i;
+	struct squashfs_ldir_inode *ldir;
+	struct squashfs_dir_inode *dir;
+	u32 file_size, offset;
+	unsigned char *table;
+	u64 block;
+	int ret;
+
+	switch (get_unaligned_le16(&base->inode_type)) {
+	case SQFS_DIR_TYPE:
+		dir = dir_i;
+		block = get_unaligned_le32(&dir->start_block);
+		offset = get_unaligned_le16(&dir->offset);
+		file_size = get_unaligned_le16(&dir->file_size);
+		break;
+	case SQFS_LDIR_TYPE:
+		ldir = dir_i;
+		block = get_unaligned_le32(&ldir->start_block);
+		offset = get_unaligned_le16(&ldir->offset);
+		file_size = get_unaligned_le32(&ldir->file_size);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (file_size <= SQFS_EMPTY_FILE_SIZE)
+		return SQFS_EMPTY_DIR;
+
+	/*
+	 * The size includes three bytes which are not stored. The buffer is
+	 * zero-padded so that sqfs_readdir() never reads past its end.
+	 */
+	table = calloc(1, max_t(u32, file_size, SQFS_DIR_HEADER_SIZE));
+	if (!table)
+		return -ENOMEM;
+
+	block += get_unaligned_le64(&sblk->directory_table_start);
+	ret = sqfs_read_metadata(table, &block, &offset,
+				 file_size - SQFS_EMPTY_FILE_SIZE);
+	if (ret) {
+		free(table);
+		return ret;
+	}
+
+	free(dirs->dir_table);
+	dirs->dir_table = table;
+	dirs->table = table;
+
+	/* Setup directory header */
+	memcpy(dirs->dir_header, dirs->table, SQFS_DIR_HEADER_SIZE);
+	dirs->table += SQFS_DIR_HEADER_SIZE;
+	dirs->size = file_size - SQFS_DIR_HEADER_SIZE;
+	dirs->entry_count = dirs->dir_header->count + 1;
+
+	return 0;
+}
+
+/*
+ * Walk down the path in @token_list from the root, reading only the inodes
+ * and directory listings on the way
  */
 static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
-			   int token_count, u32 *m_list, int m_count)
+			   int token_count)
 {
 	struct squashfs_super_block *sblk = ctxt.sblk;
 	char *path, *target, **sym_tokens, *res, *rem;
-	int j, ret = 0, new_inode_number, offset;
 	struct squashfs_symlink_inode *sym;
-	struct squashfs_ldir_inode *ldir;
 	struct squashfs_dir_inode *dir;
 	struct fs_dir_stream *dirsp;
 	struct fs_dirent *dent;
 	unsigned char *table;
+	int j, ret = 0;
 
 	res = NULL;
 	rem = NULL;
@@ -477,36 +789,33 @@ static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
 	dirsp = (struct fs_dir_stream *)dirs;
 
 	/* Start by root inode */
-	table = sqfs_find_inode(dirs->inode_table, le32_to_cpu(sblk->inodes),
-				sblk->inodes, sblk->block_size);
-	if (!table)
+	ret = sqfs_read_inode(get_unaligned_le64(&sblk->root_inode),
+			      (void **)&table);
+	if (ret)
 		return -EINVAL;
-
 	dir = (struct squashfs_dir_inode *)table;
-	ldir = (struct squashfs_ldir_inode *)table;
-
-	/* get directory offset in directory table */
-	offset = sqfs_dir_offset(table, m_list, m_count);
-	dirs->table = &dirs->dir_table[offset];
 
 	/* Setup directory header */
-	dirs->dir_header = malloc(SQFS_DIR_HEADER_SIZE);
-	if (!dirs->dir_header)
-		return -ENOMEM;
-
-	memcpy(dirs->dir_header, dirs->table, SQFS_DIR_HEADER_SIZE);
+	if (!dirs->dir_header) {
+		dirs->dir_header = malloc(SQFS_DIR_HEADER_SIZE);
+		if (!dirs->dir_header) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
 
-	/* Initialize squashfs_dir_stream members */
-	dirs->table += SQFS_DIR_HEADER_SIZE;
-	dirs->size = get_unaligned_le16(&dir->file_size) - SQFS_DIR_HEADER_SIZE;
-	dirs->entry_count = dirs->dir_header->count + 1;
+	ret = sqfs_read_dir_listing(dirs, table);
+	if (ret == SQFS_EMPTY_DIR) {
+		printf("Empty directory.\n");
+		goto out;
+	} else if (ret) {
+		ret = -EINVAL;
+		goto out;
+	}
 
 	/* No path given -> root directory */
-	if (!strcmp(token_list[0], "/")) {
-		dirs->table = &dirs->dir_table[offset];
-		memcpy(&dirs->i_dir, dir, sizeof(*dir));
-		return 0;
-	}
+	if (!strcmp(token_list[0], "/"))
+		goto found;
 
 	for (j = 0; j < token_count; j++) {
 		if (!sqfs_is_dir(get_unaligned_le16(&dir->inode_type))) {
@@ -530,14 +839,13 @@ static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
 		}
 
 		/* Redefine inode as the found token */
-		new_inode_number = dirs->entry->inode_offset +
-			dirs->dir_header->inode_number;
-
-		/* Get reference to inode in the inode table */
-		table = sqfs_find_inode(dirs->inode_table, new_inode_number,
-					sblk->inodes, sblk->block_size);
-		if (!table)
-			return -EINVAL;
+		free(table);
+		ret = sqfs_read_inode(sqfs_entry_ref(dirs), (void **)&table);
+		if (ret) {
+			table = NULL;
+			ret = -EINVAL;
+			goto out;
+		}
 		dir = (struct squashfs_dir_inode *)table;
 
 		/* Check for symbolic link and inode type sanity */
@@ -601,8 +909,7 @@ static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
 			free(dirs->entry);
 			dirs->entry = NULL;
 
-			ret = sqfs_search_dir(dirs, sym_tokens, token_count,
-					      m_list, m_count);
+			ret = sqfs_search_dir(dirs, sym_tokens, token_count);
 			goto out;
 		} else if (!sqfs_is_dir(get_unaligned_le16(&dir->inode_type))) {
 			printf("** Cannot find directory. **\n");
@@ -612,44 +919,30 @@ static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
 			goto out;
 		}
 
-		/* Check if it is an extended dir. */
-		if (get_unaligned_le16(&dir->inode_type) == SQFS_LDIR_TYPE)
-			ldir = (struct squashfs_ldir_inode *)table;
-
-		/* Get dir. offset into the directory table */
-		offset = sqfs_dir_offset(table, m_list, m_count);
-		dirs->table = &dirs->dir_table[offset];
-
-		/* Copy directory header */
-		memcpy(dirs->dir_header, &dirs->dir_table[offset],
-		       SQFS_DIR_HEADER_SIZE);
+		free(dirs->entry);
+		dirs->entry = NULL;
 
-		/* Check for empty directory */
-		if (sqfs_is_empty_dir(table)) {
+		/* Read the directory's listing, checking for an empty one */
+		ret = sqfs_read_dir_listing(dirs, table);
+		if (ret == SQFS_EMPTY_DIR) {
 			printf("Empty directory.\n");
-			free(dirs->entry);
-			dirs->entry = NULL;
-			ret = SQFS_EMPTY_DIR;
+			goto out;
+		} else if (ret) {
+			ret = -EINVAL;
 			goto out;
 		}
-
-		dirs->table += SQFS_DIR_HEADER_SIZE;
-		dirs->size = get_unaligned_le16(&dir->file_size);
-		dirs->entry_count = dirs->dir_header->count + 1;
-		dirs->size -= SQFS_DIR_HEADER_SIZE;
-		free(dirs->entry);
-		dirs->entry = NULL;
 	}
 
-	offset = sqfs_dir_offset(table, m_list, m_count);
-	dirs->table = &dirs->dir_table[offset];
+found:
+	dirs->table = dirs->dir_table;
 
 	if (get_unaligned_le16(&dir->inode_type) == SQFS_DIR_TYPE)
-		memcpy(&dirs->i_dir, dir, sizeof(*dir));
+		memcpy(&dirs->i_dir, dir, sizeof(dirs->i_dir));
 	else
-		memcpy(&dirs->i_ldir, ldir, sizeof(*ldir));
+		memcpy(&dirs->i_ldir, table, sizeof(dirs->i_ldir));
 
 out:
+	free(table);
 	free(res);
 	free(rem);
 	free(path);
@@ -658,276 +951,16 @@ out:
 	return ret;
 }
 
-/*
- * Inode and directory tables are stored as a series of metadata blocks, and
- * given the compressed size of this table, we can calculate how much metadata
- * blocks are needed to store the result of the decompression, since a
- * decompressed metadata block should have a size of 8KiB.
- */
-static int sqfs_count_metablks(void *table, u32 offset, int table_size)
-{
-	int count = 0, cur_size = 0, ret;
-	u32 data_size;
-	bool comp;
-
-	do {
-		ret = sqfs_read_metablock(table, offset + cur_size, &comp,
-					  &data_size);
-		if (ret)
-			return -EINVAL;
-		cur_size += data_size + SQFS_HEADER_SIZE;
-		count++;
-	} while (cur_size < table_size);
-
-	return count;
-}
-
-/*
- * Storing the metadata blocks header's positions will be useful while looking
- * for an entry in the directory table, using the reference (index and offset)
- * given by its inode.
- */
-static int sqfs_get_metablk_pos(u32 *pos_list, void *table, u32 offset,
-				int metablks_count)
-{
-	u32 data_size, cur_size = 0;
-	int j, ret = 0;
-	bool comp;
-
-	if (!metablks_count)
-		return -EINVAL;
-
-	for (j = 0; j < metablks_count; j++) {
-		ret = sqfs_read_metablock(table, offset + cur_size, &comp,
-					  &data_size);
-		if (ret)
-			return -EINVAL;
-
-		cur_size += data_size + SQFS_HEADER_SIZE;
-		pos_list[j] = cur_size;
-	}
-
-	return ret;
-}
-
-static int sqfs_read_inode_table(unsigned char **inode_table)
-{
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	u64 start, n_blks, table_offset, table_size;
-	int j, ret = 0, metablks_count;
-	unsigned char *src_table, *itb;
-	u32 src_len, dest_offset = 0;
-	unsigned long dest_len = 0;
-	bool compressed;
-
-	table_size = get_unaligned_le64(&sblk->directory_table_start) -
-		get_unaligned_le64(&sblk->inode_table_start);
-	start = get_unaligned_le64(&sblk->inode_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->inode_table_start,
-				  sblk->directory_table_start, &table_offset);
-
-	/* Allocate a proper sized buffer (itb) to store the inode table */
-	itb = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!itb)
-		return -ENOMEM;
-
-	if (sqfs_disk_read(start, n_blks, itb) < 0) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
-
-	/* Parse inode table (metadata block) header */
-	ret = sqfs_read_metablock(itb, table_offset, &compressed, &src_len);
-	if (ret) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
-
-	/* Calculate size to store the whole decompressed table */
-	metablks_count = sqfs_count_metablks(itb, table_offset, table_size);
-	if (metablks_count < 1) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
-
-	*inode_table = kcalloc(metablks_count, SQFS_METADATA_BLOCK_SIZE,
-			       GFP_KERNEL);
-	if (!*inode_table) {
-		ret = -ENOMEM;
-		printf("Error: failed to allocate squashfs inode_table of size %i, increasing CONFIG_SYS_MALLOC_LEN could help\n",
-		       metablks_count * SQFS_METADATA_BLOCK_SIZE);
-		goto free_itb;
-	}
-
-	src_table = itb + table_offset + SQFS_HEADER_SIZE;
-
-	/* Extract compressed Inode table */
-	for (j = 0; j < metablks_count; j++) {
-		sqfs_read_metablock(itb, table_offset, &compressed, &src_len);
-		if (compressed) {
-			dest_len = SQFS_METADATA_BLOCK_SIZE;
-			ret = sqfs_decompress(&ctxt, *inode_table +
-					      dest_offset, &dest_len,
-					      src_table, src_len);
-			if (ret) {
-				free(*inode_table);
-				*inode_table = NULL;
-				goto free_itb;
-			}
-
-			dest_offset += dest_len;
-		} else {
-			memcpy(*inode_table + (j * SQFS_METADATA_BLOCK_SIZE),
-			       src_table, src_len);
-		}
-
-		/*
-		 * Offsets to the decompression destination, to the metadata
-		 * buffer 'itb' and to the decompression source, respectively.
-		 */
-
-		table_offset += src_len + SQFS_HEADER_SIZE;
-		src_table += src_len + SQFS_HEADER_SIZE;
-	}
-
-free_itb:
-	free(itb);
-
-	return ret;
-}
-
-static int sqfs_read_directory_table(unsigned char **dir_table, u32 **pos_list)
-{
-	u64 start, n_blks, table_offset, table_size;
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	int j, ret = 0, metablks_count = -1;
-	unsigned char *src_table, *dtb;
-	u32 src_len, dest_offset = 0;
-	unsigned long dest_len = 0;
-	bool compressed;
-
-	*dir_table = NULL;
-	*pos_list = NULL;
-	/* DIRECTORY TABLE */
-	table_size = get_unaligned_le64(&sblk->fragment_table_start) -
-		get_unaligned_le64(&sblk->directory_table_start);
-	start = get_unaligned_le64(&sblk->directory_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->directory_table_start,
-				  sblk->fragment_table_start, &table_offset);
-
-	/* Allocate a proper sized buffer (dtb) to store the directory table */
-	dtb = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!dtb)
-		return -ENOMEM;
-
-	if (sqfs_disk_read(start, n_blks, dtb) < 0)
-		goto out;
-
-	/* Parse directory table (metadata block) header */
-	ret = sqfs_read_metablock(dtb, table_offset, &compressed, &src_len);
-	if (ret)
-		goto out;
-
-	/* Calculate total size to store the whole decompressed table */
-	metablks_count = sqfs_count_metablks(dtb, table_offset, table_size);
-	if (metablks_count < 1)
-		goto out;
-
-	*dir_table = malloc(metablks_count * SQFS_METADATA_BLOCK_SIZE);
-	if (!*dir_table)
-		goto out;
-
-	*pos_list = malloc(metablks_count * sizeof(u32));
-	if (!*pos_list)
-		goto out;
-
-	ret = sqfs_get_metablk_pos(*pos_list, dtb, table_offset,
-				   metablks_count);
-	if (ret) {
-		metablks_count = -1;
-		goto out;
-	}
-
-	src_table = dtb + table_offset + SQFS_HEADER_SIZE;
-
-	/* Extract compressed Directory table */
-	dest_offset = 0;
-	for (j = 0; j < metablks_count; j++) {
-		sqfs_read_metablock(dtb, table_offset, &compressed, &src_len);
-		if (compressed) {
-			dest_len = SQFS_METADATA_BLOCK_SIZE;
-			ret = sqfs_decompress(&ctxt, *dir_table +
-					      (j * SQFS_METADATA_BLOCK_SIZE),
-					      &dest_len, src_table, src_len);
-			if (ret) {
-				metablks_count = -1;
-				goto out;
-			}
-
-			if (dest_len < SQFS_METADATA_BLOCK_SIZE) {
-				dest_offset += dest_len;
-				break;
-			}
-
-			dest_offset += dest_len;
-		} else {
-			memcpy(*dir_table + (j * SQFS_METADATA_BLOCK_SIZE),
-			       src_table, src_len);
-		}
-
-		/*
-		 * Offsets to the decompression destination, to the metadata
-		 * buffer 'dtb' and to the decompression source, respectively.
-		 */
-		table_offset += src_len + SQFS_HEADER_SIZE;
-		src_table += src_len + SQFS_HEADER_SIZE;
-	}
-
-out:
-	if (metablks_count < 1) {
-		free(*dir_table);
-		free(*pos_list);
-		*dir_table = NULL;
-		*pos_list = NULL;
-	}
-	free(dtb);
-
-	return metablks_count;
-}
-
 static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 {
-	unsigned char *inode_table = NULL, *dir_table = NULL;
-	int j, token_count = 0, ret = 0, metablks_count;
+	int j, token_count = 0, ret = 0;
 	struct squashfs_dir_stream *dirs;
 	char **token_list = NULL, *path = NULL;
-	u32 *pos_list = NULL;
 
 	dirs = calloc(1, sizeof(*dirs));
 	if (!dirs)
 		return -EINVAL;
 
-	/* these should be set to NULL to prevent dangling pointers */
-	dirs->dir_header = NULL;
-	dirs->entry = NULL;
-	dirs->table = NULL;
-	dirs->inode_table = NULL;
-	dirs->dir_table = NULL;
-
-	ret = sqfs_read_inode_table(&inode_table);
-	if (ret) {
-		ret = -EINVAL;
-		goto out;
-	}
-
-	metablks_count = sqfs_read_directory_table(&dir_table, &pos_list);
-	if (metablks_count < 1) {
-		ret = -EINVAL;
-		goto out;
-	}
-
 	/* Tokenize filename */
 	token_count = sqfs_count_tokens(filename);
 	if (token_count < 0) {
@@ -951,14 +984,8 @@ static int sqfs_opendir_nest(const char *filename, struct fs_dir_stream **dirsp)
 	ret = sqfs_tokenize(token_list, token_count, path);
 	if (ret)
 		goto out;
-	/*
-	 * ldir's (extended directory) size is greater than dir, so it works as
-	 * a general solution for the malloc size, since 'i' is a union.
-	 */
-	dirs->inode_table = inode_table;
-	dirs->dir_table = dir_table;
-	ret = sqfs_search_dir(dirs, token_list, token_count, pos_list,
-			      metablks_count);
+
+	ret = sqfs_search_dir(dirs, token_list, token_count);
 	if (ret)
 		goto out;
 
@@ -982,12 +1009,9 @@ out:
 	for (j = 0; j < token_count; j++)
 		free(token_list[j]);
 	free(token_list);
-	free(pos_list);
 	free(path);
-	if (ret) {
-		free(inode_table);
-		free(dirs);
-	}
+	if (ret)
+		sqfs_closedir((struct fs_dir_stream *)dirs);
 
 	return ret;
 }
@@ -1006,14 +1030,13 @@ int sqfs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
 
 static int sqfs_readdir_nest(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
 {
-	struct squashfs_super_block *sblk = ctxt.sblk;
 	struct squashfs_dir_stream *dirs;
 	struct squashfs_lreg_inode *lreg;
 	struct squashfs_base_inode *base;
 	struct squashfs_reg_inode *reg;
-	int i_number, offset = 0, ret;
 	struct fs_dirent *dent;
 	unsigned char *ipos;
+	int offset = 0, ret;
 	u16 name_size;
 
 	dirs = (struct squashfs_dir_stream *)fs_dirs;
@@ -1051,10 +1074,8 @@ static int sqfs_readdir_nest(struct fs_dir_stream *fs_dirs, struct fs_dirent **d
 			return -SQFS_STOP_READDIR;
 	}
 
-	i_number = dirs->dir_header->inode_number + dirs->entry->inode_offset;
-	ipos = sqfs_find_inode(dirs->inode_table, i_number, sblk->inodes,
-			       sblk->block_size);
-	if (!ipos)
+	ret = sqfs_read_inode(sqfs_entry_ref(dirs), (void **)&ipos);
+	if (ret)
 		return -SQFS_STOP_READDIR;
 
 	base = (struct squashfs_base_inode *)ipos;
@@ -1096,8 +1117,10 @@ static int sqfs_readdir_nest(struct fs_dir_stream *fs_dirs, struct fs_dirent **d
 		dent->type = FS_DT_LNK;
 		break;
 	default:
+		free(ipos);
 		return -SQFS_STOP_READDIR;
 	}
+	free(ipos);
 
 	/* Set entry name (capped at FS_DIRENT_NAME_LEN which is a U-Boot limitation) */
 	name_size = min_t(u16, dirs->entry->name_size + 1, FS_DIRENT_NAME_LEN - 1);
@@ -1126,8 +1149,13 @@ int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition
 	struct squashfs_super_block *sblk;
 	int ret;
 
+	/* Drop anything cached from a filesystem probed earlier */
+	if (ctxt.sblk)
+		sqfs_close();
+
 	ctxt.cur_dev = fs_dev_desc;
 	ctxt.cur_part_info = *fs_partition;
+	ctxt.write_gen = fs_dev_desc->write_gen;
 
 	ret = sqfs_read_sblk(&sblk);
 	if (ret)
@@ -1147,6 +1175,11 @@ int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition
 		goto error;
 	}
 
+	sqfs_cache_init(&ctxt.meta_cache, CONFIG_FS_SQUASHFS_METADATA_CACHE,
+			SQFS_METADATA_BLOCK_SIZE);
+	sqfs_cache_init(&ctxt.frag_cache, CONFIG_FS_SQUASHFS_FRAGMENT_CACHE,
+			get_unaligned_le32(&sblk->block_size));
+
 	return 0;
 error:
 	ctxt.cur_dev = NULL;
@@ -1353,10 +1386,8 @@ static int sqfs_get_lregfile_info(struct squashfs_lreg_inode *lreg,
 static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 			  loff_t len, loff_t *actread)
 {
-	char *dir = NULL, *fragment_block, *datablock = NULL;
-	char *fragment = NULL, *file = NULL, *resolved, *data;
 	u64 start, n_blks, table_size, data_offset, table_offset, sparse_size;
-	int ret, j, i_number, datablk_count = 0;
+	char *dir = NULL, *datablock = NULL, *file = NULL, *resolved, *data;
 	struct squashfs_super_block *sblk = ctxt.sblk;
 	struct squashfs_fragment_block_entry frag_entry;
 	struct squashfs_file_info finfo = {0};
@@ -1366,9 +1397,11 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 	struct squashfs_lreg_inode *lreg;
 	struct squashfs_base_inode *base;
 	struct squashfs_reg_inode *reg;
+	struct sqfs_cache_entry *fragment;
+	unsigned char *ipos = NULL;
+	int ret, j, datablk_count = 0;
 	unsigned long dest_len;
 	struct fs_dirent *dent;
-	unsigned char *ipos;
 
 	*actread = 0;
 
@@ -1381,8 +1414,8 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 	}
 
 	/*
-	 * sqfs_opendir_nest will uncompress inode and directory tables, and will
-	 * return a pointer to the directory that contains the requested file.
+	 * sqfs_opendir_nest will read the listing of the directory that
+	 * contains the requested file.
 	 */
 	sqfs_split_path(&file, &dir, filename);
 	ret = sqfs_opendir_nest(dir, &dirsp);
@@ -1409,10 +1442,9 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 		goto out;
 	}
 
-	i_number = dirs->dir_header->inode_number + dirs->entry->inode_offset;
-	ipos = sqfs_find_inode(dirs->inode_table, i_number, sblk->inodes,
-			       sblk->block_size);
-	if (!ipos) {
+	ret = sqfs_read_inode(sqfs_entry_ref(dirs), (void **)&ipos);
+	if (ret) {
+		ipos = NULL;
 		ret = -EINVAL;
 		goto out;
 	}
@@ -1568,53 +1600,22 @@ static int sqfs_read_nest(const char *filename, void *buf, loff_t offset,
 		goto out;
 	}
 
-	start = lldiv(frag_entry.start, ctxt.cur_dev->blksz);
-	table_size = SQFS_BLOCK_SIZE(frag_entry.size);
-	table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
-	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
-
-	fragment = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-
-	if (!fragment) {
-		ret = -ENOMEM;
+	ret = sqfs_get_fragment(&frag_entry, finfo.comp, &fragment);
+	if (ret)
 		goto out;
-	}
 
-	ret = sqfs_disk_read(start, n_blks, fragment);
-	if (ret < 0)
+	if (finfo.offset > fragment->size ||
+	    finfo.size - *actread > fragment->size - finfo.offset) {
+		ret = -EINVAL;
 		goto out;
-
-	/* File compressed and fragmented */
-	if (finfo.frag && finfo.comp) {
-		dest_len = get_unaligned_le32(&sblk->block_size);
-		fragment_block = malloc(dest_len);
-		if (!fragment_block) {
-			ret = -ENOMEM;
-			goto out;
-		}
-
-		ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
-				      (void *)fragment  + table_offset,
-				      frag_entry.size);
-		if (ret) {
-			free(fragment_block);
-			goto out;
-		}
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
-
-		free(fragment_block);
-
-	} else if (finfo.frag && !finfo.comp) {
-		fragment_block = (void *)fragment + table_offset;
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
 	}
 
+	memcpy(buf + *actread, fragment->data + finfo.offset,
+	       finfo.size - *actread);
+	*actread = finfo.size;
+
 out:
-	free(fragment);
+	free(ipos);
 	free(datablock);
 	free(file);
 	free(dir);
@@ -1633,7 +1634,6 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 
 static int sqfs_size_nest(const char *filename, loff_t *size)
 {
-	struct squashfs_super_block *sblk = ctxt.sblk;
 	struct squashfs_symlink_inode *symlink;
 	struct fs_dir_stream *dirsp = NULL;
 	struct squashfs_base_inode *base;
@@ -1641,14 +1641,14 @@ static int sqfs_size_nest(const char *filename, loff_t *size)
 	struct squashfs_lreg_inode *lreg;
 	struct squashfs_reg_inode *reg;
 	char *dir, *file, *resolved;
+	unsigned char *ipos = NULL;
 	struct fs_dirent *dent;
-	unsigned char *ipos;
-	int ret, i_number;
+	int ret;
 
 	sqfs_split_path(&file, &dir, filename);
 	/*
-	 * sqfs_opendir_nest will uncompress inode and directory tables, and will
-	 * return a pointer to the directory that contains the requested file.
+	 * sqfs_opendir_nest will read the listing of the directory that
+	 * contains the requested file.
 	 */
 	ret = sqfs_opendir_nest(dir, &dirsp);
 	if (ret) {
@@ -1673,11 +1673,9 @@ static int sqfs_size_nest(const char *filename, loff_t *size)
 		goto free_strings;
 	}
 
-	i_number = dirs->dir_header->inode_number + dirs->entry->inode_offset;
-	ipos = sqfs_find_inode(dirs->inode_table, i_number, sblk->inodes,
-			       sblk->block_size);
-
-	if (!ipos) {
+	ret = sqfs_read_inode(sqfs_entry_ref(dirs), (void **)&ipos);
+	if (ret) {
+		ipos = NULL;
 		*size = 0;
 		ret = -EINVAL;
 		goto free_strings;
@@ -1700,7 +1698,8 @@ static int sqfs_size_nest(const char *filename, loff_t *size)
 	case SQFS_LSYMLINK_TYPE:
 		if (++symlinknest == MAX_SYMLINK_NEST) {
 			*size = 0;
-			return -ELOOP;
+			ret = -ELOOP;
+			break;
 		}
 
 		symlink = (struct squashfs_symlink_inode *)ipos;
@@ -1724,6 +1723,7 @@ static int sqfs_size_nest(const char *filename, loff_t *size)
 	}
 
 free_strings:
+	free(ipos);
 	free(dir);
 	free(file);
 
@@ -1742,8 +1742,8 @@ int sqfs_exists(const char *filename)
 
 	sqfs_split_path(&file, &dir, filename);
 	/*
-	 * sqfs_opendir_nest will uncompress inode and directory tables, and will
-	 * return a pointer to the directory that contains the requested file.
+	 * sqfs_opendir_nest will read the listing of the directory that
+	 * contains the requested file.
 	 */
 	symlinknest = 0;
 	ret = sqfs_opendir_nest(dir, &dirsp);
@@ -1779,12 +1779,53 @@ int sqfs_size(const char *filename, loff_t *size)
 
 void sqfs_close(void)
 {
+	debug("%s: metadata cache %lu hits %lu misses, fragment cache %lu hits %lu misses\n",
+	      __func__, ctxt.meta_cache.hits, ctxt.meta_cache.misses,
+	      ctxt.frag_cache.hits, ctxt.frag_cache.misses);
+	sqfs_cache_free(&ctxt.meta_cache);
+	sqfs_cache_free(&ctxt.frag_cache);
+	free(ctxt.frag_index);
+	ctxt.frag_index = NULL;
 	sqfs_decompressor_cleanup(&ctxt);
 	free(ctxt.sblk);
 	ctxt.sblk = NULL;
 	ctxt.cur_dev = NULL;
 }
 
+void sqfs_release(void)
+{
+	/*
+	 * Keep the caches for the next command. They are emptied by
+	 * sqfs_close(), or by sqfs_is_mounted() once the device changes.
+	 */
+}
+
+bool sqfs_is_mounted(struct blk_desc *fs_dev_desc,
+		     struct disk_partition *fs_partition)
+{
+	if (!ctxt.sblk)
+		return false;
+	if (ctxt.cur_dev == fs_dev_desc &&
+	    ctxt.write_gen == fs_dev_desc->write_gen &&
+	    ctxt.cur_part_info.start == fs_partition->start &&
+	    ctxt.cur_part_info.size == fs_partition->size)
+		return true;
+
+	/* The cached blocks may no longer match what is on the device */
+	sqfs_cache_empty(&ctxt.meta_cache);
+	sqfs_cache_empty(&ctxt.frag_cache);
+
+	return false;
+}
+
+void sqfs_get_cache_stats(struct sqfs_cache_stats *stats)
+{
+	stats->meta_hits = ctxt.meta_cache.hits;
+	stats->meta_misses = ctxt.meta_cache.misses;
+	stats->frag_hits = ctxt.frag_cache.hits;
+	stats->frag_misses = ctxt.frag_cache.misses;
+}
+
 void sqfs_closedir(struct fs_dir_stream *dirs)
 {
 	struct squashfs_dir_stream *sqfs_dirs;
@@ -1793,7 +1834,6 @@ void sqfs_closedir(struct fs_dir_stream *dirs)
 		return;
 
 	sqfs_dirs = (struct squashfs_dir_stream *)dirs;
-	free(sqfs_dirs->inode_table);
 	free(sqfs_dirs->dir_table);
 	free(sqfs_dirs->dir_header);
 	free(sqfs_dirs);
@@ -71,13 +71,57 @@ struct squashfs_super_block {
 	__le64 export_table_start;
 };
 
+/**
+ * struct sqfs_cache_entry - a decompressed block kept in memory
+ *
+ * @pos: Byte offset of the block on disk (of its header, for metadata)
+ * @next: Byte offset of the metadata block following this one on disk
+ * @size: Number of bytes of decompressed data
+ * @lru: Cache clock value when last used, or 0 if the entry is empty
+ * @data: Decompressed data, allocated when the entry is first filled
+ */
+struct sqfs_cache_entry {
+	u64 pos;
+	u64 next;
+	u32 size;
+	ulong lru;
+	void *data;
+};
+
+/**
+ * struct sqfs_cache - least-recently-used cache of decompressed blocks
+ *
+ * @entries: Cache entries
+ * @count: Number of entries
+ * @block_size: Size of the data buffer of each entry
+ * @clock: Incremented on each use of an entry
+ * @hits: Number of lookups found in the cache
+ * @misses: Number of lookups which had to read the disk
+ */
+struct sqfs_cache {
+	struct sqfs_cache_entry *entries;
+	int count;
+	u32 block_size;
+	ulong clock;
+	ulong hits;
+	ulong misses;
+};
+
 struct squashfs_ctxt {
 	struct disk_partition cur_part_info;
 	struct blk_desc *cur_dev;
+	/* Value of cur_dev->write_gen when the filesystem was probed */
+	uint write_gen;
 	struct squashfs_super_block *sblk;
 #if IS_ENABLED(CONFIG_ZSTD)
 	void *zstd_workspace;
 #endif
+	/* Decompressed inode, directory and fragment table blocks */
+	struct sqfs_cache meta_cache;
+	/* Decompressed fragment blocks */
+	struct sqfs_cache frag_cache;
+	/* Fragment index table, read when a fragment is first looked up */
+	__le64 *frag_index;
 };
 
 struct squashfs_directory_index {
@@ -262,19 +306,18 @@ struct squashfs_dir_stream {
 	struct squashfs_directory_header *dir_header;
 	struct squashfs_directory_entry *entry;
 	/*
-	 * 'table' points to a position into the directory table. Both 'table'
-	 * and 'inode' are defined for the first time in sqfs_opendir().
-	 * 'table's value changes in sqfs_readdir().
+	 * 'table' points to a position into the directory listing. It is
+	 * defined for the first time in sqfs_opendir(), and its value changes
+	 * in sqfs_readdir().
 	 */
 	unsigned char *table;
 	union squashfs_inode i;
 	struct squashfs_dir_inode i_dir;
 	struct squashfs_ldir_inode i_ldir;
 	/*
-	 * References to the tables' beginnings. They are assigned in
-	 * sqfs_opendir() and freed in sqfs_closedir().
+	 * The decompressed listing of the directory being read. It is
+	 * assigned in sqfs_opendir() and freed in sqfs_closedir().
 	 */
-	unsigned char *inode_table;
 	unsigned char *dir_table;
 };
 
@@ -293,10 +336,9 @@ struct squashfs_file_info {
 	bool comp;
 };
 
-void *sqfs_find_inode(void *inode_table, int inode_number, __le32 inode_count,
-		      __le32 block_size);
+int sqfs_inode_size(struct squashfs_base_inode *inode, u32 blk_size);
 
-int sqfs_dir_offset(void *dir_i, u32 *m_list, int m_count);
+int sqfs_inode_fixed_size(u16 type);
 
 int sqfs_read_metablock(unsigned char *file_mapping, int offset,
 			bool *compressed, u32 *data_size);
@@ -109,36 +109,39 @@ int sqfs_inode_size(struct squashfs_base_inode *inode, u32 blk_size)
 }
 
 /*
- * Given the uncompressed inode table, the inode to be found and the number of
- * inodes in the table, return inode position in case of success.
+ * Return the size of the fixed part of an inode of the given type, i.e. without
+ * its block list, symlink target or directory index
  */
-void *sqfs_find_inode(void *inode_table, int inode_number, __le32 inode_count,
-		      __le32 block_size)
+int sqfs_inode_fixed_size(u16 type)
 {
-	struct squashfs_base_inode *base;
-	unsigned int offset = 0, k;
-	int sz;
-
-	if (!inode_table) {
-		printf("%s: Invalid pointer to inode table.\n", __func__);
-		return NULL;
-	}
-
-	for (k = 0; k < le32_to_cpu(inode_count); k++) {
-		base = inode_table + offset;
-		if (get_unaligned_le32(&base->inode_number) == inode_number)
-			return inode_table + offset;
-
-		sz = sqfs_inode_size(base, le32_to_cpu(block_size));
-		if (sz < 0)
-			return NULL;
-
-		offset += sz;
+	switch (type) {
+	case SQFS_DIR_TYPE:
+		return sizeof(struct squashfs_dir_inode);
+	case SQFS_REG_TYPE:
+		return sizeof(struct squashfs_reg_inode);
+	case SQFS_LDIR_TYPE:
+		return sizeof(struct squashfs_ldir_inode);
+	case SQFS_LREG_TYPE:
+		return sizeof(struct squashfs_lreg_inode);
+	case SQFS_SYMLINK_TYPE:
+	case SQFS_LSYMLINK_TYPE:
+		return sizeof(struct squashfs_symlink_inode);
+	case SQFS_BLKDEV_TYPE:
+	case SQFS_CHRDEV_TYPE:
+		return sizeof(struct squashfs_dev_inode);
+	case SQFS_LBLKDEV_TYPE:
+	case SQFS_LCHRDEV_TYPE:
+		return sizeof(struct squashfs_ldev_inode);
+	case SQFS_FIFO_TYPE:
+	case SQFS_SOCKET_TYPE:
+		return sizeof(struct squashfs_ipc_inode);
+	case SQFS_LFIFO_TYPE:
+	case SQFS_LSOCKET_TYPE:
+		return sizeof(struct squashfs_lipc_inode);
+	default:
+		printf("Error while reading inode: unknown type.\n");
+		return -EINVAL;
 	}
-
-	printf("Inode not found.\n");
-
-	return NULL;
 }
 
 int sqfs_read_metablock(unsigned char *file_mapping, int offset,
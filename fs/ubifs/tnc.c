@@ -1206,6 +1206,9 @@ int ubifs_lookup_level0(struct ubifs_info *c, const union ubifs_key *key,
 		if (zbr->znode) {
 			znode->time = time;
 			znode = zbr->znode;
+#ifdef __UBOOT__
+			c->zn_hits++;
+#endif
 			continue;
 		}
 
@@ -417,6 +417,9 @@ struct ubifs_znode *ubifs_load_znode(struct ubifs_info *c,
 		goto out;
 
 	atomic_long_inc(&c->clean_zn_cnt);
+#ifdef __UBOOT__
+	c->zn_reads++;
+#endif
 
 	/*
 	 * Increment the global clean znode counter as well. It is OK that
@@ -721,23 +721,13 @@ static inline void *kmap(struct page *page)
 	return page->addr;
 }
 
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+static int read_data_node(struct ubifs_info *c, struct inode *inode,
+			  void *addr, unsigned int block,
+			  struct ubifs_data_node *dn)
 {
-	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
 	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
 
 	len = le32_to_cpu(dn->size);
@@ -768,6 +758,73 @@ dump:
 	return -EINVAL;
 }
 
+static int read_block(struct inode *inode, void *addr, unsigned int block,
+		      struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	union ubifs_key key;
+	int err;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err) {
+		if (err == -ENOENT)
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		return err;
+	}
+	c->dn_reads++;
+
+	return read_data_node(c, inode, addr, block, dn);
+}
+
+/*
+ * Files are mostly written in one go, so their data nodes usually sit next to
+ * each other in the same LEB. Read as many of them as fit into the bulk-read
+ * buffer with a single LEB read and serve the following blocks from there.
+ * Fall back to reading a single node if that does not work out.
+ */
+static int read_block_bulk(struct inode *inode, void *addr, unsigned int block,
+			   struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	struct bu_info *bu = &c->bu;
+	unsigned int first = key_block(c, &bu->key);
+	int err, i;
+
+	if (!c->bulk_read)
+		return read_block(inode, addr, block, dn);
+
+	if (!bu->cnt || key_inum(c, &bu->key) != inode->i_ino ||
+	    block < first || block >= first + bu->blk_cnt) {
+		data_key_init(c, &bu->key, inode->i_ino, block);
+		bu->buf_len = c->max_bu_buf_len;
+		err = ubifs_tnc_get_bu_keys(c, bu);
+		if (!err && bu->cnt)
+			err = ubifs_tnc_bulk_read(c, bu);
+		if (err || !bu->cnt) {
+			bu->cnt = 0;
+			return read_block(inode, addr, block, dn);
+		}
+		c->bu_reads++;
+		c->bu_nodes += bu->cnt;
+	}
+
+	for (i = 0; i < bu->cnt; i++) {
+		struct ubifs_zbranch *zbr = &bu->zbranch[i];
+
+		if (key_block(c, &zbr->key) == block)
+			return read_data_node(c, inode, addr, block,
+					      bu->buf + zbr->offs -
+					      bu->zbranch[0].offs);
+	}
+
+	/* Within the range read but not found, so it must be a hole */
+	memset(addr, 0, UBIFS_BLOCK_SIZE);
+
+	return -ENOENT;
+}
+
 static int do_readpage(struct ubifs_info *c, struct inode *inode,
 		       struct page *page, int last_block_size)
 {
@@ -847,7 +904,7 @@ static int do_readpage(struct ubifs_info *c, struct inode *inode,
 
 				free(buff);
 			} else {
-				ret = read_block(inode, addr, block, dn);
+				ret = read_block_bulk(inode, addr, block, dn);
 				if (ret) {
 					err = ret;
 					if (err != -ENOENT)
@@ -914,6 +971,9 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 		goto out;
 	}
 
+	/* Do not serve blocks from what an earlier read left in the buffer */
+	c->bu.cnt = 0;
+
 	/*
 	 * Read file inode
 	 */
@@ -993,6 +1053,23 @@ int ubifs_load(char *filename, unsigned long addr, u32 size)
 	return err;
 }
 
+void ubifs_stats(void)
+{
+	struct ubifs_info *c;
+
+	if (!ubifs_is_mounted()) {
+		printf("UBIFS not mounted, use ubifsmount to mount volume first!\n");
+		return;
+	}
+
+	c = ubifs_sb->s_fs_info;
+	printf("Volume: %s\n", c->vi.name);
+	printf("Index:  %ld znodes cached, %lu hits, %lu read from flash\n",
+	       atomic_long_read(&c->clean_zn_cnt), c->zn_hits, c->zn_reads);
+	printf("Data:   %lu nodes in %lu bulk reads, %lu single reads\n",
+	       c->bu_nodes, c->bu_reads, c->dn_reads);
+}
+
 void uboot_ubifs_umount(void)
 {
 	if (ubifs_sb) {
@@ -1654,6 +1654,11 @@ struct ubifs_debug_info;
  * @max_bu_buf_len: maximum bulk-read buffer length
  * @bu_mutex: protects the pre-allocated bulk-read buffer and @c->bu
  * @bu: pre-allocated bulk-read information
+ * @zn_hits: number of index lookup steps served from the TNC (U-Boot only)
+ * @zn_reads: number of znodes read from the flash (U-Boot only)
+ * @bu_reads: number of bulk-reads done when loading files (U-Boot only)
+ * @bu_nodes: number of data nodes read by bulk-reads (U-Boot only)
+ * @dn_reads: number of data nodes read one at a time (U-Boot only)
  *
  * @write_reserve_mutex: protects @write_reserve_buf
  * @write_reserve_buf: on the write path we allocate memory, which might
@@ -1896,6 +1901,13 @@ struct ubifs_info {
 	int max_bu_buf_len;
 	struct mutex bu_mutex;
 	struct bu_info bu;
+#ifdef __UBOOT__
+	unsigned long zn_hits;
+	unsigned long zn_reads;
+	unsigned long bu_reads;
+	unsigned long bu_nodes;
+	unsigned long dn_reads;
+#endif
 
 	struct mutex write_reserve_mutex;
 	void *write_reserve_buf;
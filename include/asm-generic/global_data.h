@@ -257,6 +257,17 @@ struct global_data {
 	void *dm_priv_base;
 # endif
 #endif
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	/**
+	 * @dm_compat_index: index of the compatible strings of all drivers,
+	 * sorted by hash, used to bind devicetree nodes
+	 */
+	struct dm_compat_entry *dm_compat_index;
+	/**
+	 * @dm_compat_count: number of entries in @dm_compat_index
+	 */
+	int dm_compat_count;
+#endif
 #ifdef CONFIG_TIMER
 	/**
 	 * @timer: timer instance for Driver Model
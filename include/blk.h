@@ -10,6 +10,7 @@
 #include <bouncebuf.h>
 #include <dm/uclass-id.h>
 #include <efi.h>
+#include <linux/list.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -80,6 +81,7 @@ struct blk_desc {
 		uint32_t mbr_sig;	/* MBR integer signature */
 		efi_guid_t guid_sig;	/* GPT GUID Signature */
 	};
+	uint		write_gen;	/* bumped by each write or erase */
 #if CONFIG_IS_ENABLED(BLK)
 	/*
 	 * For now we have a few functions which take struct blk_desc as a
@@ -140,6 +142,44 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_readahead() - get a buffer for reading ahead after a cache miss
+ *
+ * If reads from the device have been sequential, this works out how many
+ * blocks should be read in total to satisfy the request and read ahead, so
+ * that following reads can be served from the cache. The window grows while
+ * reads stay sequential and shrinks when read-ahead blocks go unused.
+ *
+ * @param iftype - uclass_id_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks requested
+ * @param blksz - size in bytes of each block
+ * @param lba_max - number of blocks on the device
+ * @param countp - returns the total number of blocks to read from @start
+ *
+ * Return: buffer owned by the cache to read *@countp blocks into, or NULL if
+ * no readahead should be done
+ */
+void *blkcache_readahead(int iftype, int dev,
+			 lbaint_t start, lbaint_t blkcnt,
+			 unsigned long blksz, lbaint_t lba_max,
+			 lbaint_t *countp);
+
+/**
+ * blkcache_fill_readahead() - make blocks read ahead available to the cache
+ *
+ * @param iftype - uclass_id_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks available
+ * @param blksz - size in bytes of each block
+ * @param buffer - buffer containing data to cache
+ */
+void blkcache_fill_readahead(int iftype, int dev,
+			     lbaint_t start, lbaint_t blkcnt,
+			     unsigned long blksz, void const *buffer);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
  * because of a write or device (re)initialization.
@@ -166,15 +206,40 @@ struct block_cache_stats {
 	unsigned entries; /* current entry count */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
+	unsigned ways; /* entries per hash set */
+};
+
+/*
+ * per-device statistics of the block cache
+ */
+struct block_cache_dev_stats {
+	int iftype;
+	int devnum;
+	unsigned hits;
+	unsigned misses;
+	unsigned ra_blocks; /* blocks read ahead */
+	unsigned ra_used; /* blocks read ahead which were then used */
+	u64 bytes_saved; /* bytes returned from the cache */
 };
 
 /**
  * get_blkcache_stats() - return statistics and reset
  *
+ * This resets the per-device statistics too.
+ *
  * @param stats - statistics are copied here
  */
 void blkcache_stats(struct block_cache_stats *stats);
 
+/**
+ * blkcache_dev_stats() - return statistics for a device
+ *
+ * @param index - index of device, starting at 0
+ * @param stats - statistics are copied here
+ * Return: 0 if OK, -ENOENT if there is no device with that index
+ */
+int blkcache_dev_stats(int index, struct block_cache_dev_stats *stats);
+
 /** blkcache_free() - free all memory allocated to the block cache */
 void blkcache_free(void);
 
@@ -191,6 +256,19 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline void *blkcache_readahead(int iftype, int dev,
+				       lbaint_t start, lbaint_t blkcnt,
+				       unsigned long blksz, lbaint_t lba_max,
+				       lbaint_t *countp)
+{
+	return NULL;
+}
+
+static inline void blkcache_fill_readahead(int iftype, int dev,
+					   lbaint_t start, lbaint_t blkcnt,
+					   unsigned long blksz,
+					   void const *buffer) {}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
 static inline void blkcache_free(void) {}
@@ -199,6 +277,61 @@ static inline void blkcache_free(void) {}
 
 struct udevice;
 
+/**
+ * enum blk_req_op - operation requested by an asynchronous block request
+ *
+ * @BLK_REQ_READ: Read blocks into the buffer
+ * @BLK_REQ_WRITE: Write blocks from the buffer
+ */
+enum blk_req_op {
+	BLK_REQ_READ,
+	BLK_REQ_WRITE,
+};
+
+struct blk_req;
+
+/**
+ * typedef blk_req_done_t - function called when a block request completes
+ *
+ * @req: Request which has completed, with @req->result set
+ */
+typedef void (*blk_req_done_t)(struct blk_req *req);
+
+/**
+ * struct blk_req - an asynchronous block request
+ *
+ * The caller fills in the operation, blocks and buffer, and optionally @done
+ * and @priv, then calls blk_submit(). The request, and the buffer, must not be
+ * touched until the request completes.
+ *
+ * @op: Operation to perform
+ * @start: Start block number (0=first)
+ * @blkcnt: Number of blocks to transfer
+ * @buffer: Buffer to read into or write from
+ * @done: Function to call when the request completes, or NULL
+ * @priv: Private data for the caller, e.g. for use by @done
+ * @dev: Block device the request was submitted to, set by blk_submit()
+ * @result: Number of blocks transferred, or -ve error, once complete
+ * @complete: true once the request has completed
+ * @write_gen: Value of the device's write_gen when the request was
+ *	submitted, so that a read does not fill the block cache with data
+ *	which a write made out of date while the read was in progress
+ * @sibling: Node for use by the driver while the request is in progress
+ */
+struct blk_req {
+	enum blk_req_op op;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	blk_req_done_t done;
+	void *priv;
+	struct udevice *dev;
+	long result;
+	bool complete;
+	uint write_gen;
+	struct list_head sibling;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -258,6 +391,32 @@ struct blk_ops {
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
 
+	/**
+	 * submit() - start an asynchronous request (optional)
+	 *
+	 * This starts the request and returns without waiting for it to
+	 * complete. When it completes, the driver calls blk_req_complete(),
+	 * normally from its poll() method. Drivers which implement this must
+	 * also implement poll().
+	 *
+	 * @dev:	Block device to use
+	 * @req:	Request to start
+	 * @return 0 if started, -EBUSY if the device cannot accept another
+	 * request until one completes, other -ve on error
+	 */
+	int (*submit)(struct udevice *dev, struct blk_req *req);
+
+	/**
+	 * poll() - complete any asynchronous requests which have finished
+	 *
+	 * This calls blk_req_complete() for each request which has finished
+	 * since the last call.
+	 *
+	 * @dev:	Block device to check
+	 * @return number of requests still in progress, or -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
+
 #if IS_ENABLED(CONFIG_BOUNCE_BUFFER)
 	/**
 	 * buffer_aligned() - test memory alignment of block operation buffer
@@ -331,6 +490,60 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
  */
 long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt);
 
+/**
+ * blk_submit() - Start an asynchronous read or write
+ *
+ * This starts @req and returns, so that the caller can do other work while
+ * the device transfers the data. Use blk_poll() or blk_wait() to find out
+ * when it has completed, at which point @req->done is called, if set.
+ *
+ * If the driver does not support asynchronous requests, or the buffer must
+ * be bounced, the request is carried out before this returns. A read which
+ * is satisfied by the block cache also completes straight away.
+ *
+ * @dev: Device to use
+ * @req: Request to start
+ * Return: 0 if started (or completed), -EBUSY if the device cannot accept
+ * another request until one completes, other -ve on error
+ */
+int blk_submit(struct udevice *dev, struct blk_req *req);
+
+/**
+ * blk_poll() - Check for completion of asynchronous requests
+ *
+ * This completes any requests on @dev which have finished, calling their
+ * @done functions.
+ *
+ * @dev: Device to check
+ * Return: number of requests still in progress, or -ve on error
+ */
+int blk_poll(struct udevice *dev);
+
+/**
+ * blk_wait() - Wait for an asynchronous request to complete
+ *
+ * This polls the device, completing any requests which finish in the
+ * meantime, until @req has completed.
+ *
+ * @dev: Device the request was submitted to
+ * @req: Request to wait for
+ * Return: number of blocks transferred (which may be less than
+ * @req->blkcnt), or -ve on error
+ */
+long blk_wait(struct udevice *dev, struct blk_req *req);
+
+/**
+ * blk_req_complete() - Mark a block request as complete
+ *
+ * This is called by drivers when a request has finished. It records the
+ * result, adds the data read to the block cache if the request came from
+ * blk_submit() and then calls the request's @done function.
+ *
+ * @req: Request which has completed
+ * @result: Number of blocks transferred, or -ve on error
+ */
+void blk_req_complete(struct blk_req *req, long result);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -549,6 +762,7 @@ static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
 	blkcache_invalidate(block_dev->uclass_id, block_dev->devnum);
+	block_dev->write_gen++;
 	return block_dev->block_write(block_dev, start, blkcnt, buffer);
 }
 
@@ -556,6 +770,7 @@ static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
 	blkcache_invalidate(block_dev->uclass_id, block_dev->devnum);
+	block_dev->write_gen++;
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
@@ -217,6 +217,13 @@ enum bootstage_id {
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
 	BOOTSTAGE_ID_ALLOC,
+
+	/*
+	 * Later additions go here, well above the IDs allocated from
+	 * BOOTSTAGE_ID_USER, so that the IDs above keep their values
+	 */
+	BOOTSTAGE_ID_ACCUM_DM_INDEX = 0x400,
+	BOOTSTAGE_ID_ACCUM_DECOMP_CPU,
 };
 
 /*
@@ -335,6 +342,21 @@ uint32_t bootstage_start(enum bootstage_id id, const char *name);
  */
 uint32_t bootstage_accum(enum bootstage_id id);
 
+/**
+ * Add time to an accumulated activity
+ *
+ * This is like bootstage_accum(), but for activities whose time is measured
+ * elsewhere, e.g. work spread over several CPUs, which can take more time
+ * in total than has passed.
+ *
+ * @param id	Bootstage id to record this time against
+ * @param name	Textual name to display for this id in the report (maybe NULL)
+ * @param duration	Time in microseconds to add
+ * Return: total time accumulated for this id
+ */
+uint32_t bootstage_accum_add(enum bootstage_id id, const char *name,
+			     uint32_t duration);
+
 /* Print a report about boot time */
 void bootstage_report(void);
 
@@ -435,6 +457,12 @@ static inline uint32_t bootstage_accum(enum bootstage_id id)
 	return 0;
 }
 
+static inline uint32_t bootstage_accum_add(enum bootstage_id id,
+					   const char *name, uint32_t duration)
+{
+	return 0;
+}
+
 static inline int bootstage_stash(void *base, int size)
 {
 	return 0;	/* Pretend to succeed */
@@ -8,6 +8,7 @@
 #ifndef __INCLUDE_BOUNCEBUF_H__
 #define __INCLUDE_BOUNCEBUF_H__
 
+#include <asm/cache.h>
 #include <linux/types.h>
 
 /*
@@ -83,4 +84,94 @@ int bounce_buffer_start_extalign(struct bounce_buffer *state, void *data,
  */
 int bounce_buffer_stop(struct bounce_buffer *state);
 
+/* Most segments a split buffer can have: head, middle and tail */
+#define BOUNCE_SPLIT_SEGS	3
+
+/**
+ * struct bounce_seg - Part of a buffer for a scatter-gather DMA engine
+ *
+ * @addr: Start of this part, aligned to ARCH_DMA_MINALIGN
+ * @len: Length of this part in bytes
+ */
+struct bounce_seg {
+	void *addr;
+	size_t len;
+};
+
+/**
+ * struct bounce_split - Buffer whose ends are bounced and middle used as is
+ *
+ * An unaligned buffer only shares its first and last cache lines with other
+ * data, so only these need to be bounced. The rest of the buffer is aligned
+ * and can be used for DMA directly. This suits DMA engines which take a list
+ * of segments, since the transfer has up to three of them.
+ *
+ * Where the buffer cannot be split, e.g. because it is very small, the whole
+ * buffer is bounced as with bounce_buffer_start(), giving one segment.
+ *
+ * @bb: Bounce-buffer state, used when the whole buffer is bounced
+ * @seg: Segments to use for the transfer, in order
+ * @count: Number of segments in @seg
+ * @split: true if the buffer has been split, false if @bb is used
+ * @ends: Bounce buffers for the head (first line) and tail (second line)
+ */
+struct bounce_split {
+	struct bounce_buffer bb;
+	struct bounce_seg seg[BOUNCE_SPLIT_SEGS];
+	int count;
+	bool split;
+	u8 ends[2 * ARCH_DMA_MINALIGN] __aligned(ARCH_DMA_MINALIGN);
+};
+
+/**
+ * bounce_split_start() -- Start a session, bouncing only the ends of a buffer
+ *
+ * The buffer is only split if @data is aligned to @granule, since each
+ * segment then has a length which is a multiple of @granule. Cache
+ * maintenance is done only on the lines used by the segments.
+ *
+ * state:	stores state passed between bounce_split_{start,stop}
+ * data:	pointer to buffer to be aligned
+ * len:		length of the buffer
+ * flags:	flags describing the transaction, see GEN_BB_...
+ * granule:	size which each segment length must be a multiple of (power
+ *		of two), e.g. the width of the DMA engine's bus
+ * Return: 0 if OK, -ENOMEM if the whole buffer must be bounced but there is
+ *	no memory
+ */
+int bounce_split_start(struct bounce_split *state, void *data, size_t len,
+		       unsigned int flags, size_t granule);
+
+/**
+ * bounce_split_stop() -- Finish a session started with bounce_split_start()
+ * state:	stores state passed between bounce_split_{start,stop}
+ */
+int bounce_split_stop(struct bounce_split *state);
+
+/**
+ * struct bounce_stats - Statistics on DMA transfers using bounce buffers
+ *
+ * These are only kept once U-Boot has relocated.
+ *
+ * @direct_bytes: Bytes transferred directly to or from the caller's buffer
+ * @bounced_bytes: Bytes copied through a bounce buffer
+ * @splits: Number of transfers which bounced only the ends of the buffer
+ */
+struct bounce_stats {
+	u64 direct_bytes;
+	u64 bounced_bytes;
+	uint splits;
+};
+
+/**
+ * bounce_buffer_get_stats() -- Get statistics on bounce-buffer use
+ * stats:	returns the statistics
+ */
+void bounce_buffer_get_stats(struct bounce_stats *stats);
+
+/**
+ * bounce_buffer_reset_stats() -- Reset the bounce-buffer statistics
+ */
+void bounce_buffer_reset_stats(void);
+
 #endif
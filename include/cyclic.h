@@ -11,6 +11,9 @@
 #ifndef __cyclic_h
 #define __cyclic_h
 
+#include <linker_lists.h>
+#include <dm/uclass-id.h>
+#include <linux/errno.h>
 #include <linux/list.h>
 #include <asm/types.h>
 #include <u-boot/schedule.h> // to be removed later
@@ -104,4 +107,114 @@ static inline int cyclic_unregister_all(void)
 }
 #endif /* CYCLIC */
 
+/**
+ * enum cyclic_job_state - state of a background job
+ *
+ * @CYCLIC_JOB_IDLE: Not started, or no longer current
+ * @CYCLIC_JOB_RUNNING: Started and not finished yet
+ * @CYCLIC_JOB_DONE: Finished, with its result in @ret
+ */
+enum cyclic_job_state {
+	CYCLIC_JOB_IDLE,
+	CYCLIC_JOB_RUNNING,
+	CYCLIC_JOB_DONE,
+};
+
+/**
+ * struct cyclic_job - a job which can run in the background, e.g. probing
+ *	devices
+ *
+ * A job runs in its own uthread, making progress each time the code running
+ * the console, autoboot or bootstd calls schedule(), e.g. while waiting for
+ * a key or for a device. Anything which needs the devices set up by the job
+ * waits for it with cyclic_job_wait_uclass() first.
+ *
+ * Driver model has no locking, so while a job is running nothing else may
+ * probe or remove devices in its uclass, or below them (e.g. hubs and storage
+ * on a USB controller). Removing a device in the uclass once the job is done
+ * returns the job to CYCLIC_JOB_IDLE, since its result is no longer current.
+ *
+ * @name: Name of the job, as used in the 'bgprobe' environment variable
+ * @uclass: Uclass of the devices set up by the job, or UCLASS_INVALID
+ * @func: Function to do the job. Return: 0 if OK, -ve on error
+ * @state: Current state of the job
+ * @ret: Value returned by @func, once the job is done
+ * @grp_id: uthread group running the job
+ * @start_us: Time the job started, in microseconds
+ * @time_us: Time the job took from start to finish, in microseconds
+ * @wait_us: Time spent by other code waiting for the job, in microseconds
+ */
+struct cyclic_job {
+	const char *name;
+	enum uclass_id uclass;
+	int (*func)(void);
+	enum cyclic_job_state state;
+	int ret;
+	uint grp_id;
+	ulong start_us;
+	ulong time_us;
+	ulong wait_us;
+};
+
+/* Declare a new background job */
+#define CYCLIC_JOB(__name)						\
+	ll_entry_declare(struct cyclic_job, __name, cyclic_job)
+
+#if CONFIG_IS_ENABLED(CYCLIC_JOBS)
+/**
+ * cyclic_jobs_start() - start background jobs
+ *
+ * Jobs which are already running are left alone. A job which is done is run
+ * again.
+ *
+ * @names: Space-separated list of names of the jobs to start, or NULL for
+ *	none
+ * Return: 0 if OK, -ENOENT if a job was not found, other -ve if a job could
+ *	not be started
+ */
+int cyclic_jobs_start(const char *names);
+
+/**
+ * cyclic_job_wait() - wait for a background job to finish
+ *
+ * @name: Name of the job
+ * Return: result of the job, or -ESRCH if it was not started
+ */
+int cyclic_job_wait(const char *name);
+
+/**
+ * cyclic_job_wait_uclass() - wait for background jobs setting up a uclass
+ *
+ * @id: Uclass ID
+ * Return: 0 if the jobs succeeded, -ESRCH if none was started for @id or
+ *	their results are no longer current, else the result of the first
+ *	job which failed
+ */
+int cyclic_job_wait_uclass(enum uclass_id id);
+
+/**
+ * cyclic_jobs_list() - show the state and timings of each background job
+ */
+void cyclic_jobs_list(void);
+#else
+static inline int cyclic_jobs_start(const char *names)
+{
+	return 0;
+}
+
+static inline int cyclic_job_wait(const char *name)
+{
+	return -ESRCH;
+}
+
+static inline int cyclic_job_wait_uclass(enum uclass_id id)
+{
+	return -ESRCH;
+}
+
+static inline void cyclic_jobs_list(void)
+{
+}
+#endif /* CYCLIC_JOBS */
+
 #endif
@@ -12,6 +12,8 @@
 #include <dm/ofnode.h>
 #include <dm/uclass-id.h>
 
+struct udevice_id;
+
 /**
  * lists_driver_lookup_name() - Return u_boot_driver corresponding to name
  *
@@ -45,6 +47,38 @@ struct uclass_driver *lists_uclass_lookup(enum uclass_id id);
  */
 int lists_bind_drivers(struct udevice *parent, bool pre_reloc_only);
 
+/**
+ * lists_driver_lookup_compat() - Find the driver for a compatible string
+ *
+ * This returns the first driver in the linker list whose of_match table
+ * contains @compat, using the index of compatible strings if available.
+ *
+ * @compat: Compatible string to look up
+ * @of_idp: Returns the matching entry in the driver's of_match table
+ * Return: pointer to driver, or NULL if not found
+ */
+struct driver *lists_driver_lookup_compat(const char *compat,
+					  const struct udevice_id **of_idp);
+
+/**
+ * lists_compat_index_init() - set up the index of compatible strings
+ *
+ * This builds an index of the compatible strings of all drivers, which
+ * lists_bind_fdt() uses to find the driver for a node without comparing
+ * against every driver. It does nothing if the index already exists. The
+ * time taken is recorded as the 'dm_index' bootstage record.
+ *
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+int lists_compat_index_init(void);
+#else
+static inline int lists_compat_index_init(void)
+{
+	return 0;
+}
+#endif
+
 /**
  * lists_bind_fdt() - bind a device tree node
  *
@@ -201,6 +201,9 @@ int ext4fs_open(const char *filename, loff_t *len);
 int ext4fs_read(char *buf, loff_t offset, loff_t len, loff_t *actread);
 int ext4fs_mount(void);
 void ext4fs_close(void);
+void ext4fs_release(void);
+bool ext4fs_is_mounted(struct blk_desc *fs_dev_desc,
+		       struct disk_partition *fs_partition);
 void ext4fs_reinit_global(void);
 int ext4fs_ls(const char *dirname);
 int ext4fs_exists(const char *filename);
@@ -25,7 +25,7 @@ struct disk_partition;
 #define DIRENTSPERCLUST	((mydata->clust_size * mydata->sect_size) / \
 			 sizeof(dir_entry))
 
-#define FATBUFBLOCKS	6
+#define FATBUFBLOCKS	CONFIG_VAL(FS_FAT_BUF_SECTORS)
 #define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
@@ -167,6 +167,8 @@ typedef struct {
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
 	__u8	fat_dirty;      /* Set if fatbuf has been modified */
+	__u16	dirty_lo;	/* First modified sector in fatbuf */
+	__u16	dirty_hi;	/* Sector after the last modified one */
 	__u32	rootdir_sect;	/* Start sector of root directory */
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
@@ -208,6 +210,8 @@ void fat_closedir(struct fs_dir_stream *dirs);
 int fat_unlink(const char *filename);
 int fat_mkdir(const char *dirname);
 void fat_close(void);
+void fat_release(void);
+bool fat_is_mounted(struct blk_desc *dev_desc, struct disk_partition *info);
 void *fat_next_cluster(fat_itr *itr, unsigned int *nbytes);
 
 /**
@@ -32,6 +32,50 @@ int fastboot_mmc_get_part_info(const char *part_name,
  */
 void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 			      u32 download_bytes, char *response);
+/**
+ * fastboot_mmc_stream_start() - Start writing an image while it downloads
+ *
+ * The image is written to the partition as it arrives, so it can be larger
+ * than the download buffer. Sparse images are expanded on the fly. The special
+ * names handled by fastboot_mmc_flash_write(), such as the GPT, cannot be
+ * used.
+ *
+ * @cmd: Named partition to write image to
+ * @buf: Buffer to use for staging the data
+ * @size: Size of @buf in bytes
+ * @response: Pointer to fastboot response buffer
+ * Return: 0 if OK, -ve on error, with @response set
+ */
+int fastboot_mmc_stream_start(const char *cmd, void *buf, u32 size,
+			      char *response);
+
+/**
+ * fastboot_mmc_stream_write() - Write the next part of a streamed image
+ *
+ * @data: Image data
+ * @len: Length of @data in bytes
+ * @response: Pointer to fastboot response buffer, set on error
+ * Return: 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_write(const void *data, u32 len, char *response);
+
+/**
+ * fastboot_mmc_stream_finish() - Finish writing a streamed image
+ *
+ * @response: Pointer to fastboot response buffer, set to OKAY if the whole
+ *	image was written
+ * Return: 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_finish(char *response);
+
+/**
+ * fastboot_mmc_stream_abort() - Abandon a streamed image without finishing it
+ *
+ * Whatever has been written so far is left as it is, so the partition holds
+ * an incomplete image.
+ */
+void fastboot_mmc_stream_abort(void);
+
 /**
  * fastboot_mmc_flash_erase() - Erase eMMC for fastboot
  *
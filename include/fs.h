@@ -90,6 +90,35 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part);
  */
 void fs_close(void);
 
+#if CONFIG_IS_ENABLED(FS_CACHE)
+/**
+ * fs_cache_invalidate() - note that a block device may have changed
+ *
+ * Filesystems cached on the device are unmounted and probed again the next
+ * time they are used. This is safe to call while a filesystem operation is in
+ * progress, e.g. from the block layer when the filesystem writes.
+ *
+ * @desc: Block device which changed, or NULL for all devices
+ */
+void fs_cache_invalidate(struct blk_desc *desc);
+
+/**
+ * fs_cache_flush() - unmount all cached filesystems
+ *
+ * This must not be called while a filesystem operation is in progress.
+ */
+void fs_cache_flush(void);
+
+/**
+ * fs_cache_show() - show the filesystems in the mount cache
+ */
+void fs_cache_show(void);
+#else
+static inline void fs_cache_invalidate(struct blk_desc *desc) {}
+static inline void fs_cache_flush(void) {}
+static inline void fs_cache_show(void) {}
+#endif
+
 /**
  * fs_get_type() - Get type of current filesystem
  *
@@ -34,6 +34,23 @@ int gzip_parse_header(const unsigned char *src, unsigned long len);
  */
 int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp);
 
+/**
+ * gunzip_parallel() - Decompress gzipped data, using several CPUs if possible
+ *
+ * If the data is in blocked gzip (BGZF) format, i.e. made of several members
+ * which each record their size, the members are decompressed in parallel by
+ * smp_worker_run(). Otherwise this is the same as gunzip().
+ *
+ * @dst: Destination for uncompressed data
+ * @dstlen: Size of destination buffer
+ * @src: Source data to decompress
+ * @lenp: On entry, length of data at @src. On exit, number of bytes of
+ * uncompressed data
+ * Return: 0 if OK, -ve on error
+ */
+int gunzip_parallel(void *dst, int dstlen, unsigned char *src,
+		    unsigned long *lenp);
+
 /**
  * zunzip() - Uncompress blocks compressed with zlib without headers
  *
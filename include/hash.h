@@ -120,6 +120,34 @@ int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 int hash_block(const char *algo_name, const void *data, unsigned int len,
 	       uint8_t *output, int *output_size);
 
+/**
+ * hash_progressive_submit() - Start hashing a buffer
+ *
+ * When the algorithm is handled by a hash device which can work in the
+ * background, this starts hashing @buf and returns straight away, so that
+ * the caller can (for example) read the next buffer while it is hashed. The
+ * caller must not change @buf until hash_progressive_poll() returns 0.
+ * Otherwise this is the same as calling @algo->hash_update().
+ *
+ * @algo:	Algorithm from hash_progressive_lookup_algo()
+ * @ctx:	Context from @algo->hash_init()
+ * @buf:	Data to hash
+ * @size:	Number of bytes in @buf
+ * Return: 0 if OK, -ve on error
+ */
+int hash_progressive_submit(struct hash_algo *algo, void *ctx,
+			    const void *buf, unsigned int size);
+
+/**
+ * hash_progressive_poll() - Check whether a submitted buffer has been hashed
+ *
+ * @algo:	Algorithm from hash_progressive_lookup_algo()
+ * @ctx:	Context from @algo->hash_init()
+ * Return: 0 if the buffer has been hashed, -EBUSY if it is still being
+ * hashed, other -ve on error
+ */
+int hash_progressive_poll(struct hash_algo *algo, void *ctx);
+
 #endif /* !USE_HOSTCC */
 
 /**
@@ -128,6 +156,10 @@ int hash_block(const char *algo_name, const void *data, unsigned int len,
  * The function returns the pointer to the struct or -EPROTONOSUPPORT if the
  * algorithm is not available.
  *
+ * With CONFIG_HASH_OFFLOAD, if a hash device supports the algorithm then the
+ * returned struct uses that device, falling back to software if the device
+ * cannot be used.
+ *
  * @algo_name: Hash algorithm to look up
  * @algop: Pointer to the hash_algo struct if found
  *
@@ -149,6 +181,19 @@ int hash_lookup_algo(const char *algo_name, struct hash_algo **algop);
 int hash_progressive_lookup_algo(const char *algo_name,
 				 struct hash_algo **algop);
 
+/**
+ * hash_get_soft_algo() - Get a software hash algorithm
+ *
+ * This ignores any hash devices, so it can be used to compare them with the
+ * software implementation.
+ *
+ * @index: Index of the algorithm (0 for the first)
+ * @algop: Returns a pointer to the hash_algo struct
+ *
+ * Return: 0 if ok, -ENOENT if @index is out of range
+ */
+int hash_get_soft_algo(int index, struct hash_algo **algop);
+
 /**
  * hash_parse_string() - Parse hash string into a binary array
  *
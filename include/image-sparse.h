@@ -27,8 +27,129 @@ struct sparse_storage {
 				 lbaint_t blkcnt);
 
 	void		(*mssg)(const char *str, char *response);
+
+	/*
+	 * Optional: start writing blocks and return without waiting. The
+	 * buffer is left alone until wait() returns. At most one write is
+	 * outstanding at a time. If this is NULL, write() is used.
+	 */
+	int		(*submit)(struct sparse_storage *info,
+				  lbaint_t blk,
+				  lbaint_t blkcnt,
+				  const void *buffer);
+
+	/* Wait for the write started by submit(); returns blocks written */
+	lbaint_t	(*wait)(struct sparse_storage *info);
+};
+
+/* State of a sparse_stream */
+enum sparse_stream_state {
+	SPARSE_FILE_HDR,	/* collecting the file header */
+	SPARSE_CHUNK_HDR,	/* collecting a chunk header */
+	SPARSE_SKIP,		/* skipping bytes, then going to @next */
+	SPARSE_RAW,		/* writing the data of a raw chunk */
+	SPARSE_FILL,		/* collecting the value for a fill chunk */
+	SPARSE_IMAGE,		/* not a sparse image: writing it as is */
+	SPARSE_DONE,		/* all chunks processed */
+	SPARSE_FAILED,		/* an error was reported */
 };
 
+/**
+ * struct sparse_stream - Writes a sparse image which arrives in pieces
+ *
+ * The image is written as it is received, so it does not have to be held in
+ * memory. Raw data is collected in a staging buffer and written when the
+ * buffer is full. If the storage has a submit() method the buffer is split in
+ * two, so one half can be filled while the other is being written.
+ *
+ * If the data does not start with a sparse-image header, it is written to the
+ * storage unchanged.
+ *
+ * @info: Storage to write to
+ * @state: Current state
+ * @next: State to go to after skipping (SPARSE_SKIP)
+ * @hdr: Sparse-image file header
+ * @chunk_hdr: Header of the current chunk
+ * @collect: Buffer for collecting a header or fill value
+ * @have: Number of bytes in @collect
+ * @skip: Number of bytes left to skip (SPARSE_SKIP)
+ * @left: Number of data bytes left in the current chunk (SPARSE_RAW)
+ * @chunk: Number of chunks processed
+ * @blk: Next block to write, not counting the data being staged
+ * @total_blocks: Number of sparse-image blocks processed
+ * @bytes_written: Number of bytes written, including fills
+ * @stage: Staging buffers (two if the storage supports submit())
+ * @stage_size: Size of each staging buffer in bytes
+ * @cur: Index of the staging buffer being filled
+ * @staged: Number of bytes in the staging buffer being filled
+ * @busy: true if a write started with submit() is outstanding
+ */
+struct sparse_stream {
+	struct sparse_storage *info;
+	enum sparse_stream_state state;
+	enum sparse_stream_state next;
+	sparse_header_t hdr;
+	chunk_header_t chunk_hdr;
+	u8 collect[sizeof(sparse_header_t)];
+	uint have;
+	u64 skip;
+	u64 left;
+	uint chunk;
+	lbaint_t blk;
+	u32 total_blocks;
+	u64 bytes_written;
+	u8 *stage[2];
+	size_t stage_size;
+	int cur;
+	size_t staged;
+	bool busy;
+};
+
+/**
+ * sparse_stream_start() - Start writing an image in pieces
+ *
+ * @ss: Stream to set up
+ * @info: Storage to write to
+ * @buf: Buffer to use for staging data, aligned to ARCH_DMA_MINALIGN
+ * @size: Size of @buf in bytes; at least twice info->blksz
+ * Return: 0 if OK, -EINVAL if @buf is too small
+ */
+int sparse_stream_start(struct sparse_stream *ss, struct sparse_storage *info,
+			void *buf, size_t size);
+
+/**
+ * sparse_stream_write() - Write the next piece of an image
+ *
+ * @ss: Stream to write to
+ * @data: Next part of the image
+ * @len: Length of @data in bytes
+ * @response: Response buffer passed to info->mssg() on error
+ * Return: 0 if OK, -ve on error, after which the stream ignores further data
+ */
+int sparse_stream_write(struct sparse_stream *ss, const void *data,
+			size_t len, char *response);
+
+/**
+ * sparse_stream_finish() - Write out anything left and check the result
+ *
+ * @ss: Stream to finish
+ * @part_name: Name of the partition, for messages
+ * @response: Response buffer passed to info->mssg() on error
+ * Return: 0 if the whole image was written, -ve on error
+ */
+int sparse_stream_finish(struct sparse_stream *ss, const char *part_name,
+			 char *response);
+
+/**
+ * sparse_stream_abort() - Stop writing an image which will not be completed
+ *
+ * This waits for any outstanding write but does not write out the staged data,
+ * so a partial image is never padded and finished off.
+ *
+ * @ss: Stream to abort
+ */
+void sparse_stream_abort(struct sparse_stream *ss);
+
 static inline int is_sparse_image(void *buf)
 {
 	sparse_header_t *s_header = (sparse_header_t *)buf;
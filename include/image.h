@@ -1244,6 +1244,7 @@ int fit_get_data_conf_prop(const void *fit, const char *prop_name,
 int fit_image_hash_get_algo(const void *fit, int noffset, const char **algo);
 int fit_image_hash_get_value(const void *fit, int noffset, uint8_t **value,
 				int *value_len);
+int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore);
 
 int fit_set_timestamp(void *fit, int noffset, time_t timestamp);
 
@@ -1328,6 +1329,81 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 			       size_t size);
 
 int fit_image_verify(const void *fit, int noffset);
+
+/**
+ * typedef fit_stream_read_t - Read part of a FIT for fit_image_load_stream()
+ *
+ * @priv:	Private data passed to fit_image_load_stream()
+ * @offset:	Offset to read from, relative to the start of the FIT
+ * @size:	Number of bytes to read
+ * @buf:	Buffer to read into
+ * Return: number of bytes read, or -ve on error
+ */
+typedef long (*fit_stream_read_t)(void *priv, ulong offset, ulong size,
+				  void *buf);
+
+/**
+ * fit_image_load_stream() - Load an image with external data in one pass
+ *
+ * This reads the external data of an image in chunks. Each chunk is hashed
+ * and then decompressed or copied to @dst before the next is read, so the
+ * data only passes through memory once. The hash values are checked once all
+ * data has been read, so @dst holds unverified data if this fails.
+ *
+ * Signatures over the image data cannot be checked this way, so images with
+ * signature nodes are refused. The configuration signature, which covers the
+ * hash values, must be checked by the caller before calling this function.
+ *
+ * Only images which are not compressed, or use gzip or zstd, can be
+ * streamed.
+ *
+ * @fit:	Pointer to the FIT
+ * @noffset:	Offset of the image node
+ * @ext_offset:	Offset of the external data from the start of the FIT, used
+ *		with the data-offset property
+ * @align:	Alignment required for the offset and size of each read
+ * @decomp:	true to decompress the data, false to copy it as is
+ * @read:	Function to read data
+ * @priv:	Private data for @read
+ * @dst:	Destination for the (uncompressed) data
+ * @dst_size:	Size of @dst
+ * @lenp:	Returns the number of bytes written to @dst
+ * Return: 0 if OK, -EPROTONOSUPPORT if the image cannot be streamed, so the
+ * caller should load it some other way, -EPERM if a hash does not match,
+ * -ENOSPC if @dst is too small, -EIO on read or decompression error, -ENOMEM
+ * if out of memory, other -ve on other error
+ */
+int fit_image_load_stream(const void *fit, int noffset, ulong ext_offset,
+			  ulong align, bool decomp, fit_stream_read_t read,
+			  void *priv, void *dst, ulong dst_size, ulong *lenp);
+
+/**
+ * fit_stream_set_source() - Set where to read the external data of a FIT
+ *
+ * This is for a FIT of which only the structure, fdt_totalsize() bytes, is in
+ * memory. fit_image_load() then uses @read to stream the external data of
+ * each image it loads to the load address. An image which cannot be streamed
+ * is read to where it would be if the whole FIT had been loaded.
+ *
+ * The source is forgotten if the FIT structure in memory changes.
+ *
+ * @fit:	FIT structure in memory
+ * @read:	Function to read the FIT from the start of its structure, or
+ *		NULL to forget the source
+ * @priv:	Private data for @read
+ */
+void fit_stream_set_source(const void *fit, fit_stream_read_t read,
+			   void *priv);
+
+/**
+ * fit_stream_get_source() - Get where to read the external data of a FIT
+ *
+ * @fit:	FIT structure in memory
+ * @privp:	Returns the private data for the read function
+ * Return: function to read the FIT, or NULL if it is all in memory
+ */
+fit_stream_read_t fit_stream_get_source(const void *fit, void **privp);
+
 #if CONFIG_IS_ENABLED(FIT_SIGNATURE)
 int fit_config_verify(const void *fit, int conf_noffset);
 #else
@@ -455,4 +455,17 @@ struct abuf;
  */
 int zstd_decompress(struct abuf *in, struct abuf *out);
 
+/**
+ * zstd_decompress_parallel() - Decompress Zstandard data using several CPUs
+ *
+ * If the data is made of several frames which each record their content size,
+ * the frames are decompressed in parallel by smp_worker_run(). Otherwise this
+ * is the same as zstd_decompress().
+ *
+ * @in: Input buffer to decompress
+ * @out: Output buffer to hold the results (must be large enough)
+ * Return: size of the decompressed data, or -ve on error
+ */
+int zstd_decompress_parallel(struct abuf *in, struct abuf *out);
+
 #endif  /* LINUX_ZSTD_H */
@@ -68,6 +68,7 @@ struct bd_info;
 #define MMC_CAP_NONREMOVABLE	BIT(14)
 #define MMC_CAP_NEEDS_POLL	BIT(15)
 #define MMC_CAP_CD_ACTIVE_HIGH  BIT(16)
+#define MMC_CAP_CQE		BIT(17)
 
 #define MMC_MODE_8BIT		BIT(30)
 #define MMC_MODE_4BIT		BIT(29)
@@ -105,6 +106,7 @@ struct bd_info;
 #define MMC_CMD_ERASE_GROUP_START	35
 #define MMC_CMD_ERASE_GROUP_END		36
 #define MMC_CMD_ERASE			38
+#define MMC_CMD_CMDQ_TASK_MGMT		48
 #define MMC_CMD_APP_CMD			55
 #define MMC_CMD_SPI_READ_OCR		58
 #define MMC_CMD_SPI_CRC_ON_OFF		59
@@ -205,6 +207,7 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 /*
  * EXT_CSD fields
  */
+#define EXT_CSD_CMDQ_MODE_EN		15	/* R/W */
 #define EXT_CSD_ENH_START_ADDR		136	/* R/W */
 #define EXT_CSD_ENH_SIZE_MULT		140	/* R/W */
 #define EXT_CSD_GP_SIZE_MULT		143	/* R/W */
@@ -235,6 +238,10 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_BOOT_MULT		226	/* RO */
 #define EXT_CSD_SEC_FEATURE		231	/* RO */
 #define EXT_CSD_GENERIC_CMD6_TIME       248     /* RO */
+#define EXT_CSD_CMDQ_DEPTH		307	/* RO */
+#define EXT_CSD_CMDQ_SUPPORT		308	/* RO */
+#define EXT_CSD_MAX_PACKED_WRITES	500	/* RO */
+#define EXT_CSD_MAX_PACKED_READS	501	/* RO */
 #define EXT_CSD_BKOPS_SUPPORT		502	/* RO */
 
 /*
@@ -310,6 +317,19 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 
 #define EXT_CSD_SEC_FEATURE_TRIM_EN	(1 << 4) /* Support secure & insecure trim */
 
+#define EXT_CSD_CMDQ_SUPPORTED		BIT(0)
+#define EXT_CSD_CMDQ_DEPTH_MASK		0x1f
+
+/* Flag for CMD23 (SET_BLOCK_COUNT) which starts a packed command */
+#define MMC_CMD23_ARG_PACKED		BIT(30)
+
+/* Packed-command header, sent with CMD25 before a packed read */
+#define MMC_PACKED_VERSION		0x01
+#define MMC_PACKED_READ			0x01
+
+/* CMD48 (CMDQ_TASK_MGMT) argument to discard all queued tasks */
+#define MMC_CMDQ_DISCARD_ALL		1
+
 #define R1_ILLEGAL_COMMAND		(1 << 22)
 #define R1_APP_CMD			(1 << 5)
 
@@ -447,6 +467,68 @@ struct mmc_data {
 	uint blocksize;
 };
 
+/* Most tasks that an eMMC command queue can hold */
+#define MMC_CQE_MAX_TASKS	32
+
+/**
+ * struct mmc_cqe_task - a read task for a command-queueing host
+ *
+ * @tag: Slot for the task, from 0 to one less than the queue depth
+ * @start: First block to read
+ * @blocks: Number of blocks to read
+ * @dest: Buffer for the data
+ */
+struct mmc_cqe_task {
+	uint tag;
+	lbaint_t start;
+	uint blocks;
+	void *dest;
+};
+
+/* The entry is in use */
+#define MMC_CACHE_VALID		BIT(0)
+/* The entry has a tuning result */
+#define MMC_CACHE_TUNED		BIT(1)
+
+/* Number of cards which can be remembered */
+#define MMC_CACHE_ENTRIES	4
+
+/**
+ * struct mmc_cache_entry - an eMMC, as found when it was last set up
+ *
+ * This is kept in the bloblist (BLOBLISTT_U_BOOT_MMC_CACHE), so that a later
+ * boot phase, or a later boot if the bloblist survives reset, can set up the
+ * same card more quickly. All fields are in host byte order.
+ *
+ * @cid: Card identification, to check that the card is the same
+ * @ocr: Operating conditions reported by the card
+ * @ext_csd_crc: CRC32 of the EXT_CSD fields which affect the bus mode
+ * @seq: Sequence number of the MMC device
+ * @flags: MMC_CACHE_... flags
+ * @mode: Bus mode which was selected (enum bus_mode)
+ * @bus_width: Bus width which was selected (1, 4 or 8)
+ * @tuning: Host-specific tuning result, if MMC_CACHE_TUNED is set
+ */
+struct mmc_cache_entry {
+	u32 cid[4];
+	u32 ocr;
+	u32 ext_csd_crc;
+	u8 seq;
+	u8 flags;
+	u8 mode;
+	u8 bus_width;
+	u32 tuning;
+};
+
+/**
+ * struct mmc_cache - the cards which have been set up
+ *
+ * @entry: Entry for each card
+ */
+struct mmc_cache {
+	struct mmc_cache_entry entry[MMC_CACHE_ENTRIES];
+};
+
 /* forward decl. */
 struct mmc;
 
@@ -512,6 +594,26 @@ struct dm_mmc_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*execute_tuning)(struct udevice *dev, uint opcode);
+
+#if CONFIG_IS_ENABLED(MMC_CACHE)
+	/**
+	 * get_tuning() - Get the result of the last tuning
+	 *
+	 * @dev:	Device to check
+	 * @tapp:	Returns a host-specific value, e.g. the tap delay
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*get_tuning)(struct udevice *dev, u32 *tapp);
+
+	/**
+	 * set_tuning() - Restore a result from get_tuning(), without tuning
+	 *
+	 * @dev:	Device to update
+	 * @tap:	Value from get_tuning()
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*set_tuning)(struct udevice *dev, u32 tap);
+#endif
 #endif
 
 	/**
@@ -560,6 +662,41 @@ struct dm_mmc_ops {
 	 * @return 0 if success, -ve on error
 	 */
 	int (*hs400_prepare_ddr)(struct udevice *dev);
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	/**
+	 * cqe_enable() - switch the host in or out of command-queueing mode
+	 *
+	 * The card is already in command-queueing mode when this is called
+	 * to enable it, and is still in it when this is called to disable
+	 * it. Disabling discards any tasks still in the queue.
+	 *
+	 * @dev:	Device to update
+	 * @enable:	true to enable, false to go back to sending commands
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cqe_enable)(struct udevice *dev, bool enable);
+
+	/**
+	 * cqe_submit() - queue a read task
+	 *
+	 * @dev:	Device to use
+	 * @task:	Task to queue, whose tag is not in use
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cqe_submit)(struct udevice *dev, struct mmc_cqe_task *task);
+
+	/**
+	 * cqe_poll() - collect tasks which have finished
+	 *
+	 * @dev:	Device to check
+	 * @donep:	Returns a mask of the tags which finished since the
+	 *		last call
+	 * @return 0 if OK, -ve if a task failed, in which case none of the
+	 * tasks which are still queued can be relied on
+	 */
+	int (*cqe_poll)(struct udevice *dev, u32 *donep);
+#endif
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -577,6 +714,9 @@ int mmc_reinit(struct mmc *mmc);
 int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt);
 int mmc_hs400_prepare_ddr(struct mmc *mmc);
 int mmc_send_stop_transmission(struct mmc *mmc, bool write);
+int mmc_cqe_enable(struct mmc *mmc, bool enable);
+int mmc_cqe_submit(struct mmc *mmc, struct mmc_cqe_task *task);
+int mmc_cqe_poll(struct mmc *mmc, u32 *donep);
 
 #else
 struct mmc_ops {
@@ -607,6 +747,7 @@ struct mmc_config {
 	uint f_min;
 	uint f_max;
 	uint b_max;
+	uint cqe_depth;		/* tasks the host can queue, 0 if none */
 	unsigned char part_type;
 #if CONFIG_IS_ENABLED(MMC_PWRSEQ)
 	struct udevice *pwr_dev;
@@ -758,6 +899,20 @@ struct mmc {
 	bool hs400_tuning:1;
 
 	enum bus_mode user_speed_mode; /* input speed mode from user */
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	u8 cqe_depth;		/* tasks the card can queue, 0 if none */
+	bool cqe_on;		/* card and host are in command-queueing mode */
+#endif
+#if CONFIG_IS_ENABLED(MMC_PACKED)
+	u8 max_packed_reads;	/* most reads in a packed command, 0 if none */
+#endif
+#if CONFIG_IS_ENABLED(MMC_QUEUE)
+	struct mmc_queue *queue;	/* asynchronous requests */
+#endif
+#if CONFIG_IS_ENABLED(MMC_CACHE)
+	struct mmc_cache_entry cache;	/* what is known about the card */
+	bool cache_hit;		/* card matches @cache, so it can be used */
+#endif
 
 	CONFIG_IS_ENABLED(CYCLIC, (struct cyclic_info cyclic));
 };
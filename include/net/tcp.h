@@ -68,8 +68,8 @@ struct ip_tcp_hdr {
  * TCP header options, Seq, MSS, and SACK
  */
 
-#define TCP_SACK 32			/* Number of packets analyzed   */
-					/* on leading edge of stream    */
+#define TCP_SACK 32			/* Number of ranges of data     */
+					/* tracked beyond the ACK edge  */
 
 #define TCP_O_END	0x00		/* End of option list		*/
 #define TCP_1_NOP	0x01		/* Single padding NOP		*/
@@ -88,6 +88,11 @@ struct ip_tcp_hdr {
 #define TCP_MSS		1460		/* Max segment size		*/
 #define TCP_SCALE	0x01		/* Scale			*/
 
+/* Receive window used unless the application sets one */
+#define TCP_RX_WINDOW_DEFAULT	(PKTBUFSRX * TCP_MSS)
+/* Largest window which can be offered with window scaling */
+#define TCP_RX_WINDOW_MAX	(1 << 30)
+
 /**
  * struct tcp_mss - TCP option structure for MSS (Max segment size)
  * @kind: Field ID
@@ -298,6 +303,9 @@ typedef void rxhand_tcp(uchar *pkt, u16 dport,
 			u32 tcp_seq_num, u32 tcp_ack_num,
 			u8 action, unsigned int len);
 void tcp_set_tcp_handler(rxhand_tcp *f);
+void tcp_set_rx_window(u32 size);
+u32 tcp_get_rx_window(void);
+u32 tcp_get_ack_edge(void);
 
 void rxhand_tcp_f(union tcp_build_pkt *b, unsigned int len);
 
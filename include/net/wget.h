@@ -19,3 +19,5 @@ enum wget_state {
 #define DEBUG_WGET		0	/* Set to 1 for debug messages */
 #define WGET_RETRY_COUNT	30
 #define WGET_TIMEOUT		2000UL
+#define WGET_ACK_SEGMENTS	2	/* ACK at least every 2 segments */
+#define WGET_DELAYED_ACK_MS	20UL	/* ...or after this long */
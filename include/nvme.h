@@ -9,6 +9,24 @@
 
 struct nvme_dev;
 
+/**
+ * struct nvme_io_stats - I/O queue statistics for an NVMe controller
+ *
+ * @q_depth:	Number of entries in the I/O queue
+ * @cmds:	Number of read / write commands submitted
+ * @doorbells:	Number of submission-queue doorbell writes for those commands
+ * @reaps:	Number of completion-queue doorbell writes, each of which
+ *		retires one or more commands
+ * @max_inflight: Largest number of commands outstanding at once
+ */
+struct nvme_io_stats {
+	uint q_depth;
+	ulong cmds;
+	ulong doorbells;
+	ulong reaps;
+	uint max_inflight;
+};
+
 /**
  * nvme_identify - identify controller or namespace capabilities and status
  *
@@ -90,4 +108,18 @@ int nvme_print_info(struct udevice *udev);
  */
 int nvme_get_namespace_id(struct udevice *udev, u32 *ns_id, u8 *eui64);
 
+/**
+ * nvme_get_io_stats - return I/O queue statistics
+ *
+ * This returns the statistics of the controller that a namespace belongs to,
+ * optionally resetting them afterwards.
+ *
+ * @udev:	NVMe namespace block device
+ * @stats:	Place where to put the statistics
+ * @reset:	true to reset the statistics after reading them
+ * @return:	0 on success, -ve on error
+ */
+int nvme_get_io_stats(struct udevice *udev, struct nvme_io_stats *stats,
+		      bool reset);
+
 #endif /* __NVME_H__ */
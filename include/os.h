@@ -548,4 +548,35 @@ long os_get_time_offset(void);
  */
 void os_set_time_offset(long offset);
 
+/**
+ * os_thread_create() - start a host thread
+ *
+ * @func:	Function to run in the new thread
+ * @arg:	Argument to pass to @func
+ * @threadp:	Returns a handle for the thread, for os_thread_join()
+ * Return:	0 if OK, -ve on error
+ */
+int os_thread_create(void *(*func)(void *arg), void *arg, void **threadp);
+
+/**
+ * os_thread_join() - wait for a host thread to finish
+ *
+ * @thread:	Handle returned by os_thread_create()
+ * Return:	0 if OK, -ve on error
+ */
+int os_thread_join(void *thread);
+
+/**
+ * os_initjmp() - set up a jmp_buf to start a function on a new stack
+ *
+ * This is used to implement initjmp() on sandbox.
+ *
+ * @jmp:	jmp_buf to set up, for use with longjmp()
+ * @func:	Function to call when @jmp is used, which must not return
+ * @stack:	Lowest address of the stack
+ * @size:	Size of the stack in bytes
+ * Return:	0 if OK, -ve on error
+ */
+int os_initjmp(ulong *jmp, void (*func)(void), void *stack, size_t size);
+
 #endif
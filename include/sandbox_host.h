@@ -8,6 +8,8 @@
 #ifndef __SANDBOX_HOST__
 #define __SANDBOX_HOST__
 
+#include <linux/list.h>
+
 /**
  * struct host_sb_plat - platform data for a host device
  *
@@ -21,6 +23,20 @@ struct host_sb_plat {
 	int fd;
 };
 
+/* Number of asynchronous requests a host block device accepts at once */
+#define HOST_BLK_MAX_REQS	4
+
+/**
+ * struct host_blk_priv - private data for a host block device
+ *
+ * @reqs: Asynchronous requests waiting to be carried out, oldest first
+ * @count: Number of requests in @reqs
+ */
+struct host_blk_priv {
+	struct list_head reqs;
+	int count;
+};
+
 /**
  * struct host_ops - operations supported by UCLASS_HOST
  */
@@ -125,6 +125,7 @@
 #define  SDHCI_INT_CARD_INSERT	BIT(6)
 #define  SDHCI_INT_CARD_REMOVE	BIT(7)
 #define  SDHCI_INT_CARD_INT	BIT(8)
+#define  SDHCI_INT_CQE		BIT(14)
 #define  SDHCI_INT_ERROR	BIT(15)
 #define  SDHCI_INT_TIMEOUT	BIT(16)
 #define  SDHCI_INT_CRC		BIT(17)
@@ -276,6 +277,26 @@ struct sdhci_ops {
 	int	(*set_ios_post)(struct sdhci_host *host);
 	void	(*set_clock)(struct sdhci_host *host, u32 div);
 	int (*platform_execute_tuning)(struct mmc *host, u8 opcode);
+
+	/**
+	 * platform_get_tuning() - Get the result of the last tuning
+	 *
+	 * @host: SDHCI host structure
+	 * @tapp: Returns a host-specific value, e.g. the tap delay
+	 * Return: 0 if successful, -ve on error
+	 */
+	int (*platform_get_tuning)(struct sdhci_host *host, u32 *tapp);
+
+	/**
+	 * platform_set_tuning() - Restore a value from platform_get_tuning()
+	 *
+	 * This is used instead of tuning when the same card was tuned before.
+	 *
+	 * @host: SDHCI host structure
+	 * @tap: Value to restore
+	 * Return: 0 if successful, -ve on error
+	 */
+	int (*platform_set_tuning)(struct sdhci_host *host, u32 tap);
 	int (*set_delay)(struct sdhci_host *host);
 	/* Callback function to set DLL clock configuration */
 	int (*config_dll)(struct sdhci_host *host, u32 clock, bool enable);
@@ -362,6 +383,9 @@ struct sdhci_host {
 #if CONFIG_IS_ENABLED(MMC_SDHCI_ADMA)
 	struct sdhci_adma_desc *adma_desc_table;
 #endif
+#if CONFIG_IS_ENABLED(MMC_SDHCI_CQE)
+	struct sdhci_cqe *cqe;	/* command-queueing engine, if used */
+#endif
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
@@ -532,6 +556,47 @@ extern const struct dm_mmc_ops sdhci_ops;
 #else
 #endif
 
+/**
+ * sdhci_reset() - Reset parts of the controller
+ *
+ * @host: SDHCI host structure
+ * @mask: Parts to reset (SDHCI_RESET_...)
+ */
+void sdhci_reset(struct sdhci_host *host, u8 mask);
+
+/* Flags for sdhci_cqe_setup() */
+#define SDHCI_CQE_SHORT_TRANS_DESC	BIT(0)	/* 12-byte 64-bit descriptors */
+
+#if CONFIG_IS_ENABLED(MMC_SDHCI_CQE)
+/**
+ * sdhci_cqe_setup() - Set up the command-queueing engine, if wanted
+ *
+ * This does nothing unless @cfg has MMC_CAP_CQE, i.e. the device tree has
+ * 'supports-cqe'. It must be called after sdhci_setup_cfg(), so that the
+ * DMA mode is known.
+ *
+ * @cfg: MMC configuration, whose cqe_depth is set
+ * @host: SDHCI host structure
+ * @base: Address of the CQHCI registers, or NULL if there are none
+ * @flags: Quirks of the engine (SDHCI_CQE_...)
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int sdhci_cqe_setup(struct mmc_config *cfg, struct sdhci_host *host,
+		    void *base, uint flags);
+
+/* Command-queueing operations, for struct dm_mmc_ops */
+int sdhci_cqe_enable(struct udevice *dev, bool enable);
+int sdhci_cqe_submit(struct udevice *dev, struct mmc_cqe_task *task);
+int sdhci_cqe_poll(struct udevice *dev, u32 *donep);
+#else
+static inline int sdhci_cqe_setup(struct mmc_config *cfg,
+				  struct sdhci_host *host, void *base,
+				  uint flags)
+{
+	return 0;
+}
+#endif
+
 void sdhci_adma_write_desc(struct sdhci_host *host, void **next_desc,
 			   dma_addr_t addr, int len, bool end);
 struct sdhci_adma_desc *sdhci_adma_init(void);
@@ -0,0 +1,118 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Running jobs on secondary CPUs
+ *
+ * U-Boot normally runs on a single CPU, with the others waiting to be released
+ * to the OS. This allows a CPU-bound task made of independent jobs, such as
+ * decompressing a multi-frame image, to use the other CPUs for a while. They
+ * are parked again before smp_worker_run() returns.
+ */
+
+#ifndef __SMP_WORKER_H
+#define __SMP_WORKER_H
+
+#include <linux/errno.h>
+#include <linux/types.h>
+
+/**
+ * typedef smp_job_func - function which runs one job
+ *
+ * This may run on any CPU, at the same time as other jobs. It must not
+ * allocate memory, print or call anything else which uses global state. Any
+ * per-CPU resources (e.g. a workspace) should be set up by the caller of
+ * smp_worker_run() and looked up with @cpu.
+ *
+ * @ctx: Context passed to smp_worker_run()
+ * @job: Job number to run, from 0 to count - 1
+ * @cpu: CPU running the job, from 0 (the boot CPU) to smp_worker_cpus() - 1
+ * Return: 0 if OK, -ve on error
+ */
+typedef int (*smp_job_func)(void *ctx, int job, int cpu);
+
+#if CONFIG_IS_ENABLED(SMP_WORKERS)
+/**
+ * smp_worker_cpus() - get the number of CPUs which can run jobs
+ *
+ * Return: number of CPUs, including the boot CPU
+ */
+int smp_worker_cpus(void);
+
+/**
+ * smp_worker_cpu() - get the CPU running the caller
+ *
+ * Return: 0 on the boot CPU, else the number of the secondary CPU
+ */
+int smp_worker_cpu(void);
+
+/**
+ * smp_worker_run() - run jobs on the boot CPU and any secondary CPUs
+ *
+ * The jobs are shared out between the CPUs, which each run their jobs in
+ * order. This returns once all of them have finished and the secondary CPUs
+ * are parked.
+ *
+ * @func: Function to run each job
+ * @ctx: Context to pass to @func
+ * @count: Number of jobs
+ * @busy_usp: If not NULL, returns the total time spent running jobs, adding
+ *	up all the CPUs
+ * Return: 0 if all the jobs succeeded, else the error from one which failed
+ */
+int smp_worker_run(smp_job_func func, void *ctx, int count, ulong *busy_usp);
+
+/**
+ * arch_smp_worker_count() - get the number of secondary CPUs for jobs
+ *
+ * Return: number of secondary CPUs which arch_smp_worker_start() can start
+ */
+int arch_smp_worker_count(void);
+
+/**
+ * arch_smp_worker_start() - start a secondary CPU running jobs
+ *
+ * This brings the CPU out of wherever it waits into a minimal environment
+ * in which it calls @entry, then waits to be parked again.
+ *
+ * @cpu: Secondary CPU to start, from 1 to arch_smp_worker_count()
+ * @entry: Function for the CPU to run, passed @cpu
+ * Return: 0 if OK, -ve on error
+ */
+int arch_smp_worker_start(int cpu, void (*entry)(int cpu));
+
+/**
+ * arch_smp_worker_park() - wait for a secondary CPU to finish its jobs
+ *
+ * This waits for @entry to return on the CPU, then puts the CPU back where
+ * it waits, ready to be started again or released to the OS. All memory
+ * written by the CPU is visible to the caller afterwards.
+ *
+ * @cpu: Secondary CPU, as passed to arch_smp_worker_start()
+ * Return: 0 if OK, -ve on error
+ */
+int arch_smp_worker_park(int cpu);
+
+/**
+ * arch_smp_worker_cpu() - get the CPU running the caller
+ *
+ * Return: 0 on the boot CPU, else the number of the secondary CPU
+ */
+int arch_smp_worker_cpu(void);
+#else
+static inline int smp_worker_cpus(void)
+{
+	return 1;
+}
+
+static inline int smp_worker_cpu(void)
+{
+	return 0;
+}
+
+static inline int smp_worker_run(smp_job_func func, void *ctx, int count,
+				 ulong *busy_usp)
+{
+	return -ENOSYS;
+}
+#endif
+
+#endif /* __SMP_WORKER_H */
@@ -12,6 +12,23 @@
 
 struct disk_partition;
 
+/**
+ * struct sqfs_cache_stats - use of the SquashFS block caches
+ *
+ * The counts start from zero when a filesystem is probed.
+ *
+ * @meta_hits: Metadata blocks found in the cache
+ * @meta_misses: Metadata blocks read from the device
+ * @frag_hits: Fragment blocks found in the cache
+ * @frag_misses: Fragment blocks read from the device
+ */
+struct sqfs_cache_stats {
+	ulong meta_hits;
+	ulong meta_misses;
+	ulong frag_hits;
+	ulong frag_misses;
+};
+
 int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp);
 int sqfs_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp);
 int sqfs_probe(struct blk_desc *fs_dev_desc,
@@ -21,6 +38,16 @@ int sqfs_read(const char *filename, void *buf, loff_t offset,
 int sqfs_size(const char *filename, loff_t *size);
 int sqfs_exists(const char *filename);
 void sqfs_close(void);
+void sqfs_release(void);
+bool sqfs_is_mounted(struct blk_desc *fs_dev_desc,
+		     struct disk_partition *fs_partition);
 void sqfs_closedir(struct fs_dir_stream *dirs);
 
+/**
+ * sqfs_get_cache_stats() - get the use of the block caches
+ *
+ * @stats: Returns the counts for the filesystem probed last
+ */
+void sqfs_get_cache_stats(struct sqfs_cache_stats *stats);
+
 #endif /* SQFS_H  */
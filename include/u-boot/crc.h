@@ -96,6 +96,24 @@ uint32_t crc32_no_comp(uint32_t crc, const unsigned char *buf, uint len);
 void crc32_wd_buf(const uint8_t *input, uint ilen, uint8_t *output,
 		  uint chunk_sz);
 
+/**
+ * crc32_slice_by_8() - Calculate a CRC32 using slice-by-8 tables
+ *
+ * This processes eight bytes at a time using eight tables, where entry n of
+ * table k is the CRC of byte n followed by k zero bytes. The CRC is not
+ * inverted before or after the calculation.
+ *
+ * This is only available with CONFIG_CRC32_SLICE_BY_8
+ *
+ * @crc: Previous crc (use 0 at start)
+ * @buf: Bytes to checksum
+ * @len: Number of bytes to checksum
+ * @tab: Tables for the polynomial to use
+ * Return: checksum value
+ */
+uint32_t crc32_slice_by_8(uint32_t crc, const unsigned char *buf, uint len,
+			  const uint32_t (*tab)[256]);
+
 /* lib/crc32c.c */
 
 /**
@@ -112,7 +130,9 @@ void crc32c_init(uint32_t *crc32c_table, uint32_t pol);
  * crc32c_cal() - Perform CRC32 on a buffer given a table
  *
  * This algorithm uses the table (set up by crc32c_init() to speed up
- * processing.
+ * processing. If the table is for the CRC32C (Castagnoli) polynomial, the
+ * ARMv8 CRC32 instructions or slice-by-8 tables are used instead, where
+ * available.
  *
  * @crc: Previous crc (use 0 at start)
  * @data: Data bytes to checksum
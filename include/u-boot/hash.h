@@ -35,6 +35,64 @@ int hash_init(struct udevice *dev, enum HASH_ALGO algo, void **ctxp);
 int hash_update(struct udevice *dev, void *ctx, const void *ibuf, const uint32_t ilen);
 int hash_finish(struct udevice *dev, void *ctx, void *obuf);
 
+/**
+ * hash_supports() - Check whether a hash device supports an algorithm
+ *
+ * Devices which do not implement the hash_supports() operation are taken
+ * not to support any algorithm, so they are never picked by
+ * hash_find_device().
+ *
+ * The FSL CAAM, Exynos ACE and Nuvoton NPCM engines are not hash devices:
+ * they provide the hw_sha*() functions (CONFIG_SHA_HW_ACCEL) which
+ * common/hash.c puts straight into its algorithm table, so they are used
+ * without this check.
+ *
+ * @dev:	Hash device
+ * @algo:	Algorithm to check
+ * Return: true if supported, false if not
+ */
+bool hash_supports(struct udevice *dev, enum HASH_ALGO algo);
+
+/**
+ * hash_find_device() - Find a hash device which supports an algorithm
+ *
+ * Only the device which is returned is probed; others are left alone.
+ *
+ * @algo:	Algorithm required
+ * @devp:	Returns the first device which supports @algo, probed
+ * Return: 0 if OK, -ENODEV if there is no such device, other -ve error if
+ *	the device failed to probe
+ */
+int hash_find_device(enum HASH_ALGO algo, struct udevice **devp);
+
+/**
+ * hash_submit() - Start hashing a buffer
+ *
+ * If the device can hash in the background, this starts the operation and
+ * returns. The caller must then call hash_poll() until it returns 0 before
+ * changing @ibuf or submitting more data. Otherwise this acts like
+ * hash_update().
+ *
+ * @dev:	Hash device
+ * @ctx:	Context from hash_init()
+ * @ibuf:	Data to hash
+ * @ilen:	Number of bytes in @ibuf
+ * Return: 0 if OK, -EBUSY if an operation is already in progress, other -ve
+ * on error
+ */
+int hash_submit(struct udevice *dev, void *ctx, const void *ibuf,
+		const uint32_t ilen);
+
+/**
+ * hash_poll() - Check whether a submitted buffer has been hashed
+ *
+ * @dev:	Hash device
+ * @ctx:	Context from hash_init()
+ * Return: 0 if no operation is in progress, -EBUSY if the device is still
+ * hashing, other -ve on error
+ */
+int hash_poll(struct udevice *dev, void *ctx);
+
 /*
  * struct hash_ops - Driver model for Hash operations
  *
@@ -47,6 +105,14 @@ struct hash_ops {
 	int (*hash_update)(struct udevice *dev, void *ctx, const void *ibuf, const uint32_t ilen);
 	int (*hash_finish)(struct udevice *dev, void *ctx, void *obuf);
 
+	/* chunked operations, for hashing in the background (optional) */
+	int (*hash_submit)(struct udevice *dev, void *ctx, const void *ibuf,
+			   const uint32_t ilen);
+	int (*hash_poll)(struct udevice *dev, void *ctx);
+
+	/* check whether an algorithm is supported */
+	bool (*hash_supports)(struct udevice *dev, enum HASH_ALGO algo);
+
 	/* all-in-one operation */
 	int (*hash_digest)(struct udevice *dev, enum HASH_ALGO algo,
 			   const void *ibuf, const uint32_t ilen,
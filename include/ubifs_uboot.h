@@ -30,5 +30,6 @@ int ubifs_size(const char *filename, loff_t *size);
 int ubifs_read(const char *filename, void *buf, loff_t offset,
 	       loff_t size, loff_t *actread);
 void ubifs_close(void);
+void ubifs_stats(void);
 
 #endif /* __UBIFS_UBOOT_H__ */
@@ -14,6 +14,7 @@
 #include <stdbool.h>
 #include <fdtdec.h>
 #include <usb_defs.h>
+#include <linux/list.h>
 #include <linux/usb/ch9.h>
 #include <asm/cache.h>
 #include <part.h>
@@ -658,11 +659,15 @@ struct usb_dev_plat {
  *		so this will be false.
  * @companion:  True if this is a companion controller to another USB
  *		controller
+ * @scan_list:	Hub ports on this bus waiting to be scanned (see usb_hub.c)
+ * @scanning:	true while the ports in @scan_list are being scanned
  */
 struct usb_bus_priv {
 	int next_addr;
 	bool desc_before_addr;
 	bool companion;
+	struct list_head scan_list;
+	bool scanning;
 };
 
 /**
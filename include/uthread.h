@@ -0,0 +1,147 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Cooperative threads
+ *
+ * A uthread runs until it yields, by calling schedule() directly or from a
+ * delay such as udelay(). This allows slow hardware waits, e.g. for a USB
+ * port to reset or a card to power up, to overlap with each other. There is
+ * no pre-emption and no locking: a thread can rely on nothing else running
+ * between two yields.
+ */
+
+#ifndef __UTHREAD_H
+#define __UTHREAD_H
+
+#include <linux/errno.h>
+#include <linux/types.h>
+
+struct uthread;
+
+#if CONFIG_IS_ENABLED(UTHREAD)
+#include <linux/list.h>
+#include <asm/setjmp.h>
+
+/**
+ * struct uthread - a cooperative thread
+ *
+ * @fn: Function run by the thread
+ * @arg: Argument to pass to @fn
+ * @ctx: Context saved when the thread is not running
+ * @stack: Stack for the thread, or NULL for the main thread
+ * @done: true once @fn has returned
+ * @alloced: true if this struct was allocated by uthread_create()
+ * @grp_id: Group which the thread belongs to, or 0 for none
+ * @list: Node in the list of threads
+ */
+struct uthread {
+	void (*fn)(void *arg);
+	void *arg;
+	jmp_buf ctx;
+	void *stack;
+	bool done;
+	bool alloced;
+	uint grp_id;
+	struct list_head list;
+};
+
+/**
+ * uthread_create() - create a thread, ready to run at the next yield
+ *
+ * @uthr: Thread to set up, or NULL to allocate one, which is freed once it
+ *	has finished
+ * @fn: Function to run
+ * @arg: Argument to pass to @fn
+ * @stack_sz: Stack size in bytes, or 0 for CONFIG_UTHREAD_STACK_SIZE
+ * @grp_id: Group to add the thread to (see uthread_grp_new_id()), or 0
+ * Return: 0 if OK, -ENOMEM if out of memory, other -ve on error
+ */
+int uthread_create(struct uthread *uthr, void (*fn)(void *), void *arg,
+		   size_t stack_sz, uint grp_id);
+
+/**
+ * uthread_schedule() - switch to the next thread which is ready to run
+ *
+ * This is normally called through schedule(). Threads run in turn, with the
+ * main thread (the one which U-Boot starts on) taking its turn as well.
+ *
+ * Return: true if another thread ran, false if there was none to run
+ */
+bool uthread_schedule(void);
+
+/**
+ * uthread_active() - check whether any threads are waiting to run
+ *
+ * Return: true if there is a thread other than the caller which has not
+ *	finished
+ */
+bool uthread_active(void);
+
+/**
+ * uthread_is_main() - check whether the caller is on the main thread
+ *
+ * Return: true if running on the thread which U-Boot started on, false if
+ *	running in a thread made by uthread_create()
+ */
+bool uthread_is_main(void);
+
+/**
+ * uthread_grp_new_id() - get a new group ID
+ *
+ * Return: ID to pass to uthread_create(), never 0
+ */
+uint uthread_grp_new_id(void);
+
+/**
+ * uthread_grp_done() - check whether all the threads in a group have finished
+ *
+ * @grp_id: Group ID
+ * Return: true if no thread in the group is still running
+ */
+bool uthread_grp_done(uint grp_id);
+
+/**
+ * uthread_grp_wait() - wait for all the threads in a group to finish
+ *
+ * This yields until uthread_grp_done() is true.
+ *
+ * @grp_id: Group ID
+ */
+void uthread_grp_wait(uint grp_id);
+#else
+static inline int uthread_create(struct uthread *uthr, void (*fn)(void *),
+				 void *arg, size_t stack_sz, uint grp_id)
+{
+	return -ENOSYS;
+}
+
+static inline bool uthread_schedule(void)
+{
+	return false;
+}
+
+static inline bool uthread_active(void)
+{
+	return false;
+}
+
+static inline bool uthread_is_main(void)
+{
+	return true;
+}
+
+static inline uint uthread_grp_new_id(void)
+{
+	return 0;
+}
+
+static inline bool uthread_grp_done(uint grp_id)
+{
+	return true;
+}
+
+static inline void uthread_grp_wait(uint grp_id)
+{
+}
+#endif
+
+#endif /* __UTHREAD_H */
@@ -24,6 +24,7 @@
 #include <dm/device.h>
 #include <linux/bitops.h>
 #include <linux/bug.h>
+#include <linux/errno.h>
 #include <linux/typecheck.h>
 #define VIRTIO_ID_NET		1 /* virtio net */
 #define VIRTIO_ID_BLOCK		2 /* virtio block */
@@ -372,6 +373,48 @@ void virtio_driver_features_init(struct virtio_dev_priv *priv,
  */
 int virtio_init(void);
 
+/**
+ * struct virtio_blk_stats - request statistics for a virtio block device
+ *
+ * @reqs:	Number of block requests handled
+ * @chains:	Number of descriptor chains added to the virtqueue
+ * @kicks:	Number of times new chains were made available to the device
+ * @notifies:	Number of kicks which had to notify the device
+ * @max_inflight: Largest number of chains in flight at once
+ * @chain_blks:	Largest number of blocks in one chain
+ * @seg_max:	Largest number of data segments in one chain
+ * @indirect:	true if chains use indirect descriptors
+ * @event_idx:	true if notifications are suppressed using event indexes
+ */
+struct virtio_blk_stats {
+	ulong reqs;
+	ulong chains;
+	ulong kicks;
+	ulong notifies;
+	uint max_inflight;
+	uint chain_blks;
+	uint seg_max;
+	bool indirect;
+	bool event_idx;
+};
+
+/**
+ * virtio_blk_get_stats() - get the request statistics of a block device
+ *
+ * @dev:	virtio-blk block device, which must be probed
+ * @stats:	Returns the statistics
+ * Return: 0 if OK, -ENOSYS if @dev is not a virtio-blk device
+ */
+#if CONFIG_IS_ENABLED(VIRTIO_BLK)
+int virtio_blk_get_stats(struct udevice *dev, struct virtio_blk_stats *stats);
+#else
+static inline int virtio_blk_get_stats(struct udevice *dev,
+				       struct virtio_blk_stats *stats)
+{
+	return -ENOSYS;
+}
+#endif
+
 static inline u16 __virtio16_to_cpu(bool little_endian, __virtio16 val)
 {
 	if (little_endian)
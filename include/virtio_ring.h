@@ -43,6 +43,12 @@
  */
 #define VIRTIO_RING_F_EVENT_IDX		29
 
+/*
+ * Most buffers in a chain which is placed in an indirect table. Longer chains
+ * are put in the ring directly.
+ */
+#define VRING_INDIRECT_MAX		64
+
 /* Virtio ring descriptors: 16 bytes. These can chain together via "next". */
 struct vring_desc {
 	/* Address (guest-physical) */
@@ -63,6 +69,8 @@ struct vring_desc_shadow {
 	u16 next;
 	/* Metadata about the descriptor. */
 	bool chain_head;
+	/* Indirect descriptor table used by a chain head, or NULL if none */
+	struct vring_desc *indir;
 };
 
 struct vring_avail {
@@ -103,6 +111,9 @@ struct vring {
  * @vring: actual memory layout for this queue
  * @vring_desc_shadow: guest-only copy of descriptors
  * @event: host publishes avail event idx
+ * @indirect: chains of several buffers use indirect descriptors
+ * @indir_tables: indirect table of VRING_INDIRECT_MAX descriptors for each
+ *	descriptor in the ring, used when a chain starts there
  * @free_head: head of free buffer list
  * @num_added: number we've added since last sync
  * @last_used_idx: last used index we've seen
@@ -117,6 +128,8 @@ struct virtqueue {
 	struct vring vring;
 	struct vring_desc_shadow *vring_desc_shadow;
 	bool event;
+	bool indirect;
+	struct vring_desc *indir_tables;
 	unsigned int free_head;
 	unsigned int num_added;
 	u16 last_used_idx;
@@ -187,6 +200,10 @@ struct virtio_sg;
  * @in_sgs:	the number of scatterlists which are writable
  *		(after readable ones)
  *
+ * If VIRTIO_RING_F_INDIRECT_DESC was negotiated, a chain of more than one
+ * buffer, and no more than VRING_INDIRECT_MAX, is placed in an indirect table,
+ * so it takes only one descriptor in the ring.
+ *
  * Caller must ensure we don't call this with other virtqueue operations
  * at the same time (except where noted).
  *
@@ -203,10 +220,15 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
  * After one or more virtqueue_add() calls, invoke this to kick
  * the other side.
  *
+ * If VIRTIO_RING_F_EVENT_IDX was negotiated, the other side is only
+ * notified if it asked to be for the buffers added since the last kick.
+ *
  * Caller must ensure we don't call this with other virtqueue
  * operations at the same time (except where noted).
+ *
+ * Return: true if the other side was notified
  */
-void virtqueue_kick(struct virtqueue *vq);
+bool virtqueue_kick(struct virtqueue *vq);
 
 /**
  * virtqueue_get_buf - get the next used buffer
@@ -12,6 +12,9 @@
 #include <arpa/inet.h>
 #else
 #include <efi_loader.h>
+#ifdef CONFIG_ARM64_CRC32
+#include <asm/system.h>
+#endif
 #endif
 #include <compiler.h>
 #include <u-boot/crc.h>
@@ -27,6 +30,13 @@
 #define __efi_runtime_rodata
 #endif
 
+/* Tools are not size-constrained, so always use the faster code there */
+#ifdef USE_HOSTCC
+#define CRC32_SLICE_BY_8	1
+#else
+#define CRC32_SLICE_BY_8	CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+#endif
+
 #define tole(x) cpu_to_le32(x)
 
 #ifdef CONFIG_DYNAMIC_CRC_TABLE
@@ -82,7 +92,9 @@ static void __efi_runtime make_crc_table(void)
   }
   crc_table_empty = 0;
 }
-#elif !defined(CONFIG_ARM64_CRC32)
+#elif CRC32_SLICE_BY_8
+#include "crc32table.h"
+#else
 /* ========================================================================
  * Table of CRC-32's of all single-byte values (made by make_crc_table)
  */
@@ -177,16 +189,63 @@ const uint32_t * ZEXPORT get_crc_table()
 
 /* ========================================================================= */
 
+#if CRC32_SLICE_BY_8
+uint32_t __efi_runtime crc32_slice_by_8(uint32_t crc, const unsigned char *buf,
+					uint len, const uint32_t (*tab)[256])
+{
+	const uint32_t *b;
+	uint32_t one, two;
+
+	/* Align it */
+	for (; len && ((uintptr_t)buf & 3); len--)
+		crc = tab[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	/* Eight bytes at a time, one table lookup per byte */
+	for (b = (const uint32_t *)buf; len >= 8; len -= 8) {
+		one = le32_to_cpu(*b++) ^ crc;
+		two = le32_to_cpu(*b++);
+		crc = tab[7][one & 0xff] ^ tab[6][(one >> 8) & 0xff] ^
+		      tab[5][(one >> 16) & 0xff] ^ tab[4][one >> 24] ^
+		      tab[3][two & 0xff] ^ tab[2][(two >> 8) & 0xff] ^
+		      tab[1][(two >> 16) & 0xff] ^ tab[0][two >> 24];
+	}
+
+	/* And the last few bytes */
+	for (buf = (const unsigned char *)b; len; len--)
+		crc = tab[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+#endif
+
+#ifdef CONFIG_ARM64_CRC32
+static uint32_t __efi_runtime crc32_arm64(uint32_t crc, const Bytef *buf,
+					  uInt len)
+{
+	for (; len && ((uintptr_t)buf & 7); len--)
+		crc = __builtin_aarch64_crc32b(crc, *buf++);
+	for (; len >= 8; len -= 8, buf += 8)
+		crc = __builtin_aarch64_crc32x(crc,
+					       le64_to_cpu(*(const uint64_t *)buf));
+	while (len--)
+		crc = __builtin_aarch64_crc32b(crc, *buf++);
+
+	return crc;
+}
+#endif
+
 /* No ones complement version. JFFS2 (and other things ?)
  * don't use ones compliment in their CRC calculations.
  */
 uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 {
 #ifdef CONFIG_ARM64_CRC32
-    crc = cpu_to_le32(crc);
-    while (len--)
-        crc = __builtin_aarch64_crc32b(crc, *buf++);
-    return le32_to_cpu(crc);
+    /* The CRC32 instructions are optional in ARMv8.0 */
+    if (cpu_has_crc32())
+        return crc32_arm64(crc, buf, len);
+#endif
+#if CRC32_SLICE_BY_8
+    return crc32_slice_by_8(crc, buf, len, crc32table_le);
 #else
     const uint32_t *tab = crc_table;
     const uint32_t *b =(const uint32_t *)buf;
@@ -11,10 +11,51 @@
  */
 
 #include <compiler.h>
+#include <u-boot/crc.h>
+#ifdef CONFIG_ARM64_CRC32
+#include <asm/system.h>
+#endif
+
+/* Bit-reflected Castagnoli polynomial */
+#define CRC32C_POLY	0x82f63b78
+
+#if CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+#include "crc32ctable.h"
+#endif
+
+#ifdef CONFIG_ARM64_CRC32
+static uint32_t crc32c_arm64(uint32_t crc, const unsigned char *buf, uint len)
+{
+	for (; len && ((uintptr_t)buf & 7); len--)
+		crc = __builtin_aarch64_crc32cb(crc, *buf++);
+	for (; len >= 8; len -= 8, buf += 8)
+		crc = __builtin_aarch64_crc32cx(crc,
+						le64_to_cpu(*(const uint64_t *)buf));
+	while (len--)
+		crc = __builtin_aarch64_crc32cb(crc, *buf++);
+
+	return crc;
+}
+#endif
 
 uint32_t crc32c_cal(uint32_t crc, const char *data, int length,
 		    uint32_t *crc32c_table)
 {
+	/*
+	 * crc32c_init() leaves the polynomial at index 128, which identifies a
+	 * Castagnoli table. Faster code is available for that.
+	 */
+	if (crc32c_table[128] == CRC32C_POLY && length > 0) {
+#ifdef CONFIG_ARM64_CRC32
+		if (cpu_has_crc32())
+			return crc32c_arm64(crc, (const u8 *)data, length);
+#endif
+#if CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+		return crc32_slice_by_8(crc, (const u8 *)data, length,
+					crc32ctable_le);
+#endif
+	}
+
 	while (length--)
 		crc = crc32c_table[(u8)(crc ^ *data++)] ^ (crc >> 8);
 
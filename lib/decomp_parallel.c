@@ -0,0 +1,344 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Decompressing multi-frame images on several CPUs
+ *
+ * A zstd image made of several frames which record their content size, or a
+ * blocked gzip (BGZF) image, whose members record their compressed size,
+ * can be split up before decompressing it. Each frame or member then becomes
+ * a job for smp_worker_run(), writing to its own part of the output.
+ */
+
+#define LOG_CATEGORY	LOGC_BOOT
+
+#include <abuf.h>
+#include <bootstage.h>
+#include <gzip.h>
+#include <log.h>
+#include <malloc.h>
+#include <smp_worker.h>
+#include <time.h>
+#include <asm/unaligned.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/sizes.h>
+#include <linux/zstd.h>
+#include <u-boot/zlib.h>
+
+/**
+ * struct decomp_frame - a frame or member which is decompressed as one job
+ *
+ * @src: Compressed data
+ * @src_len: Length of compressed data
+ * @dst: Where to put the decompressed data
+ * @dst_len: Length of the decompressed data
+ */
+struct decomp_frame {
+	const void *src;
+	size_t src_len;
+	void *dst;
+	size_t dst_len;
+};
+
+/* Record the wall-clock and total CPU time spent decompressing */
+static void decomp_parallel_record(ulong start, ulong busy_us)
+{
+	ulong us = timer_get_us() - start;
+
+	bootstage_accum_add(BOOTSTAGE_ID_ACCUM_DECOMP, "decomp", us);
+	bootstage_accum_add(BOOTSTAGE_ID_ACCUM_DECOMP_CPU, "decomp_cpu",
+			    busy_us);
+	log_debug("decompressed in %lu us, %lu us of CPU time\n", us,
+		  busy_us);
+}
+
+#if CONFIG_IS_ENABLED(ZSTD)
+/**
+ * struct zstd_parallel - state for decompressing zstd frames in parallel
+ *
+ * @frames: Frames to decompress
+ * @dctx: Decompression context for each CPU
+ */
+struct zstd_parallel {
+	struct decomp_frame *frames;
+	zstd_dctx *dctx[CONFIG_SMP_WORKERS_MAX + 1];
+};
+
+static int zstd_frame_job(void *ctx, int job, int cpu)
+{
+	struct zstd_parallel *par = ctx;
+	struct decomp_frame *frame = &par->frames[job];
+	size_t len;
+
+	len = zstd_decompress_dctx(par->dctx[cpu], frame->dst, frame->dst_len,
+				   frame->src, frame->src_len);
+	if (zstd_is_error(len) || len != frame->dst_len)
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * Find the frames in @in, filling in @frames if not NULL. Returns the number
+ * of frames, or 0 if any frame does not record its content size
+ */
+static int zstd_find_frames(struct abuf *in, struct abuf *out,
+			    struct decomp_frame *frames, size_t *totalp)
+{
+	const void *src = abuf_data(in);
+	size_t pos = 0, total = 0, len;
+	zstd_frame_header hdr;
+	int count = 0;
+
+	while (pos < abuf_size(in)) {
+		if (zstd_get_frame_header(&hdr, src + pos, abuf_size(in) - pos))
+			break;
+		len = zstd_find_frame_compressed_size(src + pos,
+						      abuf_size(in) - pos);
+		if (zstd_is_error(len))
+			break;
+		if (hdr.frameType == ZSTD_frame) {
+			if (hdr.frameContentSize == ZSTD_CONTENTSIZE_UNKNOWN)
+				return 0;
+			if (frames) {
+				frames[count].src = src + pos;
+				frames[count].src_len = len;
+				frames[count].dst = abuf_data(out) + total;
+				frames[count].dst_len = hdr.frameContentSize;
+			}
+			total += hdr.frameContentSize;
+			count++;
+		}
+		pos += len;
+	}
+	*totalp = total;
+
+	return count;
+}
+
+int zstd_decompress_parallel(struct abuf *in, struct abuf *out)
+{
+	struct zstd_parallel par = {};
+	ulong start, busy_us;
+	int count, cpu, cpus, ret;
+	size_t wsize, total;
+	void *workspace;
+
+	start = timer_get_us();
+	count = zstd_find_frames(in, out, NULL, &total);
+	if (count < 2) {
+		ret = zstd_decompress(in, out);
+		if (ret >= 0)
+			decomp_parallel_record(start, timer_get_us() - start);
+		return ret;
+	}
+	if (total > abuf_size(out))
+		return -ENOSPC;
+
+	cpus = min(smp_worker_cpus(), count);
+	wsize = zstd_dctx_workspace_bound();
+	workspace = malloc(wsize * cpus);
+	par.frames = calloc(count, sizeof(*par.frames));
+	if (!workspace || !par.frames) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	zstd_find_frames(in, out, par.frames, &total);
+
+	for (cpu = 0; cpu < cpus; cpu++) {
+		par.dctx[cpu] = zstd_init_dctx(workspace + cpu * wsize, wsize);
+		if (!par.dctx[cpu]) {
+			ret = -EPERM;
+			goto out;
+		}
+	}
+
+	ret = smp_worker_run(zstd_frame_job, &par, count, &busy_us);
+	if (ret) {
+		log_err("%s: failed to decompress: %d\n", __func__, ret);
+		goto out;
+	}
+	decomp_parallel_record(start, busy_us);
+	ret = total;
+
+out:
+	free(par.frames);
+	free(workspace);
+
+	return ret;
+}
+#endif /* ZSTD */
+
+#if CONFIG_IS_ENABLED(GZIP)
+/* Header, extra-field length and 'BC' subfield of a BGZF member */
+#define BGZF_HDR_LEN		18
+/* CRC32 and uncompressed size at the end of each member */
+#define GZIP_TRAILER_LEN	8
+/* Enough for the inflate state and a 32KiB window */
+#define GUNZIP_ARENA_SIZE	SZ_64K
+
+/**
+ * struct gunzip_parallel - state for decompressing BGZF members in parallel
+ *
+ * @frames: Members to decompress
+ * @arena: Memory for zlib's allocations, for each CPU
+ * @used: Number of bytes of @arena in use, for each CPU
+ */
+struct gunzip_parallel {
+	struct decomp_frame *frames;
+	void *arena[CONFIG_SMP_WORKERS_MAX + 1];
+	size_t used[CONFIG_SMP_WORKERS_MAX + 1];
+};
+
+/* zlib allocator which takes memory from the arena of the CPU */
+static void *gunzip_arena_alloc(void *opaque, uInt items, uInt size)
+{
+	struct gunzip_parallel *par = opaque;
+	int cpu = smp_worker_cpu();
+	void *ptr;
+
+	size = ALIGN(items * size, 16);
+	if (par->used[cpu] + size > GUNZIP_ARENA_SIZE)
+		return NULL;
+	ptr = par->arena[cpu] + par->used[cpu];
+	par->used[cpu] += size;
+
+	return ptr;
+}
+
+static void gunzip_arena_free(void *opaque, void *ptr, uInt size)
+{
+}
+
+static int gunzip_member_job(void *ctx, int job, int cpu)
+{
+	struct gunzip_parallel *par = ctx;
+	struct decomp_frame *frame = &par->frames[job];
+	z_stream s = {};
+	int ret;
+
+	par->used[cpu] = 0;
+	s.zalloc = gunzip_arena_alloc;
+	s.zfree = gunzip_arena_free;
+	s.opaque = par;
+	if (inflateInit2(&s, -MAX_WBITS) != Z_OK)
+		return -ENOMEM;
+
+	s.next_in = (void *)frame->src;
+	s.avail_in = frame->src_len;
+	s.next_out = frame->dst;
+	s.avail_out = frame->dst_len;
+	ret = inflate(&s, Z_FINISH);
+	inflateEnd(&s);
+	if (ret != Z_STREAM_END || s.avail_out)
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * Get the size of the BGZF member at @src, which is recorded in a 'BC'
+ * subfield of the extra field. Returns -EINVAL if this is not one.
+ */
+static long gzip_bgzf_member_size(const unsigned char *src, ulong len)
+{
+	uint xlen, pos, slen;
+	ulong size;
+
+	if (len < BGZF_HDR_LEN || src[0] != 0x1f || src[1] != 0x8b ||
+	    src[2] != Z_DEFLATED || !(src[3] & 4))
+		return -EINVAL;
+
+	xlen = get_unaligned_le16(src + 10);
+	for (pos = 12; pos + 6 <= 12 + xlen && pos + 6 <= len;
+	     pos += 4 + slen) {
+		slen = get_unaligned_le16(src + pos + 2);
+		if (src[pos] == 'B' && src[pos + 1] == 'C' && slen == 2) {
+			size = get_unaligned_le16(src + pos + 4) + 1;
+			return size <= len ? size : -EINVAL;
+		}
+	}
+
+	return -EINVAL;
+}
+
+/*
+ * Find the members in @src, filling in @frames if not NULL. Returns the
+ * number of members, or -EINVAL if one is corrupt
+ */
+static int gunzip_find_members(void *dst, unsigned char *src, ulong len,
+			       struct decomp_frame *frames, size_t *totalp)
+{
+	size_t pos = 0, total = 0;
+	long size, hdr_len;
+	int count = 0;
+
+	while (1) {
+		size = gzip_bgzf_member_size(src + pos, len - pos);
+		if (size < 0)
+			break;
+		hdr_len = gzip_parse_header(src + pos, size);
+		if (hdr_len < 0 || hdr_len + GZIP_TRAILER_LEN > size)
+			return -EINVAL;
+		if (frames) {
+			frames[count].src = src + pos + hdr_len;
+			frames[count].src_len = size - hdr_len -
+				GZIP_TRAILER_LEN;
+			frames[count].dst = dst + total;
+			frames[count].dst_len =
+				get_unaligned_le32(src + pos + size - 4);
+		}
+		total += get_unaligned_le32(src + pos + size - 4);
+		pos += size;
+		count++;
+	}
+	*totalp = total;
+
+	return count;
+}
+
+int gunzip_parallel(void *dst, int dstlen, unsigned char *src,
+		    unsigned long *lenp)
+{
+	struct gunzip_parallel par = {};
+	ulong start, busy_us;
+	int count, cpu, cpus, ret;
+	size_t total;
+	void *arena;
+
+	start = timer_get_us();
+	count = gunzip_find_members(dst, src, *lenp, NULL, &total);
+	if (count < 2) {
+		ret = gunzip(dst, dstlen, src, lenp);
+		if (!ret)
+			decomp_parallel_record(start, timer_get_us() - start);
+		return ret;
+	}
+	if (total > dstlen)
+		return -ENOSPC;
+
+	cpus = min(smp_worker_cpus(), count);
+	arena = malloc(GUNZIP_ARENA_SIZE * cpus);
+	par.frames = calloc(count, sizeof(*par.frames));
+	if (!arena || !par.frames) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	gunzip_find_members(dst, src, *lenp, par.frames, &total);
+	for (cpu = 0; cpu < cpus; cpu++)
+		par.arena[cpu] = arena + cpu * GUNZIP_ARENA_SIZE;
+
+	ret = smp_worker_run(gunzip_member_job, &par, count, &busy_us);
+	if (ret) {
+		log_err("%s: failed to decompress: %d\n", __func__, ret);
+		goto out;
+	}
+	decomp_parallel_record(start, busy_us);
+	*lenp = total;
+
+out:
+	free(par.frames);
+	free(arena);
+
+	return ret;
+}
+#endif /* GZIP */
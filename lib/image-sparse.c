@@ -49,270 +49,543 @@
 
 static void default_log(const char *ignored, char *response) {}
 
-static lbaint_t write_sparse_chunk_raw(struct sparse_storage *info,
-				       lbaint_t blk, lbaint_t blkcnt,
-				       void *data,
-				       char *response)
+static int sparse_fail(struct sparse_stream *ss, const char *msg,
+		       char *response)
 {
-	lbaint_t n = blkcnt, write_blks, blks = 0;
-	lbaint_t aligned_buf_blks = FASTBOOT_MAX_BLK_WRITE;
-	uint32_t *aligned_buf = NULL;
+	ss->info->mssg(msg, response);
+	ss->state = SPARSE_FAILED;
 
-	if (CONFIG_IS_ENABLED(SYS_DCACHE_OFF)) {
-		write_blks = info->write(info, blk, n, data);
-		if (write_blks < n)
-			goto write_fail;
+	return -EIO;
+}
 
-		return write_blks;
-	}
+/* Wait for the outstanding write, if any */
+static int sparse_stream_wait(struct sparse_stream *ss, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	lbaint_t blks;
 
-	aligned_buf = memalign(ARCH_DMA_MINALIGN, info->blksz * aligned_buf_blks);
-	if (!aligned_buf) {
-		info->mssg("Malloc failed for: CHUNK_TYPE_RAW", response);
-		return -ENOMEM;
+	if (!ss->busy)
+		return 0;
+	ss->busy = false;
+	blks = info->wait(info);
+	if (IS_ERR_VALUE(blks) || blks < ss->stage_size / info->blksz) {
+		printf("%s: Write failed (%lld)\n", __func__, (long long)blks);
+		return sparse_fail(ss, "flash write failure", response);
 	}
 
-	while (blkcnt > 0) {
-		n = min(aligned_buf_blks, blkcnt);
-		memcpy(aligned_buf, data, n * info->blksz);
+	return 0;
+}
 
-		/* write_blks might be > n due to NAND bad-blocks */
-		write_blks = info->write(info, blk + blks, n, aligned_buf);
-		if (write_blks < n) {
-			free(aligned_buf);
-			goto write_fail;
+/* Write out the staging buffer, which must hold whole blocks */
+static int sparse_stream_flush(struct sparse_stream *ss, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	lbaint_t n = ss->staged / info->blksz;
+	lbaint_t blks;
+	int ret;
+
+	if (!n)
+		return 0;
+
+	if (info->submit) {
+		/* Make sure that the other buffer is free, then swap */
+		ret = sparse_stream_wait(ss, response);
+		if (ret)
+			return ret;
+		ret = info->submit(info, ss->blk, n, ss->stage[ss->cur]);
+		if (ret) {
+			printf("%s: Write failed, block #" LBAFU " [" LBAFU
+			       "] (%d)\n", __func__, ss->blk, n, ret);
+			return sparse_fail(ss, "flash write failure", response);
 		}
-
-		blks += write_blks;
-		data += n * info->blksz;
-		blkcnt -= n;
+		/* A short final write is checked against the full size */
+		ss->busy = n == ss->stage_size / info->blksz;
+		if (!ss->busy) {
+			blks = info->wait(info);
+			if (blks != n)
+				goto write_fail;
+		}
+		ss->blk += n;
+		ss->cur = !ss->cur;
+	} else {
+		/* blks might be > n due to NAND bad-blocks */
+		blks = info->write(info, ss->blk, n, ss->stage[ss->cur]);
+		if (IS_ERR_VALUE(blks) || blks < n)
+			goto write_fail;
+		ss->blk += blks;
 	}
+	ss->staged = 0;
 
-	free(aligned_buf);
-	return blks;
+	return 0;
 
 write_fail:
-	if (IS_ERR_VALUE(write_blks)) {
-		printf("%s: Write failed, block #" LBAFU " [" LBAFU "] (%lld)\n",
-		       __func__, blk + blks, n, (long long)write_blks);
-		info->mssg("flash write failure", response);
-		return write_blks;
+	printf("%s: Write failed, block #" LBAFU " [" LBAFU "] (%lld)\n",
+	       __func__, ss->blk, n, (long long)blks);
+	return sparse_fail(ss, "flash write failure", response);
+}
+
+/* Add data to the staging buffer, writing it out as it fills */
+static int sparse_stream_stage(struct sparse_stream *ss, const void *data,
+			       size_t len, char *response)
+{
+	size_t n;
+	int ret;
+
+	while (len) {
+		n = min(len, ss->stage_size - ss->staged);
+		memcpy(ss->stage[ss->cur] + ss->staged, data, n);
+		ss->staged += n;
+		data += n;
+		len -= n;
+		if (ss->staged == ss->stage_size) {
+			ret = sparse_stream_flush(ss, response);
+			if (ret)
+				return ret;
+		}
 	}
 
-	/* write_blks < n */
-	printf("%s: Write failed, block #" LBAFU " [" LBAFU "]\n",
-	       __func__, blk + blks, n);
-	info->mssg("flash write failure(incomplete)", response);
-	return -1;
+	return 0;
 }
 
-int write_sparse_image(struct sparse_storage *info,
-		       const char *part_name, void *data, char *response)
+/* Get the next block to be written, counting staged data */
+static lbaint_t sparse_stream_next_blk(struct sparse_stream *ss)
 {
-	lbaint_t blk;
-	lbaint_t blkcnt;
-	lbaint_t blks;
-	uint64_t bytes_written = 0;
-	unsigned int chunk;
-	unsigned int offset;
-	uint64_t chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
-	int fill_buf_num_blks;
-	int i;
-	int j;
+	return ss->blk + ss->staged / ss->info->blksz;
+}
 
-	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
+/*
+ * Collect bytes into ss->collect until @want are present. Returns the number
+ * of bytes used from @data
+ */
+static size_t sparse_stream_collect(struct sparse_stream *ss, const void *data,
+				    size_t len, uint want)
+{
+	size_t n = min_t(size_t, len, want - ss->have);
 
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *)data;
+	memcpy(ss->collect + ss->have, data, n);
+	ss->have += n;
 
-	data += sparse_header->file_hdr_sz;
-	if (sparse_header->file_hdr_sz > sizeof(sparse_header_t)) {
-		/*
-		 * Skip the remaining bytes in a header that is longer than
-		 * we expected.
-		 */
-		data += (sparse_header->file_hdr_sz - sizeof(sparse_header_t));
-	}
+	return n;
+}
 
-	if (!info->mssg)
-		info->mssg = default_log;
+/* Skip @skip bytes of input, then move to state @next */
+static void sparse_stream_skip(struct sparse_stream *ss, u64 skip,
+			       enum sparse_stream_state next)
+{
+	ss->have = 0;
+	ss->skip = skip;
+	ss->next = next;
+	ss->state = skip ? SPARSE_SKIP : next;
+}
+
+/* Finish the current chunk, skipping @skip bytes of trailing input */
+static void sparse_stream_next_chunk(struct sparse_stream *ss, u64 skip)
+{
+	ss->chunk++;
+	sparse_stream_skip(ss, skip, ss->chunk < ss->hdr.total_chunks ?
+			   SPARSE_CHUNK_HDR : SPARSE_DONE);
+}
+
+static int sparse_stream_file_hdr(struct sparse_stream *ss, char *response)
+{
+	sparse_header_t *hdr = &ss->hdr;
+	struct sparse_storage *info = ss->info;
+	unsigned int offset;
+
+	memcpy(hdr, ss->collect, sizeof(*hdr));
+	if (!is_sparse_image(hdr)) {
+		/* Write the image as it is, starting with these bytes */
+		ss->state = SPARSE_IMAGE;
+		puts("Flashing Raw Image\n");
+
+		return sparse_stream_stage(ss, ss->collect, ss->have, response);
+	}
 
 	debug("=== Sparse Image Header ===\n");
-	debug("magic: 0x%x\n", sparse_header->magic);
-	debug("major_version: 0x%x\n", sparse_header->major_version);
-	debug("minor_version: 0x%x\n", sparse_header->minor_version);
-	debug("file_hdr_sz: %d\n", sparse_header->file_hdr_sz);
-	debug("chunk_hdr_sz: %d\n", sparse_header->chunk_hdr_sz);
-	debug("blk_sz: %d\n", sparse_header->blk_sz);
-	debug("total_blks: %d\n", sparse_header->total_blks);
-	debug("total_chunks: %d\n", sparse_header->total_chunks);
+	debug("magic: 0x%x\n", hdr->magic);
+	debug("major_version: 0x%x\n", hdr->major_version);
+	debug("minor_version: 0x%x\n", hdr->minor_version);
+	debug("file_hdr_sz: %d\n", hdr->file_hdr_sz);
+	debug("chunk_hdr_sz: %d\n", hdr->chunk_hdr_sz);
+	debug("blk_sz: %d\n", hdr->blk_sz);
+	debug("total_blks: %d\n", hdr->total_blks);
+	debug("total_chunks: %d\n", hdr->total_chunks);
 
 	/*
 	 * Verify that the sparse block size is a multiple of our
 	 * storage backend block size
 	 */
-	div_u64_rem(sparse_header->blk_sz, info->blksz, &offset);
+	div_u64_rem(hdr->blk_sz, info->blksz, &offset);
 	if (offset) {
 		printf("%s: Sparse image block size issue [%u]\n",
-		       __func__, sparse_header->blk_sz);
-		info->mssg("sparse image block size issue", response);
-		return -1;
+		       __func__, hdr->blk_sz);
+		return sparse_fail(ss, "sparse image block size issue",
+				   response);
 	}
+	if (hdr->file_hdr_sz < sizeof(*hdr) ||
+	    hdr->chunk_hdr_sz < sizeof(chunk_header_t))
+		return sparse_fail(ss, "sparse image header size issue",
+				   response);
 
 	puts("Flashing Sparse Image\n");
 
-	/* Start processing chunks */
-	blk = info->start;
-	for (chunk = 0; chunk < sparse_header->total_chunks; chunk++) {
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *)data;
-		data += sizeof(chunk_header_t);
-
-		if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
-			debug("=== Chunk Header ===\n");
-			debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
-			debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-			debug("total_size: 0x%x\n", chunk_header->total_sz);
-		}
+	/* Skip the remaining bytes in a header longer than we expected */
+	sparse_stream_skip(ss, hdr->file_hdr_sz - sizeof(*hdr),
+			   hdr->total_chunks ? SPARSE_CHUNK_HDR : SPARSE_DONE);
 
-		if (sparse_header->chunk_hdr_sz > sizeof(chunk_header_t)) {
-			/*
-			 * Skip the remaining bytes in a header that is longer
-			 * than we expected.
-			 */
-			data += (sparse_header->chunk_hdr_sz -
-				 sizeof(chunk_header_t));
-		}
+	return 0;
+}
+
+static int sparse_stream_chunk_hdr(struct sparse_stream *ss, char *response)
+{
+	chunk_header_t *chunk_header = &ss->chunk_hdr;
+	sparse_header_t *hdr = &ss->hdr;
+	struct sparse_storage *info = ss->info;
+	u64 chunk_data_sz, extra;
+	lbaint_t blkcnt, blk;
+	int ret;
+
+	memcpy(chunk_header, ss->collect, sizeof(*chunk_header));
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
 
-		chunk_data_sz = ((u64)sparse_header->blk_sz) * chunk_header->chunk_sz;
-		blkcnt = DIV_ROUND_UP_ULL(chunk_data_sz, info->blksz);
-		switch (chunk_header->chunk_type) {
-		case CHUNK_TYPE_RAW:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
-				info->mssg("Bogus chunk size for chunk type Raw",
+	/* Skip the remaining bytes in a header longer than we expected */
+	extra = hdr->chunk_hdr_sz - sizeof(*chunk_header);
+	chunk_data_sz = ((u64)hdr->blk_sz) * chunk_header->chunk_sz;
+	blkcnt = DIV_ROUND_UP_ULL(chunk_data_sz, info->blksz);
+	blk = sparse_stream_next_blk(ss);
+
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    (hdr->chunk_hdr_sz + chunk_data_sz))
+			return sparse_fail(ss,
+					   "Bogus chunk size for chunk type Raw",
 					   response);
-				return -1;
-			}
+		if (blk + blkcnt > info->start + info->size) {
+			printf("%s: Request would exceed partition size!\n",
+			       __func__);
+			return sparse_fail(ss,
+					   "Request would exceed partition size!",
+					   response);
+		}
+		ss->left = chunk_data_sz;
+		ss->bytes_written += ((u64)blkcnt) * info->blksz;
+		ss->total_blocks += chunk_header->chunk_sz;
+		if (ss->left)
+			sparse_stream_skip(ss, extra, SPARSE_RAW);
+		else
+			sparse_stream_next_chunk(ss, extra);
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    (hdr->chunk_hdr_sz + sizeof(uint32_t)))
+			return sparse_fail(ss,
+					   "Bogus chunk size for chunk type FILL",
+					   response);
+		if (blk + blkcnt > info->start + info->size) {
+			printf("%s: Request would exceed partition size!\n",
+			       __func__);
+			return sparse_fail(ss,
+					   "Request would exceed partition size!",
+					   response);
+		}
+		sparse_stream_skip(ss, extra, SPARSE_FILL);
+		break;
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
+	case CHUNK_TYPE_DONT_CARE:
+		if (chunk_header->total_sz < hdr->chunk_hdr_sz)
+			return sparse_fail(ss,
+					   "Bogus chunk size for chunk type Dont Care",
 					   response);
-				return -1;
-			}
+		ret = sparse_stream_flush(ss, response);
+		if (ret)
+			return ret;
+		ss->blk += info->reserve(info, ss->blk, blkcnt);
+		ss->total_blocks += chunk_header->chunk_sz;
+		sparse_stream_next_chunk(ss, extra + chunk_header->total_sz -
+					 hdr->chunk_hdr_sz);
+		break;
+
+	case CHUNK_TYPE_CRC32:
+		if (chunk_header->total_sz !=
+		    hdr->chunk_hdr_sz + sizeof(uint32_t))
+			return sparse_fail(ss,
+					   "Bogus chunk size for chunk type CRC32",
+					   response);
+		ss->total_blocks += chunk_header->chunk_sz;
+		sparse_stream_next_chunk(ss, extra + sizeof(uint32_t));
+		break;
+
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		return sparse_fail(ss, "Unknown chunk type", response);
+	}
 
-			blks = write_sparse_chunk_raw(info, blk, blkcnt,
-						      data, response);
-			if (IS_ERR_VALUE(blks))
-				return -1;
+	return 0;
+}
 
-			blk += blks;
-			bytes_written += ((u64)blkcnt) * info->blksz;
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
+static int sparse_stream_fill(struct sparse_stream *ss, char *response)
+{
+	chunk_header_t *chunk_header = &ss->chunk_hdr;
+	struct sparse_storage *info = ss->info;
+	int fill_buf_num_blks;
+	u64 chunk_data_sz;
+	uint32_t *fill_buf;
+	uint32_t fill_val;
+	lbaint_t blkcnt;
+	lbaint_t blks;
+	int i, j, ret;
 
-		case CHUNK_TYPE_FILL:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
-				info->mssg("Bogus chunk size for chunk type FILL", response);
-				return -1;
-			}
+	/* Keep the writes in order */
+	ret = sparse_stream_flush(ss, response);
+	if (!ret)
+		ret = sparse_stream_wait(ss, response);
+	if (ret)
+		return ret;
 
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(
-						info->blksz * fill_buf_num_blks,
+	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
+	chunk_data_sz = ((u64)ss->hdr.blk_sz) * chunk_header->chunk_sz;
+	blkcnt = DIV_ROUND_UP_ULL(chunk_data_sz, info->blksz);
+	fill_buf = (uint32_t *)memalign(ARCH_DMA_MINALIGN,
+					ROUNDUP(info->blksz * fill_buf_num_blks,
 						ARCH_DMA_MINALIGN));
-			if (!fill_buf) {
-				info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
-					   response);
-				return -1;
-			}
+	if (!fill_buf)
+		return sparse_fail(ss, "Malloc failed for: CHUNK_TYPE_FILL",
+				   response);
+
+	memcpy(&fill_val, ss->collect, sizeof(fill_val));
+	for (i = 0; i < (info->blksz * fill_buf_num_blks / sizeof(fill_val));
+	     i++)
+		fill_buf[i] = fill_val;
+
+	for (i = 0; i < blkcnt;) {
+		j = blkcnt - i;
+		if (j > fill_buf_num_blks)
+			j = fill_buf_num_blks;
+		blks = info->write(info, ss->blk, j, fill_buf);
+		/* blks might be > j (eg. NAND bad-blocks) */
+		if (IS_ERR_VALUE(blks) || blks < j) {
+			printf("%s: %s " LBAFU " [%d]\n", __func__,
+			       "Write failed, block #", ss->blk, j);
+			free(fill_buf);
+			return sparse_fail(ss, "flash write failure", response);
+		}
+		ss->blk += blks;
+		i += j;
+	}
+	ss->bytes_written += ((u64)blkcnt) * info->blksz;
+	ss->total_blocks += DIV_ROUND_UP_ULL(chunk_data_sz, ss->hdr.blk_sz);
+	free(fill_buf);
+	sparse_stream_next_chunk(ss, 0);
 
-			fill_val = *(uint32_t *)data;
-			data = (char *)data + sizeof(uint32_t);
+	return 0;
+}
 
-			for (i = 0;
-			     i < (info->blksz * fill_buf_num_blks /
-				  sizeof(fill_val));
-			     i++)
-				fill_buf[i] = fill_val;
+int sparse_stream_start(struct sparse_stream *ss, struct sparse_storage *info,
+			void *buf, size_t size)
+{
+	int count = info->submit ? 2 : 1;
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
-					   response);
-				return -1;
-			}
+	memset(ss, '\0', sizeof(*ss));
+	if (!info->mssg)
+		info->mssg = default_log;
+	ss->info = info;
+	ss->stage_size = rounddown(size / count, info->blksz);
+	ss->stage_size = min_t(size_t, ss->stage_size,
+			       FASTBOOT_MAX_BLK_WRITE * info->blksz);
+	if (!ss->stage_size)
+		return -EINVAL;
+	ss->stage[0] = buf;
+	ss->stage[1] = buf + ss->stage_size;
+	ss->blk = info->start;
+	ss->state = SPARSE_FILE_HDR;
 
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					info->mssg("flash write failure",
-						   response);
-					free(fill_buf);
-					return -1;
-				}
-				blk += blks;
-				i += j;
-			}
-			bytes_written += ((u64)blkcnt) * info->blksz;
-			total_blocks += DIV_ROUND_UP_ULL(chunk_data_sz,
-							 sparse_header->blk_sz);
-			free(fill_buf);
-			break;
+	return 0;
+}
 
-		case CHUNK_TYPE_DONT_CARE:
-			blk += info->reserve(info, blk, blkcnt);
-			total_blocks += chunk_header->chunk_sz;
+int sparse_stream_write(struct sparse_stream *ss, const void *data,
+			size_t len, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	size_t n;
+	int ret = 0;
+
+	while (len && !ret) {
+		switch (ss->state) {
+		case SPARSE_FILE_HDR:
+			n = sparse_stream_collect(ss, data, len,
+						  sizeof(sparse_header_t));
+			if (ss->have == sizeof(sparse_header_t))
+				ret = sparse_stream_file_hdr(ss, response);
 			break;
-
-		case CHUNK_TYPE_CRC32:
-			if (chunk_header->total_sz !=
-			    sparse_header->chunk_hdr_sz + sizeof(uint32_t)) {
-				info->mssg("Bogus chunk size for chunk type CRC32",
-					   response);
-				return -1;
+		case SPARSE_CHUNK_HDR:
+			n = sparse_stream_collect(ss, data, len,
+						  sizeof(chunk_header_t));
+			if (ss->have == sizeof(chunk_header_t))
+				ret = sparse_stream_chunk_hdr(ss, response);
+			break;
+		case SPARSE_SKIP:
+			n = min_t(u64, len, ss->skip);
+			ss->skip -= n;
+			if (!ss->skip)
+				ss->state = ss->next;
+			break;
+		case SPARSE_RAW:
+			n = min_t(u64, len, ss->left);
+			ret = sparse_stream_stage(ss, data, n, response);
+			ss->left -= n;
+			if (!ret && !ss->left)
+				sparse_stream_next_chunk(ss, 0);
+			break;
+		case SPARSE_FILL:
+			n = sparse_stream_collect(ss, data, len,
+						  sizeof(uint32_t));
+			if (ss->have == sizeof(uint32_t))
+				ret = sparse_stream_fill(ss, response);
+			break;
+		case SPARSE_IMAGE:
+			n = len;
+			if ((u64)(ss->blk - info->start) * info->blksz +
+			    ss->staged + n > (u64)info->size * info->blksz) {
+				pr_err("too large for partition\n");
+				return sparse_fail(ss, "too large for partition",
+						   response);
 			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
+			ret = sparse_stream_stage(ss, data, n, response);
 			break;
-
+		case SPARSE_DONE:
+			/* Ignore anything after the last chunk */
+			n = len;
+			break;
+		case SPARSE_FAILED:
 		default:
-			printf("%s: Unknown chunk type: %x\n", __func__,
-			       chunk_header->chunk_type);
-			info->mssg("Unknown chunk type", response);
-			return -1;
+			return -EIO;
 		}
+		data += n;
+		len -= n;
 	}
 
-	debug("Wrote %d blocks, expected to write %d blocks\n",
-	      total_blocks, sparse_header->total_blks);
-	printf("........ wrote %llu bytes to '%s'\n", bytes_written, part_name);
+	return ret;
+}
 
-	if (total_blocks != sparse_header->total_blks) {
-		info->mssg("sparse image write failure", response);
-		return -1;
+int sparse_stream_finish(struct sparse_stream *ss, const char *part_name,
+			 char *response)
+{
+	struct sparse_storage *info = ss->info;
+	size_t pad;
+	int ret;
+
+	switch (ss->state) {
+	case SPARSE_FAILED:
+		/* The error is already reported; just drain the last write */
+		if (ss->busy) {
+			ss->busy = false;
+			info->wait(info);
+		}
+		return -EIO;
+	case SPARSE_IMAGE:
+		/* Pad the last block with zeroes */
+		pad = -ss->staged % info->blksz;
+		memset(ss->stage[ss->cur] + ss->staged, '\0', pad);
+		ss->staged += pad;
+		ss->bytes_written = (u64)(sparse_stream_next_blk(ss) -
+					  info->start) * info->blksz;
+		break;
+	case SPARSE_DONE:
+		break;
+	case SPARSE_FILE_HDR:
+		if (ss->have) {
+			/* Too short to be a sparse image, so write it as is */
+			ss->state = SPARSE_IMAGE;
+			puts("Flashing Raw Image\n");
+			ret = sparse_stream_stage(ss, ss->collect, ss->have,
+						  response);
+			if (ret)
+				return ret;
+			return sparse_stream_finish(ss, part_name, response);
+		}
+		fallthrough;
+	default:
+		return sparse_fail(ss, "incomplete image", response);
 	}
 
+	ret = sparse_stream_flush(ss, response);
+	if (!ret)
+		ret = sparse_stream_wait(ss, response);
+	if (ret)
+		return ret;
+
+	if (ss->state == SPARSE_DONE) {
+		debug("Wrote %d blocks, expected to write %d blocks\n",
+		      ss->total_blocks, ss->hdr.total_blks);
+		if (ss->total_blocks != ss->hdr.total_blks) {
+			printf("........ wrote %llu bytes to '%s'\n",
+			       ss->bytes_written, part_name);
+			return sparse_fail(ss, "sparse image write failure",
+					   response);
+		}
+	}
+	printf("........ wrote %llu bytes to '%s'\n", ss->bytes_written,
+	       part_name);
+
 	return 0;
 }
+
+void sparse_stream_abort(struct sparse_stream *ss)
+{
+	if (ss->busy) {
+		ss->busy = false;
+		ss->info->wait(ss->info);
+	}
+	ss->state = SPARSE_FAILED;
+}
+
+int write_sparse_image(struct sparse_storage *info,
+		       const char *part_name, void *data, char *response)
+{
+	sparse_header_t *sparse_header = data;
+	chunk_header_t *chunk_header;
+	struct sparse_stream ss;
+	u64 size;
+	void *buf;
+	uint i;
+	int ret;
+
+	/* Find the length of the image from its chunk headers */
+	size = sparse_header->file_hdr_sz;
+	for (i = 0; i < sparse_header->total_chunks; i++) {
+		chunk_header = data + size;
+		if (chunk_header->total_sz < sparse_header->chunk_hdr_sz)
+			break;
+		size += chunk_header->total_sz;
+	}
+	if (i < sparse_header->total_chunks)
+		size += sparse_header->chunk_hdr_sz;
+
+	buf = memalign(ARCH_DMA_MINALIGN,
+		       info->blksz * FASTBOOT_MAX_BLK_WRITE);
+	if (!buf) {
+		if (info->mssg)
+			info->mssg("Malloc failed for: CHUNK_TYPE_RAW",
+				   response);
+		return -ENOMEM;
+	}
+	ret = sparse_stream_start(&ss, info, buf,
+				  info->blksz * FASTBOOT_MAX_BLK_WRITE);
+	if (!ret)
+		ret = sparse_stream_write(&ss, data, size, response);
+	if (!ret)
+		ret = sparse_stream_finish(&ss, part_name, response);
+	else
+		sparse_stream_finish(&ss, part_name, response);
+	free(buf);
+
+	return ret ? -1 : 0;
+}
@@ -12,6 +12,7 @@
 #include <spl.h>
 #include <time.h>
 #include <timer.h>
+#include <uthread.h>
 #include <watchdog.h>
 #include <div64.h>
 #include <asm/global_data.h>
@@ -194,6 +195,20 @@ void udelay(unsigned long usec)
 {
 	ulong kv;
 
+	/*
+	 * A delay in a uthread runs the other threads rather than sleeping.
+	 * Code on the main thread, which has not opted into threads, keeps
+	 * the plain delay below.
+	 */
+	if (!uthread_is_main() && uthread_active()) {
+		ulong start = timer_get_us();
+
+		do {
+			schedule();
+		} while (timer_get_us() - start < usec);
+		return;
+	}
+
 	do {
 		schedule();
 		kv = usec > CFG_WD_PERIOD ? CFG_WD_PERIOD : usec;
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Cooperative threads, switched with setjmp() and longjmp()
+ */
+
+#include <log.h>
+#include <malloc.h>
+#include <vsprintf.h>
+#include <uthread.h>
+#include <u-boot/schedule.h>
+#include <linux/errno.h>
+#include <linux/list.h>
+
+/* The thread which U-Boot starts on, which has no stack of its own */
+static struct uthread main_thread = {
+	.list = LIST_HEAD_INIT(main_thread.list),
+};
+
+/* Thread which is running now */
+static struct uthread *current = &main_thread;
+
+/* Last group ID handed out */
+static uint last_grp_id;
+
+/* Get the next thread after @uthr which has not finished */
+static struct uthread *uthread_next(struct uthread *uthr)
+{
+	struct uthread *next = uthr;
+
+	do {
+		next = list_entry(next->list.next, struct uthread, list);
+	} while (next->done && next != uthr);
+
+	return next;
+}
+
+/* Free the threads which have finished; must be called on the main thread */
+static void uthread_reap(void)
+{
+	struct uthread *uthr, *tmp;
+
+	list_for_each_entry_safe(uthr, tmp, &main_thread.list, list) {
+		if (!uthr->done)
+			continue;
+		list_del(&uthr->list);
+		free(uthr->stack);
+		if (uthr->alloced)
+			free(uthr);
+	}
+}
+
+static void __noreturn uthread_entry(void)
+{
+	current->fn(current->arg);
+	current->done = true;
+
+	/* This thread is never picked again, so this does not return */
+	uthread_schedule();
+	panic("uthread: finished thread resumed\n");
+}
+
+int uthread_create(struct uthread *uthr, void (*fn)(void *), void *arg,
+		   size_t stack_sz, uint grp_id)
+{
+	bool alloced = false;
+	int ret;
+
+	if (!stack_sz)
+		stack_sz = CONFIG_UTHREAD_STACK_SIZE;
+	if (!uthr) {
+		uthr = calloc(1, sizeof(*uthr));
+		if (!uthr)
+			return -ENOMEM;
+		alloced = true;
+	}
+	uthr->fn = fn;
+	uthr->arg = arg;
+	uthr->done = false;
+	uthr->alloced = alloced;
+	uthr->grp_id = grp_id;
+	uthr->stack = memalign(16, stack_sz);
+	if (!uthr->stack) {
+		ret = -ENOMEM;
+		goto err;
+	}
+	ret = initjmp(uthr->ctx, uthread_entry, uthr->stack, stack_sz);
+	if (ret)
+		goto err_stack;
+	list_add_tail(&uthr->list, &main_thread.list);
+
+	return 0;
+
+err_stack:
+	free(uthr->stack);
+err:
+	if (alloced)
+		free(uthr);
+	log_debug("Cannot create thread (err=%d)\n", ret);
+
+	return ret;
+}
+
+bool uthread_schedule(void)
+{
+	struct uthread *prev = current;
+	struct uthread *next;
+
+	next = uthread_next(prev);
+	if (next == prev) {
+		if (prev == &main_thread)
+			uthread_reap();
+		return false;
+	}
+
+	current = next;
+	if (!setjmp(prev->ctx))
+		longjmp(next->ctx, 1);
+
+	/* Back on @prev, which is now current again */
+	if (current == &main_thread)
+		uthread_reap();
+
+	return true;
+}
+
+bool uthread_active(void)
+{
+	return uthread_next(current) != current;
+}
+
+bool uthread_is_main(void)
+{
+	return current == &main_thread;
+}
+
+uint uthread_grp_new_id(void)
+{
+	return ++last_grp_id;
+}
+
+bool uthread_grp_done(uint grp_id)
+{
+	struct uthread *uthr;
+
+	list_for_each_entry(uthr, &main_thread.list, list) {
+		if (uthr->grp_id == grp_id && !uthr->done)
+			return false;
+	}
+
+	return true;
+}
+
+void uthread_grp_wait(uint grp_id)
+{
+	while (!uthread_grp_done(grp_id))
+		schedule();
+}
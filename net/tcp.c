@@ -39,19 +39,23 @@ static u32 tcp_ack_edge;
 static int tcp_activity_count;
 
 /*
- * Search for TCP_SACK and review the comments before the code section
- * TCP_SACK is the number of packets at the front of the stream
+ * Data received beyond tcp_ack_edge, as sorted, non-overlapping ranges of
+ * sequence numbers. This is what SACK reports to the sender.
  */
+static struct sack_edges tcp_hills[TCP_SACK];
+static unsigned int tcp_hill_cnt;
 
-enum pkt_state {PKT, NOPKT};
-struct sack_r {
-	struct sack_edges se;
-	enum pkt_state st;
-};
+/* Receive window in bytes, and the window scale we offer for it */
+static u32 tcp_rx_window = TCP_RX_WINDOW_DEFAULT;
+static u8 tcp_rx_shift;
 
-static struct sack_r edge_a[TCP_SACK];
-static unsigned int sack_idx;
-static unsigned int prev_len;
+/* Options agreed with the other end in the SYN exchange */
+static bool tcp_ws_ok;
+static bool tcp_sack_ok;
+
+/* Options seen in the packet being processed */
+static bool rmt_ws;
+static bool rmt_sack;
 
 /*
  * TCP lengths are stored as a rounded up number of 32 bit words.
@@ -98,6 +102,8 @@ static void dummy_handler(uchar *pkt, u16 dport,
 /**
  * tcp_set_tcp_handler() - set a handler to receive data
  * @f: handler
+ *
+ * This also sets the receive window back to TCP_RX_WINDOW_DEFAULT.
  */
 void tcp_set_tcp_handler(rxhand_tcp *f)
 {
@@ -106,6 +112,48 @@ void tcp_set_tcp_handler(rxhand_tcp *f)
 		tcp_packet_handler = dummy_handler;
 	else
 		tcp_packet_handler = f;
+	tcp_set_rx_window(TCP_RX_WINDOW_DEFAULT);
+}
+
+/**
+ * tcp_set_rx_window() - set the receive window for the next connection
+ * @size: window size in bytes
+ *
+ * An application which stores data at its final location as it arrives, in
+ * or out of order, can accept a much larger window than the packet buffers
+ * allow. The window is offered with window scaling, which only applies if the
+ * other end supports it; otherwise it is limited to 64KB.
+ *
+ * Call this after tcp_set_tcp_handler() and before connecting.
+ */
+void tcp_set_rx_window(u32 size)
+{
+	tcp_rx_window = clamp_t(u32, size, TCP_MSS, TCP_RX_WINDOW_MAX);
+	for (tcp_rx_shift = 0; tcp_rx_window >> tcp_rx_shift > 0xffff;)
+		tcp_rx_shift++;
+}
+
+/**
+ * tcp_get_ack_edge() - get the next sequence number expected in order
+ *
+ * All data before this has been received. Data received beyond a hole does
+ * not move the edge until the hole is filled.
+ *
+ * Return: sequence number to acknowledge
+ */
+u32 tcp_get_ack_edge(void)
+{
+	return tcp_ack_edge;
+}
+
+/**
+ * tcp_get_rx_window() - get the receive window in use
+ *
+ * Return: window size in bytes
+ */
+u32 tcp_get_rx_window(void)
+{
+	return tcp_ws_ok ? tcp_rx_window : min_t(u32, tcp_rx_window, 0xffff);
 }
 
 /**
@@ -163,7 +211,7 @@ int net_set_ack_options(union tcp_build_pkt *b)
 	b->sack.sack_v.kind = TCP_1_NOP;
 	b->sack.sack_v.len = 0;
 
-	if (IS_ENABLED(CONFIG_PROT_TCP_SACK)) {
+	if (IS_ENABLED(CONFIG_PROT_TCP_SACK) && tcp_sack_ok) {
 		if (tcp_lost.len > TCP_OPT_LEN_2) {
 			debug_cond(DEBUG_DEV_PKT, "TCP ack opt lost.len %x\n",
 				   tcp_lost.len);
@@ -211,6 +259,8 @@ void net_set_syn_options(union tcp_build_pkt *b)
 {
 	if (IS_ENABLED(CONFIG_PROT_TCP_SACK))
 		tcp_lost.len = 0;
+	tcp_ws_ok = false;
+	tcp_sack_ok = false;
 
 	b->ip.hdr.tcp_hlen = 0xa0;
 
@@ -218,7 +268,7 @@ void net_set_syn_options(union tcp_build_pkt *b)
 	b->ip.mss.len = TCP_OPT_LEN_4;
 	b->ip.mss.mss = htons(TCP_MSS);
 	b->ip.scale.kind = TCP_O_SCL;
-	b->ip.scale.scale = TCP_SCALE;
+	b->ip.scale.scale = tcp_rx_shift;
 	b->ip.scale.len = TCP_OPT_LEN_3;
 	if (IS_ENABLED(CONFIG_PROT_TCP_SACK)) {
 		b->ip.sack_p.kind = TCP_P_SACK;
@@ -326,20 +376,15 @@ int tcp_set_tcp_header(uchar *pkt, int dport, int sport, int payload_len,
 
 	/*
 	 * TCP window size - TCP header variable tcp_win.
-	 * Change tcp_win only if you have an understanding of network
-	 * overrun, congestion, TCP segment sizes, TCP windows, TCP scale,
-	 * queuing theory  and packet buffering. If there are too few buffers,
-	 * there will be data loss, recovery may work or the sending TCP,
-	 * the server, could abort the stream transmission.
-	 * MSS is governed by maximum Ethernet frame length.
-	 * The number of buffers is governed by the desire to have a queue of
-	 * full buffers to be processed at the destination to maximize
-	 * throughput. Temporary memory use for the boot phase on modern
-	 * SOCs is may not be considered a constraint to buffer space, if
-	 * it is, then the u-boot tftp or nfs kernel netboot should be
-	 * considered.
+	 * The application places data at its final location as it arrives,
+	 * in or out of order, so the window is not limited by the number of
+	 * packet buffers. The window in a SYN is never scaled.
 	 */
-	b->ip.hdr.tcp_win = htons(PKTBUFSRX * TCP_MSS >> TCP_SCALE);
+	if (action & TCP_SYN)
+		b->ip.hdr.tcp_win = htons(min_t(u32, tcp_rx_window, 0xffff));
+	else
+		b->ip.hdr.tcp_win = htons(tcp_get_rx_window() >>
+					  (tcp_ws_ok ? tcp_rx_shift : 0));
 
 	b->ip.hdr.tcp_xsum = 0;
 	b->ip.hdr.tcp_ugr = 0;
@@ -353,112 +398,112 @@ int tcp_set_tcp_header(uchar *pkt, int dport, int sport, int payload_len,
 	return pkt_hdr_len;
 }
 
+static inline bool tcp_seq_before(u32 a, u32 b)
+{
+	return (s32)(a - b) < 0;
+}
+
+static inline bool tcp_seq_after(u32 a, u32 b)
+{
+	return (s32)(a - b) > 0;
+}
+
+/**
+ * tcp_update_sack() - set up the SACK blocks to send with the next ACK
+ * @recent: index of the hill holding the most recently received data
+ *
+ * The first block reports the most recent data, as RFC 2018 asks, and the
+ * others follow in order.
+ */
+static void tcp_update_sack(unsigned int recent)
+{
+	unsigned int i, n = 0;
+
+	tcp_lost.len = TCP_OPT_LEN_2;
+	if (!tcp_hill_cnt)
+		return;
+
+	tcp_lost.hill[n++] = tcp_hills[recent];
+	for (i = 0; i < tcp_hill_cnt && n < TCP_SACK_HILLS - 1; i++) {
+		if (i != recent)
+			tcp_lost.hill[n++] = tcp_hills[i];
+	}
+	tcp_lost.len += n * TCP_OPT_LEN_8;
+}
+
 /**
  * tcp_hole() - Selective Acknowledgment (Essential for fast stream transfer)
  * @tcp_seq_num: TCP sequence start number
  * @len: the length of sequence numbers
+ *
+ * Record that a segment has been received. If it is at the ACK edge the edge
+ * moves forward, taking in any data which arrived earlier and is now
+ * contiguous. Otherwise it is added to the list of hills, merging with its
+ * neighbours. If the list is full the segment is simply not recorded, so it
+ * is neither acknowledged nor reported and the sender must send it again.
  */
 void tcp_hole(u32 tcp_seq_num, u32 len)
 {
-	u32 idx_sack, sack_in;
-	u32 sack_end = TCP_SACK - 1;
-	u32 hill = 0;
-	enum pkt_state expect = PKT;
-	u32 seq = tcp_seq_num - tcp_seq_init;
-	u32 hol_l = tcp_ack_edge - tcp_seq_init;
-	u32 hol_r = 0;
-
-	/* Place new seq number in correct place in receive array */
-	if (prev_len == 0)
-		prev_len = len;
-
-	idx_sack = sack_idx + ((tcp_seq_num - tcp_ack_edge) / prev_len);
-	if (idx_sack < TCP_SACK) {
-		edge_a[idx_sack].se.l = tcp_seq_num;
-		edge_a[idx_sack].se.r = tcp_seq_num + len;
-		edge_a[idx_sack].st = PKT;
-
-		/*
-		 * The fin (last) packet is not the same length as data
-		 * packets, and if it's length is recorded and used for
-		 *  array index calculation, calculation breaks.
-		 */
-		if (prev_len < len)
-			prev_len = len;
+	u32 l = tcp_seq_num, r = tcp_seq_num + len;
+	unsigned int i, j;
+
+	debug_cond(DEBUG_DEV_PKT, "TCP hole seq %u, len %u, edge %u, hills %u\n",
+		   tcp_seq_num - tcp_seq_init, len, tcp_ack_edge - tcp_seq_init,
+		   tcp_hill_cnt);
+
+	if (!tcp_seq_after(r, tcp_ack_edge))
+		return;		/* already have all of it */
+	if (tcp_seq_after(r, tcp_ack_edge + tcp_get_rx_window()))
+		return;		/* outside the window */
+	if (tcp_seq_before(l, tcp_ack_edge))
+		l = tcp_ack_edge;
+
+	if (l == tcp_ack_edge) {
+		tcp_ack_edge = r;
+		for (i = 0; i < tcp_hill_cnt; i++) {
+			if (tcp_seq_after(tcp_hills[i].l, tcp_ack_edge))
+				break;
+			if (tcp_seq_after(tcp_hills[i].r, tcp_ack_edge))
+				tcp_ack_edge = tcp_hills[i].r;
+		}
+		tcp_hill_cnt -= i;
+		memmove(tcp_hills, tcp_hills + i,
+			tcp_hill_cnt * sizeof(*tcp_hills));
+		tcp_update_sack(0);
+		return;
 	}
 
-	debug_cond(DEBUG_DEV_PKT,
-		   "TCP 1 seq %d, edg %d, len %d, sack_idx %d, sack_end %d\n",
-		    seq, hol_l, len, sack_idx, sack_end);
-
-	/* Right edge of contiguous stream, is the left edge of first hill */
-	hol_l = tcp_seq_num - tcp_seq_init;
-	hol_r = hol_l + len;
-
-	if (IS_ENABLED(CONFIG_PROT_TCP_SACK))
-		tcp_lost.len = TCP_OPT_LEN_2;
-
-	debug_cond(DEBUG_DEV_PKT,
-		   "TCP 1 in %d, seq %d, pkt_l %d, pkt_r %d, sack_idx %d, sack_end %d\n",
-		   idx_sack, seq, hol_l, hol_r, sack_idx, sack_end);
-
-	for (sack_in = sack_idx; sack_in < sack_end && hill < TCP_SACK_HILLS;
-	     sack_in++)  {
-		switch (expect) {
-		case NOPKT:
-			switch (edge_a[sack_in].st) {
-			case NOPKT:
-				debug_cond(DEBUG_INT_STATE, "N");
-				break;
-			case PKT:
-				debug_cond(DEBUG_INT_STATE, "n");
-				if (IS_ENABLED(CONFIG_PROT_TCP_SACK)) {
-					tcp_lost.hill[hill].l =
-						edge_a[sack_in].se.l;
-					tcp_lost.hill[hill].r =
-						edge_a[sack_in].se.r;
-				}
-				expect = PKT;
-				break;
-			}
+	/* Find the first hill which ends at or after the new data */
+	for (i = 0; i < tcp_hill_cnt; i++) {
+		if (!tcp_seq_before(tcp_hills[i].r, l))
 			break;
-		case PKT:
-			switch (edge_a[sack_in].st) {
-			case NOPKT:
-				debug_cond(DEBUG_INT_STATE, "p");
-				if (sack_in > sack_idx &&
-				    hill < TCP_SACK_HILLS) {
-					hill++;
-					if (IS_ENABLED(CONFIG_PROT_TCP_SACK))
-						tcp_lost.len += TCP_OPT_LEN_8;
-				}
-				expect = NOPKT;
-				break;
-			case PKT:
-				debug_cond(DEBUG_INT_STATE, "P");
-
-				if (tcp_ack_edge == edge_a[sack_in].se.l) {
-					tcp_ack_edge = edge_a[sack_in].se.r;
-					edge_a[sack_in].st = NOPKT;
-					sack_idx++;
-				} else {
-					if (IS_ENABLED(CONFIG_PROT_TCP_SACK) &&
-					    hill < TCP_SACK_HILLS)
-						tcp_lost.hill[hill].r =
-							edge_a[sack_in].se.r;
-				if (IS_ENABLED(CONFIG_PROT_TCP_SACK) &&
-				    sack_in == sack_end - 1)
-					tcp_lost.hill[hill].r =
-						edge_a[sack_in].se.r;
-				}
+	}
+
+	if (i < tcp_hill_cnt && !tcp_seq_after(tcp_hills[i].l, r)) {
+		/* Overlaps or touches hill i: merge, then absorb later hills */
+		if (tcp_seq_before(l, tcp_hills[i].l))
+			tcp_hills[i].l = l;
+		if (tcp_seq_after(r, tcp_hills[i].r))
+			tcp_hills[i].r = r;
+		for (j = i + 1; j < tcp_hill_cnt; j++) {
+			if (tcp_seq_after(tcp_hills[j].l, tcp_hills[i].r))
 				break;
-			}
-			break;
+			if (tcp_seq_after(tcp_hills[j].r, tcp_hills[i].r))
+				tcp_hills[i].r = tcp_hills[j].r;
 		}
+		memmove(tcp_hills + i + 1, tcp_hills + j,
+			(tcp_hill_cnt - j) * sizeof(*tcp_hills));
+		tcp_hill_cnt -= j - i - 1;
+	} else {
+		if (tcp_hill_cnt == TCP_SACK)
+			return;
+		memmove(tcp_hills + i + 1, tcp_hills + i,
+			(tcp_hill_cnt - i) * sizeof(*tcp_hills));
+		tcp_hills[i].l = l;
+		tcp_hills[i].r = r;
+		tcp_hill_cnt++;
 	}
-	debug_cond(DEBUG_INT_STATE, "\n");
-	if (!IS_ENABLED(CONFIG_PROT_TCP_SACK) || tcp_lost.len <= TCP_OPT_LEN_2)
-		sack_idx = 0;
+	tcp_update_sack(i);
 }
 
 /**
@@ -475,27 +520,29 @@ void tcp_parse_options(uchar *o, int o_len)
 	 * NOPs are options with a zero length, and thus are special.
 	 * All other options have length fields.
 	 */
-	for (p = o; p < (o + o_len); p = p + p[1]) {
-		if (!p[1])
-			return; /* Finished processing options */
+	while (p < o + o_len) {
+		if (p[0] == TCP_O_END)
+			return;
+		if (p[0] == TCP_1_NOP) {
+			p++;
+			continue;
+		}
+		if (p + 1 >= o + o_len || p[1] < 2 || p + p[1] > o + o_len)
+			return; /* malformed */
 
 		switch (p[0]) {
-		case TCP_O_END:
-			return;
-		case TCP_O_MSS:
 		case TCP_O_SCL:
+			rmt_ws = true;
+			break;
 		case TCP_P_SACK:
-		case TCP_V_SACK:
+			rmt_sack = true;
 			break;
 		case TCP_O_TS:
 			tsopt = (struct tcp_t_opt *)p;
 			rmt_timestamp = tsopt->t_snd;
-			return;
+			break;
 		}
-
-		/* Process optional NOPs */
-		if (p[0] == TCP_O_NOP)
-			p++;
+		p += p[1];
 	}
 }
 
@@ -507,7 +554,6 @@ static u8 tcp_state_machine(u8 tcp_flags, u32 tcp_seq_num, int payload_len)
 	u8 tcp_push = tcp_flags & TCP_PUSH;
 	u8 tcp_ack = tcp_flags & TCP_ACK;
 	u8 action = TCP_DATA;
-	int i;
 
 	/*
 	 * tcp_flags are examined to determine TX action in a given state
@@ -532,6 +578,8 @@ static u8 tcp_state_machine(u8 tcp_flags, u32 tcp_seq_num, int payload_len)
 		debug_cond(DEBUG_INT_STATE, "TCP CLOSED %x\n", tcp_flags);
 		if (tcp_syn) {
 			action = TCP_SYN | TCP_ACK;
+			tcp_ws_ok = false;
+			tcp_sack_ok = false;
 			tcp_seq_init = tcp_seq_num;
 			tcp_ack_edge = tcp_seq_num + 1;
 			current_tcp_state = TCP_SYN_RECEIVED;
@@ -550,16 +598,16 @@ static u8 tcp_state_machine(u8 tcp_flags, u32 tcp_seq_num, int payload_len)
 			action |= TCP_ACK;
 			tcp_seq_init = tcp_seq_num;
 			tcp_ack_edge = tcp_seq_num + 1;
-			sack_idx = 0;
-			edge_a[sack_idx].se.l = tcp_ack_edge;
-			edge_a[sack_idx].se.r = tcp_ack_edge;
-			prev_len = 0;
+			tcp_hill_cnt = 0;
+			tcp_lost.len = TCP_OPT_LEN_2;
 			current_tcp_state = TCP_ESTABLISHED;
-			for (i = 0; i < TCP_SACK; i++)
-				edge_a[i].st = NOPKT;
 
-			if (tcp_syn && tcp_ack)
+			/* Options only apply if both ends sent them */
+			if (tcp_syn && tcp_ack) {
+				tcp_ws_ok = rmt_ws;
+				tcp_sack_ok = rmt_sack;
 				action |= TCP_PUSH;
+			}
 		} else {
 			action = TCP_DATA;
 		}
@@ -571,9 +619,9 @@ static u8 tcp_state_machine(u8 tcp_flags, u32 tcp_seq_num, int payload_len)
 			tcp_fin = TCP_DATA;  /* cause standalone FIN */
 		}
 
-		if ((tcp_fin) &&
-		    (!IS_ENABLED(CONFIG_PROT_TCP_SACK) ||
-		     tcp_lost.len <= TCP_OPT_LEN_2)) {
+		/* Only accept a FIN once everything before it has arrived */
+		if (tcp_fin && !tcp_hill_cnt &&
+		    !tcp_seq_after(tcp_seq_num, tcp_ack_edge)) {
 			action = action | TCP_FIN | TCP_PUSH | TCP_ACK;
 			current_tcp_state = TCP_CLOSE_WAIT;
 		} else if (tcp_ack) {
@@ -672,6 +720,8 @@ void rxhand_tcp_f(union tcp_build_pkt *b, unsigned int pkt_len)
 	tcp_hdr_len = GET_TCP_HDR_LEN_IN_BYTES(b->ip.hdr.tcp_hlen);
 	payload_len = tcp_len - tcp_hdr_len;
 
+	rmt_ws = false;
+	rmt_sack = false;
 	if (tcp_hdr_len > TCP_HDR_SIZE)
 		tcp_parse_options((uchar *)b + IP_TCP_HDR_SIZE,
 				  tcp_hdr_len - TCP_HDR_SIZE);
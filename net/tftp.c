@@ -17,6 +17,7 @@
 #include <net.h>
 #include <net6.h>
 #include <asm/global_data.h>
+#include <linux/math64.h>
 #include <net/tftp.h>
 #include "bootp.h"
 
@@ -95,6 +96,21 @@ static ushort	tftp_windowsize;
 static ushort	tftp_next_ack;
 /* Last nack block we send */
 static ushort	tftp_last_nack;
+/* Window size to ask for in the next request */
+static ushort	tftp_window_size_req;
+/*
+ * Blocks received ahead of a missing one, which are already stored: bit n is
+ * set if block tftp_cur_block + 1 + n has been received
+ */
+static u64	tftp_early_map;
+/* Block number of the final (short) block, if it arrived early */
+static ushort	tftp_final_block;
+static bool	tftp_final_early;
+/* Transfer statistics */
+static ulong	tftp_stat_blocks;	/* data blocks stored */
+static ulong	tftp_stat_retrans;	/* data blocks received more than once */
+static ulong	tftp_stat_early;	/* data blocks stored out of order */
+static ulong	tftp_stat_loss;		/* NACKs and timeouts */
 #ifdef CONFIG_CMD_TFTPPUT
 /* 1 if writing, else 0 */
 static int	tftp_put_active;
@@ -118,6 +134,8 @@ static int	tftp_put_final_block_sent;
 #define TFTP_MTU_BLOCKSIZE6 (CONFIG_TFTP_BLOCKSIZE - 20)
 /* sequence number is 16 bit */
 #define TFTP_SEQUENCE_SIZE	((ulong)(1<<16))
+/* number of blocks ahead of the expected one which can be stored early */
+#define TFTP_EARLY_BLOCKS	64
 
 #define DEFAULT_NAME_LEN	(8 + 4 + 1)
 static char default_filename[DEFAULT_NAME_LEN];
@@ -183,6 +201,12 @@ static void new_transfer(void)
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_early_map = 0;
+	tftp_final_early = false;
+	tftp_stat_blocks = 0;
+	tftp_stat_retrans = 0;
+	tftp_stat_early = 0;
+	tftp_stat_loss = 0;
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -277,6 +301,60 @@ static void update_block_number(void)
 	show_block_marker();
 }
 
+/**
+ * tftp_skip_early() - Move past blocks which were already stored out of order
+ *
+ * Return: true if the final block has been reached, else false
+ */
+static bool tftp_skip_early(void)
+{
+	while (tftp_early_map & 1) {
+		tftp_early_map >>= 1;
+		tftp_cur_block = (tftp_cur_block + 1) % TFTP_SEQUENCE_SIZE;
+		update_block_number();
+		tftp_prev_block = tftp_cur_block;
+		if (tftp_final_early && tftp_cur_block == tftp_final_block)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Once negotiated, the window belongs to the server, so the only way to back
+ * off is to ask for a smaller one next time. Halve it after a transfer which
+ * lost packets and double it after a clean one, up to the configured size.
+ */
+static void tftp_adapt_window(void)
+{
+	if (!IS_ENABLED(CONFIG_TFTP_WINDOWSIZE_ADAPTIVE))
+		return;
+
+	if (tftp_stat_loss)
+		tftp_window_size_req = max(tftp_window_size_req / 2, 1);
+	else
+		tftp_window_size_req = min(tftp_window_size_req * 2,
+					   (int)tftp_window_size_option);
+	debug("TFTP windowsize for next request: %d\n", tftp_window_size_req);
+}
+
+/* Make the statistics for a completed download available to scripts */
+static void tftp_export_stats(ulong time_ms)
+{
+	ulong rate = 0;
+
+	if (!IS_ENABLED(CONFIG_TFTP_STATS))
+		return;
+
+	if (time_ms)
+		rate = div_u64((u64)net_boot_file_size * 1000, time_ms * 1024);
+	env_set_ulong("tftpblocks", tftp_stat_blocks);
+	env_set_ulong("tftpretransmits", tftp_stat_retrans);
+	env_set_ulong("tftpreordered", tftp_stat_early);
+	env_set_ulong("tftpwindow", tftp_windowsize);
+	env_set_ulong("tftprate", rate);
+}
+
 /* The TFTP get or put is complete */
 static void tftp_complete(void)
 {
@@ -299,10 +377,13 @@ static void tftp_complete(void)
 
 	led_activity_off();
 
-	if (!tftp_put_active)
+	if (!tftp_put_active) {
+		tftp_export_stats(time_start);
+		tftp_adapt_window();
 		efi_set_bootdev("Net", "", tftp_filename,
 				map_sysmem(tftp_load_addr, 0),
 				net_boot_file_size);
+	}
 	net_set_state(NETLOOP_SUCCESS);
 }
 
@@ -357,9 +438,9 @@ static void tftp_send(void)
 		 * Implemented only for tftp get.
 		 * Don't bother sending if it's 1
 		 */
-		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_option > 1)
+		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_req > 1)
 			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
-					0, tftp_window_size_option, 0);
+					0, tftp_window_size_req, 0);
 		len = pkt - xp;
 		break;
 
@@ -454,6 +535,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 {
 	__be16 proto;
 	__be16 *s;
+	ushort block, ahead;
 	int i;
 	u16 timeout_val_rcvd;
 
@@ -590,18 +672,48 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			return;
 		len -= 2;
 
-		if (ntohs(*(__be16 *)pkt) != (ushort)(tftp_cur_block + 1)) {
+		block = ntohs(*(__be16 *)pkt);
+		ahead = (ushort)(block - tftp_cur_block - 1);
+		if (ahead) {
 			debug("Received unexpected block: %d, expected: %d\n",
-			      ntohs(*(__be16 *)pkt),
-			      (ushort)(tftp_cur_block + 1));
+			      block, (ushort)(tftp_cur_block + 1));
 			/*
 			 * Only ACK if the block count received is greater than
 			 * the expected block count, otherwise skip ACK.
 			 * (required to properly handle the server retransmitting
 			 *  the window)
 			 */
-			if ((ushort)(tftp_cur_block + 1) - (short)(ntohs(*(__be16 *)pkt)) > 0)
+			if ((short)ahead < 0) {
+				tftp_stat_retrans++;
 				break;
+			}
+
+			/*
+			 * Store a block which arrived ahead of a missing one
+			 * straight away, so that it need not be received again
+			 * when the server retransmits the window
+			 */
+			if (tftp_state == STATE_DATA &&
+			    ahead < min((int)tftp_windowsize, TFTP_EARLY_BLOCKS)) {
+				if (tftp_early_map & BIT_ULL(ahead)) {
+					tftp_stat_retrans++;
+				} else {
+					if (store_block(tftp_cur_block + 1 + ahead,
+							pkt + 2, len)) {
+						eth_halt();
+						net_set_state(NETLOOP_FAIL);
+						break;
+					}
+					tftp_early_map |= BIT_ULL(ahead);
+					tftp_stat_blocks++;
+					tftp_stat_early++;
+					if (len < tftp_block_size) {
+						tftp_final_block = block;
+						tftp_final_early = true;
+					}
+				}
+			}
+
 			/*
 			 * If one packet is dropped most likely
 			 * all other buffers in the window
@@ -610,6 +722,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			 */
 			if (tftp_last_nack != tftp_cur_block) {
 				tftp_send();
+				tftp_stat_loss++;
 				tftp_last_nack = tftp_cur_block;
 				tftp_next_ack = (ushort)(tftp_cur_block +
 							 tftp_windowsize);
@@ -644,6 +757,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 		if (tftp_cur_block == tftp_prev_block) {
 			/* Same block again; ignore it. */
+			tftp_stat_retrans++;
 			break;
 		}
 
@@ -657,8 +771,10 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			net_set_state(NETLOOP_FAIL);
 			break;
 		}
+		tftp_stat_blocks++;
+		tftp_early_map >>= 1;
 
-		if (len < tftp_block_size) {
+		if (len < tftp_block_size || tftp_skip_early()) {
 			tftp_send();
 			tftp_complete();
 			break;
@@ -666,11 +782,13 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 		/*
 		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
+		 *	the remote for the next one. After filling a gap we may
+		 *	have moved past the expected ACK, so check for that too.
 		 */
-		if (tftp_cur_block == tftp_next_ack) {
+		if ((short)((ushort)tftp_cur_block - tftp_next_ack) >= 0) {
 			tftp_send();
-			tftp_next_ack += tftp_windowsize;
+			tftp_next_ack = (ushort)(tftp_cur_block +
+						 tftp_windowsize);
 		}
 		break;
 
@@ -701,7 +819,9 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 static void tftp_timeout_handler(void)
 {
+	tftp_stat_loss++;
 	if (++timeout_count > timeout_count_max) {
+		tftp_adapt_window();
 		restart("Retry count exceeded");
 	} else {
 		puts("T ");
@@ -803,8 +923,13 @@ void tftp_start(enum proto_t protocol)
 
 	sanitize_tftp_block_size_option(protocol);
 
+	if (!IS_ENABLED(CONFIG_TFTP_WINDOWSIZE_ADAPTIVE) ||
+	    !tftp_window_size_req ||
+	    tftp_window_size_req > tftp_window_size_option)
+		tftp_window_size_req = tftp_window_size_option;
+
 	debug("TFTP blocksize = %i, TFTP windowsize = %d timeout = %ld ms\n",
-	      tftp_block_size_option, tftp_window_size_option, timeout_ms);
+	      tftp_block_size_option, tftp_window_size_req, timeout_ms);
 
 	if (IS_ENABLED(CONFIG_IPV6))
 		tftp_remote_ip6 = net_server_ip6;
@@ -60,8 +60,10 @@ static enum net_loop_state wget_loop_state;
 /* Timeout retry parameters */
 static u8 retry_action;			/* actions for TCP retry */
 static unsigned int retry_tcp_ack_num;	/* TCP retry acknowledge number*/
-static unsigned int retry_tcp_seq_num;	/* TCP retry sequence number */
-static int retry_len;			/* TCP retry length */
+static unsigned int retry_rx_edge;	/* TCP retry sequence number to ACK */
+
+/* Number of segments received in order since the last ACK */
+static int wget_unacked;
 
 /**
  * store_block() - store block in memory
@@ -105,8 +107,7 @@ static inline int store_block(uchar *src, unsigned int offset, unsigned int len)
 static void wget_send_stored(void)
 {
 	u8 action = retry_action;
-	int len = retry_len;
-	unsigned int tcp_ack_num = retry_tcp_seq_num + (len == 0 ? 1 : len);
+	unsigned int tcp_ack_num = retry_rx_edge;
 	unsigned int tcp_seq_num = retry_tcp_ack_num;
 	unsigned int server_port;
 	uchar *ptr, *offset;
@@ -156,9 +157,43 @@ static void wget_send(u8 action, unsigned int tcp_seq_num,
 {
 	retry_action = action;
 	retry_tcp_ack_num = tcp_ack_num;
-	retry_tcp_seq_num = tcp_seq_num;
-	retry_len = len;
+	retry_rx_edge = tcp_seq_num + (len == 0 ? 1 : len);
+
+	wget_send_stored();
+}
+
+static void wget_timeout_handler(void);
 
+/* The delayed ACK timer has expired, so send the ACK */
+static void wget_delayed_ack(void)
+{
+	net_set_timeout_handler(wget_timeout, wget_timeout_handler);
+	wget_unacked = 0;
+	wget_send_stored();
+}
+
+/**
+ * wget_ack() - acknowledge the data received in order so far
+ * @tcp_ack_num: acknowledgment number from the server
+ * @now: true to ACK straight away, false to allow the ACK to be delayed
+ *
+ * An ACK covers all the data up to the ACK edge, so it need not be sent for
+ * every segment: send one for every WGET_ACK_SEGMENTS segments received in
+ * order, or when the delayed ACK timer expires. Anything out of order is
+ * acknowledged at once, so that the server sees duplicate ACKs (with SACK
+ * blocks) and can retransmit what is missing.
+ */
+static void wget_ack(unsigned int tcp_ack_num, bool now)
+{
+	retry_action = TCP_ACK;
+	retry_tcp_ack_num = tcp_ack_num;
+	retry_rx_edge = tcp_get_ack_edge();
+
+	if (!now && ++wget_unacked < WGET_ACK_SEGMENTS) {
+		net_set_timeout_handler(WGET_DELAYED_ACK_MS, wget_delayed_ack);
+		return;
+	}
+	wget_unacked = 0;
 	wget_send_stored();
 }
 
@@ -305,6 +340,7 @@ static void wget_handler(uchar *pkt, u16 dport,
 			 u8 action, unsigned int len)
 {
 	enum tcp_state wget_tcp_state = tcp_get_tcp_state();
+	bool in_order = false;
 
 	net_set_timeout_handler(wget_timeout, wget_timeout_handler);
 	packets++;
@@ -345,17 +381,38 @@ static void wget_handler(uchar *pkt, u16 dport,
 			   "wget: Transferring, seq=%x, ack=%x,len=%x\n",
 			   tcp_seq_num, tcp_ack_num, len);
 
-		if (next_data_seq_num != tcp_seq_num) {
-			debug_cond(DEBUG_WGET, "wget: seq=%x packet was lost\n", next_data_seq_num);
-			return;
-		}
-		next_data_seq_num = tcp_seq_num + len;
+		/*
+		 * Store anything within the window at its offset in the file,
+		 * whether it is in order or not. The TCP layer keeps track of
+		 * what has arrived, so only the ACK differs.
+		 */
+		if (len) {
+			int ahead = tcp_seq_num + len - next_data_seq_num;
+			unsigned int edge;
 
-		if (store_block(pkt, tcp_seq_num - initial_data_seq_num, len) != 0) {
-			wget_fail("wget: store error\n",
-				  tcp_seq_num, tcp_ack_num, action);
-			net_set_state(NETLOOP_FAIL);
-			return;
+			if (ahead <= 0 || ahead > tcp_get_rx_window()) {
+				debug_cond(DEBUG_WGET,
+					   "wget: seq=%x outside window\n",
+					   tcp_seq_num);
+				wget_ack(tcp_ack_num, true);
+				return;
+			}
+			if (store_block(pkt, tcp_seq_num - initial_data_seq_num,
+					len) != 0) {
+				wget_fail("wget: store error\n",
+					  tcp_seq_num, tcp_ack_num, action);
+				net_set_state(NETLOOP_FAIL);
+				return;
+			}
+
+			edge = tcp_get_ack_edge();
+			in_order = tcp_seq_num == next_data_seq_num &&
+				edge == tcp_seq_num + len;
+			if (!in_order)
+				debug_cond(DEBUG_WGET,
+					   "wget: seq=%x out of order, edge=%x\n",
+					   tcp_seq_num, edge);
+			next_data_seq_num = edge;
 		}
 
 		switch (wget_tcp_state) {
@@ -370,8 +427,7 @@ static void wget_handler(uchar *pkt, u16 dport,
 			net_set_state(NETLOOP_FAIL);
 			break;
 		case TCP_ESTABLISHED:
-			wget_send(TCP_ACK, tcp_seq_num, tcp_ack_num,
-				  len);
+			wget_ack(tcp_ack_num, !in_order);
 			wget_loop_state = NETLOOP_SUCCESS;
 			break;
 		case TCP_CLOSE_WAIT:     /* End of transfer */
@@ -412,6 +468,9 @@ static unsigned int random_port(void)
 
 void wget_start(void)
 {
+	phys_size_t free;
+	ulong window;
+
 	image_url = strchr(net_boot_file_name, ':');
 	if (image_url > 0) {
 		web_server_ip = string_to_ip(net_boot_file_name);
@@ -452,7 +511,21 @@ void wget_start(void)
 	net_set_timeout_handler(wget_timeout, wget_timeout_handler);
 	tcp_set_tcp_handler(wget_handler);
 
+	/*
+	 * Data goes straight to its place in memory, so the window can be
+	 * as large as the space available there
+	 */
+	window = CONFIG_PROT_TCP_RX_WINDOW;
+	if (CONFIG_IS_ENABLED(LMB)) {
+		free = lmb_get_free_size(image_load_addr);
+		if (free && free < window)
+			window = free;
+	}
+	tcp_set_rx_window(window);
+	debug_cond(DEBUG_WGET, "wget: window %u\n", tcp_get_rx_window());
+
 	wget_timeout_count = 0;
+	wget_unacked = 0;
 	current_wget_state = WGET_CLOSED;
 
 	our_port = random_port();
@@ -6,7 +6,17 @@
  * Written by Simon Glass <sjg@chromium.org>
  */
 
+#include <bootstage.h>
+#include <command.h>
+#include <env.h>
+#include <gzip.h>
+#include <hash.h>
 #include <image.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <os.h>
+#include <linux/libfdt.h>
+#include <linux/sizes.h>
 #include <test/suites.h>
 #include <test/ut.h>
 #include "bootstd_common.h"
@@ -33,3 +43,280 @@ static int test_image_phase(struct unit_test_state *uts)
 	return 0;
 }
 BOOTSTD_TEST(test_image_phase, 0);
+
+#if CONFIG_IS_ENABLED(FIT_STREAM)
+/* Read from a FIT held in memory, for fit_image_load_stream() */
+static long image_stream_read(void *priv, ulong offset, ulong size, void *buf)
+{
+	memcpy(buf, priv + offset, size);
+
+	return size;
+}
+
+/*
+ * Set up a FIT in @buf with a 'kernel' firmware image containing @data as
+ * external data, to be loaded at @load, with sha256 and crc32 hashes over it.
+ * Returns the offset of the image node.
+ */
+static int setup_stream_fit(struct unit_test_state *uts, void *buf,
+			    const char *comp, const void *data, int size,
+			    ulong load, ulong *ext_offsetp)
+{
+	u8 value[FIT_MAX_HASH_LEN];
+	int images, node, hash, len;
+	ulong ext_offset;
+
+	ut_assertok(fdt_create_empty_tree(buf, SZ_4K));
+	ut_assertok(fdt_setprop_string(buf, 0, FIT_DESC_PROP, "stream test"));
+	ut_assertok(fdt_setprop_u32(buf, 0, FIT_TIMESTAMP_PROP, 0));
+	images = fdt_add_subnode(buf, 0, FIT_IMAGES_PATH + 1);
+	ut_assert(images >= 0);
+	node = fdt_add_subnode(buf, images, "kernel");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_string(buf, node, FIT_TYPE_PROP, "firmware"));
+	ut_assertok(fdt_setprop_string(buf, node, FIT_ARCH_PROP, "sandbox"));
+	ut_assertok(fdt_setprop_string(buf, node, FIT_OS_PROP, "u-boot"));
+	ut_assertok(fdt_setprop_string(buf, node, FIT_COMP_PROP, comp));
+	ut_assertok(fdt_setprop_u64(buf, node, FIT_LOAD_PROP, load));
+	ut_assertok(fdt_setprop_u32(buf, node, FIT_DATA_OFFSET_PROP, 0));
+	ut_assertok(fdt_setprop_u32(buf, node, FIT_DATA_SIZE_PROP, size));
+
+	hash = fdt_add_subnode(buf, node, FIT_HASH_NODENAME "-1");
+	ut_assert(hash >= 0);
+	ut_assertok(fdt_setprop_string(buf, hash, FIT_ALGO_PROP, "sha256"));
+	len = sizeof(value);
+	ut_assertok(hash_block("sha256", data, size, value, &len));
+	ut_assertok(fdt_setprop(buf, hash, FIT_VALUE_PROP, value, len));
+
+	hash = fdt_add_subnode(buf, node, FIT_HASH_NODENAME "-2");
+	ut_assert(hash >= 0);
+	ut_assertok(fdt_setprop_string(buf, hash, FIT_ALGO_PROP, "crc32"));
+	len = sizeof(value);
+	ut_assertok(hash_block("crc32", data, size, value, &len));
+	ut_assertok(fdt_setprop(buf, hash, FIT_VALUE_PROP, value, len));
+
+	ut_assertok(fdt_pack(buf));
+	ext_offset = ALIGN(fdt_totalsize(buf), 4);
+	memcpy(buf + ext_offset, data, size);
+	*ext_offsetp = ext_offset;
+
+	return fdt_subnode_offset(buf, images, "kernel");
+}
+
+/* Test loading an image in one pass with fit_image_load_stream() */
+static int test_image_load_stream(struct unit_test_state *uts)
+{
+	const int size = SZ_256K + 123;
+	void *buf, *data, *comp, *dst;
+	ulong ext_offset, len;
+	ulong comp_len;
+	int node, i;
+
+	buf = calloc(1, SZ_1M);
+	data = malloc(size);
+	comp = malloc(size);
+	dst = malloc(size);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(data);
+	ut_assertnonnull(comp);
+	ut_assertnonnull(dst);
+	for (i = 0; i < size; i++)
+		((u8 *)data)[i] = i * 7 / 1000;
+
+	/* Uncompressed, with reads aligned to a 'sector' */
+	node = setup_stream_fit(uts, buf, "none", data, size, 0, &ext_offset);
+	ut_assert(node >= 0);
+	ut_assertok(fit_image_load_stream(buf, node, ext_offset, 512, true,
+					  image_stream_read, buf, dst, size,
+					  &len));
+	ut_asserteq(size, len);
+	ut_asserteq_mem(data, dst, size);
+
+	/* The destination is too small */
+	ut_asserteq(-ENOSPC, fit_image_load_stream(buf, node, ext_offset, 1,
+						   true, image_stream_read,
+						   buf, dst, size - 1, &len));
+
+	/* Corrupt the data so that the hashes do not match */
+	((u8 *)buf)[ext_offset + size / 2] ^= 1;
+	ut_asserteq(-EPERM, fit_image_load_stream(buf, node, ext_offset, 1,
+						  true, image_stream_read,
+						  buf, dst, size, &len));
+
+	/* gzip, decompressed on the fly */
+	if (IS_ENABLED(CONFIG_GZIP_COMPRESSED)) {
+		comp_len = size;
+		ut_assertok(gzip(comp, &comp_len, data, size));
+		node = setup_stream_fit(uts, buf, "gzip", comp, comp_len, 0,
+					&ext_offset);
+		ut_assert(node >= 0);
+		memset(dst, '\0', size);
+		ut_assertok(fit_image_load_stream(buf, node, ext_offset, 512,
+						  true, image_stream_read, buf,
+						  dst, size, &len));
+		ut_asserteq(size, len);
+		ut_asserteq_mem(data, dst, size);
+
+		/* Without decompression the data is copied as is */
+		ut_assertok(fit_image_load_stream(buf, node, ext_offset, 1,
+						  false, image_stream_read,
+						  buf, dst, size, &len));
+		ut_asserteq(comp_len, len);
+		ut_asserteq_mem(comp, dst, comp_len);
+	}
+
+	/* LZMA cannot be streamed, so the caller must fall back */
+	node = setup_stream_fit(uts, buf, "lzma", data, size, 0, &ext_offset);
+	ut_assert(node >= 0);
+	ut_asserteq(-EPROTONOSUPPORT,
+		    fit_image_load_stream(buf, node, ext_offset, 1, true,
+					  image_stream_read, buf, dst, size,
+					  &len));
+
+	free(dst);
+	free(comp);
+	free(data);
+	free(buf);
+
+	return 0;
+}
+BOOTSTD_TEST(test_image_load_stream, 0);
+
+/* Call fit_image_load() on a FIT set up by setup_stream_fit() */
+static int load_fit(void *buf, enum fit_load_op load_op, ulong *datap,
+		    ulong *lenp)
+{
+	struct bootm_headers images = { .verify = 1 };
+	const char *uname = "kernel";
+
+	return fit_image_load(&images, map_to_sysmem(buf), &uname, NULL,
+			      IH_ARCH_SANDBOX, IH_TYPE_FIRMWARE,
+			      BOOTSTAGE_ID_FIT_LOADABLE_START, load_op, datap,
+			      lenp);
+}
+
+/* Test that fit_image_load() streams external data when it can */
+static int test_image_load_fit_stream(struct unit_test_state *uts)
+{
+	const int size = SZ_64K + 45;
+	void *buf, *data, *comp, *dst;
+	ulong ext_offset, load, len;
+	ulong comp_len;
+	int node, i;
+
+	buf = calloc(1, SZ_256K);
+	data = malloc(size);
+	comp = malloc(size);
+	dst = malloc(size);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(data);
+	ut_assertnonnull(comp);
+	ut_assertnonnull(dst);
+	for (i = 0; i < size; i++)
+		((u8 *)data)[i] = (i * 2654435761U) >> 24;
+
+	/* Copied to the load address while the hashes are checked */
+	node = setup_stream_fit(uts, buf, "none", data, size,
+				map_to_sysmem(dst), &ext_offset);
+	ut_assert(node >= 0);
+	ut_asserteq(node, load_fit(buf, FIT_LOAD_REQUIRED, &load, &len));
+	ut_asserteq(map_to_sysmem(dst), load);
+	ut_asserteq(size, len);
+	ut_asserteq_mem(data, dst, size);
+
+	/* Without a separate load address, the image is checked in place */
+	ut_asserteq(node, load_fit(buf, FIT_LOAD_IGNORED, &load, &len));
+	ut_asserteq(map_to_sysmem(buf + ext_offset), load);
+	ut_asserteq(size, len);
+
+	/* A bad hash is caught either way */
+	((u8 *)buf)[ext_offset + size / 2] ^= 1;
+	ut_asserteq(-EACCES, load_fit(buf, FIT_LOAD_REQUIRED, &load, &len));
+	ut_asserteq(-EACCES, load_fit(buf, FIT_LOAD_IGNORED, &load, &len));
+
+	/* gzip, decompressed while the hashes are checked */
+	if (IS_ENABLED(CONFIG_GZIP_COMPRESSED)) {
+		comp_len = size;
+		ut_assertok(gzip(comp, &comp_len, data, size));
+		node = setup_stream_fit(uts, buf, "gzip", comp, comp_len,
+					map_to_sysmem(dst), &ext_offset);
+		ut_assert(node >= 0);
+		memset(dst, '\0', size);
+		ut_asserteq(node, load_fit(buf, FIT_LOAD_REQUIRED, &load,
+					   &len));
+		ut_asserteq(size, len);
+		ut_asserteq_mem(data, dst, size);
+	}
+
+	free(dst);
+	free(comp);
+	free(data);
+	free(buf);
+
+	return 0;
+}
+BOOTSTD_TEST(test_image_load_fit_stream, 0);
+
+/* Test that a FIT loaded with 'load -f' has its data read from the file */
+static int test_image_load_fit_file(struct unit_test_state *uts)
+{
+	const char *fname = "image_stream.itb";
+	const int size = SZ_64K + 45;
+	void *buf, *fit, *data, *dst;
+	ulong ext_offset, load, len;
+	ulong addr = 0x1000;
+	int node, fd, i;
+
+	buf = calloc(1, SZ_256K);
+	fit = map_sysmem(addr, SZ_256K);
+	data = malloc(size);
+	dst = malloc(size);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(data);
+	ut_assertnonnull(dst);
+	for (i = 0; i < size; i++)
+		((u8 *)data)[i] = (i * 2654435761U) >> 24;
+
+	node = setup_stream_fit(uts, buf, "none", data, size,
+				map_to_sysmem(dst), &ext_offset);
+	ut_assert(node >= 0);
+	fd = os_open(fname, OS_O_WRONLY | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	ut_asserteq(ext_offset + size, os_write(fd, buf, ext_offset + size));
+	os_close(fd);
+
+	/* Only the structure is read */
+	memset(fit, 0xa5, SZ_256K);
+	ut_assertok(run_commandf("load -f hostfs - %lx %s", addr, fname));
+	ut_asserteq(fdt_totalsize(buf), env_get_hex("filesize", 0));
+	ut_asserteq(0xa5, ((u8 *)fit)[ext_offset]);
+
+	/* The data is streamed from the file to the load address */
+	ut_asserteq(node, load_fit(fit, FIT_LOAD_REQUIRED, &load, &len));
+	ut_asserteq(map_to_sysmem(dst), load);
+	ut_asserteq(size, len);
+	ut_asserteq_mem(data, dst, size);
+	ut_asserteq(0xa5, ((u8 *)fit)[ext_offset]);
+
+	/* To be checked in place, the data is read to just after the FIT */
+	ut_asserteq(node, load_fit(fit, FIT_LOAD_IGNORED, &load, &len));
+	ut_asserteq(addr + ext_offset, load);
+	ut_asserteq(size, len);
+	ut_asserteq_mem(data, fit + ext_offset, size);
+
+	/* Once the FIT is changed, the file is no longer used */
+	memset(fit + ext_offset, 0xa5, size);
+	ut_assertok(fdt_setprop_string(fit, 0, FIT_DESC_PROP, "changed"));
+	ut_asserteq(-EACCES, load_fit(fit, FIT_LOAD_IGNORED, &load, &len));
+
+	fit_stream_set_source(NULL, NULL, NULL);
+	ut_assertok(os_unlink(fname));
+	unmap_sysmem(fit);
+	free(dst);
+	free(data);
+	free(buf);
+
+	return 0;
+}
+BOOTSTD_TEST(test_image_load_fit_file, 0);
+#endif
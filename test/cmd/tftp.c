@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the tftpboot command, using an emulated TFTP server
+ */
+
+#include <command.h>
+#include <dm.h>
+#include <env.h>
+#include <mapmem.h>
+#include <net.h>
+#include <asm/eth.h>
+#include <test/cmd.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define TFTP_OPCODE_RRQ		1
+#define TFTP_OPCODE_DATA	3
+#define TFTP_OPCODE_ACK		4
+#define TFTP_OPCODE_OACK	6
+
+#define SERVER_PORT	2000
+#define SERVER_BLKSIZE	512
+/* Leave room for the packet being processed when a window is queued */
+#define SERVER_MAX_WINDOW	(PKTBUFSRX - 1)
+#define FILE_SIZE	(SERVER_BLKSIZE * 9 + 100)
+
+/**
+ * struct tftp_server - state of the emulated TFTP server
+ *
+ * @data: File contents
+ * @req_window: Window size asked for in the last request
+ * @window: Window size in use
+ * @drop: Block to drop the first time it is sent, or 0 for none
+ */
+struct tftp_server {
+	u8 data[FILE_SIZE];
+	int req_window;
+	int window;
+	int drop;
+};
+
+static struct tftp_server server;
+
+/* Queue a UDP packet from the server in reply to the request @packet */
+static void sb_tftp_reply(struct udevice *dev, void *packet, const void *data,
+			  int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct ethernet_hdr *eth_recv;
+	struct ip_udp_hdr *ip_recv;
+
+	/* Don't allow the buffer to overrun */
+	if (priv->recv_packets >= PKTBUFSRX)
+		return;
+
+	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IP);
+
+	ip_recv = (void *)eth_recv + ETHER_HDR_SIZE;
+	net_set_ip_header((uchar *)ip_recv, net_read_ip(&ip->ip_src),
+			  net_read_ip(&ip->ip_dst), IP_UDP_HDR_SIZE + len,
+			  IPPROTO_UDP);
+	ip_recv->udp_src = htons(SERVER_PORT);
+	ip_recv->udp_dst = ip->udp_src;
+	ip_recv->udp_len = htons(UDP_HDR_SIZE + len);
+	ip_recv->udp_xsum = 0;
+	memcpy((void *)ip_recv + IP_UDP_HDR_SIZE, data, len);
+
+	priv->recv_packet_length[priv->recv_packets] =
+		ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+	++priv->recv_packets;
+}
+
+/* Accept the request, echoing the options with our block and window size */
+static void sb_tftp_rrq(struct udevice *dev, void *packet, const char *opt,
+			const char *end)
+{
+	char oack[100], *p;
+	__be16 *op;
+
+	server.req_window = 1;
+	for (opt += strlen(opt) + 1; opt < end; opt += strlen(opt) + 1) {
+		if (!strcmp(opt, "windowsize"))
+			server.req_window = dectoul(opt + 11, NULL);
+	}
+	server.window = min(server.req_window, SERVER_MAX_WINDOW);
+
+	op = (__be16 *)oack;
+	*op = htons(TFTP_OPCODE_OACK);
+	p = oack + 2;
+	p += sprintf(p, "blksize%c%d%c", 0, SERVER_BLKSIZE, 0);
+	p += sprintf(p, "timeout%c%d%c", 0, 5, 0);
+	if (server.req_window > 1)
+		p += sprintf(p, "windowsize%c%d%c", 0, server.window, 0);
+	sb_tftp_reply(dev, packet, oack, p - oack);
+}
+
+/* Send the window of blocks following an ACK */
+static void sb_tftp_ack(struct udevice *dev, void *packet, int acked)
+{
+	u8 buf[4 + SERVER_BLKSIZE];
+	int block, len, offset;
+
+	for (block = acked + 1; block <= acked + server.window; block++) {
+		offset = (block - 1) * SERVER_BLKSIZE;
+		if (offset > FILE_SIZE)
+			break;
+		if (block == server.drop) {
+			server.drop = 0;
+			continue;
+		}
+		len = min(FILE_SIZE - offset, SERVER_BLKSIZE);
+		*(__be16 *)buf = htons(TFTP_OPCODE_DATA);
+		*(__be16 *)(buf + 2) = htons(block);
+		memcpy(buf + 4, server.data + offset, len);
+		sb_tftp_reply(dev, packet, buf, 4 + len);
+	}
+}
+
+static int sb_tftp_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	char *data = (char *)ip + IP_UDP_HDR_SIZE;
+	__be16 *op = (__be16 *)data;
+
+	if (ntohs(eth->et_protlen) == PROT_ARP)
+		return sandbox_eth_arp_req_to_reply(dev, packet, len);
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return -EPROTONOSUPPORT;
+
+	switch (ntohs(*op)) {
+	case TFTP_OPCODE_RRQ:
+		sb_tftp_rrq(dev, packet, data + 2, (char *)packet + len);
+		break;
+	case TFTP_OPCODE_ACK:
+		sb_tftp_ack(dev, packet, ntohs(op[1]));
+		break;
+	}
+
+	return 0;
+}
+
+/* Download the file, checking its contents and the statistics */
+static int tftp_check(struct unit_test_state *uts, int retransmits)
+{
+	void *buf;
+
+	ut_assertok(run_command("tftpboot 20000 1.1.2.2:file", 0));
+	ut_asserteq(FILE_SIZE, env_get_hex("filesize", 0));
+	buf = map_sysmem(0x20000, FILE_SIZE);
+	ut_asserteq_mem(server.data, buf, FILE_SIZE);
+	unmap_sysmem(buf);
+
+	ut_asserteq(10, env_get_ulong("tftpblocks", 10, 0));
+	ut_asserteq(retransmits, env_get_ulong("tftpretransmits", 10, -1));
+	ut_asserteq(retransmits, env_get_ulong("tftpreordered", 10, -1));
+	ut_asserteq(server.window, env_get_ulong("tftpwindow", 10, 0));
+
+	return 0;
+}
+
+static int net_test_tftp(struct unit_test_state *uts)
+{
+	char *prev_ethact = env_get("ethact");
+	char *prev_ethrotate = env_get("ethrotate");
+	char *prev_ipaddr = env_get("ipaddr");
+	int i;
+
+	for (i = 0; i < FILE_SIZE; i++)
+		server.data[i] = i * 7;
+	server.drop = 0;
+
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+	env_set("ethact", "eth@10002000");
+	env_set("ethrotate", "no");
+	env_set("ipaddr", "1.1.2.1");
+	env_set("tftpwindowsize", "4");
+
+	/* Clean transfers bring the requested window up to the maximum */
+	for (i = 0; i < 3; i++)
+		ut_assertok(tftp_check(uts, 0));
+	ut_asserteq(4, server.req_window);
+
+	/*
+	 * With block 5 lost, block 6 is stored when it arrives early, so it
+	 * is only a retransmit when the server sends the window again
+	 */
+	server.drop = 5;
+	ut_assertok(tftp_check(uts, 1));
+	ut_asserteq(0, server.drop);
+
+	/* The loss halves the next window, and a clean transfer restores it */
+	ut_assertok(tftp_check(uts, 0));
+	ut_asserteq(2, server.req_window);
+	ut_assertok(tftp_check(uts, 0));
+	ut_asserteq(4, server.req_window);
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	env_set("ethact", prev_ethact);
+	env_set("ethrotate", prev_ethrotate);
+	env_set("ipaddr", prev_ipaddr);
+	env_set("tftpwindowsize", NULL);
+
+	return 0;
+}
+CMD_TEST(net_test_tftp, 0);
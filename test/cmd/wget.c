@@ -12,6 +12,7 @@
 #include <fdtdec.h>
 #include <log.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
 #include <net/tcp.h>
 #include <net/wget.h>
@@ -22,9 +23,11 @@
 #include <test/cmd.h>
 #include <test/test.h>
 #include <test/ut.h>
+#include <linux/sizes.h>
 
 #define SHIFT_TO_TCPHDRLEN_FIELD(x) ((x) << 4)
 #define LEN_B_TO_DW(x) ((x) >> 2)
+#define GET_TCP_HDR_LEN_IN_BYTES(x) ((x) >> 2)
 
 int net_set_ack_options(union tcp_build_pkt *b);
 
@@ -234,3 +237,264 @@ static int net_test_wget(struct unit_test_state *uts)
 	return 0;
 }
 CMD_TEST(net_test_wget, UTF_CONSOLE);
+
+#define LOSSY_BODY_SIZE		SZ_64K
+
+/**
+ * struct lossy_server - state of an HTTP server which loses a segment
+ *
+ * Offsets are in the stream sent by the server, starting after its SYN.
+ *
+ * @stream: HTTP header followed by the body
+ * @total: Number of bytes in @stream
+ * @isn: Initial sequence number
+ * @rcv_nxt: Next sequence number expected from the client
+ * @snd_una: Offset of the first byte not acknowledged
+ * @snd_nxt: Offset of the next new byte to send
+ * @ws: Window scale offered by the client, or -1 if none
+ * @rx_window: Window advertised by the client in its last ACK
+ * @max_window: Largest window advertised by the client
+ * @drop: Offset of a segment to drop the first time it is sent, or -1
+ * @fin_sent: true if the server has sent its FIN
+ * @recovering: true if the first missing segment has been sent again
+ * @segs: Number of data segments sent
+ * @retrans: Number of data segments sent again
+ * @acks: Number of ACKs received for data
+ * @sacks: Number of ACKs which carried SACK blocks
+ */
+struct lossy_server {
+	u8 stream[LOSSY_BODY_SIZE + 100];
+	uint total;
+	u32 isn;
+	u32 rcv_nxt;
+	uint snd_una;
+	uint snd_nxt;
+	int ws;
+	uint rx_window;
+	uint max_window;
+	int drop;
+	bool fin_sent;
+	bool recovering;
+	int segs;
+	int retrans;
+	int acks;
+	int sacks;
+};
+
+static struct lossy_server lossy;
+
+/* Queue a TCP segment from the server, in reply to @packet */
+static void lossy_send(struct udevice *dev, void *packet, u8 flags, u32 seq,
+		       const void *opt, int opt_len, const void *data, int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *tcp = packet + ETHER_HDR_SIZE;
+	struct ethernet_hdr *eth_send;
+	struct ip_tcp_hdr *tcp_send;
+	int hlen = TCP_HDR_SIZE + opt_len;
+	int pkt_len = IP_HDR_SIZE + hlen + len;
+
+	if (priv->recv_packets >= PKTBUFSRX)
+		return;
+
+	eth_send = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth_send->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_send->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_send->et_protlen = htons(PROT_IP);
+	tcp_send = (void *)eth_send + ETHER_HDR_SIZE;
+	tcp_send->tcp_src = tcp->tcp_dst;
+	tcp_send->tcp_dst = tcp->tcp_src;
+	tcp_send->tcp_seq = htonl(seq);
+	tcp_send->tcp_ack = htonl(lossy.rcv_nxt);
+	tcp_send->tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(LEN_B_TO_DW(hlen));
+	tcp_send->tcp_flags = flags;
+	tcp_send->tcp_win = htons(0xffff);
+	tcp_send->tcp_ugr = 0;
+	memcpy((void *)tcp_send + IP_TCP_HDR_SIZE, opt, opt_len);
+	memcpy((void *)tcp_send + IP_TCP_HDR_SIZE + opt_len, data, len);
+	tcp_send->tcp_xsum = 0;
+	tcp_send->tcp_xsum = tcp_set_pseudo_header((uchar *)tcp_send,
+						   tcp->ip_dst, tcp->ip_src,
+						   hlen + len, pkt_len);
+	net_set_ip_header((uchar *)tcp_send, tcp->ip_src, tcp->ip_dst,
+			  pkt_len, IPPROTO_TCP);
+
+	priv->recv_packet_length[priv->recv_packets] = ETHER_HDR_SIZE + pkt_len;
+	++priv->recv_packets;
+}
+
+/* Send the segment at offset @pos in the stream, unless it is to be lost */
+static void lossy_send_data(struct udevice *dev, void *packet, uint pos)
+{
+	int len = min(lossy.total - pos, (uint)TCP_MSS);
+
+	lossy.segs++;
+	if (pos == lossy.drop) {
+		lossy.drop = -1;
+		return;
+	}
+	lossy_send(dev, packet, TCP_ACK, lossy.isn + 1 + pos, NULL, 0,
+		   lossy.stream + pos, len);
+}
+
+/* Handle the options from the client, returning true if it sent SACK */
+static bool lossy_parse_options(u8 *opt, int len, bool syn)
+{
+	bool sack = false;
+	int i;
+
+	for (i = 0; i < len && opt[i] != TCP_O_END;) {
+		if (opt[i] == TCP_1_NOP) {
+			i++;
+			continue;
+		}
+		if (syn && opt[i] == TCP_O_SCL)
+			lossy.ws = opt[i + 2];
+		if (opt[i] == TCP_V_SACK)
+			sack = true;
+		i += opt[i + 1];
+	}
+
+	return sack;
+}
+
+static int sb_lossy_handler(struct udevice *dev, void *packet,
+			    unsigned int len)
+{
+	static const u8 syn_opt[] = {
+		TCP_O_MSS, TCP_OPT_LEN_4, TCP_MSS >> 8, TCP_MSS & 0xff,
+		TCP_1_NOP, TCP_O_SCL, TCP_OPT_LEN_3, 0,
+		TCP_1_NOP, TCP_1_NOP, TCP_P_SACK, TCP_OPT_LEN_2,
+	};
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *tcp = packet + ETHER_HDR_SIZE;
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	int hlen, payload_len;
+	bool sack;
+	uint acked;
+
+	if (ntohs(eth->et_protlen) == PROT_ARP)
+		return sb_arp_handler(dev, packet, len);
+	if (ntohs(eth->et_protlen) != PROT_IP || tcp->ip_p != IPPROTO_TCP)
+		return -EPROTONOSUPPORT;
+
+	hlen = GET_TCP_HDR_LEN_IN_BYTES(tcp->tcp_hlen);
+	payload_len = ntohs(tcp->ip_len) - IP_HDR_SIZE - hlen;
+	sack = lossy_parse_options((u8 *)tcp + IP_TCP_HDR_SIZE,
+				   hlen - TCP_HDR_SIZE,
+				   tcp->tcp_flags & TCP_SYN);
+	lossy.rcv_nxt = ntohl(tcp->tcp_seq) + payload_len +
+		((tcp->tcp_flags & (TCP_SYN | TCP_FIN)) ? 1 : 0);
+
+	if (tcp->tcp_flags & TCP_SYN) {
+		lossy_send(dev, packet, TCP_SYN | TCP_ACK, lossy.isn, syn_opt,
+			   sizeof(syn_opt), NULL, 0);
+		return 0;
+	}
+	if (tcp->tcp_flags & TCP_FIN) {
+		lossy_send(dev, packet, TCP_ACK, lossy.isn + 2 + lossy.total,
+			   NULL, 0, NULL, 0);
+		return 0;
+	}
+
+	lossy.rx_window = ntohs(tcp->tcp_win) << (lossy.ws < 0 ? 0 : lossy.ws);
+	lossy.max_window = max(lossy.max_window, lossy.rx_window);
+
+	/* The request starts the response; nothing is acknowledged yet */
+	acked = ntohl(tcp->tcp_ack) - lossy.isn - 1;
+	if (payload_len) {
+		acked = 0;
+	} else if (acked == lossy.snd_una && lossy.snd_una < lossy.snd_nxt) {
+		/* A duplicate ACK: send the first missing segment again */
+		lossy.acks++;
+		if (sack)
+			lossy.sacks++;
+		if (!lossy.recovering) {
+			lossy.retrans++;
+			lossy_send_data(dev, packet, lossy.snd_una);
+			lossy.recovering = true;
+		}
+	} else if (acked > lossy.snd_una && acked <= lossy.total) {
+		lossy.acks++;
+		lossy.snd_una = acked;
+		lossy.recovering = false;
+	}
+
+	while (lossy.snd_nxt < lossy.total &&
+	       lossy.snd_nxt < lossy.snd_una + lossy.rx_window &&
+	       priv->recv_packets < PKTBUFSRX) {
+		lossy_send_data(dev, packet, lossy.snd_nxt);
+		lossy.snd_nxt += min(lossy.total - lossy.snd_nxt,
+				     (uint)TCP_MSS);
+	}
+
+	if (lossy.snd_una == lossy.total && !lossy.fin_sent) {
+		lossy_send(dev, packet, TCP_FIN | TCP_ACK,
+			   lossy.isn + 1 + lossy.total, NULL, 0, NULL, 0);
+		lossy.fin_sent = true;
+	}
+
+	return 0;
+}
+
+/*
+ * Download a file from a server which loses one segment, checking that the
+ * segments which follow it are kept, that ACKs are combined and that window
+ * scaling is used
+ */
+static int net_test_wget_loss(struct unit_test_state *uts)
+{
+	char *prev_ethact = env_get("ethact");
+	char *prev_ethrotate = env_get("ethrotate");
+	char *prev_loadaddr = env_get("loadaddr");
+	ulong start, us;
+	int hdr_len, i;
+	void *buf;
+
+	memset(&lossy, '\0', sizeof(lossy));
+	hdr_len = sprintf((char *)lossy.stream,
+			  "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n",
+			  LOSSY_BODY_SIZE);
+	for (i = 0; i < LOSSY_BODY_SIZE; i++)
+		lossy.stream[hdr_len + i] = i * 13 + (i >> 8);
+	lossy.total = hdr_len + LOSSY_BODY_SIZE;
+	lossy.isn = 0x12345678;
+	lossy.ws = -1;
+	lossy.drop = TCP_MSS * 10;
+
+	sandbox_eth_set_tx_handler(0, sb_lossy_handler);
+	env_set("ethact", "eth@10002000");
+	env_set("ethrotate", "no");
+	env_set("loadaddr", "0x20000");
+
+	start = timer_get_us();
+	ut_assertok(run_command("wget ${loadaddr} 1.1.2.2:/big.bin", 0));
+	us = timer_get_us() - start;
+	printf("wget: %d bytes in %lu us, %d segments, %d ACKs\n",
+	       LOSSY_BODY_SIZE, us, lossy.segs, lossy.acks);
+
+	sandbox_eth_set_tx_handler(0, NULL);
+	env_set("ethact", prev_ethact);
+	env_set("ethrotate", prev_ethrotate);
+	env_set("loadaddr", prev_loadaddr);
+
+	ut_asserteq(LOSSY_BODY_SIZE, env_get_hex("filesize", 0));
+	buf = map_sysmem(0x20000, LOSSY_BODY_SIZE);
+	ut_asserteq_mem(lossy.stream + hdr_len, buf, LOSSY_BODY_SIZE);
+	unmap_sysmem(buf);
+
+	/* The window is scaled past 64KB */
+	ut_assert(lossy.ws > 0);
+	ut_assert(lossy.max_window > 0xffff);
+
+	/* Only the lost segment is sent again, and ACKs are combined */
+	ut_asserteq(-1, lossy.drop);
+	ut_asserteq(1, lossy.retrans);
+	ut_assert(lossy.acks < lossy.segs);
+	if (IS_ENABLED(CONFIG_PROT_TCP_SACK))
+		ut_assert(lossy.sacks > 0);
+
+	return 0;
+}
+CMD_TEST(net_test_wget_loss, 0);
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for bounce buffers which only bounce the ends of a buffer
+ */
+
+#include <bouncebuf.h>
+#include <malloc.h>
+#include <test/common.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <asm/cache.h>
+#include <linux/string.h>
+
+#define TEST_LEN	(8 * 512)
+
+/* Pretend to be a DMA engine writing @val++ to each byte of the segments */
+static void bounce_test_dma(struct bounce_split *state, u8 val)
+{
+	int i;
+
+	for (i = 0; i < state->count; i++) {
+		memset(state->seg[i].addr, val, state->seg[i].len);
+		val++;
+	}
+}
+
+/* Test splitting an unaligned buffer for a read into it */
+static int bounce_test_split_read(struct unit_test_state *uts)
+{
+	const size_t align = ARCH_DMA_MINALIGN;
+	struct bounce_split state;
+	struct bounce_stats stats;
+	size_t head, tail;
+	u8 *buf, *data;
+
+	buf = memalign(align, TEST_LEN + 2 * align);
+	ut_assertnonnull(buf);
+	memset(buf, 0xff, TEST_LEN + 2 * align);
+	data = buf + 8;
+	head = align - 8;
+	tail = 8;
+	bounce_buffer_reset_stats();
+
+	ut_assertok(bounce_split_start(&state, data, TEST_LEN, GEN_BB_WRITE,
+				       8));
+	ut_asserteq(3, state.count);
+	ut_asserteq_ptr(state.ends, state.seg[0].addr);
+	ut_asserteq(head, state.seg[0].len);
+	ut_asserteq_ptr(data + head, state.seg[1].addr);
+	ut_asserteq(TEST_LEN - head - tail, state.seg[1].len);
+	ut_asserteq_ptr(state.ends + align, state.seg[2].addr);
+	ut_asserteq(tail, state.seg[2].len);
+	bounce_test_dma(&state, 1);
+	ut_assertok(bounce_split_stop(&state));
+
+	/* Each part ends up in place, without touching the bytes around it */
+	ut_asserteq(0xff, buf[7]);
+	ut_asserteq(1, data[0]);
+	ut_asserteq(1, data[head - 1]);
+	ut_asserteq(2, data[head]);
+	ut_asserteq(2, data[TEST_LEN - tail - 1]);
+	ut_asserteq(3, data[TEST_LEN - tail]);
+	ut_asserteq(3, data[TEST_LEN - 1]);
+	ut_asserteq(0xff, data[TEST_LEN]);
+
+	bounce_buffer_get_stats(&stats);
+	ut_asserteq(TEST_LEN - align, stats.direct_bytes);
+	ut_asserteq(align, stats.bounced_bytes);
+	ut_asserteq(1, stats.splits);
+	free(buf);
+
+	return 0;
+}
+COMMON_TEST(bounce_test_split_read, 0);
+
+/* Test splitting an unaligned buffer for a write from it */
+static int bounce_test_split_write(struct unit_test_state *uts)
+{
+	const size_t align = ARCH_DMA_MINALIGN;
+	struct bounce_split state;
+	u8 *buf, *data;
+	int i;
+
+	buf = memalign(align, TEST_LEN + align);
+	ut_assertnonnull(buf);
+	data = buf + align - 8;
+	for (i = 0; i < TEST_LEN; i++)
+		data[i] = i;
+
+	ut_assertok(bounce_split_start(&state, data, TEST_LEN, GEN_BB_READ,
+				       8));
+	ut_asserteq(3, state.count);
+	ut_asserteq(8, state.seg[0].len);
+	ut_asserteq_mem(data, state.seg[0].addr, 8);
+	ut_asserteq_ptr(data + 8, state.seg[1].addr);
+	ut_asserteq_mem(data + TEST_LEN - state.seg[2].len,
+			state.seg[2].addr, state.seg[2].len);
+	ut_assertok(bounce_split_stop(&state));
+	free(buf);
+
+	return 0;
+}
+COMMON_TEST(bounce_test_split_write, 0);
+
+/* Test buffers which are not split */
+static int bounce_test_split_whole(struct unit_test_state *uts)
+{
+	const size_t align = ARCH_DMA_MINALIGN;
+	struct bounce_split state;
+	struct bounce_stats stats;
+	u8 *buf;
+
+	buf = memalign(align, TEST_LEN + align);
+	ut_assertnonnull(buf);
+	bounce_buffer_reset_stats();
+
+	/* An aligned buffer is used as is */
+	ut_assertok(bounce_split_start(&state, buf, TEST_LEN, GEN_BB_WRITE, 8));
+	ut_asserteq(1, state.count);
+	ut_asserteq_ptr(buf, state.seg[0].addr);
+	ut_assertok(bounce_split_stop(&state));
+
+	/* A buffer which is not aligned to the granule is bounced */
+	ut_assertok(bounce_split_start(&state, buf + 4, TEST_LEN, GEN_BB_WRITE,
+				       8));
+	ut_asserteq(1, state.count);
+	ut_assert(state.seg[0].addr != buf + 4);
+	bounce_test_dma(&state, 5);
+	ut_assertok(bounce_split_stop(&state));
+	ut_asserteq(5, buf[4]);
+	ut_asserteq(5, buf[TEST_LEN + 3]);
+
+	/* So is a small one */
+	ut_assertok(bounce_split_start(&state, buf + 8, align, GEN_BB_WRITE,
+				       8));
+	ut_asserteq(1, state.count);
+	ut_assertok(bounce_split_stop(&state));
+
+	bounce_buffer_get_stats(&stats);
+	ut_asserteq(TEST_LEN, stats.direct_bytes);
+	ut_asserteq(TEST_LEN + align, stats.bounced_bytes);
+	ut_asserteq(0, stats.splits);
+	free(buf);
+
+	return 0;
+}
+COMMON_TEST(bounce_test_split_whole, 0);
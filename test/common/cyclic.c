@@ -4,13 +4,19 @@
  */
 
 #include <cyclic.h>
+#include <console.h>
 #include <dm.h>
+#include <asm/global_data.h>
+#include <dm/device-internal.h>
+#include <dm/lists.h>
 #include <test/common.h>
 #include <test/test.h>
 #include <test/ut.h>
 #include <watchdog.h>
 #include <linux/delay.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 /* Test that cyclic function is called */
 static struct cyclic_test {
 	struct cyclic_info cyclic;
@@ -37,3 +43,71 @@ static int dm_test_cyclic_running(struct unit_test_state *uts)
 	return 0;
 }
 COMMON_TEST(dm_test_cyclic_running, 0);
+
+#if CONFIG_IS_ENABLED(CYCLIC_JOBS)
+/* Delay in the test job, in milliseconds */
+#define TEST_JOB_DELAY_MS	20
+
+static bool test_job_ran;
+
+static int test_job(void)
+{
+	mdelay(TEST_JOB_DELAY_MS);
+	test_job_ran = true;
+
+	return -EIO;
+}
+
+CYCLIC_JOB(test) = {
+	.name		= "test",
+	.uclass		= UCLASS_TEST_PROBE,
+	.func		= test_job,
+};
+
+/* Test starting a background job and waiting for it */
+static int common_test_cyclic_job(struct unit_test_state *uts)
+{
+	struct cyclic_job *job = ll_entry_get(struct cyclic_job, test,
+					      cyclic_job);
+	struct udevice *dev;
+
+	test_job_ran = false;
+	job->state = CYCLIC_JOB_IDLE;
+	ut_asserteq(-ESRCH, cyclic_job_wait("test"));
+	ut_asserteq(-ESRCH, cyclic_job_wait_uclass(UCLASS_TEST_PROBE));
+
+	ut_asserteq(-ENOENT, cyclic_jobs_start("test nonexistent"));
+	ut_asserteq(CYCLIC_JOB_RUNNING, job->state);
+	ut_assert(!test_job_ran);
+
+	/* Other uclasses are not held up by the job */
+	ut_asserteq(-ESRCH, cyclic_job_wait_uclass(UCLASS_TEST_FDT));
+
+	ut_asserteq(-EIO, cyclic_job_wait_uclass(UCLASS_TEST_PROBE));
+	ut_assert(test_job_ran);
+	ut_asserteq(CYCLIC_JOB_DONE, job->state);
+	ut_assert(job->time_us >= TEST_JOB_DELAY_MS * 1000);
+	ut_assert(job->wait_us);
+
+	/* Once done, the result is available without waiting */
+	ut_asserteq(-EIO, cyclic_job_wait("test"));
+
+	console_record_reset_enable();
+	cyclic_jobs_list();
+	ut_assert_skip_to_linen("job: test, state: done, time: ");
+	console_record_reset();
+
+	/* Removing a device in the uclass makes the result stale */
+	ut_assertok(device_bind_driver(gd->dm_root, "testprobe_drv", "test",
+				       &dev));
+	ut_assertok(device_probe(dev));
+	ut_asserteq(-EIO, cyclic_job_wait_uclass(UCLASS_TEST_PROBE));
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_asserteq(CYCLIC_JOB_IDLE, job->state);
+	ut_asserteq(-ESRCH, cyclic_job_wait_uclass(UCLASS_TEST_PROBE));
+	ut_assertok(device_unbind(dev));
+
+	return 0;
+}
+COMMON_TEST(common_test_cyclic_job, UTF_CONSOLE);
+#endif
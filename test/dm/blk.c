@@ -4,12 +4,15 @@
  */
 
 #include <blk.h>
+#include <blkmap.h>
 #include <dm.h>
+#include <os.h>
 #include <part.h>
 #include <sandbox_host.h>
 #include <usb.h>
 #include <asm/global_data.h>
 #include <asm/state.h>
+#include <dm/device-internal.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -334,3 +337,284 @@ static int dm_test_blk_foreach(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_foreach, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test the block cache, including readahead */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_dev_stats dstats;
+	struct block_cache_stats stats, old;
+	char buf[16 * 512], out[4 * 512];
+	lbaint_t count;
+	char *ra;
+	int i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i / 512 + i;
+	blkcache_stats(&old);
+	blkcache_configure(8, 32);
+
+	/* A block misses until it is filled */
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 3, 1, 512, out));
+	blkcache_fill(UCLASS_HOST, 0, 3, 1, 512, buf + 3 * 512);
+	ut_asserteq(1, blkcache_read(UCLASS_HOST, 0, 3, 1, 512, out));
+	ut_asserteq_mem(buf + 3 * 512, out, 512);
+
+	/* A read which spans two entries */
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 6, 4, 512, out));
+	blkcache_fill(UCLASS_HOST, 0, 6, 4, 512, buf + 6 * 512);
+	ut_asserteq(1, blkcache_read(UCLASS_HOST, 0, 6, 4, 512, out));
+	ut_asserteq_mem(buf + 6 * 512, out, 4 * 512);
+
+	/* Blocks 4 and 5 were never read, nor anything on another device */
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 3, 3, 512, out));
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 1, 3, 1, 512, out));
+
+	/* No readahead for a random read */
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 10, 1, 512, out));
+	ut_assertnull(blkcache_readahead(UCLASS_HOST, 0, 10, 1, 512, 100,
+					 &count));
+
+	/* The next read is sequential, so read up to the end of the entry */
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 11, 1, 512, out));
+	ra = blkcache_readahead(UCLASS_HOST, 0, 11, 1, 512, 100, &count);
+	ut_assertnonnull(ra);
+	ut_asserteq(5, count);
+	memcpy(ra, buf + 11 * 512, count * 512);
+	blkcache_fill(UCLASS_HOST, 0, 11, 1, 512, ra);
+	blkcache_fill_readahead(UCLASS_HOST, 0, 12, 4, 512, ra + 512);
+
+	/* ...which then hits, using two of the four blocks read ahead */
+	ut_asserteq(1, blkcache_read(UCLASS_HOST, 0, 12, 2, 512, out));
+	ut_asserteq_mem(buf + 12 * 512, out, 2 * 512);
+
+	/* The window doubles but is limited by the end of the device */
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 14, 4, 512, out));
+	ut_assertnonnull(blkcache_readahead(UCLASS_HOST, 0, 14, 4, 512, 20,
+					    &count));
+	ut_asserteq(6, count);
+
+	ut_assertok(blkcache_dev_stats(0, &dstats));
+	ut_asserteq(UCLASS_HOST, dstats.iftype);
+	ut_asserteq(0, dstats.devnum);
+	ut_asserteq(3, dstats.hits);
+	ut_asserteq(6, dstats.misses);
+	ut_asserteq(4, dstats.ra_blocks);
+	ut_asserteq(2, dstats.ra_used);
+	ut_asserteq(7 * 512, dstats.bytes_saved);
+	ut_assertok(blkcache_dev_stats(1, &dstats));
+	ut_asserteq(1, dstats.devnum);
+	ut_asserteq(-ENOENT, blkcache_dev_stats(2, &dstats));
+
+	blkcache_stats(&stats);
+	ut_asserteq(3, stats.hits);
+	ut_asserteq(7, stats.misses);
+	ut_asserteq(2, stats.entries);
+
+	/* Invalidating a device drops its entries */
+	blkcache_invalidate(UCLASS_HOST, 0);
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 3, 1, 512, out));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.entries);
+
+	blkcache_configure(old.max_blocks_per_entry, old.max_entries);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, 0);
+
+/* Test reads which hit the middle of the blocks read ahead */
+static int dm_test_blk_cache_ra_middle(struct unit_test_state *uts)
+{
+	struct block_cache_dev_stats dstats;
+	struct block_cache_stats old;
+	char buf[8 * 512], out[4 * 512];
+	int i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i / 512 + i;
+	blkcache_stats(&old);
+	blkcache_configure(8, 32);
+	blkcache_invalidate(-1, 0);
+
+	/* Read ahead a whole entry after a miss, then use the middle of it */
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 15, 1, 512, out));
+	blkcache_fill_readahead(UCLASS_HOST, 0, 16, 8, 512, buf);
+	ut_asserteq(1, blkcache_read(UCLASS_HOST, 0, 19, 2, 512, out));
+	ut_asserteq_mem(buf + 3 * 512, out, 2 * 512);
+	ut_assertok(blkcache_dev_stats(0, &dstats));
+	ut_asserteq(8, dstats.ra_blocks);
+	ut_asserteq(2, dstats.ra_used);
+
+	/* The blocks on either side are still counted when they are used */
+	ut_asserteq(1, blkcache_read(UCLASS_HOST, 0, 21, 3, 512, out));
+	ut_asserteq_mem(buf + 5 * 512, out, 3 * 512);
+	ut_asserteq(1, blkcache_read(UCLASS_HOST, 0, 16, 3, 512, out));
+	ut_asserteq_mem(buf, out, 3 * 512);
+	ut_assertok(blkcache_dev_stats(0, &dstats));
+	ut_asserteq(8, dstats.ra_used);
+
+	/* ...but only once */
+	ut_asserteq(1, blkcache_read(UCLASS_HOST, 0, 18, 4, 512, out));
+	ut_asserteq_mem(buf + 2 * 512, out, 4 * 512);
+	ut_assertok(blkcache_dev_stats(0, &dstats));
+	ut_asserteq(8, dstats.ra_blocks);
+	ut_asserteq(8, dstats.ra_used);
+
+	blkcache_configure(old.max_blocks_per_entry, old.max_entries);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache_ra_middle, 0);
+
+/* Count the completions of asynchronous requests */
+static void blk_async_done(struct blk_req *req)
+{
+	int *done = req->priv;
+
+	(*done)++;
+}
+
+static void blk_async_init(struct blk_req *req, enum blk_req_op op,
+			   lbaint_t start, lbaint_t blkcnt, void *buffer,
+			   int *done)
+{
+	memset(req, '\0', sizeof(*req));
+	req->op = op;
+	req->start = start;
+	req->blkcnt = blkcnt;
+	req->buffer = buffer;
+	req->done = blk_async_done;
+	req->priv = done;
+}
+
+/* Test asynchronous requests with a driver which supports them */
+static int dm_test_blk_async(struct unit_test_state *uts)
+{
+	struct blk_req req[HOST_BLK_MAX_REQS + 1], wreq;
+	char buf[8 * 512], out[8 * 512];
+	struct udevice *dev, *blk;
+	struct blk_desc *desc;
+	char fname[256];
+	int fd, i, done;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i / 512 + i * 3;
+	os_persistent_file(fname, sizeof(fname), "blk-async.img");
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	ut_asserteq(sizeof(buf), os_write(fd, buf, sizeof(buf)));
+	os_close(fd);
+
+	ut_assertok(host_create_device("test0", false, DEFAULT_BLKSZ, &dev));
+	ut_assertok(host_attach_file(dev, fname));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	ut_assertok(device_probe(blk));
+	desc = dev_get_uclass_plat(blk);
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+
+	/* Fill the device's queue with one read per block */
+	done = 0;
+	memset(out, '\0', sizeof(out));
+	for (i = 0; i < HOST_BLK_MAX_REQS; i++) {
+		blk_async_init(&req[i], BLK_REQ_READ, i, 1, out + i * 512,
+			       &done);
+		ut_assertok(blk_submit(blk, &req[i]));
+		ut_assert(!req[i].complete);
+	}
+	blk_async_init(&req[i], BLK_REQ_READ, i, 8 - i, out + i * 512, &done);
+	ut_asserteq(-EBUSY, blk_submit(blk, &req[i]));
+	ut_asserteq(0, done);
+
+	/* The device carries out one request each time it is polled */
+	ut_asserteq(HOST_BLK_MAX_REQS - 1, blk_poll(blk));
+	ut_asserteq(1, done);
+	ut_assert(req[0].complete);
+	ut_asserteq(1, req[0].result);
+	ut_assert(!req[1].complete);
+
+	/* Waiting for the last request completes all those before it */
+	ut_assertok(blk_submit(blk, &req[i]));
+	ut_asserteq(8 - i, blk_wait(blk, &req[i]));
+	ut_asserteq(HOST_BLK_MAX_REQS + 1, done);
+	ut_asserteq(0, blk_poll(blk));
+	ut_asserteq_mem(buf, out, sizeof(buf));
+
+	/* The data read was cached, so reading it again completes at once */
+	ut_assertok(blk_submit(blk, &req[0]));
+	ut_assert(req[0].complete);
+	ut_asserteq(1, req[0].result);
+	ut_asserteq(HOST_BLK_MAX_REQS + 2, done);
+
+	/* A write, checked by reading synchronously */
+	memset(out, 0xaa, 2 * 512);
+	blk_async_init(&wreq, BLK_REQ_WRITE, 2, 2, out, &done);
+	ut_assertok(blk_submit(blk, &wreq));
+	ut_assert(!wreq.complete);
+	ut_asserteq(2, blk_wait(blk, &wreq));
+	memcpy(buf + 2 * 512, out, 2 * 512);
+	ut_asserteq(8, blk_read(blk, 0, 8, out));
+	ut_asserteq_mem(buf, out, sizeof(buf));
+
+	/*
+	 * A read queued before a write completes first, with the old data,
+	 * which must not be left in the cache
+	 */
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blk_async_init(&req[0], BLK_REQ_READ, 2, 2, out, &done);
+	ut_assertok(blk_submit(blk, &req[0]));
+	memset(out + 2 * 512, 0x55, 2 * 512);
+	blk_async_init(&wreq, BLK_REQ_WRITE, 2, 2, out + 2 * 512, &done);
+	ut_assertok(blk_submit(blk, &wreq));
+	ut_asserteq(2, blk_wait(blk, &wreq));
+	ut_assert(req[0].complete);
+	ut_asserteq_mem(buf + 2 * 512, out, 2 * 512);
+	ut_asserteq(2, blk_read(blk, 2, 2, out));
+	ut_asserteq_mem(out + 2 * 512, out, 2 * 512);
+
+	/* Removing the device fails any requests still queued */
+	ut_assertok(blk_submit(blk, &wreq));
+	ut_assertok(host_detach_file(dev));
+	ut_assert(wreq.complete);
+	ut_asserteq(-ENODEV, wreq.result);
+	ut_assertok(device_unbind(dev));
+	os_unlink(fname);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test asynchronous requests with a driver which does not support them */
+static int dm_test_blk_async_sync(struct unit_test_state *uts)
+{
+	char write[4 * 512], read[4 * 512], mem[4 * 512];
+	struct udevice *dev, *blk;
+	struct blk_req req;
+	int i, done = 0;
+
+	/* blkmap has no submit() method */
+	ut_assertok(blkmap_create("async", &dev));
+	ut_assertok(blkmap_map_mem(dev, 0, 4, mem));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i * 5;
+
+	/* Each request is carried out before blk_submit() returns */
+	blk_async_init(&req, BLK_REQ_WRITE, 0, 4, write, &done);
+	ut_assertok(blk_submit(blk, &req));
+	ut_assert(req.complete);
+	ut_asserteq(4, req.result);
+	ut_asserteq(1, done);
+	ut_asserteq_mem(write, mem, sizeof(write));
+
+	blk_async_init(&req, BLK_REQ_READ, 0, 4, read, &done);
+	ut_assertok(blk_submit(blk, &req));
+	ut_asserteq(4, blk_wait(blk, &req));
+	ut_asserteq(2, done);
+	ut_asserteq_mem(write, read, sizeof(write));
+	ut_asserteq(0, blk_poll(blk));
+
+	ut_assertok(blkmap_destroy(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async_sync, UTF_SCAN_PDATA | UTF_SCAN_FDT);
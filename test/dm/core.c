@@ -12,6 +12,7 @@
 #include <malloc.h>
 #include <asm/global_data.h>
 #include <dm/device-internal.h>
+#include <dm/lists.h>
 #include <dm/root.h>
 #include <dm/util.h>
 #include <dm/test.h>
@@ -1423,3 +1424,43 @@ static int dm_test_try_first_device(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_try_first_device, 0);
+
+/* Test that compatible strings find the same driver as a linear search */
+static int dm_test_lookup_compat(struct unit_test_state *uts)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *id, *found_id, *check_id;
+	struct driver *drv, *found, *check;
+	int count = 0;
+
+	for (drv = driver; drv != driver + n_ents; drv++) {
+		for (id = drv->of_match; id && id->compatible; id++) {
+			/* The first driver with this string should win */
+			for (check = driver; check != drv; check++) {
+				for (check_id = check->of_match;
+				     check_id && check_id->compatible;
+				     check_id++) {
+					if (!strcmp(check_id->compatible,
+						    id->compatible))
+						break;
+				}
+				if (check_id && check_id->compatible)
+					break;
+			}
+			if (check != drv)
+				continue;
+
+			found = lists_driver_lookup_compat(id->compatible,
+							   &found_id);
+			ut_asserteq_ptr(drv, found);
+			ut_asserteq_ptr(id, found_id);
+			count++;
+		}
+	}
+	ut_assert(count > 0);
+	ut_assertnull(lists_driver_lookup_compat("not,a-driver", &found_id));
+
+	return 0;
+}
+DM_TEST(dm_test_lookup_compat, 0);
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for writing with DFU
+ */
+
+#include <dfu.h>
+#include <env.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+#define TEST_BUF_SIZE	0x1000
+#define TEST_PKT_SIZE	0x200
+#define TEST_SIZE	(3 * TEST_BUF_SIZE + 2 * TEST_PKT_SIZE)
+
+/* Set up a RAM entity which writes to @dst */
+static int setup_dfu(struct unit_test_state *uts, void *dst,
+		     struct dfu_entity **dfup)
+{
+	char alt[60];
+
+	/*
+	 * Use dfu_config_entities() directly, since sandbox overrides
+	 * dfu_alt_info with its capsule-update layout
+	 */
+	ut_assertok(env_set_ulong("dfu_bufsiz", TEST_BUF_SIZE));
+	snprintf(alt, sizeof(alt), "test ram %lx %x", (ulong)map_to_sysmem(dst),
+		 TEST_SIZE);
+	ut_assertok(dfu_config_entities(alt, "ram", "0"));
+	*dfup = dfu_get_entity(0);
+	ut_assertnonnull(*dfup);
+
+	return 0;
+}
+
+static void cleanup_dfu(void)
+{
+	dfu_free_entities();
+	env_set("dfu_bufsiz", NULL);
+}
+
+/* Test writing in packets, as the USB gadget does */
+static int dm_test_dfu_write(struct unit_test_state *uts)
+{
+	struct dfu_entity *dfu;
+	u8 *src, *dst;
+	int pos, seq;
+
+	src = malloc(TEST_SIZE);
+	dst = calloc(1, TEST_SIZE);
+	ut_assertnonnull(src);
+	ut_assertnonnull(dst);
+	for (pos = 0; pos < TEST_SIZE; pos++)
+		src[pos] = pos * 13;
+	ut_assertok(setup_dfu(uts, dst, &dfu));
+
+	for (pos = 0, seq = 0; pos < TEST_SIZE; pos += TEST_PKT_SIZE) {
+		ut_assertok(dfu_write(dfu, src + pos, TEST_PKT_SIZE, seq++));
+
+		/* the first buffer is full, so should have been queued */
+		if (pos + TEST_PKT_SIZE == TEST_BUF_SIZE &&
+		    CONFIG_IS_ENABLED(DFU_WRITE_ASYNC)) {
+			/* the writer thread has not had a chance to run */
+			ut_asserteq(0, dst[0]);
+			schedule();
+			ut_asserteq_mem(src, dst, TEST_BUF_SIZE);
+		}
+	}
+	ut_assertok(dfu_flush(dfu, NULL, 0, seq));
+	ut_asserteq_mem(src, dst, TEST_SIZE);
+
+	ut_assert_nextline("####");
+	ut_assert_nextlinen("DFU test: wrote %d bytes in ", TEST_SIZE);
+	ut_assert_console_end();
+
+	cleanup_dfu();
+	free(dst);
+	free(src);
+
+	return 0;
+}
+DM_TEST(dm_test_dfu_write, UTF_CONSOLE);
+
+/* Test writing from the DFU buffer itself, as thor does */
+static int dm_test_dfu_write_inplace(struct unit_test_state *uts)
+{
+	struct dfu_entity *dfu;
+	u8 *buf, *dst;
+	int i;
+
+	dst = calloc(1, TEST_SIZE);
+	ut_assertnonnull(dst);
+	ut_assertok(setup_dfu(uts, dst, &dfu));
+	buf = dfu_get_buf(dfu);
+	ut_assertnonnull(buf);
+
+	/* each buffer must be written before the next one arrives */
+	for (i = 0; i < 3; i++) {
+		memset(buf, i + 1, TEST_BUF_SIZE);
+		ut_assertok(dfu_write(dfu, buf, TEST_BUF_SIZE, i));
+		ut_asserteq(i + 1, dst[i * TEST_BUF_SIZE]);
+		ut_asserteq(i + 1, dst[(i + 1) * TEST_BUF_SIZE - 1]);
+	}
+	ut_assertok(dfu_flush(dfu, NULL, 0, i));
+	for (i = 0; i < 3; i++)
+		ut_asserteq(i + 1, dst[i * TEST_BUF_SIZE + 1]);
+	ut_asserteq(0, dst[3 * TEST_BUF_SIZE]);
+
+	cleanup_dfu();
+	free(dst);
+
+	return 0;
+}
+DM_TEST(dm_test_dfu_write_inplace, 0);
@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for reading ext4 files which use extents
+ */
+
+#include <blk.h>
+#include <dm.h>
+#include <ext4fs.h>
+#include <ext_common.h>
+#include <fs.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <part.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define EXT4_TEST_BLKSZ		1024
+#define EXT4_TEST_BLOCKS	32
+#define EXT4_TEST_INODES	16
+#define EXT4_TEST_ITABLE	5
+#define EXT4_TEST_ROOT_DIR	7
+#define EXT4_TEST_FILE_INO	12
+#define EXT4_TEST_FILE_BLOCKS	10
+
+/**
+ * struct ext4_test_extent - an extent of DATA.BIN
+ *
+ * @leaf: Leaf block holding the extent
+ * @lblk: First block within the file
+ * @pblk: First block of the filesystem
+ * @len: Number of blocks
+ * @unwritten: true if the extent is unwritten, so reads as zeroes
+ */
+struct ext4_test_extent {
+	int leaf;
+	int lblk;
+	int pblk;
+	int len;
+	bool unwritten;
+};
+
+/*
+ * DATA.BIN is ten blocks long, with an extent tree of depth one pointing at
+ * two leaves. Block 3 is a hole, blocks 4-5 are unwritten and blocks 8-9
+ * lie beyond the last extent.
+ */
+static const struct ext4_test_extent ext4_test_extents[] = {
+	{ 8, 0, 10, 2 },
+	{ 8, 2, 20, 1 },
+	{ 9, 4, 22, 2, true },
+	{ 9, 6, 12, 2 },
+};
+
+/* Value of each byte in block @lblk of DATA.BIN */
+static u8 ext4_test_byte(int lblk)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ext4_test_extents); i++) {
+		const struct ext4_test_extent *ext = &ext4_test_extents[i];
+
+		if (lblk >= ext->lblk && lblk < ext->lblk + ext->len)
+			return ext->unwritten ? 0 : 0x30 + lblk;
+	}
+
+	return 0;
+}
+
+/*
+ * Set up an extent header, returning a pointer to the @entries entries which
+ * follow it
+ */
+static void *ext4_test_header(void *buf, int entries, int max, int depth)
+{
+	struct ext4_extent_header *hdr = buf;
+
+	hdr->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+	hdr->eh_entries = cpu_to_le16(entries);
+	hdr->eh_max = cpu_to_le16(max);
+	hdr->eh_depth = cpu_to_le16(depth);
+
+	return hdr + 1;
+}
+
+/* Add a directory entry at @pos, returning the position of the next one */
+static int ext4_test_dirent(u8 *dir, int pos, const char *name, int ino,
+			    int type, int len)
+{
+	struct ext2_dirent *dirent = (void *)(dir + pos);
+
+	dirent->inode = cpu_to_le32(ino);
+	dirent->direntlen = cpu_to_le16(len);
+	dirent->namelen = strlen(name);
+	dirent->filetype = type;
+	memcpy(dirent + 1, name, dirent->namelen);
+
+	return pos + len;
+}
+
+/**
+ * make_ext4() - Create an ext4 filesystem holding DATA.BIN
+ *
+ * This uses 1KB blocks and one group. The root directory and DATA.BIN both
+ * use extents.
+ *
+ * @img: Buffer of EXT4_TEST_BLOCKS blocks to fill in
+ */
+static void make_ext4(u8 *img)
+{
+	struct ext2_sblock *sb = (void *)(img + EXT4_TEST_BLKSZ);
+	struct ext2_block_group *bg = (void *)(img + 2 * EXT4_TEST_BLKSZ);
+	struct ext2_inode *itable = (void *)(img + EXT4_TEST_ITABLE *
+					     EXT4_TEST_BLKSZ);
+	struct ext2_inode *root = &itable[1], *file;
+	u8 *dir = img + EXT4_TEST_ROOT_DIR * EXT4_TEST_BLKSZ;
+	struct ext4_extent_idx *idx;
+	struct ext4_extent *ext;
+	int i, pos;
+
+	memset(img, '\0', EXT4_TEST_BLOCKS * EXT4_TEST_BLKSZ);
+	sb->total_inodes = cpu_to_le32(EXT4_TEST_INODES);
+	sb->total_blocks = cpu_to_le32(EXT4_TEST_BLOCKS);
+	sb->first_data_block = cpu_to_le32(1);
+	sb->blocks_per_group = cpu_to_le32(8192);
+	sb->fragments_per_group = cpu_to_le32(8192);
+	sb->inodes_per_group = cpu_to_le32(EXT4_TEST_INODES);
+	sb->magic = cpu_to_le16(EXT2_MAGIC);
+	sb->fs_state = cpu_to_le16(1);
+	sb->revision_level = cpu_to_le32(1);
+	sb->first_inode = cpu_to_le32(11);
+	sb->inode_size = cpu_to_le16(sizeof(struct ext2_inode));
+	sb->feature_incompat = cpu_to_le32(EXT4_FEATURE_INCOMPAT_FILETYPE |
+					   EXT4_FEATURE_INCOMPAT_EXTENTS);
+
+	bg->block_id = cpu_to_le32(3);
+	bg->inode_id = cpu_to_le32(4);
+	bg->inode_table_id = cpu_to_le32(EXT4_TEST_ITABLE);
+	bg->used_dir_cnt = cpu_to_le16(1);
+
+	/* The root directory takes a single block */
+	root->mode = cpu_to_le16(FILETYPE_INO_DIRECTORY | 0755);
+	root->size = cpu_to_le32(EXT4_TEST_BLKSZ);
+	root->nlinks = cpu_to_le16(2);
+	root->flags = cpu_to_le32(EXT4_EXTENTS_FL);
+	ext = ext4_test_header(root->b.blocks.dir_blocks, 1, 4, 0);
+	ext->ee_len = cpu_to_le16(1);
+	ext->ee_start_lo = cpu_to_le32(EXT4_TEST_ROOT_DIR);
+
+	pos = ext4_test_dirent(dir, 0, ".", 2, FILETYPE_DIRECTORY, 12);
+	pos = ext4_test_dirent(dir, pos, "..", 2, FILETYPE_DIRECTORY, 12);
+	ext4_test_dirent(dir, pos, "data.bin", EXT4_TEST_FILE_INO,
+			 FILETYPE_REG, EXT4_TEST_BLKSZ - pos);
+
+	/* DATA.BIN has an index in the inode pointing to two leaves */
+	file = &itable[EXT4_TEST_FILE_INO - 1];
+	file->mode = cpu_to_le16(FILETYPE_INO_REG | 0644);
+	file->size = cpu_to_le32(EXT4_TEST_FILE_BLOCKS * EXT4_TEST_BLKSZ);
+	file->nlinks = cpu_to_le16(1);
+	file->flags = cpu_to_le32(EXT4_EXTENTS_FL);
+	idx = ext4_test_header(file->b.blocks.dir_blocks, 2, 4, 1);
+	idx[0].ei_block = cpu_to_le32(0);
+	idx[0].ei_leaf_lo = cpu_to_le32(8);
+	idx[1].ei_block = cpu_to_le32(4);
+	idx[1].ei_leaf_lo = cpu_to_le32(9);
+
+	for (i = 0; i < ARRAY_SIZE(ext4_test_extents); i++) {
+		const struct ext4_test_extent *te = &ext4_test_extents[i];
+		u8 *leaf = img + te->leaf * EXT4_TEST_BLKSZ;
+		struct ext4_extent_header *hdr = (void *)leaf;
+		int n = le16_to_cpu(hdr->eh_entries);
+
+		ext = ext4_test_header(leaf, n + 1,
+				       (EXT4_TEST_BLKSZ - sizeof(*hdr)) /
+				       sizeof(*ext), 0);
+		ext += n;
+		ext->ee_block = cpu_to_le32(te->lblk);
+		ext->ee_len = cpu_to_le16(te->len + (te->unwritten ? 32768 : 0));
+		ext->ee_start_lo = cpu_to_le32(te->pblk);
+
+		/* Unwritten blocks hold stale data, which must not be read */
+		memset(img + te->pblk * EXT4_TEST_BLKSZ,
+		       te->unwritten ? 0xee : 0, te->len * EXT4_TEST_BLKSZ);
+		for (n = 0; !te->unwritten && n < te->len; n++)
+			memset(img + (te->pblk + n) * EXT4_TEST_BLKSZ,
+			       ext4_test_byte(te->lblk + n), EXT4_TEST_BLKSZ);
+	}
+}
+
+/* Read part of DATA.BIN and check its contents */
+static int check_range(struct unit_test_state *uts, struct blk_desc *desc,
+		       u8 *buf, loff_t pos, loff_t len)
+{
+	loff_t actread;
+	int i;
+
+	memset(buf, 0xff, len);
+	ut_assertok(fs_set_blk_dev_with_part(desc, 0));
+	ut_assertok(fs_read("/data.bin", map_to_sysmem(buf), pos, len,
+			    &actread));
+	ut_asserteq(len, actread);
+	for (i = 0; i < len; i++)
+		ut_asserteq(ext4_test_byte((pos + i) / EXT4_TEST_BLKSZ),
+			    buf[i]);
+
+	return 0;
+}
+
+/* Test reading a file through its extents, including holes */
+static int dm_test_ext4_extents(struct unit_test_state *uts)
+{
+	const int size = EXT4_TEST_FILE_BLOCKS * EXT4_TEST_BLKSZ;
+	struct blk_desc *desc;
+	loff_t fsize;
+	int blkcnt;
+	u8 *img, *buf;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	img = malloc(EXT4_TEST_BLOCKS * EXT4_TEST_BLKSZ);
+	buf = malloc(size);
+	ut_assertnonnull(img);
+	ut_assertnonnull(buf);
+
+	make_ext4(img);
+	blkcnt = EXT4_TEST_BLOCKS * EXT4_TEST_BLKSZ / desc->blksz;
+	ut_asserteq(blkcnt, blk_dwrite(desc, 0, blkcnt, img));
+
+	ut_assertok(fs_set_blk_dev_with_part(desc, 0));
+	ut_asserteq(FS_TYPE_EXT, fs_get_type());
+	ut_assertok(fs_set_blk_dev_with_part(desc, 0));
+	ut_assertok(fs_size("/data.bin", &fsize));
+	ut_asserteq(size, fsize);
+
+	/* The whole file, then parts starting and ending within blocks */
+	ut_assertok(check_range(uts, desc, buf, 0, size));
+	ut_assertok(check_range(uts, desc, buf, 1500, 3000));
+	ut_assertok(check_range(uts, desc, buf, 3000, 3500));
+	ut_assertok(check_range(uts, desc, buf, 7000, size - 7000));
+	ut_assertok(check_range(uts, desc, buf, 5000, 100));
+
+	free(buf);
+	free(img);
+
+	return 0;
+}
+DM_TEST(dm_test_ext4_extents, UTF_SCAN_PDATA | UTF_SCAN_FDT);
@@ -6,11 +6,13 @@
 #include <dm.h>
 #include <fastboot.h>
 #include <fb_mmc.h>
+#include <malloc.h>
 #include <mmc.h>
 #include <part.h>
 #include <part_efi.h>
 #include <dm/test.h>
 #include <test/ut.h>
+#include <asm/cache.h>
 #include <linux/stringify.h>
 
 #define FB_ALIAS_PREFIX "fastboot_partition_alias_"
@@ -92,3 +94,129 @@ static int dm_test_fastboot_mmc_part(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_fastboot_mmc_part, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test writing an image to a partition as it downloads */
+static int dm_test_fastboot_stream(struct unit_test_state *uts)
+{
+	char response[FASTBOOT_RESPONSE_LEN] = {0};
+	char str_disk_guid[UUID_STR_LEN + 1];
+	struct blk_desc *mmc_dev_desc;
+	struct disk_partition parts[] = {
+		{
+			.start = 48,
+			.size = 16,
+			.name = "test1",
+		},
+	};
+	const int size = 6 * 512 + 100;
+	char cmd[FASTBOOT_COMMAND_LEN];
+	u8 *buf, *image, *data;
+	int i, pos;
+
+	if (!CONFIG_IS_ENABLED(FASTBOOT_STREAM_FLASH))
+		return -EAGAIN;
+	ut_assertok(blk_get_device_by_str("mmc", "0", &mmc_dev_desc));
+	if (CONFIG_IS_ENABLED(RANDOM_UUID)) {
+		gen_rand_uuid_str(parts[0].uuid, UUID_STR_FORMAT_STD);
+		gen_rand_uuid_str(str_disk_guid, UUID_STR_FORMAT_STD);
+	}
+	ut_assertok(gpt_restore(mmc_dev_desc, str_disk_guid, parts,
+				ARRAY_SIZE(parts)));
+
+	/* use a download buffer which is smaller than the image */
+	buf = memalign(ARCH_DMA_MINALIGN, 2048);
+	image = malloc(16 * 512);
+	data = malloc(16 * 512);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(image);
+	ut_assertnonnull(data);
+	for (i = 0; i < size; i++)
+		image[i] = i * 3;
+	memset(image + size, '\0', 16 * 512 - size);
+	fastboot_init(buf, 2048);
+
+	strcpy(cmd, "getvar:stream-flash");
+	ut_asserteq(FASTBOOT_COMMAND_GETVAR,
+		    fastboot_handle_command(cmd, response));
+	ut_asserteq_str("OKAYyes", response);
+
+	/* too large for the buffer */
+	strcpy(cmd, "download:00000c64");
+	fastboot_handle_command(cmd, response);
+	ut_asserteq_str("FAIL00000c64", response);
+
+	strcpy(cmd, "oem stream:test1");
+	ut_asserteq(FASTBOOT_COMMAND_OEM_STREAM,
+		    fastboot_handle_command(cmd, response));
+	ut_asserteq_str("OKAY", response);
+
+	strcpy(cmd, "download:00000c64");
+	fastboot_handle_command(cmd, response);
+	ut_asserteq_str("DATA00000c64", response);
+	for (pos = 0; pos < size; pos += 1000) {
+		fastboot_data_download(image + pos, min(1000, size - pos),
+				       response);
+		ut_asserteq_str("", response);
+	}
+	ut_asserteq(0, fastboot_data_remaining());
+	fastboot_data_complete(response);
+	ut_asserteq_str("OKAY", response);
+
+	/* the image is already written, so flash just reports the result */
+	strcpy(cmd, "flash:test2");
+	fastboot_handle_command(cmd, response);
+	ut_asserteq_str("FAILimage was streamed to another partition",
+			response);
+	strcpy(cmd, "flash:test1");
+	ut_asserteq(FASTBOOT_COMMAND_FLASH,
+		    fastboot_handle_command(cmd, response));
+	ut_asserteq_str("OKAY", response);
+
+	ut_asserteq(7, blk_dread(mmc_dev_desc, 48, 7, data));
+	ut_asserteq_mem(image, data, 7 * 512);
+
+	/* only one download is streamed */
+	strcpy(cmd, "download:00000c64");
+	fastboot_handle_command(cmd, response);
+	ut_asserteq_str("FAIL00000c64", response);
+
+	/* an abandoned download is not finished off, but reported */
+	strcpy(cmd, "oem stream:test1");
+	fastboot_handle_command(cmd, response);
+	ut_asserteq_str("OKAY", response);
+	strcpy(cmd, "download:00000c64");
+	fastboot_handle_command(cmd, response);
+	ut_asserteq_str("DATA00000c64", response);
+	memset(image, 0xa5, size);
+	fastboot_data_download(image, 1000, response);
+	ut_asserteq_str("", response);
+	strcpy(cmd, "download:00000c64");
+	fastboot_handle_command(cmd, response);
+	ut_asserteq_str("FAILearlier streamed image incomplete", response);
+	ut_asserteq(7, blk_dread(mmc_dev_desc, 48, 7, data));
+	ut_asserteq((u8)(999 * 3), data[999]);
+
+	/* streaming is off again */
+	strcpy(cmd, "download:00000c64");
+	fastboot_handle_command(cmd, response);
+	ut_asserteq_str("FAIL00000c64", response);
+
+	/* turn streaming off without using it */
+	strcpy(cmd, "oem stream:test1");
+	fastboot_handle_command(cmd, response);
+	ut_asserteq_str("OKAY", response);
+	strcpy(cmd, "oem stream:");
+	fastboot_handle_command(cmd, response);
+	ut_asserteq_str("OKAY", response);
+	strcpy(cmd, "download:00000c64");
+	fastboot_handle_command(cmd, response);
+	ut_asserteq_str("FAIL00000c64", response);
+
+	fastboot_init(NULL, 0);
+	free(data);
+	free(image);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_fastboot_stream, UTF_SCAN_PDATA | UTF_SCAN_FDT);
@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the filesystem mount cache
+ */
+
+#include <blk.h>
+#include <dm.h>
+#include <fat.h>
+#include <fs.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <part.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define FS_TEST_SECTORS	16
+#define FS_TEST_FILE_SECTORS	4
+
+/**
+ * make_fat() - Create a FAT32 filesystem holding DATA.BIN
+ *
+ * This uses one sector per cluster and a single one-sector FAT, so cluster n
+ * is at sector n. The root directory is cluster 2.
+ *
+ * @img: Buffer of FS_TEST_SECTORS sectors to fill in
+ * @chain: Clusters of the file, in order
+ * @fill: Value to fill the file with
+ */
+static void make_fat(u8 *img, const u32 *chain, u8 fill)
+{
+	struct boot_sector *bs = (void *)img;
+	struct volume_info *vi = (void *)(bs + 1);
+	__le32 *fat = (void *)(img + 512);
+	struct dir_entry *dirent = (void *)(img + 2 * 512);
+	int i;
+
+	memset(img, '\0', 2 * 512 + sizeof(*dirent));
+	bs->sector_size[1] = 512 >> 8;
+	bs->cluster_size = 1;
+	bs->reserved = cpu_to_le16(1);
+	bs->fats = 1;
+	bs->media = 0xf8;
+	bs->total_sect = cpu_to_le32(FS_TEST_SECTORS);
+	bs->fat32_length = cpu_to_le32(1);
+	bs->root_cluster = cpu_to_le32(2);
+	vi->ext_boot_sign = 0x29;
+	memcpy(vi->fs_type, "FAT32   ", sizeof(vi->fs_type));
+	memcpy(img + 0x1fe, "\x55\xAA", 2);
+
+	fat[0] = cpu_to_le32(0x0ffffff8);
+	fat[1] = cpu_to_le32(0x0fffffff);
+	fat[2] = cpu_to_le32(0x0ffffff8);
+	for (i = 0; i < FS_TEST_FILE_SECTORS; i++) {
+		fat[chain[i]] = cpu_to_le32(i == FS_TEST_FILE_SECTORS - 1 ?
+					    0x0ffffff8 : chain[i + 1]);
+		memset(img + chain[i] * 512, fill, 512);
+	}
+
+	memcpy(dirent->nameext.name, "DATA    ", 8);
+	memcpy(dirent->nameext.ext, "BIN", 3);
+	dirent->start = cpu_to_le16(chain[0]);
+	dirent->size = cpu_to_le32(FS_TEST_FILE_SECTORS * 512);
+}
+
+/* Read DATA.BIN and check that it is filled with @fill */
+static int check_file(struct unit_test_state *uts, struct blk_desc *desc,
+		      u8 *buf, u8 fill)
+{
+	loff_t actread;
+	int i;
+
+	memset(buf, '\0', FS_TEST_FILE_SECTORS * 512);
+	ut_assertok(fs_set_blk_dev_with_part(desc, 0));
+	ut_assertok(fs_read("/data.bin", map_to_sysmem(buf), 0, 0, &actread));
+	ut_asserteq(FS_TEST_FILE_SECTORS * 512, actread);
+	for (i = 0; i < actread; i++)
+		ut_asserteq(fill, buf[i]);
+
+	return 0;
+}
+
+/* Test that a cached filesystem is mounted again after a raw write */
+static int dm_test_fs_cache_remount(struct unit_test_state *uts)
+{
+	static const u32 contig[] = { 3, 4, 5, 6 };
+	static const u32 frag[] = { 3, 8, 9, 10 };
+	struct blk_desc *desc;
+	u8 *img, *buf;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	ut_asserteq(512, desc->blksz);
+	img = calloc(FS_TEST_SECTORS, 512);
+	buf = malloc(FS_TEST_FILE_SECTORS * 512);
+	ut_assertnonnull(img);
+	ut_assertnonnull(buf);
+	fs_cache_flush();
+
+	make_fat(img, contig, 0xa5);
+	ut_asserteq(FS_TEST_SECTORS, blk_dwrite(desc, 0, FS_TEST_SECTORS, img));
+	ut_assertok(check_file(uts, desc, buf, 0xa5));
+	ut_assertok(check_file(uts, desc, buf, 0xa5));
+	ut_assertok(run_command("fs cache", 0));
+	ut_assert_nextline("Device       Part  Type         Mounted  Hits  Probe us");
+	ut_assert_nextlinen("mmc        0     0  fat          yes         1");
+	ut_assert_console_end();
+
+	/*
+	 * Move the file with a raw write, leaving its old clusters as they
+	 * were, so that stale cluster runs would read the old data
+	 */
+	make_fat(img, frag, 0x5a);
+	ut_asserteq(4, blk_dwrite(desc, 0, 4, img));
+	ut_asserteq(3, blk_dwrite(desc, 8, 3, img + 8 * 512));
+	ut_assertok(run_command("fs cache", 0));
+	ut_assert_nextline("Device       Part  Type         Mounted  Hits  Probe us");
+	ut_assert_nextlinen("mmc        0     0  fat          stale       1");
+	ut_assert_console_end();
+
+	ut_assertok(check_file(uts, desc, buf, 0x5a));
+	ut_assertok(run_command("fs cache", 0));
+	ut_assert_nextline("Device       Part  Type         Mounted  Hits  Probe us");
+	ut_assert_nextlinen("mmc        0     0  fat          yes         0");
+	ut_assert_console_end();
+
+	fs_cache_flush();
+	free(buf);
+	free(img);
+
+	return 0;
+}
+DM_TEST(dm_test_fs_cache_remount, UTF_SCAN_PDATA | UTF_SCAN_FDT | UTF_CONSOLE);
+
+/* Test that the FAT boot sector and FAT window are kept between commands */
+static int dm_test_fs_cache_fat(struct unit_test_state *uts)
+{
+	static const u32 frag[] = { 3, 8, 9, 10 };
+	const struct blk_ops *ops;
+	struct blk_desc *desc;
+	u8 *img, *buf;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	img = calloc(FS_TEST_SECTORS, 512);
+	buf = malloc(FS_TEST_FILE_SECTORS * 512);
+	ut_assertnonnull(img);
+	ut_assertnonnull(buf);
+	fs_cache_flush();
+
+	make_fat(img, frag, 0xa5);
+	ut_asserteq(FS_TEST_SECTORS, blk_dwrite(desc, 0, FS_TEST_SECTORS, img));
+	ut_assertok(check_file(uts, desc, buf, 0xa5));
+
+	/*
+	 * Clear the boot sector and the FAT behind the filesystem's back, with
+	 * the driver's write method and an empty block cache. The file can
+	 * still be read, since neither is read again.
+	 */
+	ops = desc->bdev->driver->ops;
+	memset(img, '\0', 2 * 512);
+	ut_asserteq(2, ops->write(desc->bdev, 0, 2, img));
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	ut_assertok(check_file(uts, desc, buf, 0xa5));
+	ut_assertok(check_file(uts, desc, buf, 0xa5));
+
+	/* Once the device is written, the filesystem is found to be gone */
+	ut_asserteq(1, blk_dwrite(desc, FS_TEST_SECTORS - 1, 1, img));
+	ut_assert(fs_set_blk_dev_with_part(desc, 0));
+
+	fs_cache_flush();
+	free(buf);
+	free(img);
+
+	return 0;
+}
+DM_TEST(dm_test_fs_cache_fat, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Read part of DATA.BIN, where each byte holds 0x10 + its cluster index */
+static int check_range(struct unit_test_state *uts, struct blk_desc *desc,
+		       u8 *buf, loff_t pos, loff_t len)
+{
+	loff_t actread;
+	int i;
+
+	memset(buf, '\0', len);
+	ut_assertok(fs_set_blk_dev_with_part(desc, 0));
+	ut_assertok(fs_read("/data.bin", map_to_sysmem(buf), pos, len,
+			    &actread));
+	ut_asserteq(len, actread);
+	for (i = 0; i < len; i++)
+		ut_asserteq(0x10 + (pos + i) / 512, buf[i]);
+
+	return 0;
+}
+
+/* Test reading a fragmented file across the runs of consecutive clusters */
+static int dm_test_fs_cache_fat_runs(struct unit_test_state *uts)
+{
+	/* Three runs: 3, then 7-8, then 5 */
+	static const u32 frag[] = { 3, 7, 8, 5 };
+	struct blk_desc *desc;
+	u8 *img, *buf;
+	int i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	img = calloc(FS_TEST_SECTORS, 512);
+	buf = malloc(FS_TEST_FILE_SECTORS * 512 + 1);
+	ut_assertnonnull(img);
+	ut_assertnonnull(buf);
+	fs_cache_flush();
+
+	make_fat(img, frag, 0);
+	for (i = 0; i < FS_TEST_FILE_SECTORS; i++)
+		memset(img + frag[i] * 512, 0x10 + i, 512);
+	ut_asserteq(FS_TEST_SECTORS, blk_dwrite(desc, 0, FS_TEST_SECTORS, img));
+
+	/* The whole file, then parts which span the ends of runs */
+	ut_assertok(check_range(uts, desc, buf, 0, FS_TEST_FILE_SECTORS * 512));
+	ut_assertok(check_range(uts, desc, buf, 256, 1024));
+	ut_assertok(check_range(uts, desc, buf, 1124, 900));
+	ut_assertok(check_range(uts, desc, buf, 512, 1024));
+	ut_assertok(check_range(uts, desc, buf, 1536, 512));
+
+	/* Start again from the first cluster, into a misaligned buffer */
+	ut_assertok(check_range(uts, desc, buf + 1, 100, 1900));
+
+	fs_cache_flush();
+	free(buf);
+	free(img);
+
+	return 0;
+}
+DM_TEST(dm_test_fs_cache_fat_runs, UTF_SCAN_PDATA | UTF_SCAN_FDT);
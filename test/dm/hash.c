@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the hash uclass and hash offload
+ */
+
+#include <dm.h>
+#include <hash.h>
+#include <asm/test.h>
+#include <dm/device-internal.h>
+#include <dm/lists.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/hash.h>
+#include <u-boot/md5.h>
+#include <u-boot/sha256.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Test the hash uclass operations, including submit / poll */
+static int dm_test_hash_base(struct unit_test_state *uts)
+{
+	u8 expect[SHA256_SUM_LEN], out[SHA256_SUM_LEN];
+	struct udevice *dev;
+	u8 data[4096];
+	void *ctx;
+	int ret, i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 3;
+	sha256_csum_wd(data, sizeof(data), expect, CHUNKSZ_SHA256);
+
+	ut_assertok(device_bind_driver(gd->dm_root, "sandbox_hash", "hash",
+				       &dev));
+	ut_assertok(device_probe(dev));
+	ut_assert(hash_supports(dev, HASH_ALGO_SHA256));
+	ut_assert(!hash_supports(dev, HASH_ALGO_MD5));	/* not progressive */
+	ut_assert(!hash_supports(dev, HASH_ALGO_INVALID));
+
+	ut_assertok(hash_digest(dev, HASH_ALGO_SHA256, data, sizeof(data),
+				out));
+	ut_asserteq_mem(expect, out, sizeof(expect));
+	ut_asserteq(sizeof(data), sandbox_hash_get_bytes(dev));
+
+	/* At 1MB/s this takes 4ms, so the first poll must see it busy */
+	sandbox_hash_set_rate(dev, 1);
+	ut_assertok(hash_init(dev, HASH_ALGO_SHA256, &ctx));
+	ut_assertok(hash_submit(dev, ctx, data, sizeof(data) / 2));
+	ut_asserteq(-EBUSY, hash_poll(dev, ctx));
+	ut_asserteq(-EBUSY, hash_submit(dev, ctx, data, sizeof(data)));
+	do {
+		ret = hash_poll(dev, ctx);
+	} while (ret == -EBUSY);
+	ut_assertok(ret);
+
+	/* hash_update() waits for the data to be hashed */
+	ut_assertok(hash_update(dev, ctx, data + sizeof(data) / 2,
+				sizeof(data) / 2));
+	ut_assertok(hash_finish(dev, ctx, out));
+	ut_asserteq_mem(expect, out, sizeof(expect));
+	ut_asserteq(sizeof(data) * 2, sandbox_hash_get_bytes(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_hash_base, 0);
+
+/* Test that the hash API prefers a hash device when there is one */
+static int dm_test_hash_offload(struct unit_test_state *uts)
+{
+	u8 expect[SHA256_SUM_LEN], out[SHA256_SUM_LEN];
+	struct hash_algo *algo, *sw;
+	struct udevice *dev;
+	ulong mem_start;
+	u8 data[4096];
+	void *ctx;
+	int ret, i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 5;
+	sha256_csum_wd(data, sizeof(data), expect, CHUNKSZ_SHA256);
+
+	/* With no hash device, software is used */
+	ut_assertok(hash_lookup_algo("sha256", &sw));
+	ut_asserteq_ptr(sha256_csum_wd, sw->hash_func_ws);
+
+	/* The node is disabled, so that other tests do not use the device */
+	ut_assertok(device_bind_driver_to_node(gd->dm_root, "sandbox_hash",
+					       "hash", ofnode_path("/hash"),
+					       &dev));
+	ut_assert(!device_active(dev));
+	ut_assertok(hash_lookup_algo("sha256", &algo));
+	ut_assert(device_active(dev));
+	ut_assert(algo != sw);
+	ut_asserteq_str("sha256", algo->name);
+
+	ut_assertok(hash_block("sha256", data, sizeof(data), out, NULL));
+	ut_asserteq_mem(expect, out, sizeof(expect));
+	ut_asserteq(sizeof(data), sandbox_hash_get_bytes(dev));
+
+	/* A failed update leaves the context for hash_finish() to release */
+	ut_assertok(hash_progressive_lookup_algo("sha256", &algo));
+	mem_start = ut_check_delta(0);
+	ut_assertok(algo->hash_init(algo, &ctx));
+	ut_assertok(algo->hash_update(algo, ctx, data, sizeof(data), 0));
+	ut_asserteq(-ENOSPC, algo->hash_finish(algo, ctx, out, 1));
+	ut_asserteq(0, ut_check_delta(mem_start));
+
+	/* Overlap hashing with other work using submit / poll */
+	sandbox_hash_set_rate(dev, 1);
+	ut_assertok(hash_progressive_lookup_algo("sha256", &algo));
+	ut_assertok(algo->hash_init(algo, &ctx));
+	ut_assertok(hash_progressive_submit(algo, ctx, data, sizeof(data)));
+	ut_asserteq(-EBUSY, hash_progressive_poll(algo, ctx));
+	do {
+		ret = hash_progressive_poll(algo, ctx);
+	} while (ret == -EBUSY);
+	ut_assertok(ret);
+	ut_assertok(algo->hash_finish(algo, ctx, out, sizeof(out)));
+	ut_asserteq_mem(expect, out, sizeof(expect));
+	ut_asserteq(sizeof(data) * 3, sandbox_hash_get_bytes(dev));
+
+	/* The device does not support md5, so software is used */
+	ut_assertok(hash_lookup_algo("md5", &algo));
+	ut_asserteq_ptr(md5_wd, algo->hash_func_ws);
+
+	/* If the device goes away, the software algorithm is used */
+	ut_assertok(hash_lookup_algo("sha256", &algo));
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(dev));
+	memset(out, '\0', sizeof(out));
+	algo->hash_func_ws(data, sizeof(data), out, algo->chunk_size);
+	ut_asserteq_mem(expect, out, sizeof(expect));
+	ut_assertok(hash_lookup_algo("sha256", &algo));
+	ut_asserteq_ptr(sw, algo);
+
+	return 0;
+}
+DM_TEST(dm_test_hash_offload, 0);
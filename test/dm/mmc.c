@@ -3,12 +3,28 @@
  * Copyright (C) 2015 Google, Inc
  */
 
+#include <blk.h>
+#include <bloblist.h>
 #include <dm.h>
+#include <malloc.h>
 #include <mmc.h>
 #include <part.h>
+#include <asm/global_data.h>
+#include <asm/test.h>
+#include <dm/device-internal.h>
+#include <dm/lists.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
+#include "../../drivers/mmc/mmc_private.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Size of the test data for the eMMC tests, in blocks */
+#define TEST_BLOCKS	400
+
+/* Largest transfer the sandbox eMMC host accepts, in blocks */
+#define TEST_B_MAX	64
 
 /*
  * Basic test of the mmc uclass. We could expand this by implementing an MMC
@@ -51,3 +67,322 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test fully initialising pre-init devices, each in its own thread */
+static int dm_test_mmc_preinit(struct unit_test_state *uts)
+{
+	static const int seqs[] = {0, 2};
+	struct mmc *mmc[ARRAY_SIZE(seqs)];
+	struct udevice *dev;
+	int i;
+
+	if (!CONFIG_IS_ENABLED(MMC_UTHREAD))
+		return -EAGAIN;
+
+	for (i = 0; i < ARRAY_SIZE(seqs); i++) {
+		ut_assertok(uclass_get_device_by_seq(UCLASS_MMC, seqs[i], &dev));
+		mmc[i] = mmc_get_mmc_dev(dev);
+		ut_assertnonnull(mmc[i]);
+		mmc[i]->has_init = 0;
+		mmc_set_preinit(mmc[i], 1);
+	}
+
+	mmc_do_preinit();
+	for (i = 0; i < ARRAY_SIZE(seqs); i++) {
+		ut_asserteq(1, mmc[i]->has_init);
+		ut_asserteq(0, mmc[i]->init_in_progress);
+		mmc_set_preinit(mmc[i], 0);
+	}
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_preinit, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/**
+ * setup_emmc() - Bind and probe a sandbox eMMC and fill it with test data
+ *
+ * @uts: Test state
+ * @name: Name of the device-tree node for the eMMC
+ * @devp: Returns the MMC device
+ * @descp: Returns the block-device descriptor
+ * @datap: Returns the test data, which must be freed by the caller
+ * Return: 0 if OK, non-zero on error
+ */
+static int setup_emmc(struct unit_test_state *uts, const char *name,
+		      struct udevice **devp, struct blk_desc **descp,
+		      char **datap)
+{
+	struct udevice *dev, *blk;
+	char *data;
+	ofnode node;
+	int i;
+
+	node = ofnode_find_subnode(oftree_root(oftree_default()), name);
+	ut_assert(ofnode_valid(node));
+	ut_assertok(lists_bind_fdt(gd->dm_root, node, &dev, NULL, false));
+	ut_assertok(device_probe(dev));
+	ut_assertok(blk_get_from_parent(dev, &blk));
+	ut_assertok(device_probe(blk));
+	*descp = dev_get_uclass_plat(blk);
+	*devp = dev;
+
+	data = malloc(TEST_BLOCKS * 512);
+	ut_assertnonnull(data);
+	for (i = 0; i < TEST_BLOCKS * 512; i++)
+		data[i] = i * 7 + i / 512;
+	ut_asserteq(TEST_BLOCKS, blk_dwrite(*descp, 0, TEST_BLOCKS, data));
+	*datap = data;
+
+	return 0;
+}
+
+static void mmc_test_req(struct blk_req *req, enum blk_req_op op,
+			 lbaint_t start, lbaint_t blkcnt, void *buffer)
+{
+	memset(req, '\0', sizeof(*req));
+	req->op = op;
+	req->start = start;
+	req->blkcnt = blkcnt;
+	req->buffer = buffer;
+}
+
+/* Test asynchronous requests with an MMC which cannot queue or pack them */
+static int dm_test_mmc_async_sync(struct unit_test_state *uts)
+{
+	char write[4 * 512], read[4 * 512];
+	struct blk_desc *desc;
+	struct blk_req req;
+	int i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i * 5;
+
+	/* Each request is carried out before blk_submit() returns */
+	mmc_test_req(&req, BLK_REQ_WRITE, 0, 4, write);
+	ut_assertok(blk_submit(desc->bdev, &req));
+	ut_assert(req.complete);
+	ut_asserteq(4, req.result);
+
+	mmc_test_req(&req, BLK_REQ_READ, 0, 4, read);
+	ut_assertok(blk_submit(desc->bdev, &req));
+	ut_assert(req.complete);
+	ut_asserteq(4, blk_wait(desc->bdev, &req));
+	ut_asserteq_mem(write, read, sizeof(write));
+	ut_asserteq(0, blk_poll(desc->bdev));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_async_sync, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test reading an eMMC using command queueing */
+static int dm_test_mmc_cqe(struct unit_test_state *uts)
+{
+	int tasks, max_tasks, packed;
+	struct blk_desc *desc;
+	char *data, *buf;
+	struct udevice *dev;
+	struct mmc *mmc;
+
+	if (!CONFIG_IS_ENABLED(MMC_CQE))
+		return -EAGAIN;
+
+	ut_assertok(setup_emmc(uts, "mmc8", &dev, &desc, &data));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_asserteq(16, mmc->cqe_depth);
+	ut_assert(!mmc->cqe_on);
+	buf = malloc(TEST_BLOCKS * 512);
+	ut_assertnonnull(buf);
+
+	/* A read which is too large for one command is split into tasks */
+	ut_asserteq(4 * TEST_B_MAX, blk_dread(desc, 0, 4 * TEST_B_MAX, buf));
+	ut_asserteq_mem(data, buf, 4 * TEST_B_MAX * 512);
+	sandbox_mmc_get_queue_stats(dev, &tasks, &max_tasks, &packed);
+	ut_asserteq(4, tasks);
+	ut_asserteq(4, max_tasks);
+	ut_assert(mmc->cqe_on);
+
+	/* While the queue is on, smaller reads use it too */
+	ut_asserteq(TEST_B_MAX, blk_dread(desc, 300, TEST_B_MAX, buf));
+	ut_asserteq_mem(data + 300 * 512, buf, TEST_B_MAX * 512);
+	sandbox_mmc_get_queue_stats(dev, &tasks, &max_tasks, &packed);
+	ut_asserteq(5, tasks);
+
+	/* A write leaves queueing mode, since the card does not allow both */
+	memset(data + 10 * 512, 0x5a, 512);
+	ut_asserteq(1, blk_dwrite(desc, 10, 1, data + 10 * 512));
+	ut_assert(!mmc->cqe_on);
+
+	ut_asserteq(TEST_BLOCKS, blk_dread(desc, 0, TEST_BLOCKS, buf));
+	ut_asserteq_mem(data, buf, TEST_BLOCKS * 512);
+	ut_assert(mmc->cqe_on);
+	sandbox_mmc_get_queue_stats(dev, &tasks, &max_tasks, &packed);
+	ut_asserteq(12, tasks);
+	ut_asserteq(7, max_tasks);
+	ut_asserteq(0, packed);
+
+	free(buf);
+	free(data);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_cqe, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test asynchronous reads and writes with command queueing */
+static int dm_test_mmc_cqe_async(struct unit_test_state *uts)
+{
+	int tasks, max_tasks, packed, i;
+	struct blk_req req[6];
+	struct blk_desc *desc;
+	char *data, *buf;
+	struct udevice *dev;
+
+	if (!CONFIG_IS_ENABLED(MMC_CQE))
+		return -EAGAIN;
+
+	ut_assertok(setup_emmc(uts, "mmc8", &dev, &desc, &data));
+	buf = calloc(TEST_BLOCKS, 512);
+	ut_assertnonnull(buf);
+
+	/* Four reads, then a write and a read of the blocks just written */
+	for (i = 0; i < 4; i++)
+		mmc_test_req(&req[i], BLK_REQ_READ, i * 100, 48,
+			     buf + i * 100 * 512);
+	memset(data + 48 * 512, 0xa5, 2 * 512);
+	mmc_test_req(&req[4], BLK_REQ_WRITE, 48, 2, data + 48 * 512);
+	mmc_test_req(&req[5], BLK_REQ_READ, 48, 2, buf + 48 * 512);
+	for (i = 0; i < ARRAY_SIZE(req); i++)
+		ut_assertok(blk_submit(desc->bdev, &req[i]));
+	ut_assert(!req[0].complete);
+
+	/* The reads are queued together; the write waits for them */
+	ut_asserteq(2, blk_wait(desc->bdev, &req[5]));
+	for (i = 0; i < ARRAY_SIZE(req); i++) {
+		ut_assert(req[i].complete);
+		ut_asserteq(req[i].blkcnt, req[i].result);
+	}
+	for (i = 0; i < 4; i++)
+		ut_asserteq_mem(data + i * 100 * 512, buf + i * 100 * 512,
+				48 * 512);
+	ut_asserteq_mem(data + 48 * 512, buf + 48 * 512, 2 * 512);
+
+	sandbox_mmc_get_queue_stats(dev, &tasks, &max_tasks, &packed);
+	ut_asserteq(5, tasks);
+	ut_asserteq(4, max_tasks);
+	ut_asserteq(0, blk_poll(desc->bdev));
+
+	free(buf);
+	free(data);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_cqe_async, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test combining asynchronous reads into a packed command */
+static int dm_test_mmc_packed(struct unit_test_state *uts)
+{
+	int tasks, max_tasks, packed, i;
+	struct blk_req req[4];
+	struct blk_desc *desc;
+	char *data, *buf;
+	struct udevice *dev;
+
+	if (!CONFIG_IS_ENABLED(MMC_PACKED))
+		return -EAGAIN;
+
+	ut_assertok(setup_emmc(uts, "mmc9", &dev, &desc, &data));
+	ut_asserteq(8, mmc_get_mmc_dev(dev)->max_packed_reads);
+	buf = calloc(TEST_BLOCKS, 512);
+	ut_assertnonnull(buf);
+
+	for (i = 0; i < ARRAY_SIZE(req); i++) {
+		mmc_test_req(&req[i], BLK_REQ_READ, 350 - i * 100, 8 + i,
+			     buf + i * 100 * 512);
+		ut_assertok(blk_submit(desc->bdev, &req[i]));
+	}
+	ut_asserteq(11, blk_wait(desc->bdev, &req[3]));
+	for (i = 0; i < ARRAY_SIZE(req); i++) {
+		ut_asserteq(8 + i, req[i].result);
+		ut_asserteq_mem(data + (350 - i * 100) * 512,
+				buf + i * 100 * 512, (8 + i) * 512);
+	}
+
+	sandbox_mmc_get_queue_stats(dev, &tasks, &max_tasks, &packed);
+	ut_asserteq(1, packed);
+	ut_asserteq(0, tasks);
+
+	free(buf);
+	free(data);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_packed, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test remembering an eMMC's set-up in the bloblist */
+static int dm_test_mmc_cache(struct unit_test_state *uts)
+{
+	struct mmc_cache_entry *ent = NULL;
+	struct blk_desc *desc;
+	struct mmc_cache *cache;
+	int i, start, full, fast;
+	struct udevice *dev;
+	struct mmc *mmc;
+	char *data;
+
+	if (!CONFIG_IS_ENABLED(MMC_CACHE))
+		return -EAGAIN;
+
+	/* Start with an empty bloblist */
+	ut_assertok(bloblist_new(CONFIG_BLOBLIST_ADDR, 0x400, 0, 0));
+
+	ut_assertok(setup_emmc(uts, "mmc9", &dev, &desc, &data));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_assert(!mmc->cache_hit);
+
+	cache = bloblist_find(BLOBLISTT_U_BOOT_MMC_CACHE, sizeof(*cache));
+	ut_assertnonnull(cache);
+	for (i = 0; i < MMC_CACHE_ENTRIES; i++) {
+		if (cache->entry[i].flags & MMC_CACHE_VALID)
+			ent = &cache->entry[i];
+	}
+	ut_assertnonnull(ent);
+	ut_asserteq(dev_seq(dev), ent->seq);
+	ut_asserteq(mmc->selected_mode, ent->mode);
+	ut_asserteq(mmc->bus_width, ent->bus_width);
+	ut_asserteq(mmc->ocr, ent->ocr);
+	ut_asserteq_mem(mmc->cid, ent->cid, sizeof(ent->cid));
+
+	/* A different card must be set up from scratch, then recorded */
+	ent->cid[0] ^= 1;
+	mmc->has_init = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_assert(!mmc->cache_hit);
+	ut_asserteq_mem(mmc->cid, ent->cid, sizeof(ent->cid));
+
+	/* Time a full set-up with nothing recorded... */
+	ent->flags = 0;
+	mmc->has_init = 0;
+	start = sandbox_mmc_get_cmd_count(dev);
+	ut_assertok(mmc_init(mmc));
+	full = sandbox_mmc_get_cmd_count(dev) - start;
+	ut_assert(!mmc->cache_hit);
+	ut_assert(ent->flags & MMC_CACHE_VALID);
+
+	/* ...against one which uses the record */
+	mmc->has_init = 0;
+	start = sandbox_mmc_get_cmd_count(dev);
+	ut_assertok(mmc_init(mmc));
+	fast = sandbox_mmc_get_cmd_count(dev) - start;
+	ut_assert(mmc->cache_hit);
+	ut_assert(fast < full);
+
+	/* The card still works */
+	memset(data, '\0', 512);
+	ut_asserteq(1, blk_dread(desc, 1, 1, data));
+	for (i = 0; i < 512; i++)
+		ut_asserteq((char)((512 + i) * 7 + 1), data[i]);
+	free(data);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_cache, UTF_SCAN_PDATA | UTF_SCAN_FDT | UFT_BLOBLIST);
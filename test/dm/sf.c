@@ -4,6 +4,7 @@
  */
 
 #include <command.h>
+#include <console.h>
 #include <dm.h>
 #include <fdtdec.h>
 #include <mapmem.h>
@@ -101,3 +102,31 @@ static int dm_test_spi_flash_func(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_spi_flash_func, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Check that sf bench reads the flash and reports the read mode */
+static int dm_test_spi_flash_bench(struct unit_test_state *uts)
+{
+	ut_assertok(run_command("host save hostfs - 0 spi.bin 200000", 0));
+	ut_assertok(run_command("sf probe", 0));
+	ut_assert_skip_to_linen("SF: Detected m25p16 with page size 256 Bytes");
+	ut_assertok(run_command("sf bench 0 10000", 0));
+	console_record_readline(uts->actual_str, sizeof(uts->actual_str));
+	ut_asserteq_ptr(uts->actual_str,
+			strstr(uts->actual_str,
+			       "SF: read 1-1-1, opcode 0x03: 65536 bytes in "));
+	ut_assert(strstr(uts->actual_str, " MB/s"));
+	ut_assert_console_end();
+
+	ut_asserteq(1, run_command("sf bench 1f0000 20000", 0));
+	ut_assert_nextline("ERROR: attempting bench past flash size (0x200000)");
+	ut_assert_console_end();
+
+	/*
+	 * Since we are about to destroy all devices, we must tell sandbox
+	 * to forget the emulation device
+	 */
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_bench, UTF_SCAN_PDATA | UTF_SCAN_FDT | UTF_CONSOLE);
@@ -0,0 +1,633 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the SquashFS filesystem
+ */
+
+#include <blk.h>
+#include <dm.h>
+#include <fs.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <part.h>
+#include <squashfs.h>
+#include <dm/test.h>
+#include <linux/sizes.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/zlib.h>
+#include <asm/unaligned.h>
+
+#define SQFS_TEST_BLOCK_SIZE	4096
+#define SQFS_TEST_BLOCK_LOG	12
+#define SQFS_TEST_META_SIZE	8192
+#define SQFS_TEST_SBLK_SIZE	96
+#define SQFS_TEST_MAX_NODES	420
+#define SQFS_TEST_MAX_FRAGS	8
+#define SQFS_TEST_MTIME		0x60000000
+
+#define SQFS_TEST_FRAG_FILES	5
+#define SQFS_TEST_FRAG_SIZE	3000
+#define SQFS_TEST_BIG_SIZE	10000
+#define SQFS_TEST_DIR_FILES	400
+
+/**
+ * struct sqfs_test_node - a file or directory in the test image
+ *
+ * @name: Name within its directory
+ * @parent: Index of the parent directory, or -1 for the root
+ * @dir: true for a directory
+ * @text: Contents of a text file, or NULL for a file filled by
+ *	sqfs_test_byte()
+ * @size: Size of a file in bytes
+ * @ino: Inode number
+ * @iref: Inode reference: metadata block start << 16 | offset
+ * @start: Byte offset of the file's first data block
+ * @nblocks: Number of full data blocks
+ * @blk_sizes: Size of each data block on disk, with bit 24 set if it is
+ *	not compressed
+ * @frag: Fragment holding the file's tail, or -1 if none
+ * @frag_off: Offset of the tail within the fragment
+ */
+struct sqfs_test_node {
+	char name[32];
+	int parent;
+	bool dir;
+	const char *text;
+	uint size;
+	uint ino;
+	u32 iref;
+	u32 start;
+	int nblocks;
+	u32 blk_sizes[3];
+	u32 frag;
+	u32 frag_off;
+};
+
+/**
+ * struct sqfs_test_gen - state while building the test image
+ *
+ * The data and fragment blocks are compressed with zlib. The metadata blocks
+ * are stored uncompressed, so that inode references are easy to work out.
+ */
+struct sqfs_test_gen {
+	struct sqfs_test_node nodes[SQFS_TEST_MAX_NODES];
+	int count;
+	uint next_ino;
+	u8 *img;
+	uint len;
+	u8 itab[SZ_32K];
+	uint ilen;
+	u8 dtab[SZ_32K];
+	uint dlen;
+	u8 frag_buf[SQFS_TEST_BLOCK_SIZE];
+	uint frag_len;
+	u64 frag_start[SQFS_TEST_MAX_FRAGS];
+	u32 frag_size[SQFS_TEST_MAX_FRAGS];
+	int nfrags;
+};
+
+/* Byte @i of the .bin file called @name in the test image */
+static u8 sqfs_test_byte(const char *name, uint i)
+{
+	uint seed = 0;
+
+	while (*name)
+		seed += *name++;
+
+	return i * (seed % 7 + 3) + seed + i / 251;
+}
+
+static u8 sqfs_test_content(struct sqfs_test_node *node, uint i)
+{
+	return node->text ? node->text[i] : sqfs_test_byte(node->name, i);
+}
+
+static int sqfs_test_add(struct sqfs_test_gen *gen, int parent,
+			 const char *name, bool dir, uint size,
+			 const char *text)
+{
+	struct sqfs_test_node *node = &gen->nodes[gen->count];
+
+	strlcpy(node->name, name, sizeof(node->name));
+	node->parent = parent;
+	node->dir = dir;
+	node->size = size;
+	node->text = text;
+
+	return gen->count++;
+}
+
+static void *sqfs_test_zalloc(void *opaque, uint items, uint size)
+{
+	return calloc(items, size);
+}
+
+static void sqfs_test_zfree(void *opaque, void *addr, uint size)
+{
+	free(addr);
+}
+
+/*
+ * Write @len bytes from @src to the image as a data or fragment block,
+ * compressed if that makes it smaller. Returns the size to record for it.
+ */
+static u32 sqfs_test_put_block(struct sqfs_test_gen *gen, u8 *src, uint len)
+{
+	u8 *dst = gen->img + gen->len;
+	z_stream s = {};
+
+	s.zalloc = sqfs_test_zalloc;
+	s.zfree = sqfs_test_zfree;
+	if (!deflateInit2_(&s, Z_BEST_COMPRESSION, Z_DEFLATED, MAX_WBITS, 8,
+			   Z_DEFAULT_STRATEGY, sizeof(s))) {
+		s.next_in = src;
+		s.avail_in = len;
+		s.next_out = dst;
+		s.avail_out = len - 1;
+		if (deflate(&s, Z_FINISH) == Z_STREAM_END) {
+			deflateEnd(&s);
+			gen->len += s.total_out;
+			return s.total_out;
+		}
+		deflateEnd(&s);
+	}
+	memcpy(dst, src, len);
+	gen->len += len;
+
+	return len | BIT(24);
+}
+
+static void sqfs_test_flush_frag(struct sqfs_test_gen *gen)
+{
+	if (!gen->frag_len)
+		return;
+	gen->frag_start[gen->nfrags] = gen->len;
+	gen->frag_size[gen->nfrags] = sqfs_test_put_block(gen, gen->frag_buf,
+							  gen->frag_len);
+	gen->nfrags++;
+	gen->frag_len = 0;
+}
+
+/* Number the inodes, with each directory after its contents */
+static void sqfs_test_number(struct sqfs_test_gen *gen, int idx)
+{
+	int i;
+
+	for (i = 0; i < gen->count; i++) {
+		if (gen->nodes[i].parent == idx)
+			sqfs_test_number(gen, i);
+	}
+	gen->nodes[idx].ino = ++gen->next_ino;
+}
+
+/* Write the data of each file, in inode order */
+static void sqfs_test_data(struct sqfs_test_gen *gen, int idx)
+{
+	struct sqfs_test_node *node = &gen->nodes[idx];
+	u8 block[SQFS_TEST_BLOCK_SIZE];
+	uint i, pos, tail;
+	int blk;
+
+	if (node->dir) {
+		for (i = 0; i < gen->count; i++) {
+			if (gen->nodes[i].parent == idx)
+				sqfs_test_data(gen, i);
+		}
+		return;
+	}
+
+	node->start = gen->len;
+	node->nblocks = node->size / SQFS_TEST_BLOCK_SIZE;
+	for (blk = 0, pos = 0; blk < node->nblocks; blk++) {
+		for (i = 0; i < SQFS_TEST_BLOCK_SIZE; i++)
+			block[i] = sqfs_test_content(node, pos++);
+		node->blk_sizes[blk] = sqfs_test_put_block(gen, block,
+							   sizeof(block));
+	}
+
+	tail = node->size - pos;
+	node->frag = -1;
+	if (!tail)
+		return;
+	if (gen->frag_len + tail > SQFS_TEST_BLOCK_SIZE)
+		sqfs_test_flush_frag(gen);
+	node->frag = gen->nfrags;
+	node->frag_off = gen->frag_len;
+	for (i = 0; i < tail; i++)
+		gen->frag_buf[gen->frag_len++] = sqfs_test_content(node, pos++);
+}
+
+/* Get the reference to the next byte of a metadata table */
+static u32 sqfs_test_ref(uint len)
+{
+	uint blk = len / SQFS_TEST_META_SIZE;
+
+	return blk * (SQFS_TEST_META_SIZE + 2) << 16 |
+	       len % SQFS_TEST_META_SIZE;
+}
+
+static void sqfs_test_put(u8 *buf, uint *lenp, const void *data, uint size)
+{
+	memcpy(buf + *lenp, data, size);
+	*lenp += size;
+}
+
+static void sqfs_test_put16(u8 *buf, uint *lenp, u16 val)
+{
+	put_unaligned_le16(val, buf + *lenp);
+	*lenp += 2;
+}
+
+static void sqfs_test_put32(u8 *buf, uint *lenp, u32 val)
+{
+	put_unaligned_le32(val, buf + *lenp);
+	*lenp += 4;
+}
+
+static void sqfs_test_put64(u8 *buf, uint *lenp, u64 val)
+{
+	put_unaligned_le64(val, buf + *lenp);
+	*lenp += 8;
+}
+
+/* Write the common part of an inode */
+static void sqfs_test_inode(struct sqfs_test_gen *gen,
+			    struct sqfs_test_node *node, u16 type, u16 mode)
+{
+	node->iref = sqfs_test_ref(gen->ilen);
+	sqfs_test_put16(gen->itab, &gen->ilen, type);
+	sqfs_test_put16(gen->itab, &gen->ilen, mode);
+	sqfs_test_put16(gen->itab, &gen->ilen, 0);
+	sqfs_test_put16(gen->itab, &gen->ilen, 0);
+	sqfs_test_put32(gen->itab, &gen->ilen, SQFS_TEST_MTIME);
+	sqfs_test_put32(gen->itab, &gen->ilen, node->ino);
+}
+
+/* Write the listing of a directory */
+static void sqfs_test_listing(struct sqfs_test_gen *gen, int idx)
+{
+	struct sqfs_test_node *node, *first = NULL;
+	uint hdr = 0, count = 0;
+	int i;
+
+	for (i = 0; i < gen->count; i++) {
+		node = &gen->nodes[i];
+		if (node->parent != idx)
+			continue;
+
+		/* Entries under a header share an inode block */
+		if (!count || count == 256 ||
+		    node->iref >> 16 != first->iref >> 16) {
+			if (count)
+				put_unaligned_le32(count - 1, gen->dtab + hdr);
+			first = node;
+			count = 0;
+			hdr = gen->dlen;
+			sqfs_test_put32(gen->dtab, &gen->dlen, 0);
+			sqfs_test_put32(gen->dtab, &gen->dlen,
+					first->iref >> 16);
+			sqfs_test_put32(gen->dtab, &gen->dlen, first->ino);
+		}
+		sqfs_test_put16(gen->dtab, &gen->dlen, node->iref & 0xffff);
+		sqfs_test_put16(gen->dtab, &gen->dlen, node->ino - first->ino);
+		sqfs_test_put16(gen->dtab, &gen->dlen, node->dir ? 1 : 2);
+		sqfs_test_put16(gen->dtab, &gen->dlen, strlen(node->name) - 1);
+		sqfs_test_put(gen->dtab, &gen->dlen, node->name,
+			      strlen(node->name));
+		count++;
+	}
+	if (count)
+		put_unaligned_le32(count - 1, gen->dtab + hdr);
+}
+
+/* Write the inodes and directory listings, in inode order */
+static void sqfs_test_meta(struct sqfs_test_gen *gen, int idx)
+{
+	struct sqfs_test_node *node = &gen->nodes[idx];
+	uint nlink = 2, parent, pos;
+	u32 listing;
+	int i;
+
+	if (!node->dir) {
+		sqfs_test_inode(gen, node, 2, 0644);
+		sqfs_test_put32(gen->itab, &gen->ilen, node->start);
+		sqfs_test_put32(gen->itab, &gen->ilen, node->frag);
+		sqfs_test_put32(gen->itab, &gen->ilen, node->frag_off);
+		sqfs_test_put32(gen->itab, &gen->ilen, node->size);
+		for (i = 0; i < node->nblocks; i++)
+			sqfs_test_put32(gen->itab, &gen->ilen,
+					node->blk_sizes[i]);
+		return;
+	}
+
+	for (i = 0; i < gen->count; i++) {
+		if (gen->nodes[i].parent == idx) {
+			sqfs_test_meta(gen, i);
+			nlink += gen->nodes[i].dir;
+		}
+	}
+	pos = gen->dlen;
+	listing = sqfs_test_ref(pos);
+	sqfs_test_listing(gen, idx);
+	parent = node->parent < 0 ? gen->count + 1 :
+		 gen->nodes[node->parent].ino;
+
+	sqfs_test_inode(gen, node, 1, 0755);
+	sqfs_test_put32(gen->itab, &gen->ilen, listing >> 16);
+	sqfs_test_put32(gen->itab, &gen->ilen, nlink);
+	/* The size includes the '.' and '..' entries, which are not stored */
+	sqfs_test_put16(gen->itab, &gen->ilen,
+			gen->dlen - pos + 3);
+	sqfs_test_put16(gen->itab, &gen->ilen, listing & 0xffff);
+	sqfs_test_put32(gen->itab, &gen->ilen, parent);
+}
+
+/* Write a metadata table to the image, as uncompressed blocks */
+static void sqfs_test_put_table(struct sqfs_test_gen *gen, u8 *buf, uint len)
+{
+	uint pos, size;
+
+	for (pos = 0; pos < len; pos += size) {
+		size = min(len - pos, (uint)SQFS_TEST_META_SIZE);
+		sqfs_test_put16(gen->img, &gen->len, size | BIT(15));
+		sqfs_test_put(gen->img, &gen->len, buf + pos, size);
+	}
+}
+
+/**
+ * sqfs_test_make_image() - build the test image
+ *
+ * The image holds:
+ *
+ * /big.bin	10000 bytes: two full blocks and a tail in a fragment
+ * /dir/	400 empty files entry-000-with-a-long-name to entry-399-...,
+ *		whose listing spans two metadata blocks
+ * /frag/	f0.bin to f4.bin, 3000 bytes each, each in its own fragment
+ * /small/	a.txt and b.txt, sharing the fragment of f4.bin
+ *
+ * @imgp: Returns the image, which the caller must free
+ * Return: size of the image in bytes, or 0 if out of memory
+ */
+static uint sqfs_test_make_image(u8 **imgp)
+{
+	uint frag_table, id_table, inode_table, dir_table, meta;
+	struct sqfs_test_gen *gen;
+	u8 buf[SQFS_TEST_MAX_FRAGS * 16];
+	uint len, root;
+	char name[32];
+	int i, parent;
+
+	gen = calloc(1, sizeof(*gen));
+	if (gen)
+		gen->img = calloc(1, SZ_64K);
+	if (!gen || !gen->img) {
+		free(gen);
+		return 0;
+	}
+
+	root = sqfs_test_add(gen, -1, "", true, 0, NULL);
+	sqfs_test_add(gen, root, "big.bin", false, SQFS_TEST_BIG_SIZE, NULL);
+	parent = sqfs_test_add(gen, root, "dir", true, 0, NULL);
+	for (i = 0; i < SQFS_TEST_DIR_FILES; i++) {
+		snprintf(name, sizeof(name), "entry-%03d-with-a-long-name", i);
+		sqfs_test_add(gen, parent, name, false, 0, NULL);
+	}
+	parent = sqfs_test_add(gen, root, "frag", true, 0, NULL);
+	for (i = 0; i < SQFS_TEST_FRAG_FILES; i++) {
+		snprintf(name, sizeof(name), "f%d.bin", i);
+		sqfs_test_add(gen, parent, name, false, SQFS_TEST_FRAG_SIZE,
+			      NULL);
+	}
+	parent = sqfs_test_add(gen, root, "small", true, 0, NULL);
+	sqfs_test_add(gen, parent, "a.txt", false, 13, "small file a\n");
+	sqfs_test_add(gen, parent, "b.txt", false, 13, "small file b\n");
+
+	sqfs_test_number(gen, root);
+	gen->len = SQFS_TEST_SBLK_SIZE;
+	sqfs_test_data(gen, root);
+	sqfs_test_flush_frag(gen);
+	sqfs_test_meta(gen, root);
+
+	inode_table = gen->len;
+	sqfs_test_put_table(gen, gen->itab, gen->ilen);
+	dir_table = gen->len;
+	sqfs_test_put_table(gen, gen->dtab, gen->dlen);
+
+	/* Fragment table, then the index of its metadata blocks */
+	for (i = 0, len = 0; i < gen->nfrags; i++) {
+		sqfs_test_put64(buf, &len, gen->frag_start[i]);
+		sqfs_test_put32(buf, &len, gen->frag_size[i]);
+		sqfs_test_put32(buf, &len, 0);
+	}
+	meta = gen->len;
+	sqfs_test_put_table(gen, buf, len);
+	frag_table = gen->len;
+	sqfs_test_put64(gen->img, &gen->len, meta);
+
+	/* A single user and group ID, 0 */
+	len = 0;
+	sqfs_test_put32(buf, &len, 0);
+	meta = gen->len;
+	sqfs_test_put_table(gen, buf, len);
+	id_table = gen->len;
+	sqfs_test_put64(gen->img, &gen->len, meta);
+
+	/* Superblock */
+	len = 0;
+	sqfs_test_put32(gen->img, &len, 0x73717368);
+	sqfs_test_put32(gen->img, &len, gen->count);
+	sqfs_test_put32(gen->img, &len, SQFS_TEST_MTIME);
+	sqfs_test_put32(gen->img, &len, SQFS_TEST_BLOCK_SIZE);
+	sqfs_test_put32(gen->img, &len, gen->nfrags);
+	sqfs_test_put16(gen->img, &len, 1);	/* zlib */
+	sqfs_test_put16(gen->img, &len, SQFS_TEST_BLOCK_LOG);
+	/* Uncompressed inodes, no extended attributes */
+	sqfs_test_put16(gen->img, &len, 0x0201);
+	sqfs_test_put16(gen->img, &len, 1);	/* ID count */
+	sqfs_test_put16(gen->img, &len, 4);	/* version 4.0 */
+	sqfs_test_put16(gen->img, &len, 0);
+	sqfs_test_put64(gen->img, &len, gen->nodes[root].iref);
+	sqfs_test_put64(gen->img, &len, gen->len);
+	sqfs_test_put64(gen->img, &len, id_table);
+	sqfs_test_put64(gen->img, &len, -1ULL);	/* no xattr table */
+	sqfs_test_put64(gen->img, &len, inode_table);
+	sqfs_test_put64(gen->img, &len, dir_table);
+	sqfs_test_put64(gen->img, &len, frag_table);
+	sqfs_test_put64(gen->img, &len, -1ULL);	/* no export table */
+
+	*imgp = gen->img;
+	len = gen->len;
+	free(gen);
+
+	return len;
+}
+
+/* Write the test image to the start of @desc */
+static int sqfs_write_image(struct unit_test_state *uts, struct blk_desc *desc)
+{
+	lbaint_t blkcnt;
+	uint len;
+	u8 *img;
+
+	len = sqfs_test_make_image(&img);
+	ut_assert(len);
+	blkcnt = DIV_ROUND_UP(len, desc->blksz);
+	ut_asserteq(blkcnt, blk_dwrite(desc, 0, blkcnt, img));
+	free(img);
+
+	return 0;
+}
+
+/* Read the file @path, called @name, with sqfs_read() and check its data */
+static int sqfs_check_file(struct unit_test_state *uts, const char *path,
+			   const char *name, uint size, u8 *buf)
+{
+	loff_t actread;
+	uint i;
+
+	memset(buf, '\0', size);
+	ut_assertok(sqfs_read(path, buf, 0, 0, &actread));
+	ut_asserteq(size, actread);
+	for (i = 0; i < size; i++)
+		ut_asserteq(sqfs_test_byte(name, i), buf[i]);
+
+	return 0;
+}
+
+/* Test reading files and directories from a SquashFS image */
+static int dm_test_sqfs_read(struct unit_test_state *uts)
+{
+	struct fs_dir_stream *dirs;
+	struct disk_partition info;
+	struct blk_desc *desc;
+	struct fs_dirent *dent;
+	char path[40], name[10];
+	loff_t size, actread;
+	int i, count;
+	u8 *buf;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	ut_assertok(sqfs_write_image(uts, desc));
+	ut_assertok(part_get_info_whole_disk(desc, &info));
+	buf = malloc(SQFS_TEST_BIG_SIZE);
+	ut_assertnonnull(buf);
+	fs_cache_flush();
+
+	ut_assertok(sqfs_probe(desc, &info));
+
+	/* Full blocks and a fragment */
+	ut_assertok(sqfs_check_file(uts, "/big.bin", "big.bin",
+				    SQFS_TEST_BIG_SIZE, buf));
+
+	/*
+	 * Read files in more fragment blocks than the cache holds, then read
+	 * them again, so that each is evicted and read back
+	 */
+	for (i = 0; i < 2 * SQFS_TEST_FRAG_FILES; i++) {
+		snprintf(name, sizeof(name), "f%d.bin",
+			 i % SQFS_TEST_FRAG_FILES);
+		snprintf(path, sizeof(path), "/frag/%s", name);
+		ut_assertok(sqfs_check_file(uts, path, name,
+					    SQFS_TEST_FRAG_SIZE, buf));
+	}
+
+	/* Two small files sharing a fragment block with a larger one */
+	ut_assertok(sqfs_read("/small/b.txt", buf, 0, 0, &actread));
+	ut_asserteq(13, actread);
+	ut_asserteq_mem("small file b\n", buf, actread);
+	ut_assertok(sqfs_read("/small/a.txt", buf, 0, 0, &actread));
+	ut_asserteq(13, actread);
+	ut_asserteq_mem("small file a\n", buf, actread);
+
+	/* The start of a file, ending part-way through its second block */
+	memset(buf, '\0', SQFS_TEST_BIG_SIZE);
+	ut_assertok(sqfs_read("/big.bin", buf, 0, 5000, &actread));
+	ut_asserteq(5000, actread);
+	for (i = 0; i < actread; i++)
+		ut_asserteq(sqfs_test_byte("big.bin", i), buf[i]);
+	ut_asserteq(0, buf[actread]);
+
+	/* A directory whose listing spans two metadata blocks */
+	ut_assertok(sqfs_opendir("/dir", &dirs));
+	for (count = 0; !sqfs_readdir(dirs, &dent); count++) {
+		snprintf(path, sizeof(path), "entry-%03d-with-a-long-name",
+			 count);
+		ut_asserteq_str(path, dent->name);
+		ut_asserteq(FS_DT_REG, dent->type);
+		ut_asserteq(0, dent->size);
+	}
+	sqfs_closedir(dirs);
+	ut_asserteq(SQFS_TEST_DIR_FILES, count);
+
+	/* Look up entries in each metadata block of the listing */
+	ut_asserteq(1, sqfs_exists("/dir/entry-000-with-a-long-name"));
+	ut_asserteq(1, sqfs_exists("/dir/entry-399-with-a-long-name"));
+	ut_asserteq(0, sqfs_exists("/dir/entry-400-with-a-long-name"));
+	ut_assertok(sqfs_size("/dir/entry-250-with-a-long-name", &size));
+	ut_asserteq(0, size);
+	ut_assertok(sqfs_size("/frag/f3.bin", &size));
+	ut_asserteq(SQFS_TEST_FRAG_SIZE, size);
+
+	sqfs_close();
+	ut_assert(!sqfs_is_mounted(desc, &info));
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_sqfs_read, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Load a file through the filesystem layer, as the 'load' command does */
+static int sqfs_load(struct unit_test_state *uts, struct blk_desc *desc,
+		     const char *path, u8 *buf)
+{
+	loff_t actread;
+
+	ut_assertok(fs_set_blk_dev_with_part(desc, 0));
+	ut_assertok(fs_read(path, map_to_sysmem(buf), 0, 0, &actread));
+	ut_asserteq(SQFS_TEST_FRAG_SIZE, actread);
+
+	return 0;
+}
+
+/* Test that the caches are kept from one command to the next */
+static int dm_test_sqfs_cache(struct unit_test_state *uts)
+{
+	struct sqfs_cache_stats first, stats;
+	struct blk_desc *desc;
+	u8 *buf;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	ut_assertok(sqfs_write_image(uts, desc));
+	buf = malloc(SQFS_TEST_FRAG_SIZE);
+	ut_assertnonnull(buf);
+	fs_cache_flush();
+
+	/* The first load reads the blocks it needs from the device */
+	ut_assertok(sqfs_load(uts, desc, "/frag/f2.bin", buf));
+	sqfs_get_cache_stats(&first);
+	ut_assert(first.meta_misses);
+	ut_asserteq(1, first.frag_misses);
+
+	/* The second finds them all in the cache */
+	ut_assertok(sqfs_load(uts, desc, "/frag/f2.bin", buf));
+	sqfs_get_cache_stats(&stats);
+	ut_asserteq(first.meta_misses, stats.meta_misses);
+	ut_assert(stats.meta_hits > first.meta_hits);
+	ut_asserteq(first.frag_misses, stats.frag_misses);
+	ut_asserteq(first.frag_hits + 1, stats.frag_hits);
+
+	/* Writing to the device drops the cached blocks */
+	ut_assertok(sqfs_write_image(uts, desc));
+	ut_assertok(sqfs_load(uts, desc, "/frag/f2.bin", buf));
+	sqfs_get_cache_stats(&stats);
+	ut_asserteq(first.meta_misses, stats.meta_misses);
+	ut_asserteq(first.meta_hits, stats.meta_hits);
+	ut_asserteq(1, stats.frag_misses);
+	ut_asserteq(0, stats.frag_hits);
+
+	fs_cache_flush();
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_sqfs_cache, UTF_SCAN_PDATA | UTF_SCAN_FDT);
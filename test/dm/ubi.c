@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for attaching UBI devices
+ */
+
+#include <command.h>
+#include <malloc.h>
+#include <mtd.h>
+#include <nand.h>
+#include <ubi_uboot.h>
+#include <u-boot/crc.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <linux/mtd/mtd.h>
+
+#define TEST_VOL_SIZE	0x10000
+
+/* Number of PEBs which UBI checks for a fastmap anchor (UBI_FM_MAX_START) */
+#define FM_MAX_START	64
+
+/* Count the good PEBs among the first @count of @mtd */
+static int count_good(struct mtd_info *mtd, int count)
+{
+	int i, good = 0;
+
+	for (i = 0; i < count; i++)
+		good += !mtd_block_isbad(mtd, (loff_t)i * mtd->erasesize);
+
+	return good;
+}
+
+/* Checksum the whole device, to see whether anything was written */
+static int crc_flash(struct unit_test_state *uts, struct mtd_info *mtd,
+		     u8 *buf, u32 *crcp)
+{
+	size_t len = mtd->size;
+
+	ut_assertok(nand_read_skip_bad(mtd, 0, &len, NULL, mtd->size, buf));
+	*crcp = crc32(0, buf, len);
+
+	return 0;
+}
+
+/* Write a volume, then check attaching from the fastmap written on detach */
+static int check_fastmap(struct unit_test_state *uts, struct mtd_info *mtd)
+{
+	nand_erase_options_t opts = { };
+	struct ubi_device *ubi;
+	u8 *src, *dst, *buf;
+	u32 crc, new_crc;
+	int i, pebs;
+
+	pebs = mtd_div_by_eb(mtd->size, mtd);
+	opts.length = mtd->size;
+	opts.quiet = 1;
+	ut_assertok(nand_erase_opts(mtd, &opts));
+
+	src = malloc(TEST_VOL_SIZE);
+	dst = malloc(TEST_VOL_SIZE);
+	buf = malloc(mtd->size);
+	ut_assertnonnull(src);
+	ut_assertnonnull(dst);
+	ut_assertnonnull(buf);
+	for (i = 0; i < TEST_VOL_SIZE; i++)
+		src[i] = i * 7;
+
+	/*
+	 * The sandbox NAND does not support sub-page writes, so put the VID
+	 * header in the second page. The first attach must scan everything.
+	 */
+	ut_assertok(run_command("ubi part nand0 512", 0));
+	ut_assert_skip_to_linen("ubi0: attach by scanning: %d PEBs scanned in ",
+				count_good(mtd, pebs));
+	ut_assertok(run_command("ubi create test 0x10000", 0));
+	ut_assertok(ubi_volume_write("test", src, 0, TEST_VOL_SIZE));
+	ut_assertok(run_command("ubi detach", 0));
+
+	/*
+	 * now only the PEBs which may hold the fastmap anchor are scanned,
+	 * along with the rest of the fastmap and the PEBs in its pools
+	 */
+	ut_assertok(run_command("ubi part nand0 512", 0));
+	ubi = ubi_devices[0];
+	ut_assertnonnull(ubi);
+	ut_assertnonnull(ubi->fm);
+	ut_assert(ubi->attach_pebs > count_good(mtd, FM_MAX_START) +
+				     ubi->fm->used_blocks - 1);
+	ut_assert_skip_to_linen("ubi0: attach from fastmap: %d PEBs scanned in ",
+				ubi->attach_pebs);
+	ut_assertok(ubi_volume_read("test", dst, 0, TEST_VOL_SIZE));
+	ut_asserteq_mem(src, dst, TEST_VOL_SIZE);
+
+	/* nothing changed, so the fastmap should not be written again */
+	ut_assertok(crc_flash(uts, mtd, buf, &crc));
+	ut_assertok(run_command("ubi detach", 0));
+	ut_assertok(crc_flash(uts, mtd, buf, &new_crc));
+	ut_asserteq(crc, new_crc);
+
+	ut_assertok(run_command("ubi part nand0 512", 0));
+	ut_assert_skip_to_linen("ubi0: attach from fastmap: ");
+	ut_assertok(run_command("ubi detach", 0));
+
+	free(buf);
+	free(dst);
+	free(src);
+
+	return 0;
+}
+
+/* Test that UBI writes a fastmap on detach and attaches from it */
+static int dm_test_ubi_fastmap(struct unit_test_state *uts)
+{
+	struct mtd_info *mtd;
+	uint threshold;
+	int ret;
+
+	/* use the same device as 'ubi part' */
+	mtd_probe_devices();
+	mtd = get_mtd_device_nm("nand0");
+	ut_assertok_ptr(mtd);
+	put_mtd_device(mtd);
+
+	/* the emulated bit errors are corrected, so don't ask for scrubbing */
+	threshold = mtd->bitflip_threshold;
+	mtd->bitflip_threshold = mtd->ecc_strength + 1;
+	ret = check_fastmap(uts, mtd);
+	mtd->bitflip_threshold = threshold;
+
+	return ret;
+}
+DM_TEST(dm_test_ubi_fastmap, UTF_SCAN_FDT | UTF_LIVE_TREE | UTF_CONSOLE);
@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the virtio-blk driver, using the sandbox transport to emulate
+ * the device
+ */
+
+#include <blk.h>
+#include <dm.h>
+#include <malloc.h>
+#include <virtio_types.h>
+#include <virtio.h>
+#include <asm/test.h>
+#include <dm/device-internal.h>
+#include <dm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <linux/sizes.h>
+
+#define TEST_BLOCKS	4096
+
+/* Give the emulated device a new disk, then probe the block device again */
+static int setup_disk(struct unit_test_state *uts, uint seg_max,
+		      uint size_max, bool indirect, struct udevice **busp,
+		      struct udevice **devp)
+{
+	struct udevice *bus, *dev;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_VIRTIO,
+					      "sandbox-virtio-blk", &bus));
+	ut_assertok(device_find_first_child(bus, &dev));
+	ut_asserteq(UCLASS_BLK, device_get_uclass_id(dev));
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(sandbox_virtio_blk_setup(bus, TEST_BLOCKS, seg_max,
+					     size_max, indirect));
+	ut_assertok(device_probe(dev));
+	*busp = bus;
+	*devp = dev;
+
+	return 0;
+}
+
+static void fill_buf(u8 *buf, uint len, uint seed)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = i * 3 + seed;
+}
+
+/* Test that a large request is split into chains added with one kick */
+static int dm_test_virtio_blk_batch(struct unit_test_state *uts)
+{
+	ulong notifies, chains, indirect, old_chains, old_indirect;
+	struct virtio_blk_stats old, stats;
+	struct udevice *bus, *dev;
+	struct blk_desc *desc;
+	struct blk_req req[2];
+	u8 *buf, *out;
+	int i;
+
+	/* 4 segments of 32 blocks, so 128 blocks in each chain */
+	ut_assertok(setup_disk(uts, 4, SZ_16K, true, &bus, &dev));
+	desc = dev_get_uclass_plat(dev);
+	ut_asserteq(TEST_BLOCKS, desc->lba);
+	ut_assertok(virtio_blk_get_stats(dev, &stats));
+	ut_asserteq(4, stats.seg_max);
+	ut_asserteq(128, stats.chain_blks);
+	ut_assert(stats.indirect);
+	ut_assert(stats.event_idx);
+
+	buf = malloc(SZ_1M);
+	out = malloc(SZ_1M);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(out);
+	fill_buf(buf, SZ_1M, 0);
+
+	/* Probing reads the partition table, so count from here */
+	ut_assertok(virtio_blk_get_stats(dev, &old));
+	sandbox_virtio_blk_get_counts(bus, &notifies, &old_chains,
+				      &old_indirect);
+
+	/*
+	 * 2048 blocks take 16 chains, each using one indirect descriptor.
+	 * The ring has four descriptors, so they are added four at a time
+	 */
+	ut_asserteq(2048, blk_write(dev, 100, 2048, buf));
+	ut_assertok(virtio_blk_get_stats(dev, &stats));
+	ut_asserteq(1, stats.reqs - old.reqs);
+	ut_asserteq(16, stats.chains - old.chains);
+	ut_asserteq(4, stats.kicks - old.kicks);
+	ut_asserteq(4, stats.notifies - old.notifies);
+	ut_asserteq(4, stats.max_inflight);
+	sandbox_virtio_blk_get_counts(bus, &notifies, &chains, &indirect);
+	ut_asserteq(16, chains - old_chains);
+	ut_asserteq(16, indirect - old_indirect);
+
+	ut_asserteq(2048, blk_read(dev, 100, 2048, out));
+	ut_asserteq_mem(buf, out, SZ_1M);
+
+	/* Requests submitted together complete in any order */
+	memset(out, '\0', SZ_1M);
+	memset(req, '\0', sizeof(req));
+	for (i = 0; i < 2; i++) {
+		req[i].op = BLK_REQ_READ;
+		req[i].start = 100 + i * 300;
+		req[i].blkcnt = 300;
+		req[i].buffer = out + i * 300 * 512;
+		ut_assertok(blk_submit(dev, &req[i]));
+	}
+	ut_asserteq(300, blk_wait(dev, &req[1]));
+	ut_asserteq(300, blk_wait(dev, &req[0]));
+	ut_asserteq_mem(buf, out, 600 * 512);
+
+	/* Write zeroes uses a single chain */
+	ut_asserteq(16, blk_erase(dev, 108, 16));
+	ut_asserteq(32, blk_read(dev, 100, 32, out));
+	ut_asserteq_mem(buf, out, 8 * 512);
+	memset(buf + 8 * 512, '\0', 16 * 512);
+	ut_asserteq_mem(buf, out, 32 * 512);
+
+	/* A read past the end of the disk fails */
+	ut_asserteq(-EIO, (long)blk_read(dev, TEST_BLOCKS - 1, 2, out));
+
+	free(out);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_virtio_blk_batch, UTF_SCAN_PDATA | UTF_SCAN_FDT);
+
+/* Test the limits on a chain when indirect descriptors are not available */
+static int dm_test_virtio_blk_direct(struct unit_test_state *uts)
+{
+	ulong notifies, chains, indirect;
+	struct virtio_blk_stats old, stats;
+	struct udevice *bus, *dev;
+	u8 buf[64 * 512], out[64 * 512];
+
+	/*
+	 * Each chain needs a header and status descriptor, leaving two of the
+	 * four for data, each of up to 8 blocks
+	 */
+	ut_assertok(setup_disk(uts, 8, SZ_4K, false, &bus, &dev));
+	ut_assertok(virtio_blk_get_stats(dev, &stats));
+	ut_asserteq(2, stats.seg_max);
+	ut_asserteq(16, stats.chain_blks);
+	ut_assert(!stats.indirect);
+	old = stats;
+
+	fill_buf(buf, sizeof(buf), 5);
+	ut_asserteq(64, blk_write(dev, 10, 64, buf));
+	ut_asserteq(64, blk_read(dev, 10, 64, out));
+	ut_asserteq_mem(buf, out, sizeof(buf));
+
+	/* Only one chain fits in the ring at a time */
+	ut_assertok(virtio_blk_get_stats(dev, &stats));
+	ut_asserteq(8, stats.chains - old.chains);
+	ut_asserteq(8, stats.kicks - old.kicks);
+	ut_asserteq(1, stats.max_inflight);
+	sandbox_virtio_blk_get_counts(bus, &notifies, &chains, &indirect);
+	ut_asserteq(stats.chains, chains);
+	ut_asserteq(0, indirect);
+
+	return 0;
+}
+DM_TEST(dm_test_virtio_blk_direct, UTF_SCAN_PDATA | UTF_SCAN_FDT);
@@ -5,6 +5,7 @@
 
 #include <abuf.h>
 #include <bootm.h>
+#include <bootstage.h>
 #include <command.h>
 #include <gzip.h>
 #include <image.h>
@@ -12,6 +13,8 @@
 #include <malloc.h>
 #include <mapmem.h>
 #include <asm/io.h>
+#include <asm/test.h>
+#include <asm/unaligned.h>
 
 #include <u-boot/lz4.h>
 #include <u-boot/zlib.h>
@@ -505,6 +508,150 @@ static int compression_test_zstd(struct unit_test_state *uts)
 }
 LIB_TEST(compression_test_zstd, 0);
 
+#if CONFIG_IS_ENABLED(DECOMP_PARALLEL)
+/* Number of frames or members in the parallel-decompression tests */
+#define PARALLEL_FRAMES		5
+
+/* Check that @out holds PARALLEL_FRAMES copies of the plain text */
+static int check_parallel_output(struct unit_test_state *uts, const char *out)
+{
+	int i, len = strlen(plain);
+
+	for (i = 0; i < PARALLEL_FRAMES; i++)
+		ut_asserteq_mem(plain, out + i * len, len);
+
+	return 0;
+}
+
+/* Decompress a multi-frame zstd image with @workers secondary CPUs */
+static int run_zstd_parallel(struct unit_test_state *uts, int workers)
+{
+	struct abuf in, out;
+	int i, len = strlen(plain);
+	ulong load_end;
+	uint cpu_us;
+	char *buf;
+
+	buf = malloc(zstd_compressed_size * PARALLEL_FRAMES);
+	ut_assertnonnull(buf);
+	for (i = 0; i < PARALLEL_FRAMES; i++)
+		memcpy(buf + i * zstd_compressed_size, zstd_compressed,
+		       zstd_compressed_size);
+	abuf_init_set(&in, buf, zstd_compressed_size * PARALLEL_FRAMES);
+	abuf_init(&out);
+	ut_assert(abuf_realloc(&out, len * PARALLEL_FRAMES));
+
+	sandbox_smp_set_workers(workers);
+	cpu_us = bootstage_accum_add(BOOTSTAGE_ID_ACCUM_DECOMP_CPU, NULL, 0);
+	ut_asserteq(len * PARALLEL_FRAMES, zstd_decompress_parallel(&in, &out));
+	ut_assertok(check_parallel_output(uts, abuf_data(&out)));
+	ut_assert(bootstage_accum_add(BOOTSTAGE_ID_ACCUM_DECOMP_CPU, NULL, 0) >=
+		  cpu_us);
+
+	/* Loading an image decompresses it the same way */
+	memset(abuf_data(&out), '\0', len * PARALLEL_FRAMES);
+	ut_assertok(image_decomp(IH_COMP_ZSTD, map_to_sysmem(abuf_data(&out)),
+				 map_to_sysmem(buf), IH_TYPE_KERNEL,
+				 abuf_data(&out), buf, abuf_size(&in),
+				 len * PARALLEL_FRAMES, &load_end));
+	ut_asserteq(map_to_sysmem(abuf_data(&out)) + len * PARALLEL_FRAMES,
+		    load_end);
+	ut_assertok(check_parallel_output(uts, abuf_data(&out)));
+
+	/* The output buffer must hold all the frames */
+	abuf_realloc(&out, len * PARALLEL_FRAMES - 1);
+	ut_asserteq(-ENOSPC, zstd_decompress_parallel(&in, &out));
+	sandbox_smp_set_workers(CONFIG_SMP_WORKERS_MAX);
+
+	abuf_uninit(&out);
+	free(buf);
+
+	return 0;
+}
+
+static int compression_test_zstd_parallel(struct unit_test_state *uts)
+{
+	ut_assertok(run_zstd_parallel(uts, CONFIG_SMP_WORKERS_MAX));
+	ut_assertok(run_zstd_parallel(uts, 0));
+
+	return 0;
+}
+LIB_TEST(compression_test_zstd_parallel, 0);
+
+/* An empty BGZF member, as bgzip writes at the end of a file */
+static const char bgzf_eof[] =
+	"\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43"
+	"\x02\x00\x1b\x00\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+
+/*
+ * Compress the plain text into a BGZF member at @out, by adding a 'BC'
+ * subfield holding the member size to the header written by gzip(). Returns
+ * the size of the member.
+ */
+static int compress_bgzf_member(struct unit_test_state *uts, char *out,
+				ulong out_max)
+{
+	ulong len = out_max - 8;
+	char *gz = out + 8;
+
+	/* Leave room for the extra field between the header and the data */
+	ut_assertok(gzip(gz, &len, (void *)plain, strlen(plain)));
+	ut_asserteq(0, gz[3]);
+	memmove(out, gz, 10);
+	out[3] = 4;
+	memcpy(out + 10, "\x06\x00" "BC" "\x02\x00", 6);
+	put_unaligned_le16(len + 8 - 1, out + 16);
+
+	return len + 8;
+}
+
+/* Decompress a BGZF image with @workers secondary CPUs */
+static int run_gzip_parallel(struct unit_test_state *uts, int workers)
+{
+	int i, size, len = strlen(plain);
+	ulong in_size;
+	char *buf, *out;
+
+	buf = malloc(TEST_BUFFER_SIZE * (PARALLEL_FRAMES + 1));
+	out = malloc(len * PARALLEL_FRAMES);
+	ut_assertnonnull(buf);
+	ut_assertnonnull(out);
+
+	size = compress_bgzf_member(uts, buf, TEST_BUFFER_SIZE);
+	ut_assert(size > 0);
+	for (i = 1; i < PARALLEL_FRAMES; i++)
+		memcpy(buf + i * size, buf, size);
+	in_size = size * PARALLEL_FRAMES;
+	memcpy(buf + in_size, bgzf_eof, sizeof(bgzf_eof) - 1);
+	in_size += sizeof(bgzf_eof) - 1;
+
+	sandbox_smp_set_workers(workers);
+	ut_assertok(gunzip_parallel(out, len * PARALLEL_FRAMES, (void *)buf,
+				    &in_size));
+	ut_asserteq(len * PARALLEL_FRAMES, in_size);
+	ut_assertok(check_parallel_output(uts, out));
+
+	in_size = size * PARALLEL_FRAMES;
+	ut_asserteq(-ENOSPC, gunzip_parallel(out, len * PARALLEL_FRAMES - 1,
+					     (void *)buf, &in_size));
+	sandbox_smp_set_workers(CONFIG_SMP_WORKERS_MAX);
+
+	free(out);
+	free(buf);
+
+	return 0;
+}
+
+static int compression_test_gzip_parallel(struct unit_test_state *uts)
+{
+	ut_assertok(run_gzip_parallel(uts, CONFIG_SMP_WORKERS_MAX));
+	ut_assertok(run_gzip_parallel(uts, 0));
+
+	return 0;
+}
+LIB_TEST(compression_test_gzip_parallel, 0);
+#endif
+
 static int compress_using_none(struct unit_test_state *uts,
 			       void *in, unsigned long in_size,
 			       void *out, unsigned long out_max,
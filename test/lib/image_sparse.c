@@ -0,0 +1,358 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for writing sparse images in pieces
+ */
+
+#include <image-sparse.h>
+#include <malloc.h>
+#include <sparse_format.h>
+#include <asm/cache.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define TEST_BLKSZ	512
+#define TEST_BLKS	32
+#define TEST_START	4
+#define TEST_SIZE	20
+#define TEST_BUF_SIZE	(4 * TEST_BLKSZ)
+#define TEST_EXTRA	4	/* extra bytes in each header */
+
+/**
+ * struct sparse_test - memory-backed storage for the tests
+ *
+ * @mem: Contents of the 'device'
+ * @msg: Last message reported through mssg()
+ * @blk: Start block of the outstanding write
+ * @blkcnt: Number of blocks in the outstanding write, 0 if none
+ * @buffer: Buffer of the outstanding write
+ * @submits: Number of calls to submit()
+ * @overlap: Number of times submit() was called with a write outstanding
+ */
+struct sparse_test {
+	u8 mem[TEST_BLKS * TEST_BLKSZ];
+	char msg[80];
+	lbaint_t blk;
+	lbaint_t blkcnt;
+	const void *buffer;
+	int submits;
+	int overlap;
+};
+
+static struct sparse_test *test_priv;
+
+static lbaint_t test_write(struct sparse_storage *info, lbaint_t blk,
+			   lbaint_t blkcnt, const void *buffer)
+{
+	struct sparse_test *priv = info->priv;
+
+	memcpy(priv->mem + blk * TEST_BLKSZ, buffer, blkcnt * TEST_BLKSZ);
+
+	return blkcnt;
+}
+
+static lbaint_t test_reserve(struct sparse_storage *info, lbaint_t blk,
+			     lbaint_t blkcnt)
+{
+	return blkcnt;
+}
+
+static int test_submit(struct sparse_storage *info, lbaint_t blk,
+		       lbaint_t blkcnt, const void *buffer)
+{
+	struct sparse_test *priv = info->priv;
+
+	if (priv->blkcnt)
+		priv->overlap++;
+	priv->submits++;
+	priv->blk = blk;
+	priv->blkcnt = blkcnt;
+	priv->buffer = buffer;
+
+	return 0;
+}
+
+static lbaint_t test_wait(struct sparse_storage *info)
+{
+	struct sparse_test *priv = info->priv;
+	lbaint_t blkcnt = priv->blkcnt;
+
+	test_write(info, priv->blk, blkcnt, priv->buffer);
+	priv->blkcnt = 0;
+
+	return blkcnt;
+}
+
+static void test_mssg(const char *str, char *response)
+{
+	strlcpy(test_priv->msg, str, sizeof(test_priv->msg));
+}
+
+/* Add a chunk header, with TEST_EXTRA bytes of padding */
+static void *add_chunk(void *ptr, uint type, uint blks, uint data_size)
+{
+	chunk_header_t *chunk = ptr;
+
+	chunk->chunk_type = type;
+	chunk->reserved1 = 0;
+	chunk->chunk_sz = blks;
+	chunk->total_sz = sizeof(*chunk) + TEST_EXTRA + data_size;
+	memset(ptr + sizeof(*chunk), 0xee, TEST_EXTRA);
+
+	return ptr + sizeof(*chunk) + TEST_EXTRA;
+}
+
+/*
+ * Create a sparse image with raw, fill, don't-care, CRC and raw chunks, along
+ * with the expected contents of the device after writing it
+ */
+static int setup_image(u8 *image, u8 *expect)
+{
+	sparse_header_t *hdr = (sparse_header_t *)image;
+	u8 *ptr;
+	int i;
+
+	memset(hdr, '\0', sizeof(*hdr));
+	hdr->magic = SPARSE_HEADER_MAGIC;
+	hdr->major_version = 1;
+	hdr->file_hdr_sz = sizeof(*hdr) + TEST_EXTRA;
+	hdr->chunk_hdr_sz = sizeof(chunk_header_t) + TEST_EXTRA;
+	hdr->blk_sz = TEST_BLKSZ;
+	hdr->total_blks = 10;
+	hdr->total_chunks = 5;
+	ptr = image + sizeof(*hdr);
+	memset(ptr, 0xee, TEST_EXTRA);
+	ptr += TEST_EXTRA;
+
+	memset(expect, 0xcc, TEST_BLKS * TEST_BLKSZ);
+
+	/* three raw blocks, so that the staging buffer fills */
+	ptr = add_chunk(ptr, CHUNK_TYPE_RAW, 3, 3 * TEST_BLKSZ);
+	for (i = 0; i < 3 * TEST_BLKSZ; i++)
+		*ptr++ = i ^ 0x5a;
+	memcpy(expect + TEST_START * TEST_BLKSZ, ptr - 3 * TEST_BLKSZ,
+	       3 * TEST_BLKSZ);
+
+	/* two filled blocks */
+	ptr = add_chunk(ptr, CHUNK_TYPE_FILL, 2, sizeof(u32));
+	*(u32 *)ptr = 0x12345678;
+	ptr += sizeof(u32);
+	for (i = 0; i < 2 * TEST_BLKSZ; i += sizeof(u32))
+		*(u32 *)(expect + (TEST_START + 3) * TEST_BLKSZ + i) =
+			0x12345678;
+
+	/* four blocks left alone */
+	ptr = add_chunk(ptr, CHUNK_TYPE_DONT_CARE, 4, 0);
+
+	ptr = add_chunk(ptr, CHUNK_TYPE_CRC32, 0, sizeof(u32));
+	*(u32 *)ptr = 0xdeadbeef;
+	ptr += sizeof(u32);
+
+	/* a final raw block */
+	ptr = add_chunk(ptr, CHUNK_TYPE_RAW, 1, TEST_BLKSZ);
+	for (i = 0; i < TEST_BLKSZ; i++)
+		*ptr++ = i ^ 0xa5;
+	memcpy(expect + (TEST_START + 9) * TEST_BLKSZ, ptr - TEST_BLKSZ,
+	       TEST_BLKSZ);
+
+	return ptr - image;
+}
+
+/* Write @image in pieces of @step bytes, optionally using submit() */
+static int write_image(struct unit_test_state *uts, struct sparse_test *priv,
+		       const u8 *image, int size, int step, bool async)
+{
+	struct sparse_storage info = {
+		.blksz = TEST_BLKSZ,
+		.start = TEST_START,
+		.size = TEST_SIZE,
+		.priv = priv,
+		.write = test_write,
+		.reserve = test_reserve,
+		.mssg = test_mssg,
+	};
+	struct sparse_stream ss;
+	void *buf;
+	int pos, ret;
+
+	if (async) {
+		info.submit = test_submit;
+		info.wait = test_wait;
+	}
+	test_priv = priv;
+	memset(priv->mem, 0xcc, sizeof(priv->mem));
+	*priv->msg = '\0';
+	priv->submits = 0;
+	priv->overlap = 0;
+
+	buf = memalign(ARCH_DMA_MINALIGN, TEST_BUF_SIZE);
+	ut_assertnonnull(buf);
+	ut_assertok(sparse_stream_start(&ss, &info, buf, TEST_BUF_SIZE));
+	for (pos = 0, ret = 0; pos < size && !ret; pos += step)
+		ret = sparse_stream_write(&ss, image + pos,
+					  min(step, size - pos), NULL);
+	if (!ret)
+		ret = sparse_stream_finish(&ss, "test", NULL);
+	else
+		sparse_stream_finish(&ss, "test", NULL);
+	free(buf);
+
+	/* nothing may be left outstanding */
+	ut_asserteq(0, priv->blkcnt);
+	ut_asserteq(0, priv->overlap);
+
+	return ret;
+}
+
+/* Test writing a sparse image in pieces of various sizes */
+static int lib_test_sparse_stream(struct unit_test_state *uts)
+{
+	const int steps[] = {1, 7, 100, TEST_BLKSZ, 0x10000};
+	struct sparse_storage info = {
+		.blksz = TEST_BLKSZ,
+		.start = TEST_START,
+		.size = TEST_SIZE,
+		.write = test_write,
+		.reserve = test_reserve,
+		.mssg = test_mssg,
+	};
+	struct sparse_test *priv;
+	u8 *image, *expect;
+	int size, i, async;
+
+	priv = calloc(1, sizeof(*priv));
+	image = malloc(TEST_BLKS * TEST_BLKSZ);
+	expect = malloc(TEST_BLKS * TEST_BLKSZ);
+	ut_assertnonnull(priv);
+	ut_assertnonnull(image);
+	ut_assertnonnull(expect);
+	size = setup_image(image, expect);
+
+	for (async = 0; async < 2; async++) {
+		for (i = 0; i < ARRAY_SIZE(steps); i++) {
+			ut_assertok(write_image(uts, priv, image, size,
+						steps[i], async));
+			ut_asserteq_mem(expect, priv->mem, sizeof(priv->mem));
+			ut_asserteq_str("", priv->msg);
+		}
+		/* 2 + 1 blocks, then the last block, in 1K buffers */
+		ut_asserteq(async ? 3 : 0, priv->submits);
+	}
+
+	/* write_sparse_image() should give the same result */
+	memset(priv->mem, 0xcc, sizeof(priv->mem));
+	info.priv = priv;
+	ut_assertok(write_sparse_image(&info, "test", image, NULL));
+	ut_asserteq_mem(expect, priv->mem, sizeof(priv->mem));
+
+	free(expect);
+	free(image);
+	free(priv);
+
+	return 0;
+}
+LIB_TEST(lib_test_sparse_stream, 0);
+
+/* Test that broken sparse images are rejected */
+static int lib_test_sparse_stream_bad(struct unit_test_state *uts)
+{
+	struct sparse_test *priv;
+	sparse_header_t *hdr;
+	u8 *image, *expect;
+	int size, async;
+
+	priv = calloc(1, sizeof(*priv));
+	image = malloc(TEST_BLKS * TEST_BLKSZ);
+	expect = malloc(TEST_BLKS * TEST_BLKSZ);
+	ut_assertnonnull(priv);
+	ut_assertnonnull(image);
+	ut_assertnonnull(expect);
+	size = setup_image(image, expect);
+	hdr = (sparse_header_t *)image;
+
+	for (async = 0; async < 2; async++) {
+		/* truncated in the middle of the last chunk */
+		ut_asserteq(-EIO, write_image(uts, priv, image, size - 10, 100,
+					      async));
+		ut_asserteq_str("incomplete image", priv->msg);
+
+		/* wrong number of blocks */
+		hdr->total_blks++;
+		ut_asserteq(-EIO, write_image(uts, priv, image, size, 100,
+					      async));
+		ut_asserteq_str("sparse image write failure", priv->msg);
+		hdr->total_blks--;
+
+		/* chunk size which does not match its data */
+		hdr->total_blks += TEST_SIZE;
+		((chunk_header_t *)(image + hdr->file_hdr_sz))->chunk_sz +=
+			TEST_SIZE;
+		ut_asserteq(-EIO, write_image(uts, priv, image, size, 100,
+					      async));
+		ut_asserteq_str("Bogus chunk size for chunk type Raw",
+				priv->msg);
+		((chunk_header_t *)(image + hdr->file_hdr_sz))->chunk_sz -=
+			TEST_SIZE;
+		hdr->total_blks -= TEST_SIZE;
+
+		/* block size which is not a multiple of the device's */
+		hdr->blk_sz = TEST_BLKSZ / 2;
+		ut_asserteq(-EIO, write_image(uts, priv, image, size, 100,
+					      async));
+		ut_asserteq_str("sparse image block size issue", priv->msg);
+		hdr->blk_sz = TEST_BLKSZ;
+	}
+
+	free(expect);
+	free(image);
+	free(priv);
+
+	return 0;
+}
+LIB_TEST(lib_test_sparse_stream_bad, 0);
+
+/* Test writing an image which is not sparse */
+static int lib_test_sparse_stream_raw(struct unit_test_state *uts)
+{
+	struct sparse_test *priv;
+	u8 *image, *expect;
+	int size, i, async;
+
+	priv = calloc(1, sizeof(*priv));
+	image = malloc(TEST_BLKS * TEST_BLKSZ);
+	expect = malloc(TEST_BLKS * TEST_BLKSZ);
+	ut_assertnonnull(priv);
+	ut_assertnonnull(image);
+	ut_assertnonnull(expect);
+
+	/* 5.5 blocks, with the last one padded with zeroes */
+	size = 5 * TEST_BLKSZ + TEST_BLKSZ / 2;
+	for (i = 0; i < size; i++)
+		image[i] = i * 7;
+	memset(expect, 0xcc, TEST_BLKS * TEST_BLKSZ);
+	memcpy(expect + TEST_START * TEST_BLKSZ, image, size);
+	memset(expect + TEST_START * TEST_BLKSZ + size, '\0', TEST_BLKSZ / 2);
+
+	for (async = 0; async < 2; async++) {
+		ut_assertok(write_image(uts, priv, image, size, 300, async));
+		ut_asserteq_mem(expect, priv->mem, sizeof(priv->mem));
+
+		/* shorter than a sparse header */
+		ut_assertok(write_image(uts, priv, image, 10, 3, async));
+		ut_asserteq_mem(image, priv->mem + TEST_START * TEST_BLKSZ,
+				10);
+
+		/* too large for the partition */
+		ut_asserteq(-EIO, write_image(uts, priv, image,
+					      (TEST_SIZE + 1) * TEST_BLKSZ,
+					      TEST_BLKSZ, async));
+		ut_asserteq_str("too large for partition", priv->msg);
+	}
+
+	free(expect);
+	free(image);
+	free(priv);
+
+	return 0;
+}
+LIB_TEST(lib_test_sparse_stream_raw, 0);
@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for crc32 and crc32c
+ *
+ * The optimised implementations are checked against a bit-at-a-time
+ * reference over a range of lengths and alignments, so that the unaligned
+ * head, the eight-byte loop and the tail are all exercised.
+ */
+
+#include <malloc.h>
+#include <time.h>
+#include <test/lib.h>
+#include <test/ut.h>
+#include <linux/sizes.h>
+#include <u-boot/crc.h>
+
+#define CRC32_POLY	0xedb88320
+#define CRC32C_POLY	0x82f63b78
+
+/* Bit-at-a-time CRC with no inversion, for comparison */
+static u32 ref_crc(u32 crc, const u8 *buf, uint len, u32 poly)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *buf++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+	}
+
+	return crc;
+}
+
+static void fill_buf(u8 *buf, uint len)
+{
+	u32 seed = 0x12345678;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = seed >> 16;
+	}
+}
+
+static int lib_crc32(struct unit_test_state *uts)
+{
+	const u8 check[] = "123456789";
+	uint offset, len;
+	u8 buf[200];
+	u32 seed;
+
+	ut_asserteq(0xcbf43926, crc32(0, check, 9));
+	ut_asserteq(0xcbf43926, crc32(crc32(0, check, 4), check + 4, 5));
+	ut_asserteq(0, crc32(0, check, 0));
+
+	fill_buf(buf, sizeof(buf));
+	for (offset = 0; offset < 8; offset++) {
+		for (len = 0; len < sizeof(buf) - offset; len++) {
+			seed = len * 0x01010101;
+			ut_asserteq(ref_crc(seed, buf + offset, len, CRC32_POLY),
+				    crc32_no_comp(seed, buf + offset, len));
+			ut_asserteq(~ref_crc(~seed, buf + offset, len,
+					     CRC32_POLY),
+				    crc32(seed, buf + offset, len));
+		}
+	}
+
+	return 0;
+}
+LIB_TEST(lib_crc32, 0);
+
+static int lib_crc32c(struct unit_test_state *uts)
+{
+	const char check[] = "123456789";
+	u32 table[256], seed;
+	uint offset, len;
+	char buf[200];
+
+	if (!IS_ENABLED(CONFIG_CRC32C))
+		return -EAGAIN;
+
+	/* A Castagnoli table uses the optimised code */
+	crc32c_init(table, CRC32C_POLY);
+	ut_asserteq(0xe3069283, ~crc32c_cal(~0, check, 9, table));
+
+	fill_buf((u8 *)buf, sizeof(buf));
+	for (offset = 0; offset < 8; offset++) {
+		for (len = 0; len < sizeof(buf) - offset; len++) {
+			seed = len * 0x01010101;
+			ut_asserteq(ref_crc(seed, (u8 *)buf + offset, len,
+					    CRC32C_POLY),
+				    crc32c_cal(seed, buf + offset, len, table));
+		}
+	}
+
+	/* Any other polynomial uses the table provided */
+	crc32c_init(table, CRC32_POLY);
+	ut_asserteq(0xcbf43926, ~crc32c_cal(~0, check, 9, table));
+	ut_asserteq(ref_crc(0, (u8 *)buf + 3, 150, CRC32_POLY),
+		    crc32c_cal(0, buf + 3, 150, table));
+
+	return 0;
+}
+LIB_TEST(lib_crc32c, 0);
+
+/* Compare the speed of crc32() with a byte-at-a-time table lookup */
+static int lib_crc32_bench(struct unit_test_state *uts)
+{
+	const uint size = SZ_1M;
+	ulong start, ref_us, us;
+	u32 table[256], crc;
+	u8 *buf;
+	int i;
+
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	fill_buf(buf, size);
+	for (i = 0; i < 256; i++) {
+		u8 byte = i;
+
+		table[i] = ref_crc(0, &byte, 1, CRC32_POLY);
+	}
+
+	start = timer_get_us();
+	crc = ~0;
+	for (i = 0; i < size; i++)
+		crc = table[(u8)(crc ^ buf[i])] ^ (crc >> 8);
+	ref_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	ut_asserteq(~crc, crc32(0, buf, size));
+	us = timer_get_us() - start;
+	free(buf);
+
+	printf("crc32: table %lu MB/s, crc32() %lu MB/s\n",
+	       size / max(ref_us, 1UL), size / max(us, 1UL));
+
+	return 0;
+}
+LIB_TEST(lib_crc32_bench, 0);
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Test cooperative threads
+ */
+
+#include <time.h>
+#include <uthread.h>
+#include <linux/delay.h>
+#include <asm/global_data.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Number of threads in each test */
+#define TEST_THREADS	4
+
+/* Delay in each thread in lib_uthread_delay, in milliseconds */
+#define TEST_DELAY_MS	50
+
+/**
+ * struct uthread_test - state shared between test threads
+ *
+ * @count: Number of steps taken by each thread
+ * @order: Thread which took each step
+ * @steps: Total number of steps taken
+ * @gd: Global data pointer seen by a thread
+ * @gd_flags: Global data flags seen by a thread
+ */
+struct uthread_test {
+	int count[TEST_THREADS];
+	int order[TEST_THREADS * 3];
+	int steps;
+	gd_t *gd;
+	ulong gd_flags;
+};
+
+static struct uthread_test test;
+
+/* Take three steps, yielding after each one */
+static void uthread_step_thread(void *arg)
+{
+	int i, id = (ulong)arg;
+
+	for (i = 0; i < 3; i++) {
+		test.count[id]++;
+		test.order[test.steps++] = id;
+		schedule();
+	}
+}
+
+/* Test that threads take turns and that a group can be waited for */
+static int lib_uthread_basic(struct unit_test_state *uts)
+{
+	uint grp_id;
+	int i;
+
+	memset(&test, '\0', sizeof(test));
+	ut_assert(!uthread_active());
+	grp_id = uthread_grp_new_id();
+	ut_assert(grp_id);
+	for (i = 0; i < TEST_THREADS; i++)
+		ut_assertok(uthread_create(NULL, uthread_step_thread,
+					   (void *)(ulong)i, 0, grp_id));
+	ut_assert(uthread_active());
+	ut_assert(!uthread_grp_done(grp_id));
+
+	uthread_grp_wait(grp_id);
+	ut_assert(uthread_grp_done(grp_id));
+	ut_asserteq(TEST_THREADS * 3, test.steps);
+
+	/* Each thread takes one step per turn, in the order they were made */
+	for (i = 0; i < TEST_THREADS * 3; i++)
+		ut_asserteq(i % TEST_THREADS, test.order[i]);
+
+	/* The finished threads are freed on the next yield */
+	ut_assert(!uthread_schedule());
+	ut_assert(!uthread_active());
+
+	return 0;
+}
+LIB_TEST(lib_uthread_basic, 0);
+
+/* Wait for a while, letting other threads run */
+static void uthread_delay_thread(void *arg)
+{
+	int id = (ulong)arg;
+
+	mdelay(TEST_DELAY_MS);
+	test.count[id]++;
+}
+
+/* Test that delays in several threads overlap */
+static int lib_uthread_delay(struct unit_test_state *uts)
+{
+	ulong start, elapsed;
+	uint grp_id;
+	int i;
+
+	memset(&test, '\0', sizeof(test));
+	grp_id = uthread_grp_new_id();
+	start = get_timer(0);
+	for (i = 0; i < TEST_THREADS; i++)
+		ut_assertok(uthread_create(NULL, uthread_delay_thread,
+					   (void *)(ulong)i, 0, grp_id));
+	uthread_grp_wait(grp_id);
+	elapsed = get_timer(start);
+
+	for (i = 0; i < TEST_THREADS; i++)
+		ut_asserteq(1, test.count[i]);
+
+	/* Run one after another, this would take TEST_THREADS times as long */
+	ut_assert(elapsed >= TEST_DELAY_MS);
+	ut_assert(elapsed < TEST_DELAY_MS * 2);
+
+	return 0;
+}
+LIB_TEST(lib_uthread_delay, 0);
+
+/* Record the global data seen by a thread */
+static void uthread_gd_thread(void *arg)
+{
+	test.gd = (gd_t *)gd;
+	test.gd_flags = gd->flags;
+}
+
+/*
+ * Test that a thread starts with the same global data as its creator. Some
+ * architectures, such as 32-bit ARM, keep gd in a register which must be set
+ * up when the thread starts.
+ */
+static int lib_uthread_gd(struct unit_test_state *uts)
+{
+	uint grp_id;
+
+	memset(&test, '\0', sizeof(test));
+	grp_id = uthread_grp_new_id();
+	ut_assertok(uthread_create(NULL, uthread_gd_thread, NULL, 0, grp_id));
+	uthread_grp_wait(grp_id);
+
+	ut_asserteq_ptr(gd, test.gd);
+	ut_asserteq(gd->flags, test.gd_flags);
+
+	return 0;
+}
+LIB_TEST(lib_uthread_gd, 0);
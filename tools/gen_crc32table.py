@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0+
+
+"""
+Generate the slice-by-8 tables used by lib/crc32.c and lib/crc32c.c
+
+Usage:
+    tools/gen_crc32table.py crc32 >lib/crc32table.h
+    tools/gen_crc32table.py crc32c >lib/crc32ctable.h
+"""
+
+import argparse
+
+# name: (bit-reflected polynomial, description, table name, attributes)
+TABLES = {
+    'crc32': (0xedb88320, 'CRC32', 'crc32table_le', '__efi_runtime_rodata '),
+    'crc32c': (0x82f63b78, 'CRC32C (Castagnoli)', 'crc32ctable_le', ''),
+}
+
+def make_tables(poly):
+    """Make the tables for a bit-reflected polynomial
+
+    Args:
+        poly (int): Polynomial, bit-reflected
+
+    Returns:
+        list of list of int: 8 tables of 256 entries, where entry n of table
+            k is the CRC of byte n followed by k zero bytes
+    """
+    tables = [[0] * 256 for _ in range(8)]
+    for n in range(256):
+        crc = n
+        for _ in range(8):
+            crc = (crc >> 1) ^ (poly if crc & 1 else 0)
+        tables[0][n] = crc
+    for k in range(1, 8):
+        for n in range(256):
+            crc = tables[k - 1][n]
+            tables[k][n] = (crc >> 8) ^ tables[0][crc & 0xff]
+    return tables
+
+def write_header(name):
+    """Write the header file for a CRC to stdout
+
+    Args:
+        name (str): CRC to generate, a key of TABLES
+    """
+    poly, desc, var, attr = TABLES[name]
+    print('/* SPDX-License-Identifier: GPL-2.0+ */')
+    print('/* Generated by tools/gen_crc32table.py - do not edit */')
+    print()
+    print('/*')
+    print(f' * Slice-by-8 tables for the {desc} polynomial 0x{poly:08x} '
+          '(bit-reflected).')
+    print(f' * {var}[k][n] is the CRC of byte n followed by k zero bytes.')
+    print(' */')
+    print(f'static const uint32_t {attr}{var}[8][256] = {{')
+    tables = make_tables(poly)
+    for k, table in enumerate(tables):
+        print('{')
+        for i in range(0, 256, 4):
+            line = ', '.join(f'0x{val:08x}' for val in table[i:i + 4])
+            print(line + (',' if i + 4 < 256 else ''))
+        print('}' + (',' if k < len(tables) - 1 else ''))
+    print('};')
+
+def main():
+    """Parse arguments and write the requested header"""
+    parser = argparse.ArgumentParser(
+        description='Generate CRC32 slice-by-8 tables')
+    parser.add_argument('crc', choices=sorted(TABLES), help='CRC to generate')
+    args = parser.parse_args()
+    write_header(args.crc)
+
+if __name__ == '__main__':
+    main()